@@ -6,7 +6,14 @@
 #include <memory.h>
 #include <sys/syslog.h>
 #include <unistd.h>
+#include <stdarg.h>
+#include <poll.h>
 #include "client.h"
+#include "response_parser.h"
+#include "../message.h"
+#include "../frame.h"
+#include "../protocol.h"
+#include "../utils.h"
 
 /** Estructura cliente */
 struct client {
@@ -16,19 +23,60 @@ struct client {
     struct sockaddr_storage server_address;
     socklen_t               server_address_len;
     int                     server_domain;
+
+    // formato de los pedidos
+    bool binary;
+
+    // bytes leidos que pertenecen a las respuestas siguientes, si se encadenaron pedidos
+    char   pending[BUFFER_SIZE];
+    size_t pending_len;
+
+    // id del proximo pedido con id
+    uint32_t next_id;
+    // respuestas con id que llegaron antes que la que se esperaba
+    Response ** early;
+    int         early_count;
+    int         early_size;
+
+    // SEATS_CHANGED que mando el server a las suscripciones, en orden de llegada
+    Response ** changes;
+    int         changes_count;
+    int         changes_size;
+};
+
+/** Argumento de un BATCH, se serializa recien al enviarlo segun el formato del cliente */
+typedef struct {
+    char type;
+    int value;
+    char string[ARG_SIZE];
+} BatchArg;
+
+struct client_batch {
+    int requests;
+    int argc;
+    BatchArg args[MAX_BATCH_ARGS];
 };
 
 static int resolve_server_address(char * hostname, int port, Client client);
 static int connect_to_server(Client client);
 
-Client client_init(char *hostname, int port) {
+Client client_init(char *hostname, int port, char * unix_path) {
 
     Client client = malloc(sizeof(struct client));
     if (client == NULL) {
         return NULL;
     }
 
-    if (resolve_server_address(hostname, port, client) < 0) {
+    if (unix_path != NULL) {
+        // server en el mismo host, sin pasar por TCP
+        client->server_address_len = unix_address(unix_path, (struct sockaddr_un *) &client->server_address);
+        client->server_domain      = AF_UNIX;
+        if (client->server_address_len == 0) {
+            fprintf(stderr, "Invalid unix socket path '%s'.\n", unix_path);
+            free(client);
+            return NULL;
+        }
+    } else if (resolve_server_address(hostname, port, client) < 0) {
         free(client);
         return NULL;
     }
@@ -37,8 +85,19 @@ Client client_init(char *hostname, int port) {
         free(client);
         return NULL;
     }
+    client->binary = false;
+    client->pending_len = 0;
+    client->next_id = 1;
+    client->early = NULL;
+    client->early_count = client->early_size = 0;
+    client->changes = NULL;
+    client->changes_count = client->changes_size = 0;
 
-    syslog(LOG_DEBUG, "[CLIENT] connected to %s:%d", hostname, port);
+    if (unix_path != NULL) {
+        syslog(LOG_DEBUG, "[CLIENT] connected to %s", unix_path);
+    } else {
+        syslog(LOG_DEBUG, "[CLIENT] connected to %s:%d", hostname, port);
+    }
 
     return client;
 }
@@ -79,7 +138,7 @@ int resolve_server_address(char * hostname, int port, Client client) {
 
 int connect_to_server(Client client) {
     // create client socket
-    int fd = socket(client->server_domain, SOCK_STREAM, IPPROTO_TCP);
+    int fd = socket(client->server_domain, SOCK_STREAM, 0);
     if (fd < 0) {
         perror("socket() failed");
         return -1;
@@ -96,14 +155,24 @@ int connect_to_server(Client client) {
     return 0;
 }
 
-ssize_t client_send(Client client, char * buff) {
-    ssize_t n = send(client->fd, buff, strlen(buff), MSG_NOSIGNAL);
-    if (n <= 0) {
-        fprintf(stderr, "Connection lost. Exiting\n");
-        client_close(client);
-        exit(-1);
+/** Sends len bytes, exits if the connection is lost */
+static ssize_t send_all(Client client, const char * buff, size_t len) {
+    size_t sent = 0;
+
+    while (sent < len) {
+        ssize_t n = send(client->fd, buff + sent, len - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            fprintf(stderr, "Connection lost. Exiting\n");
+            client_close(client);
+            exit(-1);
+        }
+        sent += (size_t) n;
     }
-    return n;
+    return (ssize_t) sent;
+}
+
+ssize_t client_send(Client client, char * buff) {
+    return send_all(client, buff, strlen(buff));
 }
 
 ssize_t client_recv(Client client, char * buff) {
@@ -116,7 +185,324 @@ ssize_t client_recv(Client client, char * buff) {
     return n;
 }
 
+void client_set_binary(Client client, bool binary) {
+    client->binary = binary;
+}
+
+/** Serializes the text request in buffer, returns its length */
+static size_t text_request(char * buffer, int request_type, const uint32_t * id, const char * fmt, va_list ap) {
+    char * aux = buffer;
+
+    if (id != NULL) {
+        aux += sprintf(aux, "%d%c%u\n", request_type, REQUEST_ID_SEPARATOR, *id);
+    } else {
+        aux += sprintf(aux, "%d\n", request_type);
+    }
+    while(*fmt != 0) {
+        char c = *fmt++;
+        if (c == '%') {
+            c = *fmt++;
+            switch (c) {
+                case 's':
+                    aux += sprintf(aux, "%s\n", va_arg(ap, char *));
+                    break;
+                case 'd':
+                    aux += sprintf(aux, "%d\n", va_arg(ap, int));
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    aux += sprintf(aux, ".\n");
+
+    return (size_t) (aux - buffer);
+}
+
+/** Serializes the binary request, ints keep their fixed width */
+static void binary_request(FrameWriter * writer, int request_type, const uint32_t * id, const char * fmt, va_list ap) {
+    frame_writer_init(writer, (uint8_t) request_type);
+    if (id != NULL) {
+        frame_writer_set_id(writer, *id);
+    }
+    while(*fmt != 0) {
+        char c = *fmt++;
+        if (c == '%') {
+            c = *fmt++;
+            switch (c) {
+                case 's':
+                    frame_put_string(writer, va_arg(ap, char *));
+                    break;
+                case 'd':
+                    frame_put_int(writer, va_arg(ap, int));
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+/** Serializes the request in the current format and sends it, id is NULL for a request without one */
+static ssize_t send_request(Client client, int request_type, const uint32_t * id, const char * fmt, va_list ap) {
+    ssize_t ret;
+
+    if (client->binary) {
+        FrameWriter writer;
+        binary_request(&writer, request_type, id, fmt, ap);
+        size_t len = frame_writer_finish(&writer);
+        if (len == 0) {
+            fprintf(stderr, "Memory error");
+            exit(EXIT_FAILURE);
+        }
+        ret = send_all(client, writer.data, len);
+        frame_writer_free(&writer);
+    } else {
+        char buffer[BUFFER_SIZE];
+        ret = send_all(client, buffer, text_request(buffer, request_type, id, fmt, ap));
+    }
+
+    return ret;
+}
+
+ssize_t client_send_request(Client client, int request_type, const char * fmt, ...) {
+    va_list ap;
+
+    va_start(ap, fmt);
+    ssize_t ret = send_request(client, request_type, NULL, fmt, ap);
+    va_end(ap);
+
+    return ret;
+}
+
+uint32_t client_send_request_id(Client client, int request_type, const char * fmt, ...) {
+    va_list ap;
+    uint32_t id = client->next_id++;
+
+    va_start(ap, fmt);
+    send_request(client, request_type, &id, fmt, ap);
+    va_end(ap);
+
+    return id;
+}
+
+/** Reads the next response that arrives, whichever request it answers */
+static Response * read_response(Client client) {
+    char * buffer = client->pending;
+    char * message = NULL;
+    size_t len = 0;
+    MessageScanner scanner;
+    message_scanner_init(&scanner);
+    bool done = false;
+
+    // the whole response is collected first, its first byte tells the format. A read may
+    // also bring the following responses if requests were pipelined, they stay pending
+    while (!done) {
+        if (client->pending_len == 0) {
+            client->pending_len = (size_t) client_recv(client, buffer);
+        }
+        size_t used = message_scan(&scanner, buffer, client->pending_len, &done);
+
+        char * aux = realloc(message, len + used);
+        if (aux == NULL) {
+            fprintf(stderr, "Memory error");
+            exit(EXIT_FAILURE);
+        }
+        message = aux;
+        memcpy(message + len, buffer, used);
+        len += used;
+        memmove(buffer, buffer + used, client->pending_len - used);
+        client->pending_len -= used;
+    }
+
+    Response * response;
+    if (is_frame(message, len)) {
+        response = response_from_frame(message, len);
+    } else {
+        response = new_response();
+        if (response != NULL) {
+            ResponseParser parser;
+            response_parser_init(&parser, response);
+            response_parser_feed_buffer(&parser, message, len);
+            response_parser_destroy(&parser);
+        }
+    }
+    free(message);
+
+    if (response == NULL) {
+        fprintf(stderr, "Response error.");
+        exit(EXIT_FAILURE);
+    }
+    return response;
+}
+
+/** Appends the response to the array, doubling it when full */
+static void keep_response(Response *** responses, int * count, int * size, Response * response) {
+    if (*count == *size) {
+        int new_size = *size == 0 ? 4 : *size * 2;
+        Response ** aux = realloc(*responses, (size_t) new_size * sizeof(*aux));
+        if (aux == NULL) {
+            fprintf(stderr, "Memory error");
+            exit(EXIT_FAILURE);
+        }
+        *responses = aux;
+        *size = new_size;
+    }
+    (*responses)[(*count)++] = response;
+}
+
+/** Reads the next response to a request, the changes pushed in between are kept */
+static Response * next_response(Client client) {
+    while (true) {
+        Response * response = read_response(client);
+        if (response->status != SEATS_CHANGED) {
+            return response;
+        }
+        keep_response(&client->changes, &client->changes_count, &client->changes_size, response);
+    }
+}
+
+ClientBatch client_batch_new(void) {
+    ClientBatch batch = malloc(sizeof(*batch));
+    if (batch != NULL) {
+        batch->requests = batch->argc = 0;
+    }
+    return batch;
+}
+
+bool client_batch_add(ClientBatch batch, int request_type, const char * fmt, ...) {
+    int args = batch_request_args(request_type);
+    if (args < 0 || batch->requests == MAX_BATCH_REQUESTS) {
+        return false;
+    }
+
+    va_list ap;
+    va_start(ap, fmt);
+    BatchArg * arg = &batch->args[batch->argc];
+    arg->type  = FRAME_INT;
+    arg->value = request_type;
+    for (int i = 1; i <= args && *fmt != 0; fmt++) {
+        if (*fmt != '%') {
+            continue;
+        }
+        arg = &batch->args[batch->argc + i++];
+        if (*++fmt == 's') {
+            arg->type = FRAME_STRING;
+            snprintf(arg->string, ARG_SIZE, "%s", va_arg(ap, char *));
+        } else {
+            arg->type  = FRAME_INT;
+            arg->value = va_arg(ap, int);
+        }
+    }
+    va_end(ap);
+
+    batch->argc += 1 + args;
+    batch->requests++;
+    return true;
+}
+
+ssize_t client_send_batch(Client client, ClientBatch batch) {
+    if (client->binary) {
+        FrameWriter writer;
+        frame_writer_init(&writer, BATCH);
+        for (int i = 0; i < batch->argc; i++) {
+            if (batch->args[i].type == FRAME_INT) {
+                frame_put_int(&writer, batch->args[i].value);
+            } else {
+                frame_put_string(&writer, batch->args[i].string);
+            }
+        }
+        size_t len = frame_writer_finish(&writer);
+        if (len == 0) {
+            fprintf(stderr, "Memory error");
+            exit(EXIT_FAILURE);
+        }
+        ssize_t ret = send_all(client, writer.data, len);
+        frame_writer_free(&writer);
+        return ret;
+    }
+
+    // cada escritura ocupa a lo sumo (MAX_ARGS + 1) lineas de ARG_SIZE, entra en el buffer del server
+    char buffer[BUFFER_SIZE];
+    char * aux = buffer;
+    aux += sprintf(aux, "%d\n", BATCH);
+    for (int i = 0; i < batch->argc; i++) {
+        if (batch->args[i].type == FRAME_INT) {
+            aux += sprintf(aux, "%d\n", batch->args[i].value);
+        } else {
+            aux += sprintf(aux, "%s\n", batch->args[i].string);
+        }
+    }
+    aux += sprintf(aux, ".\n");
+    return send_all(client, buffer, (size_t) (aux - buffer));
+}
+
+void client_batch_destroy(ClientBatch batch) {
+    free(batch);
+}
+
+Response * client_wait_response(Client client) {
+    return next_response(client);
+}
+
+Response * client_wait_response_id(Client client, uint32_t id) {
+    for (int i = 0; i < client->early_count; i++) {
+        Response * response = client->early[i];
+        if (response->id == id) {
+            client->early[i] = client->early[--client->early_count];
+            return response;
+        }
+    }
+
+    while (true) {
+        Response * response = next_response(client);
+        if (!response->has_id || response->id == id) {
+            return response;
+        }
+
+        // responde a otro pedido, se guarda hasta que lo esperen
+        keep_response(&client->early, &client->early_count, &client->early_size, response);
+    }
+}
+
+/** Indicates whether a message can be read without blocking */
+static bool readable(Client client) {
+    struct pollfd fd = {.fd = client->fd, .events = POLLIN};
+    return client->pending_len > 0 || poll(&fd, 1, 0) > 0;
+}
+
+Response * client_seats_change(Client client, bool wait) {
+    while (client->changes_count == 0) {
+        if (!wait && !readable(client)) {
+            return NULL;
+        }
+
+        Response * response = read_response(client);
+        if (response->status == SEATS_CHANGED) {
+            return response;
+        }
+        if (!response->has_id) {
+            // nadie espera la respuesta a un pedido sin id
+            fprintf(stderr, "Response error.");
+            exit(EXIT_FAILURE);
+        }
+        keep_response(&client->early, &client->early_count, &client->early_size, response);
+    }
+
+    Response * response = client->changes[0];
+    memmove(client->changes, client->changes + 1, (size_t) --client->changes_count * sizeof(*client->changes));
+    return response;
+}
+
 void client_close(Client client) {
+    for (int i = 0; i < client->early_count; i++) {
+        destroy_response(client->early[i]);
+    }
+    free(client->early);
+    for (int i = 0; i < client->changes_count; i++) {
+        destroy_response(client->changes[i]);
+    }
+    free(client->changes);
     close(client->fd);
     free(client);
     syslog(LOG_DEBUG, "[CLIENT] disconnected");
@@ -1,7 +1,10 @@
 #ifndef TPE_FINAL_SO_CLIENT_H
 #define TPE_FINAL_SO_CLIENT_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "sys/types.h"
+#include "response.h"
 
 #define BUFFER_SIZE         4096
 
@@ -11,7 +14,11 @@
 
 typedef struct client * Client;
 
-Client client_init(char *hostname, int port);
+/** Write requests sent together as one BATCH request (protocol.h) */
+typedef struct client_batch * ClientBatch;
+
+/** Connects to the server at hostname and port, or at the Unix domain socket unix_path if it is not NULL */
+Client client_init(char *hostname, int port, char * unix_path);
 
 /** Sends message to server */
 ssize_t client_send(Client client, char * buff);
@@ -19,6 +26,57 @@ ssize_t client_send(Client client, char * buff);
 /** Receives message from server */
 ssize_t client_recv(Client client, char * buff);
 
+/**
+ * Selects the wire format of the following requests, text (protocol.h) or binary (frame.h).
+ * The server answers each request in its own format.
+ */
+void client_set_binary(Client client, bool binary);
+
+/**
+ * Serializes a request and sends it to the server. Each conversion in fmt is an
+ * argument: %s for strings and %d for ints (day, room, seat).
+ * Several requests may be sent before waiting, the responses come back in the same order.
+ */
+ssize_t client_send_request(Client client, int request_type, const char * fmt, ...);
+
+/**
+ * Same as client_send_request, the request carries a new id that its response repeats.
+ * The server may answer requests with an id in any order, returns the id to wait for.
+ */
+uint32_t client_send_request_id(Client client, int request_type, const char * fmt, ...);
+
+ClientBatch client_batch_new(void);
+
+/**
+ * Adds a write request to the batch, fmt as in client_send_request.
+ * Returns false if the batch is full or the request type can not go in a batch.
+ */
+bool client_batch_add(ClientBatch batch, int request_type, const char * fmt, ...);
+
+/**
+ * Sends the batch as a single request. The database runs every write in one transaction:
+ * the response is OK, or the status of the first write that failed followed by its index.
+ */
+ssize_t client_send_batch(Client client, ClientBatch batch);
+
+void client_batch_destroy(ClientBatch batch);
+
+/** Waits until the response to the oldest unanswered request is finished and parses it */
+Response * client_wait_response(Client client);
+
+/**
+ * Waits for the response to the request with the given id. Responses to other requests
+ * arriving first are kept until they are waited for.
+ */
+Response * client_wait_response_id(Client client, uint32_t id);
+
+/**
+ * Returns the oldest SEATS_CHANGED the server pushed to the connection after a SUBSCRIBE_SEATS
+ * (protocol.h). If none arrived it waits for one when wait is true, otherwise it returns NULL
+ * without blocking. Must not be called while a request without an id waits for its response.
+ */
+Response * client_seats_change(Client client, bool wait);
+
 /** Closes a client connection and frees resources */
 void client_close(Client client);
 
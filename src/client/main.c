@@ -30,72 +30,17 @@ typedef enum {
     CLIENT_BUY_TICKET = 1,
     CLIENT_VIEW_TICKETS,
     CLIENT_CANCEL_RESERVATION,
+    CLIENT_VIEW_SHOWCASES,
     CLIENT_EXIT
 } client_menu_option;
 
 int get_string(char * msg, char * buff, int max_len);
 int get_option(char * msg, char ** options, int count);
 
-/** Serializes a request and sends it to the server */
-ssize_t send_request(Client client, int request_type, const char * fmt, ...) {
-    va_list ap;
-    va_start(ap, fmt);
-
-    char buffer[BUFFER_SIZE] = {0};
-    char * aux = buffer;
-
-    aux += sprintf(aux, "%d\n", request_type);
-    while(*fmt != 0) {
-        char c = *fmt++;
-        if (c == '%') {
-            c = *fmt++;
-            switch (c) {
-                case 's':
-                    aux += sprintf(aux, "%s\n", va_arg(ap, char *));
-                    break;
-                case 'd':
-                    aux += sprintf(aux, "%d\n", va_arg(ap, int));
-                    break;
-                default:
-                    break;
-            }
-        }
-    }
-
-    va_end(ap);
-    sprintf(aux, ".\n");
-
-    //fprintf(stderr, "'%s'", buffer);
-
-    return client_send(client, buffer);
-}
-
 /** Waits until the server response is finished */
 Response * wait_response(Client client) {
-    Response * response = new_response();
-    if (response == NULL) {
-        fprintf(stderr, "Memory error");
-        exit(EXIT_FAILURE);
-    }
-
-    char buffer[BUFFER_SIZE] = {0};
-    ResponseParser parser;
-    response_parser_init(&parser, response);
-    bool done;
-
     printf("Waiting server response...\n");
-    do {
-        bzero(buffer, BUFFER_SIZE);
-        client_recv(client, buffer);
-        response_parser_consume(&parser, buffer);
-        done = response_parser_is_done(&parser, 0);
-    } while(!done);
-
-    response_parser_destroy(&parser);
-
-    //printf("Server response: %s\n", get_response_type(response->status));
-    //print_response(response);
-    return response;
+    return client_wait_response(client);
 }
 
 char * get_movie(Response * response) {
@@ -169,10 +114,7 @@ Showcase * get_showcase(Response * response, char * movie_name) {
     return showcase;
 }
 
-int get_seat(Response * response) {
-    int seats[SEATS];
-    response_extract_seats(response, seats);
-
+void print_seats(const int * seats) {
     putchar('\t');
     for (int j = 0; j < COLS; j++) {
         printf(" %d\t", j+1);
@@ -186,7 +128,9 @@ int get_seat(Response * response) {
         }
         putchar('\n');
     }
+}
 
+int get_seat(void) {
     int row, col;
     do {
         row = getint("Enter row: ");
@@ -201,6 +145,22 @@ int get_seat(Response * response) {
     return ((row - 1) * COLS + col) - 1;
 }
 
+/** Applies the changes pushed for the showcase since the last call, reprints the seats if any */
+void refresh_seats(Client client, const Showcase * showcase, int * seats) {
+    Response * response;
+    bool changed = false;
+
+    while ((response = client_seats_change(client, false)) != NULL) {
+        changed |= response_apply_seats_change(response, showcase, seats);
+        destroy_response(response);
+    }
+
+    if (changed) {
+        printf("Seats changed:\n");
+        print_seats(seats);
+    }
+}
+
 #define GET_COL(seat) (((seat) % COLS) + 1)
 #define GET_ROW(seat) (((seat) / COLS) + 1)
 
@@ -217,7 +177,7 @@ void print_ticket(Ticket * ticket) {
 void buy_ticket(Client client, char * client_name) {
     // GET_MOVIES
     Response * response;
-    send_request(client, GET_MOVIES, "");
+    client_send_request(client, GET_MOVIES, "");
     response = wait_response(client);
 
     char * movie_name = get_movie(response);
@@ -229,7 +189,7 @@ void buy_ticket(Client client, char * client_name) {
     }
 
     // GET_SHOWCASES
-    send_request(client, GET_SHOWCASES, "%s", movie_name);
+    client_send_request(client, GET_SHOWCASES, "%s", movie_name);
     response = wait_response(client);
 
     Showcase * showcase  = get_showcase(response, movie_name);
@@ -241,28 +201,74 @@ void buy_ticket(Client client, char * client_name) {
         return;
     }
 
-    // GET_SEATS
-    send_request(client, GET_SEATS, "%s%d%d", showcase->movie_name, showcase->day, showcase->room);
+    // SUBSCRIBE_SEATS, the server pushes every change instead of asking again for the seats
+    int seat_map[SEATS];
+    client_send_request(client, SUBSCRIBE_SEATS, "%s%d%d", showcase->movie_name, showcase->day, showcase->room);
     response = wait_response(client);
 
-    int seat = get_seat(response);
+    if (response->status != RESPONSE_OK) {
+        printf("Showcase not available!\n");
+        destroy_response(response);
+        destroy_showcase(showcase);
+        free(movie_name);
+        return;
+    }
+    response_extract_seats(response, seat_map);
+    print_seats(seat_map);
     destroy_response(response);
 
+    int count;
+    do {
+        count = getint("How many tickets? (1 to %d): ", MAX_BATCH_REQUESTS);
+    } while (count <= 0 || count > MAX_BATCH_REQUESTS);
+
+    int seats[MAX_BATCH_REQUESTS];
+    for (int i = 0; i < count; i++) {
+        refresh_seats(client, showcase, seat_map);
+        seats[i] = get_seat();
+        if (seat_map[seats[i]] == RESERVED_SEAT) {
+            printf("Seat not available.\n");
+            i--;
+        }
+    }
+
     // ask confirmation
     bool buy = yesNo("Press (y/n): ");
 
     if (buy) {
-        // ADD_BOOKING
-        send_request(client, ADD_BOOKING, "%s%s%d%d%d", client_name, showcase->movie_name, showcase->day, showcase->room, seat);
+        if (count == 1) {
+            // ADD_BOOKING
+            client_send_request(client, ADD_BOOKING, "%s%s%d%d%d", client_name, showcase->movie_name, showcase->day, showcase->room, seats[0]);
+        } else {
+            // BATCH, every ticket or none
+            ClientBatch batch = client_batch_new();
+            if (batch == NULL) {
+                fprintf(stderr, "Memory error");
+                exit(EXIT_FAILURE);
+            }
+            for (int i = 0; i < count; i++) {
+                client_batch_add(batch, ADD_BOOKING, "%s%s%d%d%d", client_name, showcase->movie_name, showcase->day, showcase->room, seats[i]);
+            }
+            client_send_batch(client, batch);
+            client_batch_destroy(batch);
+        }
         response = wait_response(client);
 
         if (response->status == RESPONSE_OK) {
-            printf("Ticket bought!\n");
-            Ticket * ticket = new_ticket(*showcase, seat);
-            print_ticket(ticket);
-            destroy_ticket(ticket);
+            printf(count == 1 ? "Ticket bought!\n" : "Tickets bought!\n");
+            for (int i = 0; i < count; i++) {
+                Ticket * ticket = new_ticket(*showcase, seats[i]);
+                print_ticket(ticket);
+                destroy_ticket(ticket);
+            }
         } else if (response->status == ALREADY_EXIST){
-            printf("Seat not available!\n");
+            int failed = response->argc > 0 ? atoi(response->args[0]) : -1;
+            if (failed >= 0 && failed < count) {
+                int seat = seats[failed];
+                printf("Seat (row %d, column %d) not available, no ticket was bought!\n", GET_ROW(seat), GET_COL(seat));
+            } else {
+                printf("Seat not available!\n");
+            }
         } else {
             printf("Error purchasing ticket!\n");
         }
@@ -276,7 +282,7 @@ void buy_ticket(Client client, char * client_name) {
 void view_tickets(Client client, char * client_name) {
     // GET_BOOKING
     Response * response;
-    send_request(client, GET_BOOKING, "%s", client_name);
+    client_send_request(client, GET_BOOKING, "%s", client_name);
     response = wait_response(client);
 
     List tickets = response_extract_tickets(response);
@@ -339,7 +345,7 @@ Ticket * get_ticket(Response * response) {
 void cancel_reservation(Client client, char * client_name) {
     // GET_BOOKING
     Response * response;
-    send_request(client, GET_BOOKING, "%s", client_name);
+    client_send_request(client, GET_BOOKING, "%s", client_name);
     response = wait_response(client);
 
     Ticket * ticket = get_ticket(response);
@@ -352,7 +358,7 @@ void cancel_reservation(Client client, char * client_name) {
 
     if (cancel) {
         // REMOVE_BOOKING
-        send_request(client, REMOVE_BOOKING, "%s%s%d%d%d", client_name,
+        client_send_request(client, REMOVE_BOOKING, "%s%s%d%d%d", client_name,
                      ticket->showcase.movie_name, ticket->showcase.day,
                      ticket->showcase.room, ticket->seat);
         response = wait_response(client);
@@ -368,6 +374,56 @@ void cancel_reservation(Client client, char * client_name) {
     destroy_ticket(ticket);
 }
 
+/** Lists the showcases of every movie, the GET_SHOWCASES requests are pipelined in one round trip */
+void view_showcases(Client client) {
+    // GET_MOVIES
+    client_send_request(client, GET_MOVIES, "");
+    Response * response = wait_response(client);
+    List movies = response_extract_movies(response);
+
+    if (list_size(movies) == 0) {
+        printf("There are no movies...\n");
+    }
+
+    // GET_SHOWCASES for every movie, sent before reading any response
+    uint32_t * ids = malloc((size_t) list_size(movies) * sizeof(*ids) + 1);
+    if (ids == NULL) {
+        fprintf(stderr, "Memory error");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < list_size(movies); i++) {
+        ids[i] = client_send_request_id(client, GET_SHOWCASES, "%s", (char *) list_get(movies, i));
+    }
+
+    // the server may answer them in any order, each one is matched by its id
+    for (int i = 0; i < list_size(movies); i++) {
+        printf("Waiting server response...\n");
+        Response * showcases_response = client_wait_response_id(client, ids[i]);
+        List showcases = response_extract_showcases(showcases_response);
+        Showcase * showcase;
+
+        printf("Showcases for '%s':\n", (char *) list_get(movies, i));
+        printf(" DAY | TIME  | ROOM\n");
+        printf("--------------------\n");
+        while ((showcase = list_get_next(showcases)) != NULL) {
+            printf(" %s | %d:%d |  %d\n", get_day(showcase->day), HOUR, MINUTES, showcase->room);
+            destroy_showcase(showcase);
+        }
+        printf("\n");
+
+        list_destroy(showcases);
+        destroy_response(showcases_response);
+    }
+
+    free(ids);
+    list_destroy(movies);
+    destroy_response(response);
+
+    // press key to go back
+    printf("Press any key... ");
+    CLEAR_BUFFER;
+}
+
 #define ADD_SHOWCASE_ENTER_MOVIE_NAME   1
 #define ADD_SHOWCASE_SEE_MOVIE_LIST     2
 #define ADD_SHOWCASE_EXIT               3
@@ -387,7 +443,7 @@ void admin_add_showcase(Client client) {
             break;
         case ADD_SHOWCASE_SEE_MOVIE_LIST:
             // GET_MOVIES
-            send_request(client, GET_MOVIES, "");
+            client_send_request(client, GET_MOVIES, "");
             response = wait_response(client);
             movie_name = get_movie(response);
             destroy_response(response);
@@ -416,7 +472,7 @@ void admin_add_showcase(Client client) {
     bool add = yesNo("Press (y/n): ");
     if (add) {
         // ADD_SHOWCASE
-        send_request(client, ADD_SHOWCASE, "%s%d%d", movie_name, day - 1, room);
+        client_send_request(client, ADD_SHOWCASE, "%s%d%d", movie_name, day - 1, room);
         response = wait_response(client);
         if (response->status == RESPONSE_OK) {
             printf("Showcase added..\n");
@@ -436,7 +492,7 @@ void admin_add_showcase(Client client) {
 void admin_remove_showcase(Client client) {
     // GET_MOVIES
     Response * response;
-    send_request(client, GET_MOVIES, "");
+    client_send_request(client, GET_MOVIES, "");
     response = wait_response(client);
 
     char * movie_name = get_movie(response);
@@ -448,7 +504,7 @@ void admin_remove_showcase(Client client) {
     }
 
     // GET_SHOWCASES
-    send_request(client, GET_SHOWCASES, "%s", movie_name);
+    client_send_request(client, GET_SHOWCASES, "%s", movie_name);
     response = wait_response(client);
 
     Showcase * showcase = get_showcase(response, movie_name);
@@ -463,7 +519,7 @@ void admin_remove_showcase(Client client) {
     bool remove = yesNo("Press (y/n): ");
     if (remove) {
         // REMOVE_SHOWCASE
-        send_request(client, REMOVE_SHOWCASE, "%s%d%d", showcase->movie_name, showcase->day, showcase->room);
+        client_send_request(client, REMOVE_SHOWCASE, "%s%d%d", showcase->movie_name, showcase->day, showcase->room);
         response = wait_response(client);
 
         if (response->status == RESPONSE_OK) {
@@ -504,7 +560,7 @@ void admin_menu(Client client) {
 }
 
 void add_new_client(Client client, char * client_name) {
-    send_request(client, ADD_CLIENT, "%s", client_name);
+    client_send_request(client, ADD_CLIENT, "%s", client_name);
     Response * response = wait_response(client);
 
     int status = response->status;
@@ -531,7 +587,7 @@ void client_menu(Client client) {
 
     add_new_client(client, client_name);
 
-    char * options[] = {"Buy a ticket", "View tickets", "Cancel a reservation", "Exit"};
+    char * options[] = {"Buy a ticket", "View tickets", "Cancel a reservation", "View all showcases", "Exit"};
 
     while (true) {
         client_menu_option option =  (client_menu_option) get_option("Choose an option: ", options, CLIENT_EXIT);
@@ -545,6 +601,9 @@ void client_menu(Client client) {
             case CLIENT_CANCEL_RESERVATION:
                 cancel_reservation(client, client_name);
                 break;
+            case CLIENT_VIEW_SHOWCASES:
+                view_showcases(client);
+                break;
             case CLIENT_EXIT:
                 return;
         }
@@ -572,11 +631,11 @@ void client_start(Client client) {
     }
 }
 
-void parse_options(int argc, char **argv, char ** host, int * port) {
+void parse_options(int argc, char **argv, char ** host, int * port, bool * binary, char ** unix_path) {
     opterr = 0;
     /* p: option e requires argument p:: optional argument */
     int c;
-    while ((c = getopt (argc, argv, "h:p:")) != -1) {
+    while ((c = getopt (argc, argv, "h:p:bu:")) != -1) {
         switch (c) {
             /* Host name */
             case 'h':
@@ -586,8 +645,16 @@ void parse_options(int argc, char **argv, char ** host, int * port) {
             case 'p':
                 *port = parse_port(optarg);
                 break;
+            /* Binary wire format */
+            case 'b':
+                *binary = true;
+                break;
+            /* Unix domain socket of a server on the same host */
+            case 'u':
+                *unix_path = optarg;
+                break;
             case '?':
-                if (optopt == 'h' || optopt == 'p')
+                if (optopt == 'h' || optopt == 'p' || optopt == 'u')
                     fprintf(stderr, "Option -%c requires an argument.\n", optopt);
                 else if (isprint (optopt))
                     fprintf(stderr, "Unknown option `-%c'.\n", optopt);
@@ -604,13 +671,16 @@ int main(int argc, char*argv[]) {
 
     char * hostname = DEFAULT_HOST;
     int server_port = DEFAULT_PORT;
+    bool binary = false;
+    char * unix_path = NULL;
 
-    parse_options(argc, argv, &hostname, &server_port);
+    parse_options(argc, argv, &hostname, &server_port, &binary, &unix_path);
 
-    Client client = client_init(hostname, server_port);
+    Client client = client_init(hostname, server_port, unix_path);
     if (client == NULL) {
         return -1;
     }
+    client_set_binary(client, binary);
 
     client_start(client);
     client_close(client);
@@ -4,6 +4,7 @@
 #include <assert.h>
 #include "response.h"
 #include "../protocol.h"
+#include "../frame.h"
 
 Response * new_response() {
     Response * ret = malloc(sizeof(*ret));
@@ -12,8 +13,15 @@ Response * new_response() {
     }
 
     ret->status = RESPONSE_OK;
+    ret->has_id = false;
+    ret->id = 0;
+    ret->id_digits = 0;
     ret->argc = 0;
     ret->args = NULL;
+    ret->data = NULL;
+    ret->len = ret->size = 0;
+    ret->offsets = NULL;
+    ret->offsets_size = 0;
 
     return ret;
 }
@@ -29,15 +37,170 @@ char * copy(char * arg) {
     return ret;
 }
 
-void response_extract_seats(Response * response, int * seats) {
+bool response_reserve(Response * response, size_t bytes, int argc) {
+    // lugar para el terminador de cada argumento nuevo y el del ultimo
+    size_t needed = response->len + bytes + (size_t) argc + 1;
+    if (needed > response->size) {
+        size_t size = response->size * 2 > needed ? response->size * 2 : needed;
+        char * data = realloc(response->data, size);
+        if (data == NULL) {
+            return false;
+        }
+        response->data = data;
+        response->size = size;
+    }
+
+    if (response->argc + argc > response->offsets_size) {
+        int size = response->offsets_size * 2 > response->argc + argc ? response->offsets_size * 2 : response->argc + argc;
+        size_t * offsets = realloc(response->offsets, (size_t) size * sizeof(*offsets));
+        if (offsets == NULL) {
+            return false;
+        }
+        response->offsets = offsets;
+        response->offsets_size = size;
+    }
+
+    return true;
+}
+
+bool response_arg_begin(Response * response) {
+    if (!response_reserve(response, 0, 1)) {
+        return false;
+    }
+
+    // el 0 que esta en data[len] queda como terminador del argumento anterior
+    if (response->argc > 0) {
+        response->len++;
+    }
+    response->offsets[response->argc++] = response->len;
+    response->data[response->len] = 0;
+    return true;
+}
+
+bool response_arg_append(Response * response, const char * bytes, size_t len) {
+    if (!response_reserve(response, len, 0)) {
+        return false;
+    }
 
-    assert(response->argc == SEATS);
+    memcpy(response->data + response->len, bytes, len);
+    response->len += len;
+    response->data[response->len] = 0;
+    return true;
+}
+
+bool response_finish(Response * response) {
+    if (response->argc == 0) {
+        return true;
+    }
+
+    char ** args = realloc(response->args, (size_t) response->argc * sizeof(*args));
+    if (args == NULL) {
+        return false;
+    }
 
     for (int i = 0; i < response->argc; i++) {
-        seats[i] = atoi(response->args[i]);
+        args[i] = response->data + response->offsets[i];
+    }
+    response->args = args;
+    return true;
+}
+
+Response * response_from_frame(const char * frame, size_t len) {
+    FrameReader reader;
+    FrameHeader header;
+    FrameArg arg;
+    char number[12];
+
+    if (!frame_reader_init(&reader, frame, len, &header)) {
+        return NULL;
+    }
+
+    Response * ret = new_response();
+    // los argumentos no son mas largos que el mensaje, los enteros en decimal tampoco
+    if (ret == NULL || !response_reserve(ret, len + (size_t) header.argc * sizeof(number), header.argc)) {
+        fprintf(stderr, "Memory error.");
+        exit(EXIT_FAILURE);
+    }
+
+    ret->status = header.code;
+    ret->has_id = header.has_id;
+    ret->id     = header.id;
+    while (ret->argc < header.argc && frame_next(&reader, &arg)) {
+        response_arg_begin(ret);
+        if (arg.type == FRAME_INT) {
+            response_arg_append(ret, number, (size_t) snprintf(number, sizeof(number), "%d", arg.value));
+        } else {
+            response_arg_append(ret, arg.string, arg.len);
+        }
+    }
+
+    if (ret->argc < header.argc || reader.offset != len || !response_finish(ret)) {
+        destroy_response(ret);
+        return NULL;
+    }
+    return ret;
+}
+
+size_t response_arg_len(Response * response, int index) {
+    size_t end = index + 1 < response->argc ? response->offsets[index + 1] - 1 : response->len;
+    return end - response->offsets[index];
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+void response_extract_seats(Response * response, int * seats) {
+    uint8_t map[SEATMAP_BYTES];
+    size_t len = response->argc == 1 ? response_arg_len(response, 0) : 0;
+    const char * arg = len > 0 ? response->args[0] : NULL;
+
+    // en binario llegan los bytes del mapa, en texto su version hexadecimal
+    if (len == SEATMAP_BYTES) {
+        memcpy(map, arg, SEATMAP_BYTES);
+    } else if (len == SEATMAP_HEX) {
+        for (int i = 0; i < SEATMAP_BYTES; i++) {
+            int high = hex_digit(arg[2 * i]), low = hex_digit(arg[2 * i + 1]);
+            if (high < 0 || low < 0) {
+                fprintf(stderr, "Response error.");
+                exit(EXIT_FAILURE);
+            }
+            map[i] = (uint8_t) (high << 4 | low);
+        }
+    } else {
+        fprintf(stderr, "Response error.");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < SEATS; i++) {
+        seats[i] = seatmap_taken(map, i) ? RESERVED_SEAT : EMPTY_SEAT;
     }
 }
 
+bool response_apply_seats_change(Response * response, const Showcase * showcase, int * seats) {
+    if (response->argc < 3 || strcmp(response->args[0], showcase->movie_name) != 0
+        || atoi(response->args[1]) != showcase->day || atoi(response->args[2]) != showcase->room) {
+        return false;
+    }
+
+    for (int i = 3; i + 1 < response->argc; i += 2) {
+        int seat = atoi(response->args[i]);
+        if (seat >= 0 && seat < SEATS) {
+            seats[seat] = atoi(response->args[i + 1]);
+        }
+    }
+    return true;
+}
+
 List response_extract_movies(Response * response) {
     List list = list_new();
 
@@ -146,9 +309,8 @@ void print_response(Response * response) {
 }
 
 void destroy_response(Response * response) {
-    for (int i = 0; i < response->argc; i++) {
-        free(response->args[i]);
-    }
     free(response->args);
+    free(response->offsets);
+    free(response->data);
     free(response);
 }
@@ -1,12 +1,30 @@
 #ifndef TPE_FINAL_SO_RESPONSE_H
 #define TPE_FINAL_SO_RESPONSE_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "../list.h"
 
+/**
+ * The arguments live in a single arena owned by the response: data holds them one
+ * after the other, each terminated with a 0, and offsets where each one starts.
+ * args points into data once the response is finished.
+ */
 typedef struct {
     int status;
+    /** id of the request being answered, if it had one (protocol.h) */
+    bool has_id;
+    uint32_t id;
+    int id_digits;
     int argc;
     char ** args;
+
+    char * data;
+    size_t len;
+    size_t size;
+    size_t * offsets;
+    int offsets_size;
 } Response;
 
 typedef struct {
@@ -22,7 +40,28 @@ typedef struct {
 
 Response * new_response(void);
 
-/** Fills the array with 1 if the seat is reserved and 0 if it is not */
+/** Makes room for bytes more argument bytes and argc more arguments, false if out of memory */
+bool response_reserve(Response * response, size_t bytes, int argc);
+
+/** Starts a new empty argument at the end of the arena */
+bool response_arg_begin(Response * response);
+
+/** Appends len bytes to the last argument */
+bool response_arg_append(Response * response, const char * bytes, size_t len);
+
+/** Points args to every argument of the arena, false if out of memory */
+bool response_finish(Response * response);
+
+/**
+ * Builds the response from a complete binary message (frame.h), NULL if it is invalid.
+ * Ints are stored as text, like in the text protocol, so the extract functions work on both.
+ */
+Response * response_from_frame(const char * frame, size_t len);
+
+/** Length of the argument index, which may hold 0 bytes if it came from a binary message */
+size_t response_arg_len(Response * response, int index);
+
+/** Decodes the seat map of GET_SEATS (protocol.h), EMPTY_SEAT or RESERVED_SEAT for each seat */
 void response_extract_seats(Response * response, int * seats);
 
 /** Returns a list of movie names */
@@ -34,6 +73,12 @@ List response_extract_showcases(Response * response);
 /** Returns a list of Tickets */
 List response_extract_tickets(Response * response);
 
+/**
+ * Applies a SEATS_CHANGED to the seats of the showcase, as filled by response_extract_seats.
+ * Returns false and leaves the seats untouched if it is about another showcase.
+ */
+bool response_apply_seats_change(Response * response, const Showcase * showcase, int * seats);
+
 Showcase * new_showcase(char * movie_name, int day, int room);
 
 void destroy_showcase(Showcase * showcase);
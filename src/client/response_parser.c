@@ -5,8 +5,8 @@
 #include "response_parser.h"
 #include "../multiline_parser.h"
 #include "../utils.h"
-
-#define ARG_BLOCK   50
+#include "../scan.h"
+#include "../protocol.h"
 
 extern bool debug;
 
@@ -15,22 +15,14 @@ void response_parser_init(ResponseParser * parser, Response * response) {
     parser->multiline_parser = parser_init(parser_no_classes(), definition);
     parser->response = response;
     parser->state = response_status;
-    parser->arg_index = 0;
-    parser->arg = NULL;
 }
 
-response_state new_arg_block(ResponseParser * parser) {
-    char * aux = parser->arg;
-
-    aux = realloc(aux, (size_t)parser->arg_index + ARG_BLOCK);
-    if (aux == NULL) {
-        free(parser->arg);
-        parser->arg = NULL;
+/** Agrega n bytes al argumento actual, en la arena de la respuesta */
+static response_state arg_bytes(ResponseParser * parser, const char * bytes, size_t n) {
+    if (!response_arg_append(parser->response, bytes, n)) {
+        fprintf(stderr, "Memory error");
         return response_error;
     }
-
-    aux[parser->arg_index] = 0;
-    parser->arg = aux;
     return response_args;
 }
 
@@ -39,7 +31,10 @@ response_state byte(ResponseParser * parser, char c) {
 
     switch (parser->state) {
         case response_status:
-            if (!isdigit(c)) {
+            if (c == REQUEST_ID_SEPARATOR) {
+                parser->response->has_id = true;
+                ret = response_id;
+            } else if (!isdigit(c)) {
                 ret = response_error;
             } else {
                 ret = response_status;
@@ -47,13 +42,16 @@ response_state byte(ResponseParser * parser, char c) {
                 parser->response->status += c - '0';
             }
             break;
-        case response_args:
-            ret = response_args;
-            parser->arg[parser->arg_index++] = c;
-            if (parser->arg_index % ARG_BLOCK == 0) {
-                ret = new_arg_block(parser);
+        case response_id:
+            if (!request_id_digit(&parser->response->id, &parser->response->id_digits, c)) {
+                ret = response_error;
+            } else {
+                ret = response_id;
             }
             break;
+        case response_args:
+            ret = arg_bytes(parser, &c, 1);
+            break;
         default:
             ret = response_error;
             break;
@@ -62,97 +60,99 @@ response_state byte(ResponseParser * parser, char c) {
     return ret;
 }
 
-response_state copy_arg(ResponseParser * parser, response_state state) {
-    char ** aux = realloc(parser->response->args, (sizeof (char*)) * (parser->response->argc + 1));
-
-    if (aux == NULL) {
-        for (int i = 0; i < parser->response->argc; i++) {
-            free(parser->response->args[i]);
-            parser->response->args[i] = NULL;
-        }
-        parser->response->argc = 0;
-        free(parser->response->args);
-        parser->response->args = NULL;
+response_state newline(ResponseParser * parser, char c) {
+    if (!response_arg_begin(parser->response)) {
         fprintf(stderr, "Memory error");
         return response_error;
     }
 
-    char * aux_arg = calloc((size_t)parser->arg_index + 1, sizeof(char));
-    if (aux_arg == NULL) {
-        free(aux);
+    return arg_bytes(parser, &c, 1);
+}
+
+/** Cuando termina el parseo los args quedan apuntando a la arena, aun si hubo un error */
+static void finish(ResponseParser * parser) {
+    if (parser->state >= response_done && !response_finish(parser->response)) {
         fprintf(stderr, "Memory error");
-        return response_error;
+        parser->state = response_error;
     }
-
-    strncpy(aux_arg, parser->arg, (size_t)parser->arg_index);
-    parser->response->args = aux;
-    parser->response->args[parser->response->argc++] = aux_arg;
-
-    return state;
 }
 
-response_state newline(ResponseParser * parser, char c) {
-    response_state ret = response_args;
-
-    // copio el arg viejo si lo habia
-    if (parser->arg != NULL) {
-        if (copy_arg(parser, ret) == response_error) {
-            return response_error;
-        }
-        free(parser->arg);
-        parser->arg_index = 0;
-        parser->arg = NULL;
+static void handle_event(ResponseParser * parser, const ParserEvent * e) {
+    if (debug) print_state("response", multiline_event, e);
+    switch (e->type) {
+        case MULTI_BYTE:
+            parser->state = byte(parser, e->data[0]);
+            break;
+        case MULTI_NEWLINE:
+            parser->state = newline(parser, e->data[0]);
+            break;
+        case MULTI_WAIT:
+            //
+            break;
+        case MULTI_FIN:
+            parser->state = response_done;
+            break;
+        default:
+            parser->state = response_error;
+            break;
     }
-
-    ret = new_arg_block(parser);
-    parser->arg[parser->arg_index++] = c;
-
-    return ret;
 }
 
-response_state response_parser_feed(ResponseParser * parser, char c) {
+static response_state feed(ResponseParser * parser, char c) {
     const ParserEvent * e = parser_feed(parser->multiline_parser, (uint8_t) c);
     do {
-        if (debug) print_state("response", multiline_event, e);
-        switch (e->type) {
-            case MULTI_BYTE:
-                parser->state = byte(parser, e->data[0]);
-                break;
-            case MULTI_NEWLINE:
-                parser->state = newline(parser, e->data[0]);
-                break;
-            case MULTI_WAIT:
-                //
-                break;
-            case MULTI_FIN:
-                // copy last arg
-                if (parser->arg != NULL) {
-                    parser->state = copy_arg(parser, response_done);
-                } else {
-                    parser->state = response_done;
-                }
-                break;
-            default:
-                parser->state = response_error;
-                break;
-        }
+        handle_event(parser, e);
         e = e->next;
     } while (e != NULL && parser->state < response_done);
 
     return parser->state;
 }
 
-response_state response_parser_consume(ResponseParser * parser, char * buffer) {
-    response_state state = parser->state;
+response_state response_parser_feed(ResponseParser * parser, char c) {
+    feed(parser, c);
+    finish(parser);
+    return parser->state;
+}
 
-    while (*buffer != 0) {
-        state = response_parser_feed(parser, *buffer++);
-        if (response_parser_is_done(parser, 0)) {
-            break;
+/** Cantidad de lineas en el buffer, alcanza para reservar la tabla de offsets */
+static int count_lines(const char * buffer, size_t len) {
+    int lines = 0;
+    for (size_t i = 0; i < len; i++, lines++) {
+        i += scan_newline(buffer + i, len - i);
+    }
+    return lines;
+}
+
+response_state response_parser_feed_buffer(ResponseParser * parser, const char * buffer, size_t len) {
+    size_t i = 0;
+
+    // cada argumento ocupa en la arena a lo sumo lo mismo que en el mensaje, con el \n como terminador
+    if (parser->state < response_done && !response_reserve(parser->response, len, count_lines(buffer, len))) {
+        fprintf(stderr, "Memory error");
+        parser->state = response_error;
+    }
+
+    while (i < len && parser->state < response_done) {
+        // el resto de la linea no pasa por el parser multilinea, solo los cambios de linea
+        size_t line = multiline_parser_line(parser->multiline_parser, (const uint8_t *) buffer + i, len - i);
+        if (line == 0) {
+            feed(parser, buffer[i++]);
+        } else if (parser->state == response_args) {
+            parser->state = arg_bytes(parser, buffer + i, line);
+            i += line;
+        } else {
+            for (size_t end = i + line; i < end && parser->state < response_done; i++) {
+                parser->state = byte(parser, buffer[i]);
+            }
         }
     }
 
-    return state;
+    finish(parser);
+    return parser->state;
+}
+
+response_state response_parser_consume(ResponseParser * parser, char * buffer) {
+    return response_parser_feed_buffer(parser, buffer, strlen(buffer));
 }
 
 bool response_parser_is_done(ResponseParser * parser, bool *error) {
@@ -165,5 +165,4 @@ bool response_parser_is_done(ResponseParser * parser, bool *error) {
 
 void response_parser_destroy(ResponseParser * parser) {
     parser_destroy(parser->multiline_parser);
-    free(parser->arg);
 }
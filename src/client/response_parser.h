@@ -7,6 +7,7 @@
 
 typedef enum {
     response_status,
+    response_id,
     response_args,
     response_done,
     response_error,
@@ -16,8 +17,6 @@ typedef struct {
     Parser * multiline_parser;
     Response * response;
     response_state state;
-    char * arg;
-    int arg_index;
 } ResponseParser;
 
 /** Initializes the parser */
@@ -26,6 +25,16 @@ void response_parser_init(ResponseParser * parser, Response * response);
 /** Feeds a character to the parser, returns the new parser state */
 response_state response_parser_feed(ResponseParser * parser, char c);
 
+/**
+ * Feeds up to len bytes, stopping when the parsing is finished. The bytes inside a
+ * line are located in bulk (scan.h) and consumed without going through the parser,
+ * only line changes are fed one by one. Returns the new parser state.
+ *
+ * The response arena is sized for the whole buffer up front, so a complete message
+ * costs the same few allocations no matter how many arguments it has.
+ */
+response_state response_parser_feed_buffer(ResponseParser * parser, const char * buffer, size_t len);
+
 /**
  * Consumes the buffer feeding each character to the parser until the parsing is finished
  * or the buffer has nothing left to read, returns the new parser state.
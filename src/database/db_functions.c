@@ -1,10 +1,19 @@
 #include "db_functions.h"
+#include "seat_cache.h"
+#include "response_writer.h"
 #include <stdio.h>
 #include <stdlib.h>
-#include <unistd.h>
+#include <string.h>
+#include <strings.h>
 
 
-char * create_tables =
+/**
+ * Migraciones del esquema, la version de un archivo se guarda en PRAGMA user_version.
+ * Al abrir se aplican las que faltan, nunca se modifica una ya publicada: los cambios
+ * van en una migracion nueva al final.
+ */
+static const char * migrations[] = {
+        // 1: tablas. IF NOT EXISTS porque los archivos anteriores a las migraciones ya las tienen
         "CREATE TABLE IF NOT EXISTS client(\n"
                 "\tid INTEGER NOT NULL,\n"
                 "\tname TEXT,\n"
@@ -28,304 +37,619 @@ char * create_tables =
                 "\tFOREIGN KEY (client_id) REFERENCES client(id),\n"
                 "\tFOREIGN KEY (showcase_id) REFERENCES showcase(id),\n"
                 "\tPRIMARY KEY (id)\n"
-                ");";
+                ");",
+
+        // 2: indices de las busquedas de cada pedido, las reservas canceladas se acumulan sin limite.
+        // Los archivos anteriores pueden tener clientes o funciones repetidos: se queda el de menor id
+        // y sus reservas pasan a el antes de crear los indices unicos
+        "CREATE TEMP TABLE duplicate(id INTEGER PRIMARY KEY, keep INTEGER NOT NULL);\n"
+        "INSERT INTO duplicate SELECT client.id, first.id FROM client\n"
+                "\tJOIN (SELECT name, MIN(id) AS id FROM client GROUP BY name) AS first ON client.name = first.name\n"
+                "\tWHERE client.id <> first.id;\n"
+        "UPDATE booking SET client_id = (SELECT keep FROM duplicate WHERE id = client_id)\n"
+                "\tWHERE client_id IN (SELECT id FROM duplicate);\n"
+        "DELETE FROM client WHERE id IN (SELECT id FROM duplicate);\n"
+        "DELETE FROM duplicate;\n"
+        "INSERT INTO duplicate SELECT showcase.id, first.id FROM showcase\n"
+                "\tJOIN (SELECT movie, day, room, MIN(id) AS id FROM showcase GROUP BY movie, day, room) AS first\n"
+                "\tON showcase.movie = first.movie AND showcase.day = first.day AND showcase.room = first.room\n"
+                "\tWHERE showcase.id <> first.id;\n"
+        "UPDATE booking SET showcase_id = (SELECT keep FROM duplicate WHERE id = showcase_id)\n"
+                "\tWHERE showcase_id IN (SELECT id FROM duplicate);\n"
+        "DELETE FROM showcase WHERE id IN (SELECT id FROM duplicate);\n"
+        "DROP TABLE duplicate;\n"
+        "CREATE UNIQUE INDEX IF NOT EXISTS client_name ON client(name);\n"
+        "CREATE UNIQUE INDEX IF NOT EXISTS showcase_movie_day_room ON showcase(movie, day, room);\n"
+        "CREATE INDEX IF NOT EXISTS showcase_day_room ON showcase(day, room);\n"
+        "DROP INDEX IF EXISTS booking_showcase_seat;\n"
+        "CREATE INDEX IF NOT EXISTS booking_showcase_seat_cancelled ON booking(showcase_id, seat, cancelled);\n"
+        "CREATE INDEX IF NOT EXISTS booking_client_cancelled ON booking(client_id, cancelled);",
+
+        // 3: reservas activas de cada funcion, para leer sus asientos sin recorrer las canceladas
+        "CREATE INDEX IF NOT EXISTS booking_active_showcase_seat ON booking(showcase_id, seat) WHERE cancelled = 0;",
+};
+#define MIGRATIONS ((int) (sizeof(migrations) / sizeof(migrations[0])))
 
 sqlite3* db_fd;
-char* exec_error_msg=ERR_MSG;
-int callback_retr_id(void *data, int argc, char **argv, char **azColName);
 
+/** Consultas usadas por las operaciones, se preparan una unica vez en database_open */
+typedef enum {
+    STMT_CLIENT_ID,
+    STMT_INSERT_CLIENT,
+    STMT_ROOM_TAKEN,
+    STMT_INSERT_SHOWCASE,
+    STMT_DELETE_SHOWCASE_BOOKINGS,
+    STMT_DELETE_SHOWCASE,
+    STMT_SHOWCASE_ID,
+    STMT_MOVIES,
+    STMT_SHOWCASES,
+    STMT_CLIENT_BOOKINGS,
+    STMT_SEATS,
+    STMT_SEAT_TAKEN,
+    STMT_INSERT_BOOKING,
+    STMT_CANCEL_BOOKING,
+    STMT_BEGIN,
+    STMT_COMMIT,
+    STMT_ROLLBACK,
+    STMT_SAVEPOINT,
+    STMT_RELEASE,
+    STMT_ROLLBACK_TO,
+    STMT_SAVEPOINT_ATOMIC,
+    STMT_RELEASE_ATOMIC,
+    STMT_ROLLBACK_TO_ATOMIC,
+    STATEMENTS
+} statement;
+
+static const char * queries[STATEMENTS] = {
+        [STMT_CLIENT_ID]                = "SELECT id FROM client WHERE name = ?1",
+        [STMT_INSERT_CLIENT]            = "INSERT INTO client(name) VALUES(?1)",
+        [STMT_ROOM_TAKEN]               = "SELECT 1 FROM showcase WHERE day = ?1 AND room = ?2",
+        [STMT_INSERT_SHOWCASE]          = "INSERT INTO showcase(movie,day,room) VALUES(?1,?2,?3)",
+        [STMT_DELETE_SHOWCASE_BOOKINGS] = "DELETE FROM booking WHERE showcase_id = ?1",
+        [STMT_DELETE_SHOWCASE]          = "DELETE FROM showcase WHERE id = ?1",
+        [STMT_SHOWCASE_ID]              = "SELECT id FROM showcase WHERE movie = ?1 AND day = ?2 AND room = ?3",
+        [STMT_MOVIES]                   = "SELECT DISTINCT movie FROM showcase",
+        [STMT_SHOWCASES]                = "SELECT DISTINCT movie,day,room FROM showcase WHERE movie = ?1",
+        [STMT_CLIENT_BOOKINGS]          = "SELECT movie,day,room,seat FROM booking INNER JOIN showcase ON showcase.id = booking.showcase_id "
+                                          "WHERE client_id = ?1 AND cancelled = ?2",
+        [STMT_SEATS]                    = "SELECT seat FROM booking INDEXED BY booking_active_showcase_seat WHERE showcase_id = ?1 AND cancelled = 0",
+        [STMT_SEAT_TAKEN]               = "SELECT 1 FROM booking WHERE showcase_id = ?1 AND seat = ?2 AND cancelled = 0",
+        [STMT_INSERT_BOOKING]           = "INSERT INTO booking(client_id, showcase_id, cancelled, seat) VALUES(?1, ?2, 0, ?3)",
+        [STMT_CANCEL_BOOKING]           = "UPDATE booking SET cancelled = 1 WHERE client_id = ?1 AND showcase_id = ?2 AND seat = ?3 AND cancelled = 0",
+        //IMMEDIATE toma el lock de escritura al empezar, la consulta previa al INSERT no puede quedar vieja
+        [STMT_BEGIN]                    = "BEGIN IMMEDIATE",
+        [STMT_COMMIT]                   = "COMMIT",
+        [STMT_ROLLBACK]                 = "ROLLBACK",
+        [STMT_SAVEPOINT]                = "SAVEPOINT write",
+        [STMT_RELEASE]                  = "RELEASE write",
+        [STMT_ROLLBACK_TO]              = "ROLLBACK TO write",
+        [STMT_SAVEPOINT_ATOMIC]         = "SAVEPOINT atomic",
+        [STMT_RELEASE_ATOMIC]           = "RELEASE atomic",
+        [STMT_ROLLBACK_TO_ATOMIC]       = "ROLLBACK TO atomic",
+};
+
+static sqlite3_stmt * statements[STATEMENTS];
+
+/** Devuelve la consulta preparada lista para ligarle parametros */
+static sqlite3_stmt * get_statement(statement stmt) {
+    sqlite3_reset(statements[stmt]);
+    sqlite3_clear_bindings(statements[stmt]);
+    return statements[stmt];
+}
+
+/** Ejecuta una consulta sin resultados, retorna SQLITE_OK o el error */
+static int run_statement(sqlite3_stmt * stmt) {
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    return rc == SQLITE_DONE ? SQLITE_OK : rc;
+}
+
+/** Ejecuta una consulta que retorna a lo sumo un entero. En caso que sean 0 tuplas deja INVALID_ID */
+static int query_int(sqlite3_stmt * stmt, int * value) {
+    int rc = sqlite3_step(stmt);
+    *value = INVALID_ID;
+    if (rc == SQLITE_ROW) {
+        *value = sqlite3_column_int(stmt, 0);
+        rc = SQLITE_DONE;
+    }
+    sqlite3_reset(stmt);
+    return rc == SQLITE_DONE ? SQLITE_OK : rc;
+}
+
+/** Hay un lote abierto por database_batch_begin, cada escritura es un savepoint dentro de el */
+static bool batch_open = false;
+
+/** Empieza la transaccion de una escritura */
+static int begin_write(void) {
+    return run_statement(get_statement(batch_open ? STMT_SAVEPOINT : STMT_BEGIN));
+}
+
+/**
+ * Confirma la escritura si status es RESPONSE_OK, si no la deshace. Retorna el estado final.
+ * Las escrituras fallidas no tocan el cache de asientos, si falla la confirmacion se recarga.
+ */
+static int end_write(int status) {
+    if (batch_open) {
+        if (status != RESPONSE_OK)
+            run_statement(get_statement(STMT_ROLLBACK_TO));
+        if (run_statement(get_statement(STMT_RELEASE)) != SQLITE_OK) {
+            seat_cache_invalidate();
+            return FAIL_QUERY;
+        }
+        return status;
+    }
+
+    if (status == RESPONSE_OK && run_statement(get_statement(STMT_COMMIT)) == SQLITE_OK)
+        return RESPONSE_OK;
+    run_statement(get_statement(STMT_ROLLBACK));
+    if (status == RESPONSE_OK)
+        seat_cache_invalidate();
+    return status == RESPONSE_OK ? FAIL_QUERY : status;
+}
+
+int database_batch_begin(void) {
+    if (run_statement(get_statement(STMT_BEGIN)) != SQLITE_OK)
+        return FAIL_QUERY;
+    batch_open = true;
+    return RESPONSE_OK;
+}
+
+int database_batch_commit(void) {
+    batch_open = false;
+    if (run_statement(get_statement(STMT_COMMIT)) == SQLITE_OK)
+        return RESPONSE_OK;
+    run_statement(get_statement(STMT_ROLLBACK));
+    seat_cache_invalidate();
+    return FAIL_QUERY;
+}
+
+/** El grupo atomico abrio su propia transaccion, no habia un lote abierto */
+static bool atomic_own = false;
+
+int database_atomic_begin(void) {
+    if (batch_open)
+        return run_statement(get_statement(STMT_SAVEPOINT_ATOMIC)) == SQLITE_OK ? RESPONSE_OK : FAIL_QUERY;
+
+    // las escrituras del grupo quedan como savepoints de esta transaccion
+    if (database_batch_begin() != RESPONSE_OK)
+        return FAIL_QUERY;
+    atomic_own = true;
+    return RESPONSE_OK;
+}
+
+int database_atomic_end(int status) {
+    if (atomic_own) {
+        atomic_own = false;
+        if (status == RESPONSE_OK)
+            return database_batch_commit();
+        batch_open = false;
+        run_statement(get_statement(STMT_ROLLBACK));
+        // las escrituras que habian salido bien ya marcaron sus asientos
+        seat_cache_invalidate();
+        return status;
+    }
+
+    if (status != RESPONSE_OK) {
+        run_statement(get_statement(STMT_ROLLBACK_TO_ATOMIC));
+        seat_cache_invalidate();
+    }
+    if (run_statement(get_statement(STMT_RELEASE_ATOMIC)) != SQLITE_OK) {
+        seat_cache_invalidate();
+        return FAIL_QUERY;
+    }
+    return status;
+}
+
+static int prepare_statements(void) {
+    for (int i = 0; i < STATEMENTS; i++) {
+        if (sqlite3_prepare_v2(db_fd, queries[i], -1, &statements[i], NULL) != SQLITE_OK)
+            return FAIL_QUERY;
+    }
+    return RESPONSE_OK;
+}
+
+static void finalize_statements(void) {
+    for (int i = 0; i < STATEMENTS; i++) {
+        sqlite3_finalize(statements[i]);
+        statements[i] = NULL;
+    }
+}
 
+static int schema_version(int * version) {
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db_fd, "PRAGMA user_version", -1, &stmt, NULL) != SQLITE_OK)
+        return FAIL_QUERY;
+    int rc = sqlite3_step(stmt);
+    *version = rc == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : 0;
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_ROW ? RESPONSE_OK : FAIL_QUERY;
+}
+
+/** Aplica las migraciones que faltan y actualiza la version, dentro de la transaccion abierta */
+static int apply_migrations(void) {
+    char pragma[64];
+    int version;
+
+    if (schema_version(&version) != RESPONSE_OK)
+        return FAIL_QUERY;
+
+    for (; version < MIGRATIONS; version++) {
+        if (sqlite3_exec(db_fd, migrations[version], NULL, NULL, NULL) != SQLITE_OK) {
+            fprintf(stderr, "Schema migration %d failed: %s\n", version + 1, sqlite3_errmsg(db_fd));
+            return FAIL_QUERY;
+        }
+    }
+    snprintf(pragma, sizeof(pragma), "PRAGMA user_version = %d", version);
+    if (sqlite3_exec(db_fd, pragma, NULL, NULL, NULL) != SQLITE_OK)
+        return FAIL_QUERY;
+    return RESPONSE_OK;
+}
+
+/** Lleva el archivo a la ultima version del esquema */
+static int migrate(void) {
+    //Varios procesos abren el mismo archivo a la vez, IMMEDIATE hace que uno solo migre
+    if (sqlite3_exec(db_fd, "BEGIN IMMEDIATE", NULL, NULL, NULL) != SQLITE_OK)
+        return FAIL_QUERY;
+
+    if (apply_migrations() == RESPONSE_OK && sqlite3_exec(db_fd, "COMMIT", NULL, NULL, NULL) == SQLITE_OK)
+        return RESPONSE_OK;
+    sqlite3_exec(db_fd, "ROLLBACK", NULL, NULL, NULL);
+    return FAIL_QUERY;
+}
 
 int database_open(const char * filename){
-    int file_exist=access(filename,F_OK);
     if (sqlite3_open(filename, &db_fd) != SQLITE_OK) {
         sqlite3_close(db_fd);
         return FAIL_TO_OPEN;
     }
-    if(file_exist==-1) {
-        if (sqlite3_exec(db_fd, create_tables, NULL, NULL, NULL) != SQLITE_OK)
+    //Varios procesos comparten el archivo, si esta bloqueado se reintenta en vez de fallar
+    sqlite3_busy_timeout(db_fd, BUSY_TIMEOUT);
+    if (migrate() != RESPONSE_OK || prepare_statements() != RESPONSE_OK)
+        return FAIL_QUERY;
+    return seat_cache_open(db_fd);
+}
+
+static const char * journal_modes[] = {"delete", "truncate", "persist", "memory", "wal", "off", NULL};
+static const char * synchronous_levels[] = {"off", "normal", "full", "extra", NULL};
+
+static bool is_one_of(const char * value, const char ** values) {
+    for (int i = 0; values[i] != NULL; i++) {
+        if (strcasecmp(value, values[i]) == 0)
+            return true;
+    }
+    return false;
+}
+
+int database_configure(const DatabaseOptions * options) {
+    char pragma[64];
+
+    //Los valores de texto se validan contra una lista fija antes de armar el PRAGMA
+    if ((options->journal_mode != NULL && !is_one_of(options->journal_mode, journal_modes))
+        || (options->synchronous != NULL && !is_one_of(options->synchronous, synchronous_levels)))
+        return RESPONSE_ERR;
+
+    if (options->journal_mode != NULL) {
+        snprintf(pragma, sizeof(pragma), "PRAGMA journal_mode = %s", options->journal_mode);
+        if (sqlite3_exec(db_fd, pragma, NULL, NULL, NULL) != SQLITE_OK)
+            return FAIL_QUERY;
+    }
+    if (options->synchronous != NULL) {
+        snprintf(pragma, sizeof(pragma), "PRAGMA synchronous = %s", options->synchronous);
+        if (sqlite3_exec(db_fd, pragma, NULL, NULL, NULL) != SQLITE_OK)
+            return FAIL_QUERY;
+    }
+    if (options->cache_size != 0) {
+        snprintf(pragma, sizeof(pragma), "PRAGMA cache_size = %d", options->cache_size);
+        if (sqlite3_exec(db_fd, pragma, NULL, NULL, NULL) != SQLITE_OK)
+            return FAIL_QUERY;
+    }
+    if (options->mmap_size >= 0) {
+        snprintf(pragma, sizeof(pragma), "PRAGMA mmap_size = %lld", options->mmap_size);
+        if (sqlite3_exec(db_fd, pragma, NULL, NULL, NULL) != SQLITE_OK)
             return FAIL_QUERY;
     }
     return RESPONSE_OK;
 }
 
 int database_close(){
+    seat_cache_close();
+    finalize_statements();
     sqlite3_close(db_fd);
     return RESPONSE_OK;
 }
 
-int add_client(char *name){
+static int insert_client(char *name){
     int client_id=get_client_id(name);
     if(client_id!=INVALID_ID)
         return ALREADY_EXIST;
-    char *insert_query = malloc(MAX_QUERY_SIZE);
-    sprintf(insert_query, "INSERT INTO client(name) VALUES('%s')", name);
-    int rc = sqlite3_exec(db_fd, insert_query, 0, 0, &exec_error_msg);
-    free(insert_query);
-    if(rc!=SQLITE_OK)
+    sqlite3_stmt *stmt = get_statement(STMT_INSERT_CLIENT);
+    sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+    if(run_statement(stmt)!=SQLITE_OK)
         return FAIL_QUERY;
     return RESPONSE_OK;
 }
 
-int add_showcase(char *movie, int day, int room) {
-//    int showcase_id=get_showcase_id(movie,day,room);
-//    if(showcase_id!=INVALID_ID)
-//        return ALREADY_EXIST;
-
-    int exist=INVALID_ID; //En caso que sean 0 tuplas retorna INVALID_ID
-    char *select_query = malloc(MAX_QUERY_SIZE);
-    sprintf(select_query, "SELECT 1 FROM showcase WHERE day = %d AND room = %d",day,room);
-    int rc = sqlite3_exec(db_fd, select_query, callback_retr_id, &exist, NULL);
-    free(select_query);
-    if(rc!=SQLITE_OK)
-        return FAIL_QUERY;
+/** El cache de asientos esta al dia. Si no se pudo cargar se consulta la base */
+static bool cache_ready(void) {
+    return seat_cache_refresh() == RESPONSE_OK;
+}
+
+/** Funcion en el cache con sus asientos al dia, NULL si no existe o si el cache no esta disponible */
+static ShowcaseSeats * cached_showcase(char *movie, int day, int room) {
+    ShowcaseSeats * showcase = cache_ready() ? seat_cache_find(movie, day, room) : NULL;
+    return showcase != NULL && seat_cache_load(showcase) == RESPONSE_OK ? showcase : NULL;
+}
+
+static int insert_showcase(char *movie, int day, int room) {
+    int exist;
+    sqlite3_stmt *stmt;
+    if (cache_ready()) {
+        exist = seat_cache_find_room(day, room) != NULL ? 1 : INVALID_ID;
+    } else {
+        stmt = get_statement(STMT_ROOM_TAKEN);
+        sqlite3_bind_int(stmt, 1, day);
+        sqlite3_bind_int(stmt, 2, room);
+        if(query_int(stmt, &exist)!=SQLITE_OK)
+            return FAIL_QUERY;
+    }
     if(exist!=INVALID_ID)
         return ALREADY_EXIST;
-    char *insert_query = malloc(MAX_QUERY_SIZE);
-    sprintf(insert_query, "INSERT INTO showcase(movie,day,room) VALUES('%s',%d,%d)",
-            movie,day,room);
-    rc = sqlite3_exec(db_fd, insert_query, 0, 0, &exec_error_msg);
-    free(insert_query);
-    if(rc!=SQLITE_OK)
+
+    stmt = get_statement(STMT_INSERT_SHOWCASE);
+    sqlite3_bind_text(stmt, 1, movie, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, day);
+    sqlite3_bind_int(stmt, 3, room);
+    if(run_statement(stmt)!=SQLITE_OK)
         return FAIL_QUERY;
+    seat_cache_add((int) sqlite3_last_insert_rowid(db_fd), movie, day, room);
     return RESPONSE_OK;
 }
 
-int remove_showcase(char *movie, int day, int room) {
+static int delete_showcase(char *movie, int day, int room) {
     int showcase_id=get_showcase_id(movie,day,room);
     if(showcase_id==INVALID_ID)
         return BAD_SHOWCASE;
-    char *insert_query = malloc(MAX_QUERY_SIZE);
-    sprintf(insert_query, "DELETE FROM booking WHERE showcase_id = %d", showcase_id);
-    int rc = sqlite3_exec(db_fd, insert_query, 0, 0, &exec_error_msg);
-    free(insert_query);
-    if(rc!=SQLITE_OK)
+
+    sqlite3_stmt *stmt = get_statement(STMT_DELETE_SHOWCASE_BOOKINGS);
+    sqlite3_bind_int(stmt, 1, showcase_id);
+    if(run_statement(stmt)!=SQLITE_OK)
         return FAIL_QUERY;
-    insert_query = malloc(MAX_QUERY_SIZE);
-    sprintf(insert_query, "DELETE FROM showcase WHERE movie='%s' AND day=%d AND room=%d",
-            movie,day,room);
-    rc = sqlite3_exec(db_fd, insert_query, 0, 0, &exec_error_msg);
-    free(insert_query);
-    if(rc!=SQLITE_OK)
+
+    stmt = get_statement(STMT_DELETE_SHOWCASE);
+    sqlite3_bind_int(stmt, 1, showcase_id);
+    if(run_statement(stmt)!=SQLITE_OK)
         return FAIL_QUERY;
+
+    ShowcaseSeats * showcase = seat_cache_find(movie, day, room);
+    if (showcase != NULL)
+        seat_cache_remove(showcase);
     return RESPONSE_OK;
 }
 
 int get_client_id(char *name) {
-    int rc, client_id=INVALID_ID; //En caso que sean 0 tuplas retorna INVALID_ID
-    char *client_query = malloc(MAX_QUERY_SIZE);
-    sprintf(client_query, "SELECT id FROM client WHERE name = '%s'", name);
-    rc = sqlite3_exec(db_fd, client_query, callback_retr_id, &client_id, NULL);
-    if(rc!=SQLITE_OK)
+    int client_id;
+    sqlite3_stmt *stmt = get_statement(STMT_CLIENT_ID);
+    sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+    if(query_int(stmt, &client_id)!=SQLITE_OK)
         return INVALID_ID;
-    free(client_query);
     return client_id;
 }
 
 int get_showcase_id(char *movie, int day, int room) {
-    int rc, showcase_id=INVALID_ID; //En caso que estan 0 tuplas retorna INVALID_ID
-    char *showcase_query = malloc(MAX_QUERY_SIZE);
-    sprintf(showcase_query,
-            "SELECT id FROM showcase WHERE showcase.movie = '%s' AND showcase.room = %d AND showcase.day = %d",
-            movie, room, day);
-    rc = sqlite3_exec(db_fd, showcase_query, callback_retr_id, &showcase_id, NULL);
-    free(showcase_query);
-    if (rc != SQLITE_OK)
+    if (cache_ready()) {
+        ShowcaseSeats * showcase = seat_cache_find(movie, day, room);
+        return showcase != NULL ? showcase->id : INVALID_ID;
+    }
+
+    int showcase_id;
+    sqlite3_stmt *stmt = get_statement(STMT_SHOWCASE_ID);
+    sqlite3_bind_text(stmt, 1, movie, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, day);
+    sqlite3_bind_int(stmt, 3, room);
+    if (query_int(stmt, &showcase_id) != SQLITE_OK)
         return INVALID_ID;
     return showcase_id;
 }
 
-int print_cols(int rc,sqlite3_stmt *stmt){
-
-    int rowCount = 0;
+int print_cols(sqlite3_stmt *stmt){
     const unsigned char * textCol=0;
-    rc = sqlite3_step(stmt);
-    while (rc != SQLITE_DONE && rc != SQLITE_OK)
+    int rc = sqlite3_step(stmt);
+    while (rc == SQLITE_ROW)
     {
-        rowCount++;
         int colCount = sqlite3_column_count(stmt);
         for (int colIndex = 0; colIndex < colCount; colIndex++)
         {
-//            int type = sqlite3_column_type(stmt, colIndex);
-//            const char * columnName = sqlite3_column_name(stmt, colIndex);
-            textCol = sqlite3_column_text(stmt, colIndex);
-            printf("%s\n",textCol);
+            //Dia, sala y asiento viajan como enteros en el protocolo binario
+            if (sqlite3_column_type(stmt, colIndex) == SQLITE_INTEGER) {
+                response_int(sqlite3_column_int(stmt, colIndex));
+            } else {
+                textCol = sqlite3_column_text(stmt, colIndex);
+                response_string((const char *) textCol);
+            }
         }
         rc = sqlite3_step(stmt);
     }
 
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
     return RESPONSE_OK;
 }
 
 int show_movies(){
-    sqlite3_stmt *stmt = NULL;
-    char* showq=malloc(MAX_QUERY_SIZE);
-    sprintf(showq,"SELECT DISTINCT movie FROM showcase");
-    int rc = sqlite3_prepare_v2(db_fd, showq, -1, &stmt, NULL);
-    free(showq);
-    if (rc != SQLITE_OK) {
-        printf("%d\n", FAIL_QUERY);
-        return FAIL_QUERY;
-    }
-
-    printf("%d\n", RESPONSE_OK);
-    print_cols(rc,stmt);
+    response_begin(RESPONSE_OK);
+    print_cols(get_statement(STMT_MOVIES));
     return RESPONSE_OK;
 }
 
 int show_showcases(char* movie){
-    sqlite3_stmt *stmt = NULL;
-    char* showq=malloc(MAX_QUERY_SIZE);
-    sprintf(showq,"SELECT DISTINCT movie,day,room FROM showcase WHERE movie = '%s'",movie);
-    int rc = sqlite3_prepare_v2(db_fd, showq, -1, &stmt, NULL);
-    free(showq);
-    if (rc != SQLITE_OK) {
-        printf("%d\n", FAIL_QUERY);
-        return FAIL_QUERY;
-    }
+    sqlite3_stmt *stmt = get_statement(STMT_SHOWCASES);
+    sqlite3_bind_text(stmt, 1, movie, -1, SQLITE_STATIC);
 
-    printf("%d\n", RESPONSE_OK);
-    print_cols(rc,stmt);
+    response_begin(RESPONSE_OK);
+    print_cols(stmt);
     return RESPONSE_OK;
 }
 
-int show_client_booking(char* name){
-    sqlite3_stmt *stmt = NULL;
+static int show_client_tickets(char* name, int cancelled){
     int client_id = get_client_id(name);
     if (client_id == INVALID_ID) {
-        printf("%d\n", BAD_CLIENT);
+        response_begin(BAD_CLIENT);
         return BAD_CLIENT;
     }
-    printf("%d\n", RESPONSE_OK);
-
-    char* showq=malloc(MAX_QUERY_SIZE);
-    sprintf(showq,"SELECT movie,day,room,seat FROM booking INNER JOIN showcase ON showcase.id = booking.showcase_id "
-                    "WHERE client_id = %d AND cancelled = 0",
-            client_id);
-    int rc = sqlite3_prepare_v2(db_fd, showq, -1, &stmt, NULL);
-    free(showq);
-    if (rc != SQLITE_OK) {
-        printf("%d\n", FAIL_QUERY);
-        return FAIL_QUERY;
-    }
 
-    print_cols(rc,stmt);
+    sqlite3_stmt *stmt = get_statement(STMT_CLIENT_BOOKINGS);
+    sqlite3_bind_int(stmt, 1, client_id);
+    sqlite3_bind_int(stmt, 2, cancelled);
+
+    response_begin(RESPONSE_OK);
+    print_cols(stmt);
     return RESPONSE_OK;
 }
 
+int show_client_booking(char* name){
+    return show_client_tickets(name, 0);
+}
+
 int show_client_cancelled(char* name){
-    sqlite3_stmt *stmt = NULL;
-    int client_id = get_client_id(name);
-    if (client_id == INVALID_ID) {
-        printf("%d\n",BAD_CLIENT);
-        return BAD_CLIENT;
-    }
-    printf("%d\n", RESPONSE_OK);
-
-    char* showq=malloc(MAX_QUERY_SIZE);
-    sprintf(showq,"SELECT movie,day,room,seat FROM booking INNER JOIN showcase ON showcase.id = booking.showcase_id "
-            "WHERE client_id = %d AND cancelled = 1",
-            client_id);
-    int rc = sqlite3_prepare_v2(db_fd, showq, -1, &stmt, NULL);
-    free(showq);
-    if (rc != SQLITE_OK) {
-        printf("%d\n", FAIL_QUERY);
-        return FAIL_QUERY;
-    }
-    print_cols(rc,stmt);
-    return RESPONSE_OK;
+    return show_client_tickets(name, 1);
 }
 
 int show_seats(char *movie, int day, int room){
+    uint8_t map[SEATMAP_BYTES] = {0};
+
+    //El mapa sale del cache, a la base solo se va si otro proceso cambio la funcion
+    bool cached = cache_ready();
+    ShowcaseSeats * showcase = cached ? seat_cache_find(movie, day, room) : NULL;
+    if (cached && showcase == NULL) {
+        response_begin(BAD_SHOWCASE);
+        return BAD_SHOWCASE;
+    }
+    if (showcase != NULL && seat_cache_load(showcase) == RESPONSE_OK) {
+        for (int i = 0; i < SEATS; i++)
+            if (seat_taken(showcase, i))
+                seatmap_set(map, i);
+        response_begin(RESPONSE_OK);
+        response_bytes(map, SEATMAP_BYTES);
+        return RESPONSE_OK;
+    }
+
     int rc,show_id=get_showcase_id(movie,day,room);
     if(show_id == INVALID_ID) {
-        printf("%d\n",BAD_SHOWCASE);
+        response_begin(BAD_SHOWCASE);
         return BAD_SHOWCASE;
     }
-    printf("%d\n", RESPONSE_OK);
-
-    for(int i=0;i<SEATS;i++){
-        int client_id=INVALID_ID;
-        char *showb_query=malloc(MAX_QUERY_SIZE);
-        sprintf(showb_query,"SELECT client_id FROM booking "
-                "WHERE showcase_id = %d AND seat = %d AND cancelled = 0",
-                show_id,i);
-        rc = sqlite3_exec(db_fd,showb_query,callback_retr_id,&client_id,&exec_error_msg);
-        if (rc != SQLITE_OK) {
-            printf("%d\n", FAIL_QUERY);
-            return FAIL_QUERY;
-        }
-        free(showb_query);
-        if(client_id==INVALID_ID){
-            printf("%d\n", EMPTY_SEAT);
-        }else{
-            printf("%d\n", RESERVED_SEAT);
-        }
+
+    //Se arma el mapa completo con una sola consulta sobre las reservas activas de la funcion
+    sqlite3_stmt *stmt = get_statement(STMT_SEATS);
+    sqlite3_bind_int(stmt, 1, show_id);
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        int seat = sqlite3_column_int(stmt, 0);
+        if (seat >= 0 && seat < SEATS)
+            seatmap_set(map, seat);
     }
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE) {
+        response_begin(FAIL_QUERY);
+        return FAIL_QUERY;
+    }
+
+    response_begin(RESPONSE_OK);
+    response_bytes(map, SEATMAP_BYTES);
     return RESPONSE_OK;
 }
 
-int add_booking(char *name, char *movie, int day, int room, int seat) {
-    int rc;
-    int client_id, showcase_id;
+static int book_seat(char *name, char *movie, int day, int room, int seat) {
+    int client_id, showcase_id, exist;
 
     client_id = get_client_id(name);
     if (client_id == INVALID_ID) {
         return BAD_CLIENT;
     }
 
-    showcase_id = get_showcase_id(movie, day, room);
+    ShowcaseSeats * showcase = cached_showcase(movie, day, room);
+    showcase_id = showcase != NULL ? showcase->id : get_showcase_id(movie, day, room);
     if (showcase_id == INVALID_ID) {
         return BAD_SHOWCASE;
     }
-    int exist=INVALID_ID; //En caso que sean 0 tuplas retorna INVALID_ID
-    char *client_query = malloc(MAX_QUERY_SIZE);
-    sprintf(client_query, "SELECT 111 FROM booking WHERE showcase_id = %d AND seat = %d AND cancelled = 0",showcase_id,seat);
-    rc = sqlite3_exec(db_fd, client_query, callback_retr_id, &exist, NULL);
-    if (rc != SQLITE_OK)
-        return FAIL_QUERY;
-    free(client_query);
+
+    sqlite3_stmt *stmt;
+    if (showcase != NULL && seat_in_cache(seat)) {
+        exist = seat_taken(showcase, seat) ? 1 : INVALID_ID;
+    } else {
+        stmt = get_statement(STMT_SEAT_TAKEN);
+        sqlite3_bind_int(stmt, 1, showcase_id);
+        sqlite3_bind_int(stmt, 2, seat);
+        if (query_int(stmt, &exist) != SQLITE_OK)
+            return FAIL_QUERY;
+    }
     if(exist!=INVALID_ID)
         return ALREADY_EXIST;
-    char *insert_query = malloc(MAX_QUERY_SIZE);
 
-    sprintf(insert_query, "INSERT INTO booking(client_id, showcase_id, cancelled, seat) VALUES(%d, %d, 0, %d)", client_id, showcase_id, seat);
-    rc = sqlite3_exec(db_fd, insert_query, NULL, NULL, NULL);
-    free(insert_query);
-    if (rc != SQLITE_OK)
+    stmt = get_statement(STMT_INSERT_BOOKING);
+    sqlite3_bind_int(stmt, 1, client_id);
+    sqlite3_bind_int(stmt, 2, showcase_id);
+    sqlite3_bind_int(stmt, 3, seat);
+    if (run_statement(stmt) != SQLITE_OK)
         return FAIL_QUERY;
+    if (showcase != NULL && seat_in_cache(seat))
+        seat_set(showcase, seat, true);
     return RESPONSE_OK;
 }
 
-int cancel_booking(char *name, char *movie, int day, int room, int seat) {
-    int client_id, showcase_id, rc;
+static int cancel_seat(char *name, char *movie, int day, int room, int seat) {
+    int client_id, showcase_id;
 
     client_id = get_client_id(name);
     if (client_id == INVALID_ID) {
         return BAD_CLIENT;
     }
 
-    showcase_id = get_showcase_id(movie, day, room);
+    ShowcaseSeats * showcase = cached_showcase(movie, day, room);
+    showcase_id = showcase != NULL ? showcase->id : get_showcase_id(movie, day, room);
     if (showcase_id == INVALID_ID) {
         return BAD_SHOWCASE;
     }
 
-    char *update_query = malloc(MAX_QUERY_SIZE);
-    sprintf(update_query,
-            "UPDATE booking SET cancelled = 1 WHERE booking.client_id = %d AND booking.showcase_id = %d AND booking.seat = %d",
-            client_id, showcase_id, seat);
-    rc = sqlite3_exec(db_fd,update_query,NULL,NULL,NULL);
-    free(update_query);
-    if (rc != SQLITE_OK){
+    sqlite3_stmt *stmt = get_statement(STMT_CANCEL_BOOKING);
+    sqlite3_bind_int(stmt, 1, client_id);
+    sqlite3_bind_int(stmt, 2, showcase_id);
+    sqlite3_bind_int(stmt, 3, seat);
+    if (run_statement(stmt) != SQLITE_OK){
         return FAIL_QUERY;
     }
+    //Sin una reserva activa de este cliente en ese asiento no cambia nada y no se avisa a nadie
+    if (sqlite3_changes(db_fd) == 0)
+        return BAD_BOOKING;
+    if (showcase != NULL && seat_in_cache(seat))
+        seat_set(showcase, seat, false);
     return RESPONSE_OK;
+}
+
+int add_client(char *name){
+    if (begin_write() != SQLITE_OK)
+        return FAIL_QUERY;
+    return end_write(insert_client(name));
+}
+
+int add_showcase(char *movie, int day, int room) {
+    if (begin_write() != SQLITE_OK)
+        return FAIL_QUERY;
+    return end_write(insert_showcase(movie, day, room));
+}
 
+int remove_showcase(char *movie, int day, int room) {
+    if (begin_write() != SQLITE_OK)
+        return FAIL_QUERY;
+    return end_write(delete_showcase(movie, day, room));
 }
 
-int callback_retr_id(void *data, int argc, char **argv, char **azColName) {
-    int *ptr = (int *) data;
-    *ptr = atoi(argv[0]);
-    return 0;
+int add_booking(char *name, char *movie, int day, int room, int seat) {
+    if (begin_write() != SQLITE_OK)
+        return FAIL_QUERY;
+    return end_write(book_seat(name, movie, day, room, seat));
+}
+
+int cancel_booking(char *name, char *movie, int day, int room, int seat) {
+    if (begin_write() != SQLITE_OK)
+        return FAIL_QUERY;
+    return end_write(cancel_seat(name, movie, day, room, seat));
 }
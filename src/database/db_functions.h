@@ -5,18 +5,36 @@
 #include "stdbool.h"
 #include "../protocol.h"
 
-#define ERR_MSG 0
-#define MAX_QUERY_SIZE (2 + MAX_ARGS  * (ARG_SIZE + 2))
-
 #define INVALID_ID (-1)
 
+/** milisegundos que se espera a que otro proceso libere la base antes de fallar */
+#define BUSY_TIMEOUT 5000
+
+/**
+ * Ajustes de durabilidad y memoria de sqlite, se eligen al iniciar el proceso.
+ * NULL, 0 o negativo (mmap_size) deja el default de sqlite.
+ */
+typedef struct {
+    /** delete, truncate, persist, memory, wal u off */
+    const char * journal_mode;
+    /** off, normal, full o extra */
+    const char * synchronous;
+    /** como PRAGMA cache_size: positivo en paginas, negativo en KiB */
+    int cache_size;
+    /** bytes del archivo mapeados en memoria, 0 lo deshabilita */
+    long long mmap_size;
+} DatabaseOptions;
+
 int database_open(const char * filename);
+/** Aplica las opciones sobre la base abierta. Retorna RESPONSE_ERR si algun valor es invalido */
+int database_configure(const DatabaseOptions * options);
 int database_close();
 
 int add_client(char *name);
 int add_showcase(char *movie, int day, int room);
 int remove_showcase(char *movie, int day, int room);
 
+/** Escriben el estado y los datos de la respuesta con response_writer.h, sin terminarla */
 int show_movies();
 int show_showcases(char* movie);
 int show_client_booking(char* name);
@@ -26,10 +44,26 @@ int show_seats(char *movie, int day, int room);
 int get_client_id(char *name);
 int get_showcase_id(char *movie, int day, int room);
 
+/**
+ * Group commit: every write until database_batch_commit runs inside a single transaction.
+ * Each write still succeeds or fails on its own, but nothing is durable until the commit.
+ */
+int database_batch_begin(void);
+/** Commits the batch, if it fails every write of the batch is lost and FAIL_QUERY is returned */
+int database_batch_commit(void);
+
+/**
+ * Escrituras de un BATCH: las que corren hasta database_atomic_end se confirman todas
+ * juntas o ninguna. Dentro de un lote de group commit el grupo es un savepoint mas.
+ */
+int database_atomic_begin(void);
+/** Cierra el grupo, lo confirma si status es RESPONSE_OK y si no lo deshace. Retorna el estado final */
+int database_atomic_end(int status);
+
 /*Saves booking info on database*/
 int add_booking(char *name, char *movie, int day, int sala, int seat);
 
-/*Cancels an existing booking*/
+/*Cancels an existing booking, BAD_BOOKING if the client has no active booking of that seat*/
 int cancel_booking(char *name, char *movie, int day, int sala, int seat);
 
 #endif //TP_FINAL_SO_DB_FUNCTIONS_H
@@ -1,45 +1,294 @@
 #include <stdio.h>
 #include <unistd.h>
+#include <string.h>
 #include <strings.h>
 #include <syslog.h>
 #include <stdlib.h>
+#include <time.h>
+#include <sys/select.h>
 #include "db_functions.h"
 #include "request.h"
 #include "request_parser.h"
+#include "response_writer.h"
+#include "../message.h"
+#include "../ring.h"
+
+/** Escrituras que se agrupan como maximo en un mismo commit */
+#define MAX_BATCH 64
 
 void process_request(int state, Request * request);
 
-int main(int argc, char const *argv[]) {
+/** Ventana de group commit en microsegundos, 0 confirma cada escritura por separado */
+static long group_commit = 0;
+
+/** Escritura del lote abierto, se responde recien despues del commit */
+typedef struct {
+    int status;
+    /** formato del pedido, la respuesta usa el mismo */
+    bool binary;
+    /** escritura de un BATCH que fallo, -1 si ninguna */
+    int failed;
+    /** id del pedido, se repite en la respuesta */
+    bool has_id;
+    uint32_t id;
+} BatchEntry;
+
+static BatchEntry batch[MAX_BATCH];
+static int batch_count = 0;
+/** Momento en que se cierra el lote abierto */
+static struct timespec batch_deadline;
+
+/** Anillo por el que llegan los pedidos (ring.h), NULL si llegan por stdin */
+static Ring * requests = NULL;
+
+static void usage(const char * name) {
+    fprintf(stderr, "Usage: %s [-j journal_mode] [-s synchronous] [-c cache_size] [-m mmap_size] [-g usec] [-r fd] <filename>\n", name);
+    exit(1);
+}
+
+static long long parse_number(const char * name, char * optarg) {
+    char *end = 0;
+    long long value = strtoll(optarg, &end, 10);
 
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <filename>\n", argv[0]);
+    if (end == optarg || '\0' != *end) {
+        usage(name);
+    }
+    return value;
+}
+
+static void parse_options(int argc, char * argv[], DatabaseOptions * options, int * ring_fd) {
+    opterr = 0;
+    int c;
+    while ((c = getopt(argc, argv, "j:s:c:m:g:r:")) != -1) {
+        switch (c) {
+            /* Journal mode, wal lets readers run while a worker writes */
+            case 'j':
+                options->journal_mode = optarg;
+                break;
+            /* Synchronous level, how often sqlite waits for the disk */
+            case 's':
+                options->synchronous = optarg;
+                break;
+            /* Page cache size */
+            case 'c':
+                options->cache_size = (int) parse_number(argv[0], optarg);
+                break;
+            /* Memory mapped I/O size in bytes */
+            case 'm':
+                options->mmap_size = parse_number(argv[0], optarg);
+                break;
+            /* Group commit window: writes arriving within it share one transaction */
+            case 'g':
+                group_commit = (long) parse_number(argv[0], optarg);
+                if (group_commit < 0) {
+                    usage(argv[0]);
+                }
+                break;
+            /* Shared memory region inherited from the server, requests and responses go through its rings */
+            case 'r':
+                *ring_fd = (int) parse_number(argv[0], optarg);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    if (optind != argc - 1) {
+        usage(argv[0]);
+    }
+}
+
+static void log_request(Request * request);
+static void log_response(int type);
+static int execute_write(Request * request, int * failed);
+
+/** Confirma el lote abierto y envia las respuestas de sus escrituras */
+static void commit_batch(void) {
+    if (batch_count == 0) {
+        return;
+    }
+
+    bool committed = database_batch_commit() == RESPONSE_OK;
+    for (int i = 0; i < batch_count; i++) {
+        int status = !committed && batch[i].status == RESPONSE_OK ? FAIL_QUERY : batch[i].status;
+        response_set_binary(batch[i].binary);
+        response_set_id(batch[i].has_id, batch[i].id);
+        response_begin(status);
+        if (batch[i].failed >= 0) {
+            response_int(batch[i].failed);
+        }
+        response_end();
+        log_response(status);
+    }
+    fflush(stdout);
+    batch_count = 0;
+}
+
+/** Espera un nuevo pedido hasta que vence el lote abierto, retorna false si no llego ninguno */
+static bool wait_input(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    long remaining = (batch_deadline.tv_sec - now.tv_sec) * 1000000 + (batch_deadline.tv_nsec - now.tv_nsec) / 1000;
+    if (remaining <= 0) {
+        return false;
+    }
+    if (requests != NULL) {
+        return ring_wait(requests, remaining);
+    }
+
+    fd_set read_fds;
+    FD_ZERO(&read_fds);
+    FD_SET(STDIN_FILENO, &read_fds);
+    struct timeval timeout = {.tv_sec = remaining / 1000000, .tv_usec = remaining % 1000000};
+
+    return select(STDIN_FILENO + 1, &read_fds, NULL, NULL, &timeout) > 0;
+}
+
+/** Agrega la escritura al lote, abriendolo si hace falta. Retorna false si no se pudo abrir */
+static bool batch_write(Request * request, bool binary) {
+    if (batch_count == 0) {
+        if (database_batch_begin() != RESPONSE_OK) {
+            return false;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &batch_deadline);
+        batch_deadline.tv_sec  += (batch_deadline.tv_nsec / 1000 + group_commit) / 1000000;
+        batch_deadline.tv_nsec  = (batch_deadline.tv_nsec / 1000 + group_commit) % 1000000 * 1000;
+    }
+
+    log_request(request);
+    batch[batch_count].status   = execute_write(request, &batch[batch_count].failed);
+    batch[batch_count].binary   = binary;
+    batch[batch_count].has_id   = request->has_id;
+    batch[batch_count++].id     = request->id;
+    if (batch_count == MAX_BATCH) {
+        commit_batch();
+    }
+    return true;
+}
+
+/** Se reutiliza en cada pedido, atenderlos no pide memoria */
+static RequestParser parser;
+
+/** Parsea y atiende un pedido completo de len bytes, binary indica su formato */
+static void handle_request(char * buffer, size_t len, bool overflow, bool binary) {
+    Request * request = parser.request;
+    int state;
+
+    request_parser_reset(&parser);
+    if (overflow) {
+        // el principio del pedido se descarto
+        state = request_error;
+    } else if (binary) {
+        state = request_from_frame(request, buffer, len) ? request_done : request_error;
+    } else {
+        state = request_parser_feed_buffer(&parser, buffer, len);
+    }
+    if (state == request_done && !request_has_args(request)) {
+        // no se usan los argumentos que dejo el pedido anterior
+        state = request_error;
+    }
+
+    bool batched = group_commit > 0 && state == request_done && is_write_request(request->type)
+                   && batch_write(request, binary);
+    if (!batched) {
+        // las respuestas salen en el orden de los pedidos, el lote se cierra antes
+        commit_batch();
+        response_set_binary(binary);
+        response_set_id(request->has_id, request->id);
+        process_request(state, request);
+    }
+}
+
+/** Lee los pedidos que van llegando, del anillo o de stdin */
+static ssize_t read_input(char * buffer, size_t size) {
+    if (requests != NULL) {
+        return (ssize_t) ring_read(requests, buffer, size);
+    }
+    return read(STDIN_FILENO, buffer, size);
+}
+
+/** Los pedidos se leen del primer anillo de la region y stdout pasa a escribir en el segundo */
+static void open_rings(int fd) {
+    Ring * responses;
+    FILE * stream = NULL;
+
+    if (ring_region_map(fd, &requests, &responses) == 0) {
+        stream = ring_open_stream(responses);
+    }
+    close(fd);
+    if (stream == NULL) {
+        fprintf(stderr, "Error mapping the shared memory region\n");
         exit(1);
     }
+    stdout = stream;
+}
+
+int main(int argc, char *argv[]) {
+    DatabaseOptions options = {.journal_mode = NULL, .synchronous = NULL, .cache_size = 0, .mmap_size = -1};
+    int ring_fd = -1;
+
+    parse_options(argc, argv, &options, &ring_fd);
+    char * filename = argv[optind];
+
+    if (ring_fd >= 0) {
+        open_rings(ring_fd);
+    }
 
-    if (database_open(argv[1]) != RESPONSE_OK) {
-        fprintf(stderr, "Error opening database '%s'", argv[1]);
+    if (database_open(filename) != RESPONSE_OK) {
+        fprintf(stderr, "Error opening database '%s'", filename);
         exit(-1);
     }
 
+    if (database_configure(&options) != RESPONSE_OK) {
+        fprintf(stderr, "Invalid options for database '%s'\n", filename);
+        exit(1);
+    }
+
+    request_parser_init(&parser);
+
     char buffer[BUFFER_SIZE];
-    ssize_t n;
-    do {
-        RequestParser parser;
-        request_parser_init(&parser);
+    size_t len = 0, scanned = 0;
+    // el pedido actual no entra en el buffer, se descarta hasta su fin
+    bool overflow = false;
+    // formato del pedido actual, lo indica su primer byte
+    bool binary = false;
+    MessageScanner scanner;
+    message_scanner_init(&scanner);
+
+    while (true) {
+        // un read puede traer varios pedidos si el server los encadena, se atienden en orden
         bool done = false;
-        do {
-            bzero(buffer, BUFFER_SIZE);
-            n = read(STDIN_FILENO, buffer, BUFFER_SIZE);
-            if (n > 0) {
-                request_parser_consume(&parser, buffer);
-                done = request_parser_is_done(&parser, 0);
-            }
-        } while(n > 0 && !done);
+        if (scanned == 0 && len > 0 && !overflow) {
+            binary = is_frame(buffer, len);
+        }
+        scanned += message_scan(&scanner, buffer + scanned, len - scanned, &done);
+        if (done) {
+            handle_request(buffer, scanned, overflow, binary);
+            memmove(buffer, buffer + scanned, len - scanned);
+            len -= scanned;
+            scanned  = 0;
+            overflow = false;
+            continue;
+        }
 
-        process_request(parser.state, parser.request);
-        request_parser_destroy(&parser);
-    } while (n > 0);
+        if (len == BUFFER_SIZE) {
+            overflow = true;
+            len = scanned = 0;
+        }
+        if (batch_count > 0 && !wait_input()) {
+            commit_batch();
+        }
 
+        ssize_t n = read_input(buffer + len, BUFFER_SIZE - len);
+        if (n <= 0) {
+            break;
+        }
+        len += (size_t) n;
+    }
+
+    commit_batch();
+    request_parser_destroy(&parser);
     database_close();
 
     return 0;
@@ -47,17 +296,15 @@ int main(int argc, char const *argv[]) {
 
 static void log_request(Request * request) {
     char buffer[BUFFER_SIZE];
-    char * aux = buffer;
-    aux += sprintf(aux, "%s(", get_request_type(request->type));
+    size_t len = (size_t) snprintf(buffer, sizeof(buffer), "%s(", get_request_type(request->type));
 
-    for (int i = 0; i < request->argc; i++) {
-        aux += sprintf(aux, "%s", request->args[i]);
-        if (i < request->argc -1) {
-            aux += sprintf(aux, ",");
-        }
+    // un BATCH puede no entrar, el log se corta
+    for (int i = 0; i < request->argc && len < sizeof(buffer); i++) {
+        len += (size_t) snprintf(buffer + len, sizeof(buffer) - len, i < request->argc - 1 ? "%s," : "%s", request->args[i]);
+    }
+    if (len < sizeof(buffer)) {
+        snprintf(buffer + len, sizeof(buffer) - len, ")");
     }
-
-    sprintf(aux, ")");
     syslog(LOG_DEBUG, "[DATABASE] request %s", buffer);
 }
 
@@ -65,34 +312,99 @@ static void log_response(int type) {
     syslog(LOG_DEBUG, "[DATABASE] response %s", get_response_type(type));
 }
 
+/** Ejecuta una escritura sobre sus argumentos */
+static int execute_command(int type, char ** args) {
+    switch(type){
+        case ADD_CLIENT:
+            return add_client(args[0]);
+        case ADD_SHOWCASE:
+            return add_showcase(args[0],atoi(args[1]),atoi(args[2]));
+        case ADD_BOOKING:
+            return add_booking(args[0],args[1],atoi(args[2]),atoi(args[3]),atoi(args[4]));
+        case REMOVE_BOOKING:
+            return cancel_booking(args[0],args[1],atoi(args[2]),atoi(args[3]),atoi(args[4]));
+        case REMOVE_SHOWCASE:
+            return remove_showcase(args[0],atoi(args[1]),atoi(args[2]));
+        default:
+            return RESPONSE_ERR;
+    }
+}
+
+/** Revisa que los argumentos de un BATCH sean escrituras completas, retorna cuantas son o -1 */
+static int batch_count_requests(Request * request) {
+    int count = 0;
+    for (int i = 0; i < request->argc; count++) {
+        int args = batch_request_args(atoi(request->args[i]));
+        if (args < 0 || count == MAX_BATCH_REQUESTS || i + 1 + args > request->argc) {
+            return -1;
+        }
+        i += 1 + args;
+    }
+    return count;
+}
+
+/** Las escrituras de un BATCH van en una sola transaccion, la primera que falla deshace todas */
+static int execute_batch(Request * request, int * failed) {
+    if (batch_count_requests(request) <= 0) {
+        return RESPONSE_ERR;
+    }
+    if (database_atomic_begin() != RESPONSE_OK) {
+        return FAIL_QUERY;
+    }
+
+    int status = RESPONSE_OK;
+    for (int i = 0, index = 0; i < request->argc && status == RESPONSE_OK; index++) {
+        int type = atoi(request->args[i]);
+        status = execute_command(type, request->args + i + 1);
+        if (status != RESPONSE_OK) {
+            *failed = index;
+        }
+        i += 1 + batch_request_args(type);
+    }
+
+    return database_atomic_end(status);
+}
+
+/** Ejecuta una escritura, su respuesta es el estado y en un BATCH el indice de la escritura que fallo */
+static int execute_write(Request * request, int * failed) {
+    *failed = -1;
+    if (request->type == BATCH) {
+        return execute_batch(request, failed);
+    }
+    return execute_command(request->type, request->args);
+}
+
 void process_request(int state, Request * request) {
 
     if (state != request_done) {
         // send error
-        printf("%d\n.\n", RESPONSE_ERR);
+        response_begin(RESPONSE_ERR);
+        response_end();
         fflush(stdout);
         return;
     }
     log_request(request);
 
     int cache = RESPONSE_ERR;
+    int failed;
     switch(request->type){
         case ADD_CLIENT:
-            cache=add_client(request->args[0]);
-            printf("%d\n", cache);
-            break;
         case ADD_SHOWCASE:
-            cache=add_showcase(request->args[0],atoi(request->args[1]),atoi(request->args[2]));
-            printf("%d\n", cache);
-            break;
         case ADD_BOOKING:
-            cache=add_booking(request->args[0],request->args[1],atoi(request->args[2]),atoi(request->args[3]),atoi(request->args[4]));
-            printf("%d\n",cache);
+        case REMOVE_BOOKING:
+        case REMOVE_SHOWCASE:
+        case BATCH:
+            cache = execute_write(request, &failed);
+            response_begin(cache);
+            if (failed >= 0) {
+                response_int(failed);
+            }
             break;
         case GET_MOVIES:
             cache = show_movies();
             break;
         case GET_SEATS:
+        case SUBSCRIBE_SEATS:
             cache = show_seats(request->args[0],atoi(request->args[1]),atoi(request->args[2]));
             break;
         case GET_SHOWCASES:
@@ -104,21 +416,13 @@ void process_request(int state, Request * request) {
         case GET_CANCELLED:
             cache = show_client_cancelled(request->args[0]);
             break;
-        case REMOVE_BOOKING:
-            cache=cancel_booking(request->args[0],request->args[1],atoi(request->args[2]),atoi(request->args[3]),atoi(request->args[4]));
-            printf("%d\n",cache);
-            break;
-        case REMOVE_SHOWCASE:
-            cache=remove_showcase(request->args[0],atoi(request->args[1]),atoi(request->args[2]));
-            printf("%d\n",cache);
-            break;
         default:
-            printf("%d\n",RESPONSE_ERR);
+            response_begin(RESPONSE_ERR);
             break; //remove it after
 
     }
 
-    printf(".\n");
+    response_end();
     fflush(stdout);     // la magia
     log_response(cache);
 }
\ No newline at end of file
@@ -1,28 +1,82 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "request.h"
+#include "../frame.h"
 
 Request * new_request(void) {
-    Request * request = malloc(sizeof(*request));
+    Request * request = calloc(1, sizeof(*request));
     if (request == NULL) {
         return NULL;
     }
 
-    request->type  = 0;
-    request->argc  = 0;
-
-    for (int i = 0; i < MAX_ARGS; i++) {
-        request->args[i] = calloc(ARG_SIZE, sizeof(char));
-        if (request->args[i] == NULL) {
-            for (int j = 0; j < i; j++) {
-                free(request->args[j]);
-            }
-            free(request);
-            return NULL;
+    request_reset(request);
+    return request;
+}
+
+void request_reset(Request * request) {
+    // solo los argumentos que se usaron, los demas ya estan vacios
+    for (int i = 0; i < request->argc; i++) {
+        request->args[i] = NULL;
+    }
+    request->type   = 0;
+    request->argc   = 0;
+    request->has_id = false;
+    request->id     = 0;
+    request->id_digits = 0;
+}
+
+bool request_has_args(const Request * request) {
+    if (request->type != BATCH) {
+        int count = request_arg_count(request->type);
+        return count >= 0 && request->argc >= count;
+    }
+
+    for (int i = 0; i < request->argc;) {
+        int args = batch_request_args(atoi(request->args[i]));
+        if (args < 0 || i + 1 + args > request->argc) {
+            return false;
         }
+        i += 1 + args;
     }
+    return true;
+}
 
-    return request;
+bool request_from_frame(Request * request, char * frame, size_t len) {
+    FrameReader reader;
+    FrameHeader header;
+    FrameArg arg;
+
+    if (!frame_reader_init(&reader, frame, len, &header) || header.argc > request_max_args(header.code)) {
+        return false;
+    }
+
+    request->type   = header.code;
+    request->has_id = header.has_id;
+    request->id     = header.id;
+    for (; request->argc < header.argc; request->argc++) {
+        if (!frame_next(&reader, &arg)) {
+            return false;
+        }
+
+        const int i = request->argc;
+        if (arg.type == FRAME_INT) {
+            request->lengths[i] = (size_t) snprintf(request->numbers[i], NUMBER_SIZE, "%d", arg.value);
+            request->args[i]    = request->numbers[i];
+        } else if (arg.len >= ARG_SIZE) {
+            return false;
+        } else {
+            // el string se corre un byte sobre su largo, asi el terminador no pisa el argumento siguiente
+            char * string = frame + (arg.string - frame) - 1;
+            memmove(string, string + 1, arg.len);
+            string[arg.len] = 0;
+            request->args[i]    = string;
+            request->lengths[i] = arg.len;
+        }
+    }
+
+    // sobran bytes despues del ultimo argumento
+    return reader.offset == len;
 }
 
 void print_request(Request * request) {
@@ -35,10 +89,6 @@ void print_request(Request * request) {
 }
 
 void destroy_request(Request * request) {
-    for (int i = 0; i < MAX_ARGS; i++) {
-        free(request->args[i]);
-    }
     free(request);
 }
 
-
@@ -5,16 +5,51 @@
 #include "../protocol.h"
 
 #define BUFFER_SIZE 4096
-
+/** Lugar para un entero de 32 bits en decimal, con signo y terminador */
+#define NUMBER_SIZE 12
+
+/**
+ * Los argumentos no se copian: apuntan al mensaje recibido, que se modifica para
+ * terminarlos en 0. Valen mientras el mensaje siga en el buffer, el pedido se
+ * reutiliza para el siguiente con request_reset.
+ */
 typedef struct {
     int type;
+    /** id opcional del pedido, se repite en la respuesta (protocol.h) */
+    bool has_id;
+    uint32_t id;
+    int id_digits;
     int argc;
-    char * args[MAX_ARGS];
+    /** un BATCH trae los argumentos de todas sus escrituras */
+    char * args[MAX_BATCH_ARGS];
+    size_t lengths[MAX_BATCH_ARGS];
+    /** enteros de un mensaje binario en decimal, no estan como texto en el mensaje */
+    char numbers[MAX_BATCH_ARGS][NUMBER_SIZE];
 } Request;
 
+/** Argumentos que admite un pedido del tipo dado */
+static inline int request_max_args(int type) {
+    return type == BATCH ? MAX_BATCH_ARGS : MAX_ARGS;
+}
+
 
 Request * new_request(void);
 
+/** Deja el pedido vacio para parsear el siguiente, sin argumentos del anterior */
+void request_reset(Request * request);
+
+/**
+ * Indica si el pedido trae todos los argumentos de su comando y, en un BATCH, cada escritura
+ * los suyos. Un pedido corto no se atiende: los argumentos que le faltan no existen.
+ */
+bool request_has_args(const Request * request);
+
+/**
+ * Arma el pedido a partir de un mensaje binario completo (frame.h), retorna false si
+ * es invalido. Los argumentos de texto quedan apuntando a frame.
+ */
+bool request_from_frame(Request * request, char * frame, size_t len);
+
 void print_request(Request * request);
 
 void destroy_request(Request * request);
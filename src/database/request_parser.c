@@ -1,4 +1,5 @@
 #include <ctype.h>
+#include <string.h>
 #include "request_parser.h"
 #include "../multiline_parser.h"
 #include "../utils.h"
@@ -13,11 +14,20 @@ void request_parser_init(RequestParser * parser) {
         parser_destroy(parser->multiline_parser);
         // ERROR
     }
-    parser->arg_index = 0;
+    parser->state = request_cmd;
+}
+
+void request_parser_reset(RequestParser * parser) {
+    parser_reset(parser->multiline_parser);
+    request_reset(parser->request);
     parser->state = request_cmd;
 }
 
 request_state cmd(Request * request, char c) {
+    if (c == REQUEST_ID_SEPARATOR) {
+        request->has_id = true;
+        return request_id;
+    }
     if (!isdigit(c)) {
         return request_error_invalid_cmd;
     }
@@ -27,15 +37,23 @@ request_state cmd(Request * request, char c) {
     return request_cmd;
 }
 
-request_state arg(Request * request, char c, int j) {
-    request_state ret = request_args;
-    if (j >= ARG_SIZE - 1) {
-        ret = request_error_argument_too_long;
-    } else {
-        request->args[request->argc - 1][j] = c;
+/** Un digito del id que sigue al comando, TYPE:ID */
+request_state id(Request * request, char c) {
+    if (!request_id_digit(&request->id, &request->id_digits, c)) {
+        return request_error_invalid_cmd;
+    }
+    return request_id;
+}
+
+/** Agrega n bytes al argumento actual, que ya apunta al mensaje */
+request_state arg(Request * request, size_t n) {
+    size_t * length = &request->lengths[request->argc - 1];
+    if (*length + n > ARG_SIZE - 1) {
+        return request_error_argument_too_long;
     }
 
-    return ret;
+    *length += n;
+    return request_args;
 }
 
 request_state req_byte(RequestParser * parser, char c) {
@@ -44,8 +62,11 @@ request_state req_byte(RequestParser * parser, char c) {
         case request_cmd:
             ret = cmd(parser->request, c);
             break;
+        case request_id:
+            ret = id(parser->request, c);
+            break;
         case request_args:
-            ret = arg(parser->request, c, parser->arg_index++);
+            ret = arg(parser->request, 1);
             break;
         default:
             ret = request_error;
@@ -55,58 +76,95 @@ request_state req_byte(RequestParser * parser, char c) {
     return ret;
 }
 
-request_state req_newline(RequestParser * parser, char c) {
-    parser->arg_index = 0;
-    parser->request->argc++;
-
-    request_state ret;
-    if (parser->request->argc > MAX_ARGS) {
-        ret = request_error_too_many_arguments;
-    } else {
-        ret = arg(parser->request, c, parser->arg_index++);
+/** Empieza un argumento en start, el primer byte de su linea */
+request_state req_newline(RequestParser * parser, char * start) {
+    Request * request = parser->request;
+    if (request->argc == request_max_args(request->type)) {
+        return request_error_too_many_arguments;
     }
 
-    return ret;
+    request->args[request->argc]    = start;
+    request->lengths[request->argc] = 0;
+    request->argc++;
+    return arg(request, 1);
 }
 
-request_state request_parser_feed(RequestParser * parser, char c) {
-    const ParserEvent *e = parser_feed(parser->multiline_parser, (uint8_t) c);
+/** Atiende un evento del parser multilinea, at es el byte que lo genero */
+static void handle_event(RequestParser * parser, const ParserEvent * e, char * at) {
+    if (debug) print_state("request", multiline_event, e);
+    switch (e->type) {
+        case MULTI_BYTE:
+            parser->state = req_byte(parser, e->data[0]);
+            break;
+        case MULTI_NEWLINE:
+            // una linea que empieza con un punto se conoce recien en el byte siguiente
+            parser->state = req_newline(parser, e->next != NULL ? at - 1 : at);
+            break;
+        case MULTI_WAIT:
+            // nada por hacer mas que esperar
+            break;
+        case MULTI_FIN:
+            parser->state = request_done;
+            break;
+        default:
+            parser->state = request_error;
+            break;
+    }
+}
+
+static request_state feed(RequestParser * parser, char * at) {
+    const ParserEvent *e = parser_feed(parser->multiline_parser, (uint8_t) *at);
     do {
-        if (debug) print_state("request", multiline_event, e);
-        switch (e->type) {
-            case MULTI_BYTE:
-                parser->state = req_byte(parser, e->data[0]);
-                break;
-            case MULTI_NEWLINE:
-                parser->state = req_newline(parser, e->data[0]);
-                break;
-            case MULTI_WAIT:
-                // nada por hacer mas que esperar
-                break;
-            case MULTI_FIN:
-                parser->state = request_done;
-                break;
-            default:
-                parser->state = request_error;
-                break;
-        }
+        handle_event(parser, e, at);
         e =  e->next;
     } while (e != NULL && parser->state < request_done);
 
     return parser->state;
 }
 
-request_state request_parser_consume(RequestParser * parser, char * buffer) {
-    request_state state = parser->state;
+/** Consume n bytes de una misma linea, sin pasar por el parser multilinea */
+static request_state req_bytes(RequestParser * parser, const char * bytes, size_t n) {
+    if (parser->state == request_args) {
+        return arg(parser->request, n);
+    }
 
-    while (*buffer != 0) {
-        state = request_parser_feed(parser, *buffer++);
-        if (request_parser_is_done(parser, 0)) {
-            break;
+    request_state ret = parser->state;
+    for (size_t i = 0; i < n && ret < request_done; i++) {
+        ret = req_byte(parser, bytes[i]);
+        parser->state = ret;
+    }
+    return ret;
+}
+
+/** Termina cada argumento en el \n que lo sigue en el mensaje */
+static void terminate_args(Request * request) {
+    for (int i = 0; i < request->argc; i++) {
+        request->args[i][request->lengths[i]] = 0;
+    }
+}
+
+request_state request_parser_feed_buffer(RequestParser * parser, char * buffer, size_t len) {
+    size_t i = 0;
+
+    while (i < len && parser->state < request_done) {
+        // el resto de la linea se saltea en bloque, el parser solo ve los cambios de linea
+        size_t line = multiline_parser_line(parser->multiline_parser, (const uint8_t *) buffer + i, len - i);
+        if (line > 0) {
+            parser->state = req_bytes(parser, buffer + i, line);
+            i += line;
+        } else {
+            feed(parser, buffer + i++);
         }
     }
 
-    return state;
+    if (parser->state == request_done) {
+        terminate_args(parser->request);
+    }
+    return parser->state;
+}
+
+request_state request_parser_consume(RequestParser * parser, char * buffer) {
+    return request_parser_feed_buffer(parser, buffer, strlen(buffer));
 }
 
 bool request_parser_is_done(RequestParser * parser, bool *error) {
@@ -122,4 +180,3 @@ void request_parser_destroy(RequestParser * parser) {
     destroy_request(parser->request);
 }
 
-
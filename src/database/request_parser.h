@@ -7,6 +7,7 @@
 
 typedef enum {
     request_cmd,
+    request_id,
     request_args,
     request_done,
     request_error,
@@ -19,19 +20,25 @@ typedef struct {
     Parser * multiline_parser;
     Request * request;
     request_state state;
-    int arg_index;
 } RequestParser;
 
 /** Initializes the parser */
 void request_parser_init(RequestParser * parser);
 
-/** Feeds a character to the parser, returns the new parser state */
-request_state request_parser_feed(RequestParser * parser, char c);
+/** Leaves the parser and its request empty, ready for the next message */
+void request_parser_reset(RequestParser * parser);
 
 /**
- * Consumes the buffer feeding each character to the parser until the parsing is finished
- * or the buffer has nothing left to read, returns the new parser state.
+ * Feeds up to len bytes, stopping when the parsing is finished. The bytes inside a
+ * line are located in bulk (scan.h) without going through the parser, only line
+ * changes are fed one by one. Returns the new parser state.
+ *
+ * The buffer must hold the whole message: the request arguments point into it and,
+ * once the parsing is done, the newline after each one is replaced with a 0.
  */
+request_state request_parser_feed_buffer(RequestParser * parser, char * buffer, size_t len);
+
+/** Same as request_parser_feed_buffer over a 0 terminated message */
 request_state request_parser_consume(RequestParser * parser, char * buffer);
 
 /** Returns true if the parsing is finished */
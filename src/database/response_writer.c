@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include "response_writer.h"
+#include "../frame.h"
+#include "../protocol.h"
+
+static bool binary = false;
+static bool has_id = false;
+static uint32_t id = 0;
+/** Respuesta binaria en construccion, el buffer se reutiliza entre respuestas */
+static FrameWriter writer;
+
+void response_set_binary(bool value) {
+    binary = value;
+}
+
+void response_set_id(bool value, uint32_t request_id) {
+    has_id = value;
+    id     = request_id;
+}
+
+void response_begin(int status) {
+    if (binary) {
+        frame_writer_reset(&writer, (uint8_t) status);
+        if (has_id) {
+            frame_writer_set_id(&writer, id);
+        }
+    } else if (has_id) {
+        printf("%d%c%u\n", status, REQUEST_ID_SEPARATOR, id);
+    } else {
+        printf("%d\n", status);
+    }
+}
+
+void response_int(int value) {
+    if (binary) {
+        frame_put_int(&writer, value);
+    } else {
+        printf("%d\n", value);
+    }
+}
+
+void response_string(const char * value) {
+    if (binary) {
+        frame_put_string(&writer, value != NULL ? value : "");
+    } else {
+        printf("%s\n", value);
+    }
+}
+
+void response_bytes(const uint8_t * data, size_t len) {
+    if (binary) {
+        frame_put_bytes(&writer, data, len);
+        return;
+    }
+    for (size_t i = 0; i < len; i++) {
+        printf("%02x", data[i]);
+    }
+    printf("\n");
+}
+
+void response_end(void) {
+    if (!binary) {
+        printf(".\n");
+        return;
+    }
+
+    size_t len = frame_writer_finish(&writer);
+    if (len == 0) {
+        // sin memoria para la respuesta completa, se avisa el error sin datos
+        char error[FRAME_HEADER + FRAME_ID_SIZE] = {(char) FRAME_MAGIC, RESPONSE_ERR};
+        if (has_id) {
+            error[0] = (char) FRAME_MAGIC_ID;
+            for (int i = 0; i < FRAME_ID_SIZE; i++) {
+                error[FRAME_HEADER + i] = (char) (id >> (8 * (FRAME_ID_SIZE - 1 - i)));
+            }
+        }
+        fwrite(error, 1, frame_header_size(error), stdout);
+        return;
+    }
+    fwrite(writer.data, 1, len, stdout);
+}
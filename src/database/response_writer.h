@@ -0,0 +1,32 @@
+#ifndef TPE_FINAL_SO_RESPONSE_WRITER_H
+#define TPE_FINAL_SO_RESPONSE_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Escritura de respuestas por stdout en el formato del pedido que se esta atendiendo,
+ * texto (protocol.h) o binario (frame.h). Cada respuesta es un estado seguido de sus datos.
+ */
+
+/** Formato de las proximas respuestas */
+void response_set_binary(bool binary);
+
+/** Id del pedido que se responde, las proximas respuestas lo repiten si has_id */
+void response_set_id(bool has_id, uint32_t id);
+
+/** Empieza una respuesta con el estado dado */
+void response_begin(int status);
+
+void response_int(int value);
+
+void response_string(const char * value);
+
+/** Bytes crudos en binario, en texto se escriben en hexadecimal (dos digitos por byte) */
+void response_bytes(const uint8_t * data, size_t len);
+
+/** Termina la respuesta, queda en el buffer de stdout hasta el proximo fflush */
+void response_end(void);
+
+#endif //TPE_FINAL_SO_RESPONSE_WRITER_H
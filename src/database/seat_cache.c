@@ -0,0 +1,172 @@
+#include <stdlib.h>
+#include <string.h>
+#include "seat_cache.h"
+
+#define BUCKETS 64
+
+typedef enum {
+    CACHE_DATA_VERSION,
+    CACHE_SHOWCASES,
+    CACHE_SHOWCASE_SEATS,
+    CACHE_STATEMENTS
+} cache_statement;
+
+static const char * queries[CACHE_STATEMENTS] = {
+        [CACHE_DATA_VERSION]   = "PRAGMA data_version",
+        [CACHE_SHOWCASES]      = "SELECT id, movie, day, room FROM showcase",
+        //Sin estadisticas SQLite puede elegir el indice que tambien tiene las canceladas
+        [CACHE_SHOWCASE_SEATS] = "SELECT seat FROM booking INDEXED BY booking_active_showcase_seat "
+                                 "WHERE showcase_id = ? AND cancelled = 0",
+};
+
+static sqlite3_stmt * statements[CACHE_STATEMENTS];
+
+/** Funciones por sala y dia, en una sala hay a lo sumo una funcion por dia */
+static ShowcaseSeats * buckets[BUCKETS];
+static bool loaded = false;
+/** data_version de la ultima carga, cambia cuando otra conexion confirma */
+static int data_version;
+
+static unsigned hash(int day, int room) {
+    return ((unsigned) day * 31u + (unsigned) room) % BUCKETS;
+}
+
+static void clear(void) {
+    for (int i = 0; i < BUCKETS; i++) {
+        while (buckets[i] != NULL) {
+            ShowcaseSeats * aux = buckets[i]->next;
+            free(buckets[i]->movie);
+            free(buckets[i]);
+            buckets[i] = aux;
+        }
+    }
+}
+
+int seat_cache_open(sqlite3 * db) {
+    for (int i = 0; i < CACHE_STATEMENTS; i++) {
+        if (sqlite3_prepare_v2(db, queries[i], -1, &statements[i], NULL) != SQLITE_OK)
+            return FAIL_QUERY;
+    }
+    loaded = false;
+    return seat_cache_refresh();
+}
+
+static int current_data_version(int * version) {
+    sqlite3_stmt * stmt = statements[CACHE_DATA_VERSION];
+    int rc = sqlite3_step(stmt);
+    *version = sqlite3_column_int(stmt, 0);
+    sqlite3_reset(stmt);
+    return rc == SQLITE_ROW ? RESPONSE_OK : FAIL_QUERY;
+}
+
+/** Carga la lista de funciones, los asientos de cada una se leen recien cuando se usan */
+static int load(void) {
+    sqlite3_stmt * stmt = statements[CACHE_SHOWCASES];
+    int rc;
+
+    clear();
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        ShowcaseSeats * showcase = seat_cache_add(sqlite3_column_int(stmt, 0), (const char *) sqlite3_column_text(stmt, 1),
+                                                  sqlite3_column_int(stmt, 2), sqlite3_column_int(stmt, 3));
+        if (showcase == NULL)
+            break;
+        showcase->loaded = false;
+    }
+    sqlite3_reset(stmt);
+    return rc == SQLITE_DONE ? RESPONSE_OK : FAIL_QUERY;
+}
+
+int seat_cache_refresh(void) {
+    int version;
+
+    if (current_data_version(&version) != RESPONSE_OK)
+        return FAIL_QUERY;
+    if (loaded && version == data_version)
+        return RESPONSE_OK;
+
+    loaded = load() == RESPONSE_OK;
+    data_version = version;
+    return loaded ? RESPONSE_OK : FAIL_QUERY;
+}
+
+int seat_cache_load(ShowcaseSeats * showcase) {
+    if (showcase->loaded)
+        return RESPONSE_OK;
+
+    //Solo las reservas activas de la funcion, por el indice parcial de las activas
+    sqlite3_stmt * stmt = statements[CACHE_SHOWCASE_SEATS];
+    int rc;
+    memset(showcase->seats, 0, sizeof(showcase->seats));
+    sqlite3_bind_int(stmt, 1, showcase->id);
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        int seat = sqlite3_column_int(stmt, 0);
+        if (seat_in_cache(seat))
+            seat_set(showcase, seat, true);
+    }
+    sqlite3_reset(stmt);
+    showcase->loaded = rc == SQLITE_DONE;
+    return showcase->loaded ? RESPONSE_OK : FAIL_QUERY;
+}
+
+void seat_cache_invalidate(void) {
+    loaded = false;
+}
+
+ShowcaseSeats * seat_cache_find_room(int day, int room) {
+    for (ShowcaseSeats * showcase = buckets[hash(day, room)]; showcase != NULL; showcase = showcase->next) {
+        if (showcase->day == day && showcase->room == room)
+            return showcase;
+    }
+    return NULL;
+}
+
+ShowcaseSeats * seat_cache_find(const char * movie, int day, int room) {
+    for (ShowcaseSeats * showcase = buckets[hash(day, room)]; showcase != NULL; showcase = showcase->next) {
+        if (showcase->day == day && showcase->room == room && strcmp(showcase->movie, movie) == 0)
+            return showcase;
+    }
+    return NULL;
+}
+
+ShowcaseSeats * seat_cache_add(int id, const char * movie, int day, int room) {
+    ShowcaseSeats * showcase = calloc(1, sizeof(*showcase));
+    char * name = malloc(strlen(movie) + 1);
+
+    if (showcase == NULL || name == NULL) {
+        free(showcase);
+        free(name);
+        loaded = false;
+        return NULL;
+    }
+
+    unsigned h = hash(day, room);
+    showcase->id    = id;
+    showcase->movie = strcpy(name, movie);
+    showcase->day   = day;
+    showcase->room  = room;
+    showcase->loaded = true;
+    showcase->next  = buckets[h];
+    buckets[h] = showcase;
+    return showcase;
+}
+
+void seat_cache_remove(ShowcaseSeats * showcase) {
+    ShowcaseSeats ** node = &buckets[hash(showcase->day, showcase->room)];
+    while (*node != NULL && *node != showcase) {
+        node = &(*node)->next;
+    }
+    if (*node != NULL) {
+        *node = showcase->next;
+        free(showcase->movie);
+        free(showcase);
+    }
+}
+
+void seat_cache_close(void) {
+    clear();
+    loaded = false;
+    for (int i = 0; i < CACHE_STATEMENTS; i++) {
+        sqlite3_finalize(statements[i]);
+        statements[i] = NULL;
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef TPE_FINAL_SO_SEAT_CACHE_H
+#define TPE_FINAL_SO_SEAT_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sqlite3.h>
+#include "../protocol.h"
+
+/**
+ * Cache en memoria de las funciones y sus asientos reservados, un bit por asiento.
+ * Se carga desde la base y las escrituras de este proceso lo actualizan a la par.
+ * Si otro proceso confirma cambios (PRAGMA data_version) se vuelve a cargar la lista de
+ * funciones, y los asientos de cada una recien cuando se usa, con seat_cache_load.
+ */
+
+#define SEAT_WORDS ((SEATS + 63) / 64)
+
+typedef struct showcase_seats {
+    int id;
+    char * movie;
+    int day;
+    int room;
+    /** bit en 1: asiento reservado */
+    uint64_t seats[SEAT_WORDS];
+    /** seats esta al dia, si no hay que llamar a seat_cache_load antes de usarlo */
+    bool loaded;
+    struct showcase_seats * next;
+} ShowcaseSeats;
+
+/** Prepara las consultas del cache sobre la base abierta */
+int seat_cache_open(sqlite3 * db);
+
+/** Deja el cache al dia, lo recarga si nunca se cargo o si otro proceso escribio */
+int seat_cache_refresh(void);
+
+/** Lee de la base los asientos de la funcion si otro proceso escribio desde la ultima vez */
+int seat_cache_load(ShowcaseSeats * showcase);
+
+/** El proximo seat_cache_refresh recarga todo, por ejemplo si se deshizo una escritura */
+void seat_cache_invalidate(void);
+
+/** Funcion en la sala y dia dados, NULL si no hay */
+ShowcaseSeats * seat_cache_find_room(int day, int room);
+
+/** Funcion de la pelicula en la sala y dia dados, NULL si no hay */
+ShowcaseSeats * seat_cache_find(const char * movie, int day, int room);
+
+/** Registra una funcion nueva sin reservas. Retorna NULL si no hay memoria (el cache queda invalido) */
+ShowcaseSeats * seat_cache_add(int id, const char * movie, int day, int room);
+
+void seat_cache_remove(ShowcaseSeats * showcase);
+
+/** Los asientos fuera de rango nunca estan en el cache */
+static inline bool seat_in_cache(int seat) {
+    return seat >= 0 && seat < SEATS;
+}
+
+static inline bool seat_taken(const ShowcaseSeats * showcase, int seat) {
+    return (showcase->seats[seat / 64] >> (seat % 64)) & 1;
+}
+
+static inline void seat_set(ShowcaseSeats * showcase, int seat, bool reserved) {
+    if (reserved) {
+        showcase->seats[seat / 64] |= (uint64_t) 1 << (seat % 64);
+    } else {
+        showcase->seats[seat / 64] &= ~((uint64_t) 1 << (seat % 64));
+    }
+}
+
+/** Libera la memoria y las consultas */
+void seat_cache_close(void);
+
+#endif //TPE_FINAL_SO_SEAT_CACHE_H
@@ -0,0 +1,214 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "frame.h"
+
+#define FRAME_MIN_SIZE 256
+
+static uint16_t get_u16(const char * buffer) {
+    const uint8_t * p = (const uint8_t *) buffer;
+    return (uint16_t) (p[0] << 8 | p[1]);
+}
+
+static uint32_t get_u32(const char * buffer) {
+    const uint8_t * p = (const uint8_t *) buffer;
+    return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | (uint32_t) p[3];
+}
+
+static void put_u16(char * buffer, uint16_t value) {
+    buffer[0] = (char) (value >> 8);
+    buffer[1] = (char) value;
+}
+
+static void put_u32(char * buffer, uint32_t value) {
+    buffer[0] = (char) (value >> 24);
+    buffer[1] = (char) (value >> 16);
+    buffer[2] = (char) (value >> 8);
+    buffer[3] = (char) value;
+}
+
+void frame_header_decode(const char * buffer, FrameHeader * header) {
+    header->code   = (uint8_t) buffer[1];
+    header->argc   = get_u16(buffer + 2);
+    header->length = get_u32(buffer + 4);
+    header->has_id = (uint8_t) buffer[0] == FRAME_MAGIC_ID;
+    header->id     = header->has_id ? get_u32(buffer + FRAME_HEADER) : 0;
+}
+
+size_t frame_size(const char * header) {
+    return frame_header_size(header) + (size_t) get_u32(header + 4);
+}
+
+/** Reserva lugar para len bytes mas, retorna NULL si no hay memoria */
+static char * reserve(FrameWriter * writer, size_t len) {
+    if (writer->error) {
+        return NULL;
+    }
+
+    if (writer->len + len > writer->size) {
+        size_t size = writer->size == 0 ? FRAME_MIN_SIZE : writer->size;
+        while (size < writer->len + len) {
+            size *= 2;
+        }
+        char * aux = realloc(writer->data, size);
+        if (aux == NULL) {
+            writer->error = true;
+            return NULL;
+        }
+        writer->data = aux;
+        writer->size = size;
+    }
+
+    char * ret = writer->data + writer->len;
+    writer->len += len;
+    return ret;
+}
+
+void frame_writer_init(FrameWriter * writer, uint8_t code) {
+    writer->data = NULL;
+    writer->size = 0;
+    frame_writer_reset(writer, code);
+}
+
+void frame_writer_reset(FrameWriter * writer, uint8_t code) {
+    writer->len   = 0;
+    writer->argc  = 0;
+    writer->error = false;
+
+    char * header = reserve(writer, FRAME_HEADER);
+    if (header != NULL) {
+        header[0] = (char) FRAME_MAGIC;
+        header[1] = (char) code;
+    }
+}
+
+void frame_writer_set_id(FrameWriter * writer, uint32_t id) {
+    if (writer->error || writer->argc > 0 || writer->len != FRAME_HEADER) {
+        writer->error = true;
+        return;
+    }
+
+    char * aux = reserve(writer, FRAME_ID_SIZE);
+    if (aux != NULL) {
+        writer->data[0] = (char) FRAME_MAGIC_ID;
+        put_u32(aux, id);
+    }
+}
+
+void frame_put_int(FrameWriter * writer, int32_t value) {
+    char * arg = reserve(writer, 5);
+    if (arg != NULL) {
+        arg[0] = FRAME_INT;
+        put_u32(arg + 1, (uint32_t) value);
+        writer->argc++;
+    }
+}
+
+void frame_put_string(FrameWriter * writer, const char * value) {
+    frame_put_bytes(writer, value, strlen(value));
+}
+
+void frame_put_bytes(FrameWriter * writer, const void * value, size_t len) {
+    if (len > UINT16_MAX) {
+        writer->error = true;
+        return;
+    }
+
+    char * arg = reserve(writer, 3 + len);
+    if (arg != NULL) {
+        arg[0] = FRAME_STRING;
+        put_u16(arg + 1, (uint16_t) len);
+        memcpy(arg + 3, value, len);
+        writer->argc++;
+    }
+}
+
+size_t frame_writer_finish(FrameWriter * writer) {
+    if (writer->error) {
+        return 0;
+    }
+
+    put_u16(writer->data + 2, writer->argc);
+    put_u32(writer->data + 4, (uint32_t) (writer->len - frame_header_size(writer->data)));
+    return writer->len;
+}
+
+void frame_writer_free(FrameWriter * writer) {
+    free(writer->data);
+    writer->data = NULL;
+    writer->len = writer->size = 0;
+}
+
+bool frame_reader_init(FrameReader * reader, const char * frame, size_t len, FrameHeader * header) {
+    if (len < FRAME_HEADER || !is_frame(frame, len) || len < frame_header_size(frame) || frame_size(frame) != len) {
+        return false;
+    }
+
+    frame_header_decode(frame, header);
+    reader->data   = frame;
+    reader->len    = len;
+    reader->offset = frame_header_size(frame);
+    return true;
+}
+
+bool frame_next(FrameReader * reader, FrameArg * out) {
+    const char * arg = reader->data + reader->offset;
+    size_t left = reader->len - reader->offset;
+
+    if (left >= 5 && arg[0] == FRAME_INT) {
+        out->type  = FRAME_INT;
+        out->value = (int32_t) get_u32(arg + 1);
+        reader->offset += 5;
+        return true;
+    }
+
+    if (left >= 3 && arg[0] == FRAME_STRING) {
+        size_t len = get_u16(arg + 1);
+        if (len > left - 3) {
+            return false;
+        }
+        out->type   = FRAME_STRING;
+        out->string = arg + 3;
+        out->len    = len;
+        reader->offset += 3 + len;
+        return true;
+    }
+
+    return false;
+}
+
+bool frame_next_arg(FrameReader * reader, char * out, size_t size) {
+    FrameArg arg;
+
+    if (!frame_next(reader, &arg)) {
+        return false;
+    }
+
+    if (arg.type == FRAME_INT) {
+        snprintf(out, size, "%d", arg.value);
+        return true;
+    }
+
+    if (arg.len >= size) {
+        return false;
+    }
+    memcpy(out, arg.string, arg.len);
+    out[arg.len] = 0;
+    return true;
+}
+
+bool frame_arg(const char * frame, size_t len, int index, char * out, size_t size) {
+    FrameReader reader;
+    FrameHeader header;
+
+    if (!frame_reader_init(&reader, frame, len, &header) || index < 0 || index >= header.argc) {
+        return false;
+    }
+
+    for (int i = 0; i < index; i++) {
+        if (!frame_next_arg(&reader, out, size)) {
+            return false;
+        }
+    }
+    return frame_next_arg(&reader, out, size);
+}
@@ -0,0 +1,116 @@
+#ifndef TPE_FINAL_SO_FRAME_H
+#define TPE_FINAL_SO_FRAME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Protocolo binario, convive con el de texto de protocol.h.
+ *
+ * Cada mensaje elige su formato con el primer byte: los mensajes de texto empiezan
+ * con un digito y los binarios con FRAME_MAGIC. La respuesta usa el formato del pedido.
+ *
+ * encabezado (FRAME_HEADER bytes, enteros big endian):
+ *   magic (1) | tipo de pedido o estado de la respuesta (1) | argc (2) | largo de los argumentos (4)
+ *
+ * Con FRAME_MAGIC_ID el encabezado sigue con un id de pedido de 4 bytes (FRAME_ID_SIZE),
+ * que la respuesta repite (ver protocol.h).
+ *
+ * argumentos, cada uno con su tipo:
+ *   FRAME_INT    entero de 4 bytes (dia, sala, asiento)
+ *   FRAME_STRING largo de 2 bytes y los caracteres, sin terminador (o bytes crudos, ver frame_put_bytes)
+ */
+
+#define FRAME_MAGIC     0xB1
+#define FRAME_MAGIC_ID  0xB2
+#define FRAME_HEADER    8
+#define FRAME_ID_SIZE   4
+#define FRAME_INT       'i'
+#define FRAME_STRING    's'
+
+typedef struct {
+    uint8_t code;
+    uint16_t argc;
+    uint32_t length;
+    bool has_id;
+    uint32_t id;
+} FrameHeader;
+
+/** Mensaje binario en construccion, el buffer crece a medida que se agregan argumentos */
+typedef struct {
+    char * data;
+    size_t len;
+    size_t size;
+    uint16_t argc;
+    /** no hubo memoria, el mensaje se descarta */
+    bool error;
+} FrameWriter;
+
+/** Recorre los argumentos de un mensaje binario completo */
+typedef struct {
+    const char * data;
+    size_t len;
+    size_t offset;
+} FrameReader;
+
+/** Argumento leido sin copiar: los enteros con su valor, los strings apuntando al mensaje */
+typedef struct {
+    char type;
+    int32_t value;
+    const char * string;
+    size_t len;
+} FrameArg;
+
+/** Indica si el mensaje que empieza en buffer es binario */
+static inline bool is_frame(const char * buffer, size_t len) {
+    return len > 0 && ((uint8_t) buffer[0] == FRAME_MAGIC || (uint8_t) buffer[0] == FRAME_MAGIC_ID);
+}
+
+/** Largo del encabezado segun el primer byte, con o sin id */
+static inline size_t frame_header_size(const char * buffer) {
+    return (uint8_t) buffer[0] == FRAME_MAGIC_ID ? FRAME_HEADER + FRAME_ID_SIZE : FRAME_HEADER;
+}
+
+/** Decodifica el encabezado, el buffer tiene al menos frame_header_size bytes */
+void frame_header_decode(const char * buffer, FrameHeader * header);
+
+/** Largo total del mensaje segun sus primeros FRAME_HEADER bytes */
+size_t frame_size(const char * header);
+
+void frame_writer_init(FrameWriter * writer, uint8_t code);
+
+/** Empieza un mensaje nuevo reutilizando el buffer del anterior */
+void frame_writer_reset(FrameWriter * writer, uint8_t code);
+
+/** Agrega el id de pedido al encabezado, antes del primer argumento */
+void frame_writer_set_id(FrameWriter * writer, uint32_t id);
+
+void frame_put_int(FrameWriter * writer, int32_t value);
+
+void frame_put_string(FrameWriter * writer, const char * value);
+
+/** Agrega len bytes como FRAME_STRING, pueden incluir ceros */
+void frame_put_bytes(FrameWriter * writer, const void * value, size_t len);
+
+/** Completa el encabezado y retorna el largo del mensaje en writer->data, 0 si hubo un error */
+size_t frame_writer_finish(FrameWriter * writer);
+
+void frame_writer_free(FrameWriter * writer);
+
+/** Prepara la lectura de los argumentos de un mensaje de len bytes, retorna false si no es valido */
+bool frame_reader_init(FrameReader * reader, const char * frame, size_t len, FrameHeader * header);
+
+/** Lee el siguiente argumento sin copiarlo, retorna false si no hay mas o el mensaje esta mal formado */
+bool frame_next(FrameReader * reader, FrameArg * arg);
+
+/**
+ * Copia el siguiente argumento en out como texto (los enteros en decimal), igual
+ * que en el protocolo de texto. Retorna false si no hay mas o el mensaje esta mal formado.
+ */
+bool frame_next_arg(FrameReader * reader, char * out, size_t size);
+
+/** Copia el argumento index (desde 0) de un mensaje binario completo, retorna false si no existe */
+bool frame_arg(const char * frame, size_t len, int index, char * out, size_t size);
+
+#endif //TPE_FINAL_SO_FRAME_H
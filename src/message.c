@@ -0,0 +1,82 @@
+#include <string.h>
+#include "message.h"
+#include "scan.h"
+
+void message_scanner_init(MessageScanner * scanner) {
+    scanner->matched = 0;
+    scanner->started = false;
+    scanner->frame   = false;
+    scanner->seen    = 0;
+}
+
+/** Cuenta los bytes de un mensaje binario, el largo se conoce al completar el encabezado */
+static size_t frame_scan(MessageScanner * scanner, const char * buffer, size_t len, bool * done) {
+    size_t i = 0;
+
+    if (scanner->seen < FRAME_HEADER) {
+        i = FRAME_HEADER - scanner->seen < len ? FRAME_HEADER - scanner->seen : len;
+        memcpy(scanner->header + scanner->seen, buffer, i);
+        scanner->seen += i;
+        if (scanner->seen < FRAME_HEADER) {
+            return i;
+        }
+    }
+
+    size_t left = frame_size(scanner->header) - scanner->seen;
+    size_t take = left < len - i ? left : len - i;
+    scanner->seen += take;
+    if (take == left) {
+        message_scanner_init(scanner);
+        *done = true;
+    }
+
+    return i + take;
+}
+
+size_t message_scan(MessageScanner * scanner, const char * buffer, size_t len, bool * done) {
+    *done = false;
+
+    if (len == 0) {
+        return 0;
+    }
+    if (!scanner->started) {
+        scanner->started = true;
+        scanner->frame   = is_frame(buffer, len);
+    }
+    if (scanner->frame) {
+        return frame_scan(scanner, buffer, len, done);
+    }
+
+    // un terminador que quedo partido entre el buffer anterior y este
+    size_t i = 0;
+    while (scanner->matched > 0 && i < len) {
+        const char c = buffer[i++];
+        if (scanner->matched == 1) {
+            scanner->matched = (c == '.') ? 2 : (c == '\n') ? 1 : 0;
+        } else if (c == '\n') {
+            message_scanner_init(scanner);
+            *done = true;
+            return i;
+        } else {
+            scanner->matched = 0;
+        }
+    }
+    if (i == len) {
+        return len;
+    }
+
+    size_t end = i + scan_terminator(buffer + i, len - i);
+    if (end < len) {
+        message_scanner_init(scanner);
+        *done = true;
+        return end + 3;
+    }
+
+    // el final del buffer puede ser el comienzo de un terminador
+    if (buffer[len - 1] == '\n') {
+        scanner->matched = 1;
+    } else if (len - i >= 2 && buffer[len - 2] == '\n' && buffer[len - 1] == '.') {
+        scanner->matched = 2;
+    }
+    return len;
+}
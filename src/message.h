@@ -0,0 +1,38 @@
+#ifndef TPE_FINAL_SO_MESSAGE_H
+#define TPE_FINAL_SO_MESSAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "frame.h"
+
+/**
+ * Deteccion del fin de mensaje sobre un flujo de bytes que puede llegar partido en
+ * varios buffers (por ejemplo varias lecturas de un pipe). El primer byte indica el
+ * formato: los mensajes de texto terminan con \n . \n y los binarios (frame.h) traen
+ * su largo en el encabezado.
+ */
+
+typedef struct {
+    /** cantidad de bytes del terminador reconocidos hasta el momento */
+    int matched;
+    /** ya se vio el primer byte del mensaje actual */
+    bool started;
+    /** el mensaje actual es binario */
+    bool frame;
+    /** bytes del mensaje binario recorridos */
+    size_t seen;
+    /** encabezado del mensaje binario, puede llegar partido */
+    char header[FRAME_HEADER];
+} MessageScanner;
+
+/** Inicializa el scanner para un nuevo mensaje */
+void message_scanner_init(MessageScanner * scanner);
+
+/**
+ * Recorre el buffer buscando el fin del mensaje actual. Retorna la cantidad de bytes
+ * que pertenecen al mensaje (incluyendo el terminador) y deja done en true si el
+ * mensaje termino. En ese caso el scanner queda listo para el siguiente mensaje.
+ */
+size_t message_scan(MessageScanner * scanner, const char * buffer, size_t len, bool * done);
+
+#endif //TPE_FINAL_SO_MESSAGE_H
@@ -1,4 +1,5 @@
 #include "multiline_parser.h"
+#include "scan.h"
 
 const char * multiline_event(enum multiline_event_type type) {
     const char *ret = NULL;
@@ -100,4 +101,9 @@ static ParserDefinition definition = {
 
 const ParserDefinition * multiline_parser_definition(void) {
     return &definition;
+}
+
+size_t multiline_parser_line(const Parser * p, const uint8_t * buffer, size_t len) {
+    // en BYTE todo lo que no es \n vuelve a BYTE emitiendo byte(c)
+    return parser_state(p) == BYTE ? scan_newline((const char *) buffer, len) : 0;
 }
\ No newline at end of file
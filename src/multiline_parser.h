@@ -22,6 +22,13 @@ enum multiline_event_type {
 /** retorna la definición del parser */
 const ParserDefinition * multiline_parser_definition(void);
 
+/**
+ * Cantidad de bytes al comienzo de buffer que el parser, en su estado actual,
+ * entregaria de a uno como MULTI_BYTE: el resto de la linea en curso. Se buscan en
+ * bloque (scan.h) y se pueden consumir sin alimentar el parser, que no cambia de estado.
+ */
+size_t multiline_parser_line(const Parser * p, const uint8_t * buffer, size_t len);
+
 /** devuelve una descripcion del evento */
 const char * multiline_event(enum multiline_event_type type);
 
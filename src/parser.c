@@ -2,15 +2,34 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "parser.h"
 
+#define BYTES 0x100
+
+/** definición compilada: por cada estado y byte, la transición que se toma */
+struct parser_table {
+    const struct parser_definition *def;
+    const unsigned                 *classes;
+    /** states_count * BYTES celdas, NULL si ningún `when' acepta el byte */
+    const struct parser_state_transition **cells;
+
+    struct parser_table *next;
+};
+
+/** tablas compiladas, viven hasta el fin del proceso */
+static struct parser_table *tables = NULL;
+static pthread_mutex_t      tables_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 /* CDT del parser */
 struct parser {
     /** tipificación para cada caracter */
     const unsigned     *classes;
     /** definición de estados */
     const struct parser_definition *def;
+    /** transiciones por estado y byte */
+    const struct parser_state_transition * const *cells;
 
     /* estado actual */
     unsigned            state;
@@ -21,6 +40,72 @@ struct parser {
     struct parser_event e2;
 };
 
+/** primera transición del estado cuya condición acepta el byte, igual que recorrerlas en orden */
+static const struct parser_state_transition *
+match(const struct parser_state_transition *state, size_t n, const unsigned *classes, const uint8_t c) {
+    const unsigned type = classes[c];
+
+    for(unsigned i = 0; i < n ; i++) {
+        const int when = state[i].when;
+        bool matched;
+        if (when <= 0xFF) {
+            matched = (c == when);
+        } else if(when == ANY) {
+            matched = true;
+        } else {
+            matched = (type & when);
+        }
+
+        if(matched) {
+            return &state[i];
+        }
+    }
+    return NULL;
+}
+
+static struct parser_table * compile(const unsigned *classes, const struct parser_definition *def) {
+    struct parser_table *ret = malloc(sizeof(*ret));
+    const struct parser_state_transition **cells = malloc(def->states_count * BYTES * sizeof(*cells));
+
+    if(ret == NULL || cells == NULL) {
+        free(ret);
+        free(cells);
+        return NULL;
+    }
+
+    for(unsigned state = 0; state < def->states_count; state++) {
+        for(unsigned c = 0; c < BYTES; c++) {
+            cells[state * BYTES + c] = match(def->states[state], def->states_n[state], classes, (uint8_t) c);
+        }
+    }
+
+    ret->def     = def;
+    ret->classes = classes;
+    ret->cells   = cells;
+    ret->next    = NULL;
+    return ret;
+}
+
+/** busca la tabla compilada de la definición, compilándola la primera vez */
+static const struct parser_state_transition * const *
+table(const unsigned *classes, const struct parser_definition *def) {
+    struct parser_table *t;
+
+    pthread_mutex_lock(&tables_mutex);
+    for(t = tables; t != NULL; t = t->next) {
+        if(t->def == def && t->classes == classes) {
+            break;
+        }
+    }
+    if(t == NULL && (t = compile(classes, def)) != NULL) {
+        t->next = tables;
+        tables  = t;
+    }
+    pthread_mutex_unlock(&tables_mutex);
+
+    return t == NULL ? NULL : t->cells;
+}
+
 void parser_destroy(struct parser *p) {
     if(p != NULL) {
         free(p);
@@ -28,11 +113,17 @@ void parser_destroy(struct parser *p) {
 }
 
 struct parser * parser_init(const unsigned *classes, const struct parser_definition *def) {
+    const struct parser_state_transition * const *cells = table(classes, def);
+    if(cells == NULL) {
+        return NULL;
+    }
+
     struct parser *ret = malloc(sizeof(*ret));
     if(ret != NULL) {
         memset(ret, 0, sizeof(*ret));
         ret->classes = classes;
         ret->def     = def;
+        ret->cells   = cells;
         ret->state   = def->start_state;
     }
     return ret;
@@ -42,41 +133,52 @@ void parser_reset(struct parser *p) {
     p->state   = p->def->start_state;
 }
 
+unsigned parser_state(const struct parser *p) {
+    return p->state;
+}
+
 const struct parser_event * parser_feed(struct parser *p, const uint8_t c) {
-    const unsigned type = p->classes[c];
+    const struct parser_state_transition *t = p->cells[p->state * BYTES + c];
 
     p->e1.next = p->e2.next = 0;
 
-    const struct parser_state_transition *state = p->def->states[p->state];
-    const size_t n                              = p->def->states_n[p->state];
-    bool matched   = false;
-
-    for(unsigned i = 0; i < n ; i++) {
-        const int when = state[i].when;
-        if (state[i].when <= 0xFF) {
-            matched = (c == when);
-        } else if(state[i].when == ANY) {
-            matched = true;
-        } else if(state[i].when > 0xFF) {
-            matched = (type & when);
-        } else {
-            matched = false;
+    if(t != NULL) {
+        t->act1(&p->e1, c);
+        if(t->act2 != NULL) {
+            p->e1.next = &p->e2;
+            t->act2(&p->e2, c);
         }
+        p->state = t->dest;
+    }
+    return &p->e1;
+}
 
-        if(matched) {
-            state[i].act1(&p->e1, c);
-            if(state[i].act2 != NULL) {
-                p->e1.next = &p->e2;
-                state[i].act2(&p->e2, c);
-            }
-            p->state = state[i].dest;
-            break;
+size_t parser_feed_buffer(struct parser *p, const uint8_t *buffer, size_t len,
+                          struct parser_event *events, size_t size, size_t *count) {
+    const struct parser_state_transition * const *cells = p->cells;
+    unsigned state = p->state;
+    size_t i, n = 0;
+
+    for(i = 0; i < len && n + 2 <= size; i++) {
+        const struct parser_state_transition *t = cells[state * BYTES + buffer[i]];
+        if(t == NULL) {
+            continue;
         }
+        t->act1(&events[n], buffer[i]);
+        events[n++].next = NULL;
+        if(t->act2 != NULL) {
+            t->act2(&events[n], buffer[i]);
+            events[n++].next = NULL;
+        }
+        state = t->dest;
     }
-    return &p->e1;
+
+    p->state = state;
+    *count   = n;
+    return i;
 }
 
-static const unsigned classes[0xFF] = {0x00};
+static const unsigned classes[BYTES] = {0x00};
 
 const unsigned * parser_no_classes(void) {
     return classes;
@@ -63,6 +63,10 @@ typedef struct parser_definition {
  * inicializa el parser.
  *
  * `classes`: caracterización de cada caracter (256 elementos)
+ *
+ * La definición se compila a una tabla con una celda por estado y byte, así
+ * cada byte se resuelve con un solo acceso. La tabla se compila una vez por
+ * definición y clases y se comparte entre todos los parsers que las usan.
  */
 struct parser * parser_init(const unsigned *classes, const struct parser_definition *def);
 
@@ -79,6 +83,19 @@ void parser_reset(struct parser *p);
  */
 const struct parser_event * parser_feed(struct parser *p, uint8_t c);
 
+/** estado actual del parser */
+unsigned parser_state(const struct parser *p);
+
+/**
+ * Alimenta el parser con los bytes de `buffer' hasta agotarlo o hasta que no
+ * queden al menos dos lugares en `events' (un byte genera hasta dos eventos).
+ * Los eventos se copian en orden en `events', sin encadenar, y `*count' indica
+ * cuántos hay. Los bytes que ningún estado acepta no generan eventos.
+ * Retorna la cantidad de bytes consumidos.
+ */
+size_t parser_feed_buffer(struct parser *p, const uint8_t *buffer, size_t len,
+                          struct parser_event *events, size_t size, size_t *count);
+
 /**
  * En caso de la aplicacion no necesite clases caracteres, se
  * provee dicho arreglo para ser usando en `parser_init'
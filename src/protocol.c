@@ -1,4 +1,6 @@
+#include <stdlib.h>
 #include "protocol.h"
+#include "frame.h"
 
 char * get_day(int day) {
     char * ret;
@@ -65,6 +67,15 @@ char * get_request_type(int type) {
         case GET_SEATS:
             ret = "GET_SEATS";
             break;
+        case BATCH:
+            ret = "BATCH";
+            break;
+        case SUBSCRIBE_SEATS:
+            ret = "SUBSCRIBE_SEATS";
+            break;
+        case CACHE_STATS:
+            ret = "CACHE_STATS";
+            break;
         default:
             ret = "UNKNOWN COMMAND";
             break;
@@ -100,10 +111,178 @@ char * get_response_type(int type) {
         case BAD_SHOWCASE:
             ret = "BAD SHOWCASE";
             break;
+        case SEATS_CHANGED:
+            ret = "SEATS CHANGED";
+            break;
         default:
             ret = "UNKNOWN ERROR";
             break;
     }
 
     return ret;
-}
\ No newline at end of file
+}
+
+int parse_request_type(const char * request, size_t len) {
+    int type = 0;
+    size_t i;
+
+    if (is_frame(request, len)) {
+        return len >= FRAME_HEADER ? (uint8_t) request[1] : -1;
+    }
+
+    for (i = 0; i < len && request[i] != '\n' && request[i] != REQUEST_ID_SEPARATOR; i++) {
+        if (request[i] < '0' || request[i] > '9') {
+            return -1;
+        }
+        type = type * 10 + request[i] - '0';
+    }
+
+    return i == 0 ? -1 : type;
+}
+
+bool request_line(const char * request, size_t len, int index, char * line, size_t size) {
+    size_t i = 0;
+
+    if (is_frame(request, len)) {
+        return index > 0 && frame_arg(request, len, index - 1, line, size);
+    }
+
+    for (int current = 0; current < index; i++) {
+        if (i >= len) {
+            return false;
+        }
+        if (request[i] == '\n') {
+            current++;
+        }
+    }
+
+    size_t j = 0;
+    while (i < len && request[i] != '\n' && j < size - 1) {
+        line[j++] = request[i++];
+    }
+    line[j] = 0;
+
+    return i < len && request[i] == '\n';
+}
+
+bool request_id_digit(uint32_t * id, int * digits, char c) {
+    if (c < '0' || c > '9' || *digits >= REQUEST_ID_DIGITS) {
+        return false;
+    }
+
+    uint32_t digit = (uint32_t) (c - '0');
+    if (*id > (UINT32_MAX - digit) / 10) {
+        return false;
+    }
+
+    *id = *id * 10 + digit;
+    (*digits)++;
+    return true;
+}
+
+bool parse_message_id(const char * message, size_t len, uint32_t * id) {
+    if (is_frame(message, len)) {
+        if (len < FRAME_HEADER + FRAME_ID_SIZE || frame_header_size(message) == FRAME_HEADER) {
+            return false;
+        }
+        FrameHeader header;
+        frame_header_decode(message, &header);
+        *id = header.id;
+        return true;
+    }
+
+    size_t i = 0;
+    while (i < len && message[i] >= '0' && message[i] <= '9') {
+        i++;
+    }
+    if (i == len || message[i] != REQUEST_ID_SEPARATOR) {
+        return false;
+    }
+
+    uint32_t value = 0;
+    int digits = 0;
+    for (i++; i < len && message[i] != '\n'; i++) {
+        if (!request_id_digit(&value, &digits, message[i])) {
+            return false;
+        }
+    }
+    *id = value;
+    return true;
+}
+
+bool is_write_request(int type) {
+    bool ret;
+    switch (type) {
+        case ADD_CLIENT:
+        case ADD_SHOWCASE:
+        case REMOVE_SHOWCASE:
+        case ADD_BOOKING:
+        case REMOVE_BOOKING:
+        case BATCH:
+            ret = true;
+            break;
+        default:
+            ret = false;
+            break;
+    }
+
+    return ret;
+}
+
+int batch_request_args(int type) {
+    int ret;
+    switch (type) {
+        case ADD_CLIENT:
+            ret = 1;
+            break;
+        case ADD_SHOWCASE:
+        case REMOVE_SHOWCASE:
+            ret = 3;
+            break;
+        case ADD_BOOKING:
+        case REMOVE_BOOKING:
+            ret = 5;
+            break;
+        default:
+            ret = -1;
+            break;
+    }
+
+    return ret;
+}
+
+int request_arg_count(int type) {
+    int ret;
+    switch (type) {
+        case GET_MOVIES:
+        case CACHE_STATS:
+            ret = 0;
+            break;
+        case GET_SHOWCASES:
+        case GET_BOOKING:
+        case GET_CANCELLED:
+            ret = 1;
+            break;
+        case GET_SEATS:
+        case SUBSCRIBE_SEATS:
+            ret = 3;
+            break;
+        default:
+            ret = batch_request_args(type);
+            break;
+    }
+
+    return ret;
+}
+
+bool batch_next_write(const char * request, size_t len, int * base, int * type) {
+    char line[ARG_SIZE];
+
+    *base = *base == 0 ? 1 : *base + 1 + batch_request_args(*type);
+    if (!request_line(request, len, *base, line, sizeof(line))) {
+        return false;
+    }
+
+    *type = atoi(line);
+    return batch_request_args(*type) >= 0;
+}
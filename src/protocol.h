@@ -1,12 +1,20 @@
 #ifndef TPE_FINAL_SO_PROTOCOL_H
 #define TPE_FINAL_SO_PROTOCOL_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
 #define ROWS        10
 #define COLS        8
 #define SEATS       ROWS * COLS
 
 #define MAX_ARGS    5
 #define ARG_SIZE    50
+/** escrituras que agrupa como maximo un BATCH */
+#define MAX_BATCH_REQUESTS  16
+/** argumentos de un BATCH: el tipo y los argumentos de cada escritura */
+#define MAX_BATCH_ARGS      (MAX_BATCH_REQUESTS * (MAX_ARGS + 1))
 #define ROOMS       5
 
 #define MOVIE_NAME_LENGTH   ARG_SIZE
@@ -14,17 +22,36 @@
 #define EMPTY_SEAT          1
 #define RESERVED_SEAT       0
 
+/**
+ * Mapa de asientos de GET_SEATS: un unico argumento con un bit por asiento, en 1 si
+ * esta reservado. El asiento i es el bit (7 - i % 8) del byte i / 8. En texto viaja
+ * en hexadecimal (SEATMAP_HEX caracteres) y en binario como bytes crudos.
+ */
+#define SEATMAP_BYTES       ((SEATS + 7) / 8)
+#define SEATMAP_HEX         (2 * SEATMAP_BYTES)
+
 
 /**
  * Protocolo de comunicacion orientado a texto.
  *
  * request:
- * REQ_TYPE \n ARGUMENTOS separados por \n . \n
+ * TYPE \n ARGUMENTOS separados por \n . \n
  *
  * response:
- * RES_TYPE \n DATOS separados por \n . \n
+ * STATUS \n DATOS separados por \n . \n
+ *
+ * Los mismos comandos y estados viajan tambien en el formato binario de frame.h.
+ *
+ * La primera linea puede llevar un id de pedido, TYPE:ID sin espacios, de hasta
+ * REQUEST_ID_DIGITS digitos y que entre en 32 bits. La respuesta repite el id
+ * (STATUS:ID) y el server puede completar los pedidos con id de una misma
+ * conexion en cualquier orden. Los pedidos sin id se responden en orden.
  */
 
+#define REQUEST_ID_SEPARATOR ':'
+#define REQUEST_ID_DIGITS    10
+
+
 /**
  * Comandos de la request
  */
@@ -39,14 +66,24 @@ typedef enum {
     GET_MOVIES,             // -                    lista de peliculas (strings)
     GET_SHOWCASES,          // nombre de pelicula   lista de showcases (movie, day, room)
 
-    GET_SEATS,              // movie, day, room     array binario
+    GET_SEATS,              // movie, day, room     mapa de asientos (SEATMAP_BYTES)
 
     ADD_BOOKING,            // usuario, movie, day, room, seat      ok o err
-    REMOVE_BOOKING,         // usuario, movie, day, room, seat      ok o err
+    REMOVE_BOOKING,         // usuario, movie, day, room, seat      ok, bad booking si el usuario no tiene
+                            //                                       reservado ese asiento, o err
 
     GET_BOOKING,            // usuario               lista de reservados (movie, day, room, seat)
     GET_CANCELLED,          // usuario               lista de cancelados (movie, day, room, seat)
 
+    BATCH,                  // por cada escritura su tipo y sus argumentos
+                            //                       ok, o el estado y el indice de la que fallo
+
+    SUBSCRIBE_SEATS,        // movie, day, room     mapa de asientos como GET_SEATS, despues
+                            //                       un SEATS_CHANGED por cada escritura que lo cambia
+
+    CACHE_STATS,            // -                    aciertos y fallos del cache de listados del server,
+                            //                       lo responde el server sin pasar por la base
+
 } request_type;
 
 /**
@@ -60,7 +97,12 @@ typedef enum {
     FAIL_QUERY,
     BAD_BOOKING,
     BAD_CLIENT,
-    BAD_SHOWCASE
+    BAD_SHOWCASE,
+    /**
+     * Aviso del server sin pedido, a las conexiones suscriptas con SUBSCRIBE_SEATS:
+     * movie, day, room y por cada asiento que cambio su numero y su estado (EMPTY_SEAT o RESERVED_SEAT)
+     */
+    SEATS_CHANGED
 } response_type;
 
 typedef enum {
@@ -81,4 +123,52 @@ char * get_request_type(int type);
 
 char * get_response_type(int type);
 
+/**
+ * Devuelve el tipo de una request serializada (primera linea o encabezado binario), -1 si es invalida.
+ * Sobre una respuesta devuelve su estado.
+ */
+int parse_request_type(const char * request, size_t len);
+
+/**
+ * Copia la linea index de un mensaje serializado (0 es el tipo, en binario los argumentos
+ * empiezan en 1), retorna false si no existe
+ */
+bool request_line(const char * request, size_t len, int index, char * line, size_t size);
+
+/**
+ * Agrega el caracter c al id, que ya tiene digits digitos. Retorna false si c no es un
+ * digito o el id pasa de REQUEST_ID_DIGITS digitos o de UINT32_MAX.
+ */
+bool request_id_digit(uint32_t * id, int * digits, char c);
+
+/** Indica si el mensaje serializado (pedido o respuesta) trae un id valido y lo deja en id */
+bool parse_message_id(const char * message, size_t len, uint32_t * id);
+
+/** Indica si el comando modifica la base de datos */
+bool is_write_request(int type);
+
+/**
+ * Cantidad de argumentos de una escritura que puede ir dentro de un BATCH, -1 si el
+ * tipo no puede. Las escrituras de un BATCH se confirman todas juntas o ninguna.
+ */
+int batch_request_args(int type);
+
+/** Cantidad de argumentos que necesita el comando, -1 si no existe o si es un BATCH */
+int request_arg_count(int type);
+
+/**
+ * Recorre las escrituras de un BATCH serializado. Con *base en 0 pasa a la primera, si no a la
+ * siguiente de la de tipo *type en la linea *base; deja la linea de su tipo en *base y el tipo en
+ * *type. Retorna false si no hay mas escrituras o la siguiente no puede ir en un BATCH.
+ */
+bool batch_next_write(const char * request, size_t len, int * base, int * type);
+
+static inline void seatmap_set(uint8_t * map, int seat) {
+    map[seat / 8] |= (uint8_t) (0x80 >> (seat % 8));
+}
+
+static inline bool seatmap_taken(const uint8_t * map, int seat) {
+    return (map[seat / 8] >> (7 - seat % 8)) & 1;
+}
+
 #endif //TPE_FINAL_SO_PROTOCOL_H
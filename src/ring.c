@@ -0,0 +1,224 @@
+#define _GNU_SOURCE
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "ring.h"
+
+/** Veces que se revisa el anillo antes de dormir, con carga el otro lado avanza antes */
+#define RING_SPIN   1000
+#define CACHE_LINE  64
+
+/** Con un solo core el otro lado no corre mientras este revisa, se duerme enseguida */
+static int spins = 0;
+
+struct ring {
+    /** bytes escritos desde que se creo el anillo, solo lo mueve el productor */
+    uint32_t head;
+    char     head_line[CACHE_LINE - sizeof(uint32_t)];
+    /** bytes leidos, solo lo mueve el consumidor */
+    uint32_t tail;
+    char     tail_line[CACHE_LINE - sizeof(uint32_t)];
+    /** el lector o el escritor se anuncio dormido, el otro lado tiene que despertarlo */
+    uint32_t reader_waiting;
+    uint32_t writer_waiting;
+    /** palabras de los futex: cada aviso las incrementa, asi ninguno se pierde */
+    uint32_t reader_wakeups;
+    uint32_t writer_wakeups;
+    uint32_t closed;
+    char     flags_line[CACHE_LINE - 5 * sizeof(uint32_t)];
+    char     data[RING_SIZE];
+};
+
+static uint32_t load(uint32_t * value) {
+    return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+}
+
+static void store(uint32_t * value, uint32_t new_value) {
+    __atomic_store_n(value, new_value, __ATOMIC_SEQ_CST);
+}
+
+static long futex(uint32_t * word, int op, uint32_t value, const struct timespec * timeout) {
+    return syscall(SYS_futex, word, op, value, timeout, NULL, 0);
+}
+
+/** El lector puede avanzar si hay bytes, el escritor si hay lugar */
+static bool ready(Ring * ring, bool reader) {
+    if (load(&ring->closed)) {
+        return true;
+    }
+    uint32_t used = load(&ring->head) - load(&ring->tail);
+    return reader ? used > 0 : used < RING_SIZE;
+}
+
+/** Tiempo que falta hasta deadline, false si ya vencio */
+static bool remaining(const struct timespec * deadline, struct timespec * left) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    long long nsec = (deadline->tv_sec - now.tv_sec) * 1000000000LL + (deadline->tv_nsec - now.tv_nsec);
+    if (nsec <= 0) {
+        return false;
+    }
+    left->tv_sec  = (time_t) (nsec / 1000000000LL);
+    left->tv_nsec = (long) (nsec % 1000000000LL);
+    return true;
+}
+
+/**
+ * Espera a que el lado pueda avanzar, hasta deadline si no es NULL. Las despertadas se leen
+ * antes de anunciarse dormido: un aviso entre la ultima revision y el futex lo hace volver.
+ */
+static bool wait_ready(Ring * ring, bool reader, const struct timespec * deadline) {
+    uint32_t * waiting = reader ? &ring->reader_waiting : &ring->writer_waiting;
+    uint32_t * wakeups = reader ? &ring->reader_wakeups : &ring->writer_wakeups;
+
+    for (int i = 0; i < spins; i++) {
+        if (ready(ring, reader)) {
+            return true;
+        }
+    }
+
+    while (true) {
+        uint32_t seen = load(wakeups);
+        store(waiting, 1);
+        if (ready(ring, reader)) {
+            store(waiting, 0);
+            return true;
+        }
+
+        struct timespec left;
+        if (deadline != NULL && !remaining(deadline, &left)) {
+            store(waiting, 0);
+            return false;
+        }
+        futex(wakeups, FUTEX_WAIT, seen, deadline != NULL ? &left : NULL);
+        store(waiting, 0);
+    }
+}
+
+/**
+ * Despierta al lector o al escritor, solo si se anuncio dormido. El aviso baja la marca: las
+ * escrituras que siguen antes de que el otro lado corra no vuelven a llamar al sistema.
+ */
+static void wake(Ring * ring, bool reader) {
+    uint32_t * waiting = reader ? &ring->reader_waiting : &ring->writer_waiting;
+    uint32_t * wakeups = reader ? &ring->reader_wakeups : &ring->writer_wakeups;
+
+    if (load(waiting) && __atomic_exchange_n(waiting, 0, __ATOMIC_SEQ_CST)) {
+        __atomic_fetch_add(wakeups, 1, __ATOMIC_SEQ_CST);
+        futex(wakeups, FUTEX_WAKE, 1, NULL);
+    }
+}
+
+int ring_region_create(void) {
+    int fd = memfd_create("ring", MFD_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    // la region arranca en cero: anillos vacios y abiertos
+    if (ftruncate(fd, 2 * sizeof(Ring)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int ring_region_map(int fd, Ring ** requests, Ring ** responses) {
+    spins = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? RING_SPIN : 0;
+
+    Ring * region = mmap(NULL, 2 * sizeof(Ring), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (region == MAP_FAILED) {
+        return -1;
+    }
+
+    *requests  = region;
+    *responses = region + 1;
+    return 0;
+}
+
+void ring_region_unmap(Ring * requests) {
+    munmap(requests, 2 * sizeof(Ring));
+}
+
+bool ring_write(Ring * ring, const char * data, size_t len) {
+    while (len > 0) {
+        wait_ready(ring, false, NULL);
+        if (load(&ring->closed)) {
+            return false;
+        }
+
+        uint32_t head  = ring->head;
+        size_t   space = RING_SIZE - (head - load(&ring->tail));
+        size_t   n     = len < space ? len : space;
+        size_t   at    = head % RING_SIZE;
+        size_t   first = n < RING_SIZE - at ? n : RING_SIZE - at;
+
+        memcpy(ring->data + at, data, first);
+        memcpy(ring->data, data + first, n - first);
+        store(&ring->head, head + (uint32_t) n);
+        wake(ring, true);
+
+        data += n;
+        len  -= n;
+    }
+
+    return true;
+}
+
+size_t ring_read(Ring * ring, char * buffer, size_t size) {
+    wait_ready(ring, true, NULL);
+
+    uint32_t tail  = ring->tail;
+    size_t   used  = load(&ring->head) - tail;
+    size_t   n     = size < used ? size : used;
+    size_t   at    = tail % RING_SIZE;
+    size_t   first = n < RING_SIZE - at ? n : RING_SIZE - at;
+
+    memcpy(buffer, ring->data + at, first);
+    memcpy(buffer + first, ring->data, n - first);
+    store(&ring->tail, tail + (uint32_t) n);
+    wake(ring, false);
+
+    return n;
+}
+
+bool ring_wait(Ring * ring, long usec) {
+    if (usec < 0) {
+        return wait_ready(ring, true, NULL);
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec  += (deadline.tv_nsec / 1000 + usec) / 1000000;
+    deadline.tv_nsec  = (deadline.tv_nsec / 1000 + usec) % 1000000 * 1000;
+
+    return wait_ready(ring, true, &deadline);
+}
+
+void ring_close(Ring * ring) {
+    store(&ring->closed, 1);
+
+    __atomic_fetch_add(&ring->reader_wakeups, 1, __ATOMIC_SEQ_CST);
+    __atomic_fetch_add(&ring->writer_wakeups, 1, __ATOMIC_SEQ_CST);
+    futex(&ring->reader_wakeups, FUTEX_WAKE, INT_MAX, NULL);
+    futex(&ring->writer_wakeups, FUTEX_WAKE, INT_MAX, NULL);
+}
+
+static ssize_t stream_write(void * cookie, const char * data, size_t len) {
+    return ring_write(cookie, data, len) ? (ssize_t) len : 0;
+}
+
+FILE * ring_open_stream(Ring * ring) {
+    cookie_io_functions_t functions = {.read = NULL, .write = stream_write, .seek = NULL, .close = NULL};
+
+    FILE * stream = fopencookie(ring, "w", functions);
+    if (stream != NULL) {
+        setvbuf(stream, NULL, _IOFBF, BUFSIZ);
+    }
+    return stream;
+}
@@ -0,0 +1,51 @@
+#ifndef TPE_FINAL_SO_RING_H
+#define TPE_FINAL_SO_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * Transporte en memoria compartida entre el server y un proceso database, alternativo a
+ * los pipes. Cada sentido es un anillo de bytes con un unico productor y un unico
+ * consumidor: escribir o leer es copiar y mover un contador. Un lado solo hace una
+ * llamada al sistema (futex) para despertar al otro si este se anuncio dormido; con
+ * carga ninguno llega a dormirse.
+ *
+ * Los dos anillos de un proceso viven en una misma region, que se crea como un fd para
+ * pasarla al proceso database a traves del execve.
+ */
+
+/** Capacidad de cada anillo, potencia de 2 para que los contadores den la vuelta juntos */
+#define RING_SIZE   (64 * 1024)
+
+typedef struct ring Ring;
+
+/** Crea la region de los dos anillos, retorna su fd (con FD_CLOEXEC) o -1 */
+int ring_region_create(void);
+
+/** Mapea la region del fd y deja en requests y responses sus dos anillos. Retorna -1 si falla */
+int ring_region_map(int fd, Ring ** requests, Ring ** responses);
+
+/** Libera el mapeo de la region, requests es el primer anillo que dejo ring_region_map */
+void ring_region_unmap(Ring * requests);
+
+/** Escribe los len bytes, esperando lugar si el anillo se llena. Retorna false si se cerro */
+bool ring_write(Ring * ring, const char * data, size_t len);
+
+/** Lee hasta size bytes, esperando si no hay ninguno. Retorna 0 si se cerro y no queda nada */
+size_t ring_read(Ring * ring, char * buffer, size_t size);
+
+/**
+ * Espera hasta usec microsegundos (sin limite si es negativo) a que haya bytes para leer
+ * o se cierre el anillo. Retorna false si el plazo vencio.
+ */
+bool ring_wait(Ring * ring, long usec);
+
+/** Cierra el anillo: el lector termina de leer lo que queda y el escritor deja de esperar */
+void ring_close(Ring * ring);
+
+/** Stream de stdio que escribe en el anillo, cada fflush es una escritura */
+FILE * ring_open_stream(Ring * ring);
+
+#endif //TPE_FINAL_SO_RING_H
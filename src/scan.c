@@ -0,0 +1,179 @@
+#include "scan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+typedef size_t (*scan_function)(const char * buffer, size_t len);
+
+static size_t newline_scalar(const char * buffer, size_t len) {
+    size_t i = 0;
+    while (i < len && buffer[i] != '\n') {
+        i++;
+    }
+    return i;
+}
+
+static size_t terminator_scalar(const char * buffer, size_t len) {
+    for (size_t i = 0; i + 2 < len; i++) {
+        if (buffer[i] == '\n' && buffer[i + 1] == '.' && buffer[i + 2] == '\n') {
+            return i;
+        }
+    }
+    return len;
+}
+
+#ifdef SCAN_X86
+
+/*
+ * El terminador se busca comparando tres cargas desplazadas en un byte: el bit i
+ * de la mascara queda en 1 si en i hay \n, en i + 1 un punto y en i + 2 otro \n.
+ */
+
+static size_t newline_sse2(const char * buffer, size_t len) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *) (buffer + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+        if (mask != 0) {
+            return i + (size_t) __builtin_ctz((unsigned) mask);
+        }
+    }
+    return i + newline_scalar(buffer + i, len - i);
+}
+
+static size_t terminator_sse2(const char * buffer, size_t len) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i dot     = _mm_set1_epi8('.');
+    size_t i = 0;
+
+    for (; i + 18 <= len; i += 16) {
+        __m128i first  = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (buffer + i)), newline);
+        __m128i second = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (buffer + i + 1)), dot);
+        __m128i third  = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (buffer + i + 2)), newline);
+        int mask = _mm_movemask_epi8(_mm_and_si128(_mm_and_si128(first, second), third));
+        if (mask != 0) {
+            return i + (size_t) __builtin_ctz((unsigned) mask);
+        }
+    }
+    return i + terminator_scalar(buffer + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static size_t newline_avx2(const char * buffer, size_t len) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *) (buffer + i));
+        unsigned mask = (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline));
+        if (mask != 0) {
+            return i + (size_t) __builtin_ctz(mask);
+        }
+    }
+    // se limpia la mitad alta de los registros antes de seguir con SSE2, si no cada instruccion SSE paga una transicion
+    _mm256_zeroupper();
+    return i + newline_sse2(buffer + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static size_t terminator_avx2(const char * buffer, size_t len) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i dot     = _mm256_set1_epi8('.');
+    size_t i = 0;
+
+    for (; i + 34 <= len; i += 32) {
+        __m256i first  = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (buffer + i)), newline);
+        __m256i second = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (buffer + i + 1)), dot);
+        __m256i third  = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (buffer + i + 2)), newline);
+        unsigned mask = (unsigned) _mm256_movemask_epi8(_mm256_and_si256(_mm256_and_si256(first, second), third));
+        if (mask != 0) {
+            return i + (size_t) __builtin_ctz(mask);
+        }
+    }
+    _mm256_zeroupper();
+    return i + terminator_sse2(buffer + i, len - i);
+}
+
+#endif
+
+static scan_level    level      = SCAN_SCALAR;
+static scan_function newline    = newline_scalar;
+static scan_function terminator = terminator_scalar;
+
+static bool supported(scan_level value) {
+    switch (value) {
+        case SCAN_SCALAR:
+            return true;
+#ifdef SCAN_X86
+        case SCAN_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case SCAN_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+bool scan_set_level(scan_level value) {
+    if (!supported(value)) {
+        return false;
+    }
+
+    switch (value) {
+#ifdef SCAN_X86
+        case SCAN_SSE2:
+            newline    = newline_sse2;
+            terminator = terminator_sse2;
+            break;
+        case SCAN_AVX2:
+            newline    = newline_avx2;
+            terminator = terminator_avx2;
+            break;
+#endif
+        default:
+            newline    = newline_scalar;
+            terminator = terminator_scalar;
+            break;
+    }
+    level = value;
+    return true;
+}
+
+/** Se elige la mejor implementacion antes de main, asi los threads nunca la ven cambiar */
+__attribute__((constructor))
+static void scan_init(void) {
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+#endif
+    if (!scan_set_level(SCAN_AVX2)) {
+        scan_set_level(SCAN_SSE2);
+    }
+}
+
+size_t scan_newline(const char * buffer, size_t len) {
+    return newline(buffer, len);
+}
+
+size_t scan_terminator(const char * buffer, size_t len) {
+    return terminator(buffer, len);
+}
+
+scan_level scan_get_level(void) {
+    return level;
+}
+
+const char * scan_level_name(scan_level value) {
+    switch (value) {
+        case SCAN_SSE2:
+            return "sse2";
+        case SCAN_AVX2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef TPE_FINAL_SO_SCAN_H
+#define TPE_FINAL_SO_SCAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Busqueda en bloque de \n y del terminador \n . \n del protocolo de texto.
+ *
+ * Se compara de a 16 (SSE2) o 32 (AVX2) bytes por instruccion. La implementacion
+ * se elige al cargar el programa segun lo que soporta el procesador, con una
+ * version escalar para el resto de las arquitecturas.
+ */
+
+typedef enum {
+    SCAN_SCALAR,
+    SCAN_SSE2,
+    SCAN_AVX2,
+} scan_level;
+
+/** Posicion del primer \n en los len bytes de buffer, len si no hay */
+size_t scan_newline(const char * buffer, size_t len);
+
+/** Posicion donde empieza el primer \n . \n completo en buffer, len si no hay */
+size_t scan_terminator(const char * buffer, size_t len);
+
+/** Implementacion en uso */
+scan_level scan_get_level(void);
+
+/** Fuerza una implementacion (para tests y benchmarks), retorna false si el procesador no la soporta */
+bool scan_set_level(scan_level level);
+
+const char * scan_level_name(scan_level level);
+
+#endif //TPE_FINAL_SO_SCAN_H
@@ -0,0 +1,50 @@
+#include <stdlib.h>
+#include <string.h>
+#include "buffer.h"
+
+#define BUFFER_MIN_SIZE 256
+
+void buffer_init(Buffer * buffer) {
+    buffer->data = NULL;
+    buffer->len  = 0;
+    buffer->size = 0;
+}
+
+int buffer_append(Buffer * buffer, const char * data, size_t len) {
+    if (buffer->len + len > buffer->size) {
+        size_t size = buffer->size == 0 ? BUFFER_MIN_SIZE : buffer->size;
+        while (size < buffer->len + len) {
+            size *= 2;
+        }
+
+        char * aux = realloc(buffer->data, size);
+        if (aux == NULL) {
+            return -1;
+        }
+        buffer->data = aux;
+        buffer->size = size;
+    }
+
+    memcpy(buffer->data + buffer->len, data, len);
+    buffer->len += len;
+    return 0;
+}
+
+void buffer_consume(Buffer * buffer, size_t len) {
+    if (len >= buffer->len) {
+        buffer->len = 0;
+        return;
+    }
+
+    memmove(buffer->data, buffer->data + len, buffer->len - len);
+    buffer->len -= len;
+}
+
+void buffer_clear(Buffer * buffer) {
+    buffer->len = 0;
+}
+
+void buffer_free(Buffer * buffer) {
+    free(buffer->data);
+    buffer_init(buffer);
+}
@@ -0,0 +1,26 @@
+#ifndef TPE_FINAL_SO_BUFFER_H
+#define TPE_FINAL_SO_BUFFER_H
+
+#include <stddef.h>
+
+/** Growable byte buffer, used to hold a whole database response */
+typedef struct {
+    char * data;
+    size_t len;
+    size_t size;
+} Buffer;
+
+void buffer_init(Buffer * buffer);
+
+/** Appends len bytes growing the buffer if needed, returns -1 on memory error */
+int buffer_append(Buffer * buffer, const char * data, size_t len);
+
+/** Discards the first len bytes, the rest moves to the beginning */
+void buffer_consume(Buffer * buffer, size_t len);
+
+/** Empties the buffer keeping its memory */
+void buffer_clear(Buffer * buffer);
+
+void buffer_free(Buffer * buffer);
+
+#endif //TPE_FINAL_SO_BUFFER_H
@@ -0,0 +1,346 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "dispatcher.h"
+#include "../protocol.h"
+
+static const DispatcherOps * ops;
+
+static WorkerQueue * workers;
+static int workers_count;
+/** takes every write request, pipelined, so the database can group commits. NULL if disabled */
+static WorkerQueue * writer;
+static LockManager locks;
+/** Connections subscribed to the seats of a showcase */
+static Subscriptions subscriptions;
+static ResponseCache cache;
+
+/** Queries waiting for the database */
+static Query * queue_first, * queue_last;
+/** Finished queries, reused by the next requests */
+static Query * free_queries;
+
+int dispatcher_init(Server server, const DispatcherOps * dispatcher_ops, subscription_push push) {
+    ops   = dispatcher_ops;
+    locks = server_locks(server);
+    cache = server_cache(server);
+    subscriptions = subscriptions_new(push);
+    workers_count = server_workers(server);
+    int processes = workers_count + (server_writer(server) >= 0 ? 1 : 0);
+    workers = calloc((size_t) processes, sizeof(*workers));
+    if (subscriptions == NULL || workers == NULL) {
+        return -1;
+    }
+    writer = server_writer(server) >= 0 ? &workers[server_writer(server)] : NULL;
+    return 0;
+}
+
+WorkerQueue * dispatcher_worker(int worker) {
+    return &workers[worker];
+}
+
+void dispatcher_session_init(Session * session, char * buffer, void * data) {
+    memset(session, 0, sizeof(*session));
+    session->buffer = buffer;
+    session->data   = data;
+    buffer_init(&session->output);
+    message_scanner_init(&session->scanner);
+}
+
+void dispatcher_session_free(Session * session) {
+    subscriptions_remove(subscriptions, session);
+    buffer_free(&session->output);
+}
+
+static Query * new_query(void) {
+    Query * query = free_queries;
+
+    if (query != NULL) {
+        free_queries = query->next;
+    } else if ((query = malloc(sizeof(*query))) != NULL) {
+        buffer_init(&query->response);
+    }
+    return query;
+}
+
+/** The query goes back to the free list keeping its response memory */
+static void release_query(Query * query) {
+    buffer_clear(&query->response);
+    query->next  = free_queries;
+    free_queries = query;
+}
+
+static void enqueue(Query * query) {
+    query->next = NULL;
+    if (queue_last == NULL) {
+        queue_first = queue_last = query;
+    } else {
+        queue_last->next = query;
+        queue_last = query;
+    }
+}
+
+static WorkerQueue * idle_worker(void) {
+    for (int i = 0; i < workers_count; i++) {
+        if (workers[i].first == NULL) {
+            return &workers[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * The writer never waits for the previous responses, any other request needs an idle worker.
+ * A SUBSCRIBE_SEATS goes to the writer too, its map falls between the same changes it is pushed.
+ */
+static WorkerQueue * worker_for(Query * query) {
+    if (writer != NULL && (is_write_request(query->type) || query->type == SUBSCRIBE_SEATS)) {
+        return writer;
+    }
+    return idle_worker();
+}
+
+/** The writer applies the requests in the order they are assigned, they need no locks after that */
+static bool holds_locks(const Query * query) {
+    return query->worker != writer;
+}
+
+/** Appends the query to the worker and starts writing its request */
+static void assign(WorkerQueue * worker, Query * query) {
+    query->worker = worker;
+    query->sent   = 0;
+    query->next   = NULL;
+    buffer_clear(&query->response);
+    message_scanner_init(&query->scanner);
+
+    if (worker->last == NULL) {
+        worker->first = query;
+    } else {
+        worker->last->next = query;
+    }
+    worker->last = query;
+
+    if (worker->writing == NULL) {
+        worker->writing = query;
+    }
+    if (!holds_locks(query)) {
+        // the writes of a showcase share a commit, their responses still finish in commit order
+        lock_manager_release(locks, &query->keys);
+    }
+    ops->write_requests(worker);
+}
+
+/** Hands workers to the queued queries whose locks are free */
+static void dispatch(void) {
+    Query * prev  = NULL;
+    Query * query = queue_first;
+
+    while (query != NULL) {
+        Query * next = query->next;
+        WorkerQueue * worker = worker_for(query);
+
+        if (worker == NULL && writer == NULL) {
+            return;
+        }
+        if (worker == NULL || !lock_manager_try_acquire(locks, &query->keys)) {
+            prev  = query;
+            query = next;
+            continue;
+        }
+
+        if (prev == NULL) {
+            queue_first = next;
+        } else {
+            prev->next = next;
+        }
+        if (queue_last == query) {
+            queue_last = prev;
+        }
+
+        assign(worker, query);
+        query = next;
+    }
+}
+
+/**
+ * The seats changed by a write are pushed and a SUBSCRIBE_SEATS subscribes its connection
+ * before the showcase is released, or as the writer answers them in commit order: no change
+ * of the showcase falls in between.
+ */
+static void publish(Query * query) {
+    Session * session = query->session;
+
+    if (query->type != SUBSCRIBE_SEATS) {
+        subscriptions_publish(subscriptions, query->request, query->len, query->response.data, query->response.len);
+    } else if (!session->closed && parse_request_type(query->response.data, query->response.len) == RESPONSE_OK
+               && subscriptions_add(subscriptions, query->request, query->len, session) < 0) {
+        ops->close(session);
+    }
+}
+
+/** The whole response was read, the worker and the locks are released before sending it */
+static void finish_query(Query * query) {
+    WorkerQueue * worker = query->worker;
+    Session * session = query->session;
+
+    worker->first = query->next;
+    if (worker->first == NULL) {
+        worker->last = NULL;
+    }
+    publish(query);
+    response_cache_invalidate(cache, query->request, query->len);
+    response_cache_store(cache, query->request, query->len, query->response.data, query->response.len, query->generation);
+    if (holds_locks(query)) {
+        lock_manager_release(locks, &query->keys);
+    }
+
+    session->in_flight--;
+    session->ordered = false;
+    if (session->closed) {
+        if (session->in_flight == 0) {
+            ops->drained(session);
+        }
+    } else {
+        if (session->output.len == 0) {
+            // nothing else pending, the response becomes the output without a copy
+            Buffer aux         = session->output;
+            session->output    = query->response;
+            query->response    = aux;
+        } else if (buffer_append(&session->output, query->response.data, query->response.len) < 0) {
+            ops->close(session);
+        }
+        if (!session->closed) {
+            ops->ready(session);
+        }
+    }
+
+    release_query(query);
+    dispatch();
+}
+
+void dispatcher_responses(WorkerQueue * worker, const char * bytes, size_t len) {
+    size_t offset = 0;
+
+    while (offset < len) {
+        Query * query = worker->first;
+        if (query == NULL) {
+            fprintf(stderr, "Database response without request\n");
+            exit(EXIT_FAILURE);
+        }
+
+        bool done;
+        size_t scanned = message_scan(&query->scanner, bytes + offset, len - offset, &done);
+        // the response of a closed connection is still read, a write is published anyway
+        if (buffer_append(&query->response, bytes + offset, scanned) < 0 && !query->session->closed) {
+            ops->close(query->session);
+        }
+        offset += scanned;
+
+        if (done) {
+            finish_query(query);
+        }
+    }
+}
+
+void dispatcher_worker_failed(WorkerQueue * worker) {
+    Query * query = worker->first;
+
+    worker->first = worker->last = worker->writing = NULL;
+    while (query != NULL) {
+        Query * next = query->next;
+        Session * session = query->session;
+
+        // a write may have been applied before the process died, the listings are read again
+        response_cache_invalidate(cache, query->request, query->len);
+        if (holds_locks(query)) {
+            lock_manager_release(locks, &query->keys);
+        }
+        if (!session->closed) {
+            ops->close(session);
+        }
+        session->in_flight--;
+        if (session->in_flight == 0) {
+            ops->drained(session);
+        }
+
+        release_query(query);
+        query = next;
+    }
+
+    dispatch();
+}
+
+/** Drops the current request from the connection buffer, it was already answered or copied */
+static void consume_request(Session * session) {
+    memmove(session->buffer, session->buffer + session->len, session->buffered - session->len);
+    session->buffered -= session->len;
+    session->len       = 0;
+    session->complete  = false;
+}
+
+/**
+ * Answers the current request without the database if it can: CACHE_STATS and the listings
+ * in the cache. The response goes to the output, returns false if the request needs a query.
+ */
+static bool answer_locally(Session * session, unsigned long * generation) {
+    if (parse_request_type(session->buffer, session->len) == CACHE_STATS) {
+        response_cache_stats(cache, session->buffer, session->len, &session->output);
+    } else if (!response_cache_lookup(cache, session->buffer, session->len, &session->output, generation)) {
+        return false;
+    }
+    consume_request(session);
+    return true;
+}
+
+/** Moves the complete request out of the connection buffer into a query and queues it */
+static int start_query(Session * session, bool tagged, unsigned long generation) {
+    Query * query = new_query();
+    if (query == NULL) {
+        return -1;
+    }
+
+    query->session    = session;
+    query->generation = generation;
+    query->len        = session->len;
+    memcpy(query->request, session->buffer, session->len);
+    query->type = parse_request_type(query->request, query->len);
+    lock_keys_from_request(query->request, query->len, &query->keys);
+
+    consume_request(session);
+    session->in_flight++;
+    session->ordered = !tagged;
+
+    enqueue(query);
+    dispatch();
+    return 0;
+}
+
+void dispatcher_scan(Session * session) {
+    while (true) {
+        if (!session->complete) {
+            session->len += message_scan(&session->scanner, session->buffer + session->len,
+                                         session->buffered - session->len, &session->complete);
+            if (!session->complete) {
+                break;
+            }
+        }
+
+        uint32_t id;
+        unsigned long generation = 0;
+        bool tagged = parse_message_id(session->buffer, session->len, &id);
+        if (session->in_flight > 0 && (!tagged || session->ordered || session->in_flight == MAX_IN_FLIGHT)) {
+            break;
+        }
+        if (!answer_locally(session, &generation) && start_query(session, tagged, generation) < 0) {
+            ops->close(session);
+            return;
+        }
+    }
+
+    if (!session->complete && session->buffered == BUFFER_SIZE) {
+        // a request never takes a whole buffer
+        ops->close(session);
+    } else {
+        ops->ready(session);
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef TPE_FINAL_SO_DISPATCHER_H
+#define TPE_FINAL_SO_DISPATCHER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "server.h"
+#include "subscriptions.h"
+#include "../message.h"
+
+/**
+ * Request handling shared by the event driven server modes, epoll and uring: which buffered
+ * requests of a connection may start, the queue of queries waiting for their locks and a
+ * database process, and the responses read back from each process in request order.
+ * The modes only move bytes, each one with its own I/O, and are told through DispatcherOps
+ * when there is something to write, send or close. Everything runs in the loop thread.
+ */
+
+/** Requests and responses of a client connection */
+typedef struct session {
+    /** bytes read from the client: the current request and whatever was pipelined after it */
+    char * buffer;
+    size_t buffered;
+    /** bytes of the current request scanned so far */
+    size_t len;
+    /** the current request is complete and waits until it can start */
+    bool complete;
+    MessageScanner scanner;
+
+    /** requests of the connection in the database */
+    int in_flight;
+    /** the request in flight has no id, nothing else starts until it is answered */
+    bool ordered;
+
+    /** responses ready to be sent, in the order they completed */
+    Buffer output;
+
+    /** the client went away, the responses still in flight are discarded */
+    bool closed;
+    /** connection of the server mode that owns the session */
+    void * data;
+} Session;
+
+/** A request of a connection on its way through the database */
+typedef struct query {
+    Session * session;
+    char request[BUFFER_SIZE];
+    size_t len;
+    /** type of the request, writes may go to the writer */
+    int type;
+    /** bytes of the request already written to the database */
+    size_t sent;
+    /** cache generation when the request missed, the response is stored if it still holds */
+    unsigned long generation;
+
+    /** locks needed by the request */
+    LockKeys keys;
+    /** database process serving the request */
+    struct worker_queue * worker;
+
+    /** whole response read from the database */
+    Buffer response;
+    MessageScanner scanner;
+
+    /** next query in the database queue, in the worker once dispatched or in the free list */
+    struct query * next;
+} Query;
+
+/** The queries a database process is serving */
+typedef struct worker_queue {
+    /** queries waiting for a response, in request order. NULL if the worker is idle */
+    Query * first, * last;
+    /** first query whose request is not completely written */
+    Query * writing;
+    /** database process of the server mode that owns the queue */
+    void * data;
+} WorkerQueue;
+
+/** What the server mode does when the dispatcher needs I/O */
+typedef struct {
+    /** queries were appended to the worker, their requests from `writing` on must be written */
+    void (*write_requests)(WorkerQueue * worker);
+    /** the session stopped starting requests: send its output if any and read it if it can take more */
+    void (*ready)(Session * session);
+    /** the client must be closed, for example on memory errors */
+    void (*close)(Session * session);
+    /** the last query of a closed session finished, it can be freed */
+    void (*drained)(Session * session);
+} DispatcherOps;
+
+/**
+ * Takes the locks and cache of the server and one queue per database process, writer included.
+ * Seat changes are pushed to the subscribed sessions with `push`. Returns -1 on memory error.
+ */
+int dispatcher_init(Server server, const DispatcherOps * ops, subscription_push push);
+
+/** Queue of the database process of server_database_in/out */
+WorkerQueue * dispatcher_worker(int worker);
+
+void dispatcher_session_init(Session * session, char * buffer, void * data);
+
+/** Removes the subscriptions of the session and frees its output */
+void dispatcher_session_free(Session * session);
+
+/**
+ * Starts every buffered request that may run now. A request with an id runs along with
+ * the other ones with an id, up to MAX_IN_FLIGHT. A request without one waits until
+ * nothing is in flight and holds the following ones until it is answered.
+ * Call it once new bytes were buffered or the output was completely sent.
+ */
+void dispatcher_scan(Session * session);
+
+/**
+ * Bytes read from the database process, a read may hold the end of a response and the
+ * beginning of the next one. Each complete response finishes its query.
+ */
+void dispatcher_responses(WorkerQueue * worker, const char * bytes, size_t len);
+
+/**
+ * The database process of the worker died. Its queries are dropped and their connections
+ * closed, the client cannot tell whether a write was applied. The worker is idle afterwards,
+ * queued queries may be assigned to it right away.
+ */
+void dispatcher_worker_failed(WorkerQueue * worker);
+
+#endif //TPE_FINAL_SO_DISPATCHER_H
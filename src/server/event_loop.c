@@ -0,0 +1,433 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include "event_loop.h"
+#include "dispatcher.h"
+
+#define MAX_EVENTS 64
+
+/**
+ * Anything registered in the reactor. The epoll event points to the handler
+ * and the handler knows how to react to the ready events of its descriptor.
+ */
+typedef struct handler {
+    int fd;
+    /** events currently registered in epoll, 0 if not registered */
+    uint32_t events;
+    void (*handle)(struct handler * handler, uint32_t events);
+    /** owner of the descriptor */
+    void * data;
+} Handler;
+
+typedef struct connection {
+    /** must be the first member, the reactor only knows about handlers */
+    Handler handler;
+    Session session;
+
+    /** bytes read from the client: the current request and whatever was pipelined after it */
+    char buffer[BUFFER_SIZE];
+    /** bytes of the output already sent to the client */
+    size_t output_sent;
+
+    /** next connection in the list of destroyed ones */
+    struct connection * next;
+} Connection;
+
+/** A database process, its queries are kept by the dispatcher */
+typedef struct worker {
+    Handler in;
+    Handler out;
+    WorkerQueue * queue;
+    /** process of the server, for server_database_in/out */
+    int index;
+} Worker;
+
+static int epoll_fd;
+
+static Server server;
+
+static Handler * listeners;
+
+static Worker * workers;
+/** Connections destroyed while processing the current batch of events */
+static Connection * dead;
+
+static void handle_accept(Handler * handler, uint32_t events);
+static void handle_connection(Handler * handler, uint32_t events);
+static void handle_database_in(Handler * handler, uint32_t events);
+static void handle_database_out(Handler * handler, uint32_t events);
+
+static int set_non_blocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) {
+        return -1;
+    }
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/** Registers, modifies or removes the interest of a handler. 0 removes it from epoll */
+static int watch(Handler * handler, uint32_t events) {
+    int ret = 0;
+
+    if (events == handler->events) {
+        return 0;
+    }
+
+    if (events == 0) {
+        ret = epoll_ctl(epoll_fd, EPOLL_CTL_DEL, handler->fd, NULL);
+    } else {
+        struct epoll_event event = {
+                .events   = events,
+                .data.ptr = handler,
+        };
+        int op = handler->events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+        ret = epoll_ctl(epoll_fd, op, handler->fd, &event);
+    }
+
+    if (ret < 0) {
+        perror("epoll_ctl() failed");
+    } else {
+        handler->events = events;
+    }
+
+    return ret;
+}
+
+/** Replaces a database process that closed its pipe, the queries it had are dropped */
+static void worker_failed(Worker * worker) {
+    watch(&worker->in, 0);
+    watch(&worker->out, 0);
+    if (server_respawn_worker(server, worker->index) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    worker->in.fd  = server_database_in(server, worker->index);
+    worker->out.fd = server_database_out(server, worker->index);
+    if (set_non_blocking(worker->in.fd) < 0 || set_non_blocking(worker->out.fd) < 0) {
+        perror("fcntl() failed");
+        exit(EXIT_FAILURE);
+    }
+    dispatcher_worker_failed(worker->queue);
+}
+
+static void close_socket(Connection * conn) {
+    watch(&conn->handler, 0);
+    syslog(LOG_DEBUG, "[SERVER] [-] socket %d", conn->handler.fd);
+    close(conn->handler.fd);
+    // pending events of this batch are ignored from now on
+    conn->handler.fd     = -1;
+    conn->session.closed = true;
+}
+
+/** The connection is freed after the current batch of events */
+static void destroy_connection(Connection * conn) {
+    if (!conn->session.closed) {
+        close_socket(conn);
+    }
+    dispatcher_session_free(&conn->session);
+    conn->next = dead;
+    dead = conn;
+}
+
+/** Closes the client socket. If requests are still in the database it is freed once they are drained */
+static void close_connection(Connection * conn) {
+    if (conn->session.in_flight > 0) {
+        close_socket(conn);
+    } else {
+        destroy_connection(conn);
+    }
+}
+
+/**
+ * While responses are pending only their sending is watched, a client that does not
+ * read them stops being read. A complete request waiting for its turn is not read past either.
+ */
+static void watch_connection(Connection * conn) {
+    uint32_t events = 0;
+
+    if (conn->output_sent < conn->session.output.len) {
+        events = EPOLLOUT;
+    } else if (!conn->session.complete) {
+        events = EPOLLIN;
+    }
+
+    if (watch(&conn->handler, events) < 0) {
+        close_connection(conn);
+    }
+}
+
+/** Writes as much of the pending requests as possible into the worker pipe */
+static void write_requests(WorkerQueue * queue) {
+    Worker * worker = queue->data;
+
+    while (queue->writing != NULL) {
+        Query * query = queue->writing;
+
+        while (query->sent < query->len) {
+            ssize_t n = write(worker->in.fd, query->request + query->sent, query->len - query->sent);
+            if (n < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    watch(&worker->in, EPOLLOUT);
+                    return;
+                }
+                // the process died, its pipe closes too and the read replaces it
+                perror("write() to database failed");
+                watch(&worker->in, 0);
+                watch(&worker->out, EPOLLIN);
+                return;
+            }
+            query->sent += (size_t) n;
+        }
+
+        queue->writing = query->next;
+    }
+
+    watch(&worker->in, 0);
+    watch(&worker->out, EPOLLIN);
+}
+
+/** Sends the ready responses, once all of them are out the next requests may start */
+static void flush_output(Connection * conn) {
+    Buffer * output = &conn->session.output;
+
+    while (conn->output_sent < output->len) {
+        ssize_t n = send(conn->handler.fd, output->data + conn->output_sent,
+                         output->len - conn->output_sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                watch_connection(conn);
+            } else {
+                close_connection(conn);
+            }
+            return;
+        }
+        conn->output_sent += (size_t) n;
+    }
+
+    buffer_clear(output);
+    conn->output_sent = 0;
+    dispatcher_scan(&conn->session);
+}
+
+/** Responses that are not waiting for the socket to be writable are sent right away */
+static void session_ready(Session * session) {
+    Connection * conn = session->data;
+
+    if (conn->output_sent < session->output.len && conn->handler.events != EPOLLOUT) {
+        flush_output(conn);
+    } else {
+        watch_connection(conn);
+    }
+}
+
+static void session_close(Session * session) {
+    close_connection(session->data);
+}
+
+static void session_drained(Session * session) {
+    destroy_connection(session->data);
+}
+
+static const DispatcherOps ops = {
+        .write_requests = write_requests,
+        .ready          = session_ready,
+        .close          = session_close,
+        .drained        = session_drained,
+};
+
+/**
+ * Queues a SEATS_CHANGED after the responses already waiting, it is sent once the socket is
+ * writable. A client that lets more than MAX_PUSH_BACKLOG bytes pile up is dropped.
+ */
+static bool push_connection(void * subscriber, const char * message, size_t len) {
+    Session * session = subscriber;
+    Connection * conn = session->data;
+
+    if (session->closed) {
+        return false;
+    }
+    // the connection is not closed while the subscriptions are being walked, the next event closes it
+    if (session->output.len + len > MAX_PUSH_BACKLOG || buffer_append(&session->output, message, len) < 0
+        || watch(&conn->handler, EPOLLOUT) < 0) {
+        shutdown(conn->handler.fd, SHUT_RDWR);
+        return false;
+    }
+    return true;
+}
+
+static void read_request(Connection * conn) {
+    Session * session = &conn->session;
+    ssize_t n = recv(conn->handler.fd, session->buffer + session->buffered, BUFFER_SIZE - session->buffered, 0);
+
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return;
+    }
+    if (n <= 0) {
+        close_connection(conn);
+        return;
+    }
+
+    session->buffered += (size_t) n;
+    dispatcher_scan(session);
+}
+
+static void handle_connection(Handler * handler, uint32_t events) {
+    Connection * conn = (Connection *) handler;
+
+    if (conn->output_sent < conn->session.output.len) {
+        flush_output(conn);
+    } else {
+        read_request(conn);
+    }
+}
+
+static void handle_accept(Handler * handler, uint32_t events) {
+    while (true) {
+        int fd = accept4(handler->fd, 0, 0, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("accept() failed");
+            }
+            return;
+        }
+
+        Connection * conn = calloc(1, sizeof(*conn));
+        if (conn == NULL || set_non_blocking(fd) < 0) {
+            fprintf(stderr, "Connection error\n");
+            free(conn);
+            close(fd);
+            continue;
+        }
+
+        conn->handler.fd     = fd;
+        conn->handler.handle = handle_connection;
+        dispatcher_session_init(&conn->session, conn->buffer, conn);
+
+        if (watch(&conn->handler, EPOLLIN) < 0) {
+            close(fd);
+            free(conn);
+            continue;
+        }
+        syslog(LOG_DEBUG, "[SERVER] [+] socket %d", fd);
+    }
+}
+
+static void handle_database_in(Handler * handler, uint32_t events) {
+    Worker * worker = handler->data;
+
+    if (worker->queue->writing != NULL) {
+        write_requests(worker->queue);
+    }
+}
+
+static void handle_database_out(Handler * handler, uint32_t events) {
+    Worker * worker = handler->data;
+    char buffer[BUFFER_SIZE];
+
+    if (worker->queue->first == NULL) {
+        watch(handler, 0);
+        return;
+    }
+
+    ssize_t n = read(handler->fd, buffer, BUFFER_SIZE);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return;
+    }
+    if (n <= 0) {
+        fprintf(stderr, "Database process closed the pipe\n");
+        worker_failed(worker);
+        return;
+    }
+
+    dispatcher_responses(worker->queue, buffer, (size_t) n);
+    if (worker->queue->first == NULL) {
+        watch(handler, 0);
+    }
+}
+
+int event_loop_run(Server running) {
+    server = running;
+    epoll_fd = epoll_create1(0);
+    if (epoll_fd < 0) {
+        perror("epoll_create1() failed");
+        return -1;
+    }
+
+    // with several listening sockets the kernel spreads the connections, the reactor takes them all
+    int acceptors = server_acceptors(server);
+    listeners = calloc((size_t) acceptors, sizeof(*listeners));
+    if (listeners == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < acceptors; i++) {
+        listeners[i].fd     = server_listen_socket(server, i);
+        listeners[i].handle = handle_accept;
+        if (set_non_blocking(listeners[i].fd) < 0) {
+            perror("fcntl() failed");
+            return -1;
+        }
+    }
+
+    int processes = server_workers(server) + (server_writer(server) >= 0 ? 1 : 0);
+    workers = calloc((size_t) processes, sizeof(*workers));
+    if (workers == NULL || dispatcher_init(server, &ops, push_connection) < 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < processes; i++) {
+        Worker * worker = &workers[i];
+        worker->in.fd       = server_database_in(server, i);
+        worker->in.handle   = handle_database_in;
+        worker->in.data     = worker;
+        worker->out.fd      = server_database_out(server, i);
+        worker->out.handle  = handle_database_out;
+        worker->out.data    = worker;
+        worker->index       = i;
+        worker->queue       = dispatcher_worker(i);
+        worker->queue->data = worker;
+
+        if (set_non_blocking(worker->in.fd) < 0 || set_non_blocking(worker->out.fd) < 0) {
+            perror("fcntl() failed");
+            return -1;
+        }
+    }
+
+    for (int i = 0; i < acceptors; i++) {
+        if (watch(&listeners[i], EPOLLIN) < 0) {
+            return -1;
+        }
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    while (true) {
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait() failed");
+            return -1;
+        }
+
+        for (int i = 0; i < n; i++) {
+            Handler * handler = events[i].data.ptr;
+            if (handler->fd >= 0) {
+                handler->handle(handler, events[i].events);
+            }
+        }
+
+        while (dead != NULL) {
+            Connection * next = dead->next;
+            free(dead);
+            dead = next;
+        }
+    }
+}
@@ -0,0 +1,15 @@
+#ifndef TPE_FINAL_SO_EVENT_LOOP_H
+#define TPE_FINAL_SO_EVENT_LOOP_H
+
+#include "server.h"
+
+/**
+ * Event driven server mode: a single epoll reactor drives the listening socket,
+ * every client socket and the database pipes in non-blocking mode.
+ * Each connection is a small state machine instead of a blocked thread.
+ */
+
+/** Runs the reactor until a fatal error occurs, returns -1 in that case */
+int event_loop_run(Server server);
+
+#endif //TPE_FINAL_SO_EVENT_LOOP_H
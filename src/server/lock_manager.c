@@ -0,0 +1,205 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "lock_manager.h"
+
+#define BUCKETS 64
+
+/** A held key */
+struct lock_node {
+    char key[LOCK_KEY_SIZE];
+    struct lock_node * next;
+};
+
+struct lock_manager {
+    pthread_mutex_t mutex;
+    /** signaled every time keys are released */
+    pthread_cond_t  released;
+    struct lock_node * buckets[BUCKETS];
+};
+
+LockManager lock_manager_new(void) {
+    struct lock_manager * ret = calloc(1, sizeof(*ret));
+
+    if (ret == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_init(&ret->mutex, NULL);
+    pthread_cond_init(&ret->released, NULL);
+
+    return ret;
+}
+
+/** Keeps the key just written at keys[count] unless it is already there, a BATCH may repeat it */
+static void add_key(LockKeys * keys) {
+    for (int i = 0; i < keys->count; i++) {
+        if (strcmp(keys->keys[i], keys->keys[keys->count]) == 0) {
+            return;
+        }
+    }
+    keys->count++;
+}
+
+/** A room on a day hosts at most one showcase, so (day, room) identifies the showcase */
+static void showcase_key(const char * request, size_t len, int day_line, LockKeys * keys) {
+    char day[ARG_SIZE], room[ARG_SIZE];
+
+    if (request_line(request, len, day_line, day, sizeof(day))
+        && request_line(request, len, day_line + 1, room, sizeof(room))) {
+        snprintf(keys->keys[keys->count], LOCK_KEY_SIZE, "s%d/%d", atoi(day), atoi(room));
+        add_key(keys);
+    }
+}
+
+static void client_key(const char * request, size_t len, int name_line, LockKeys * keys) {
+    char * key = keys->keys[keys->count];
+
+    key[0] = 'c';
+    if (request_line(request, len, name_line, key + 1, LOCK_KEY_SIZE - 1)) {
+        add_key(keys);
+    }
+}
+
+/** Keys of a write whose type is at line `base`, its arguments follow it */
+static void write_keys(const char * request, size_t len, int type, int base, LockKeys * keys) {
+    switch (type) {
+        case ADD_CLIENT:
+            client_key(request, len, base + 1, keys);
+            break;
+        case ADD_SHOWCASE:
+        case REMOVE_SHOWCASE:
+            showcase_key(request, len, base + 2, keys);
+            break;
+        case ADD_BOOKING:
+        case REMOVE_BOOKING:
+            showcase_key(request, len, base + 3, keys);
+            break;
+        default:
+            break;
+    }
+}
+
+/** Every write of the batch, the database rejects the whole batch if one is malformed */
+static void batch_keys(const char * request, size_t len, LockKeys * keys) {
+    for (int base = 0, type, count = 0; count < MAX_BATCH_REQUESTS && batch_next_write(request, len, &base, &type); count++) {
+        write_keys(request, len, type, base, keys);
+    }
+}
+
+void lock_keys_from_request(const char * request, size_t len, LockKeys * keys) {
+    keys->count = 0;
+
+    int type = parse_request_type(request, len);
+    if (type == BATCH) {
+        batch_keys(request, len, keys);
+    } else if (type == SUBSCRIBE_SEATS) {
+        showcase_key(request, len, 2, keys);
+    } else {
+        write_keys(request, len, type, 0, keys);
+    }
+}
+
+static unsigned hash(const char * key) {
+    unsigned h = 5381;
+    while (*key != 0) {
+        h = h * 33 + (unsigned char) *key++;
+    }
+    return h % BUCKETS;
+}
+
+static bool is_held(LockManager manager, const char * key) {
+    for (struct lock_node * node = manager->buckets[hash(key)]; node != NULL; node = node->next) {
+        if (strcmp(node->key, key) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool all_free(LockManager manager, const LockKeys * keys) {
+    for (int i = 0; i < keys->count; i++) {
+        if (is_held(manager, keys->keys[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void hold(LockManager manager, const LockKeys * keys) {
+    for (int i = 0; i < keys->count; i++) {
+        struct lock_node * node = malloc(sizeof(*node));
+        if (node == NULL) {
+            exit(EXIT_FAILURE);
+        }
+
+        unsigned h = hash(keys->keys[i]);
+        strcpy(node->key, keys->keys[i]);
+        node->next = manager->buckets[h];
+        manager->buckets[h] = node;
+    }
+}
+
+void lock_manager_acquire(LockManager manager, const LockKeys * keys) {
+    if (keys->count == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&manager->mutex);
+    while (!all_free(manager, keys)) {
+        pthread_cond_wait(&manager->released, &manager->mutex);
+    }
+    hold(manager, keys);
+    pthread_mutex_unlock(&manager->mutex);
+}
+
+bool lock_manager_try_acquire(LockManager manager, const LockKeys * keys) {
+    if (keys->count == 0) {
+        return true;
+    }
+
+    pthread_mutex_lock(&manager->mutex);
+    bool ret = all_free(manager, keys);
+    if (ret) {
+        hold(manager, keys);
+    }
+    pthread_mutex_unlock(&manager->mutex);
+
+    return ret;
+}
+
+void lock_manager_release(LockManager manager, const LockKeys * keys) {
+    if (keys->count == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&manager->mutex);
+    for (int i = 0; i < keys->count; i++) {
+        struct lock_node ** node = &manager->buckets[hash(keys->keys[i])];
+        while (*node != NULL && strcmp((*node)->key, keys->keys[i]) != 0) {
+            node = &(*node)->next;
+        }
+        if (*node != NULL) {
+            struct lock_node * aux = *node;
+            *node = aux->next;
+            free(aux);
+        }
+    }
+    pthread_cond_broadcast(&manager->released);
+    pthread_mutex_unlock(&manager->mutex);
+}
+
+void lock_manager_destroy(LockManager manager) {
+    for (int i = 0; i < BUCKETS; i++) {
+        struct lock_node * node = manager->buckets[i];
+        while (node != NULL) {
+            struct lock_node * aux = node->next;
+            free(node);
+            node = aux;
+        }
+    }
+    pthread_cond_destroy(&manager->released);
+    pthread_mutex_destroy(&manager->mutex);
+    free(manager);
+}
@@ -0,0 +1,45 @@
+#ifndef TPE_FINAL_SO_LOCK_MANAGER_H
+#define TPE_FINAL_SO_LOCK_MANAGER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "../protocol.h"
+
+/**
+ * Locks by key instead of a global lock over the database.
+ * Writes on the same showcase (or the same client name) are serialized,
+ * unrelated writes and every read proceed concurrently.
+ * Locks are held only during the database round-trip of a request.
+ */
+
+/** one key per write, a BATCH takes the keys of all of its writes */
+#define MAX_LOCK_KEYS   MAX_BATCH_REQUESTS
+#define LOCK_KEY_SIZE   (ARG_SIZE + 2)
+
+/** Keys needed by a request, all of them are acquired at once */
+typedef struct {
+    int count;
+    char keys[MAX_LOCK_KEYS][LOCK_KEY_SIZE];
+} LockKeys;
+
+typedef struct lock_manager * LockManager;
+
+LockManager lock_manager_new(void);
+
+/**
+ * Fills the keys needed by a serialized request. Reads need none, except SUBSCRIBE_SEATS
+ * which takes its showcase so no write on it runs between the seat map and the subscription.
+ */
+void lock_keys_from_request(const char * request, size_t len, LockKeys * keys);
+
+/** Blocks until every key is free and takes them */
+void lock_manager_acquire(LockManager manager, const LockKeys * keys);
+
+/** Takes every key if all of them are free, never blocks */
+bool lock_manager_try_acquire(LockManager manager, const LockKeys * keys);
+
+void lock_manager_release(LockManager manager, const LockKeys * keys);
+
+void lock_manager_destroy(LockManager manager);
+
+#endif //TPE_FINAL_SO_LOCK_MANAGER_H
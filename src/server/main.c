@@ -5,28 +5,86 @@
 #include <syslog.h>
 #include <getopt.h>
 #include <ctype.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
 #include "server.h"
+#include "event_loop.h"
+#include "uring_loop.h"
 #include "../utils.h"
 
 /**
- * Multi-threaded concurrent server implementation
- * ...
- * ...
+ * Concurrent server implementation.
+ * Three modes can be selected at startup:
+ * - threads: one detached thread per connection doing blocking I/O (default)
+ * - epoll: a single reactor driving non-blocking sockets and database pipes
+ * - uring: a single loop submitting every socket and pipe operation to io_uring in batches
  */
 
+typedef enum {
+    MODE_THREADS,
+    MODE_EPOLL,
+    MODE_URING,
+} server_mode;
+
+#define MAX_WORKERS 64
+#define MAX_ACCEPTORS 64
+
 static Server server;
 
 /** Creates a new thread to handle a client connection */
 static void new_thread(ClientData * data);
 
+/** Accepts the connections of one listening socket */
+static void * accept_connections(void * acceptor);
+
 /** Single connection handler */
 static void * handle_connection(void* data);
 
-void parse_options(int argc, char **argv, int * port, char ** filename) {
+static server_mode parse_mode(char * optarg) {
+    if (strcmp(optarg, "threads") == 0) {
+        return MODE_THREADS;
+    } else if (strcmp(optarg, "epoll") == 0) {
+        return MODE_EPOLL;
+    } else if (strcmp(optarg, "uring") == 0) {
+        return MODE_URING;
+    }
+
+    fprintf(stderr, "invalid server mode: %s\n", optarg);
+    exit(1);
+}
+
+/** Positive number up to max for the option, exits with message otherwise */
+static int parse_count(char * optarg, int max, const char * message) {
+    char *end = 0;
+    long sl   = strtol(optarg, &end, 10);
+
+    if (end == optarg || '\0' != *end || sl <= 0 || sl > max) {
+        fprintf(stderr, "%s: %s\n", message, optarg);
+        exit(1);
+    }
+
+    return (int) sl;
+}
+
+/** Forwards `-flag value` to the database processes, the database validates the value */
+static void add_database_option(char ** db_options, const char * flag, char * value) {
+    int count = 0;
+    // a repeated option replaces the previous value
+    while (db_options[count] != NULL && strcmp(db_options[count], flag) != 0) {
+        count += 2;
+    }
+    db_options[count]     = (char *) flag;
+    db_options[count + 1] = value;
+}
+
+void parse_options(int argc, char **argv, int * port, char ** filename, server_mode * mode, int * workers,
+                   char ** db_options, bool * writer, bool * rings, int * backlog, int * acceptors,
+                   char ** unix_path) {
     opterr = 0;
     /* p: option e requires argument p:: optional argument */
     int c;
-    while ((c = getopt (argc, argv, "p:f:")) != -1) {
+    while ((c = getopt (argc, argv, "p:f:m:w:J:S:C:M:G:Rb:a:u:")) != -1) {
         switch (c) {
             /* Server port number */
             case 'p':
@@ -36,8 +94,55 @@ void parse_options(int argc, char **argv, int * port, char ** filename) {
             case 'f':
                 *filename = optarg;
                 break;
+            /* Concurrency model */
+            case 'm':
+                *mode = parse_mode(optarg);
+                break;
+            /* Database worker processes */
+            case 'w':
+                *workers = parse_count(optarg, MAX_WORKERS, "invalid number of database workers");
+                break;
+            /* Database journal mode */
+            case 'J':
+                add_database_option(db_options, "-j", optarg);
+                break;
+            /* Database synchronous level */
+            case 'S':
+                add_database_option(db_options, "-s", optarg);
+                break;
+            /* Database page cache size */
+            case 'C':
+                add_database_option(db_options, "-c", optarg);
+                break;
+            /* Database memory mapped I/O size */
+            case 'M':
+                add_database_option(db_options, "-m", optarg);
+                break;
+            /* Group commit window in microseconds, writes go to a dedicated process */
+            case 'G':
+                add_database_option(db_options, "-g", optarg);
+                *writer = true;
+                break;
+            /* Shared memory rings instead of pipes to talk to the database processes */
+            case 'R':
+                *rings = true;
+                break;
+            /* Listen queue of each listening socket */
+            case 'b':
+                *backlog = parse_count(optarg, INT32_MAX, "invalid backlog");
+                break;
+            /* Listening sockets sharing the port, each one with its accepting thread in threads mode */
+            case 'a':
+                *acceptors = parse_count(optarg, MAX_ACCEPTORS, "invalid number of acceptors");
+                break;
+            /* Unix domain socket listening along with the port, '@' for the abstract namespace */
+            case 'u':
+                *unix_path = optarg;
+                break;
             case '?':
-                if (optopt == 'p' || optopt == 'f')
+                if (optopt == 'p' || optopt == 'f' || optopt == 'm' || optopt == 'w'
+                    || optopt == 'J' || optopt == 'S' || optopt == 'C' || optopt == 'M' || optopt == 'G'
+                    || optopt == 'b' || optopt == 'a' || optopt == 'u')
                     fprintf(stderr, "Option -%c requires an argument.\n", optopt);
                 else if (isprint (optopt))
                     fprintf(stderr, "Unknown option `-%c'.\n", optopt);
@@ -54,29 +159,52 @@ int main(int argc, char *argv[]) {
 
     int server_port = DEFAULT_PORT;
     char * filename = DEFAULT_DATABASE_FILENAME;
+    server_mode mode = MODE_THREADS;
+    int workers = 0;
+    // the five database options, flag and value each
+    char * db_options[MAX_DATABASE_OPTIONS + 1] = {NULL};
+    bool writer = false;
+    bool rings = false;
+    int backlog = DEFAULT_BACKLOG;
+    int acceptors = 1;
+    char * unix_path = NULL;
 
-    parse_options(argc, argv, &server_port, &filename);
+    parse_options(argc, argv, &server_port, &filename, &mode, &workers, db_options, &writer, &rings, &backlog,
+                  &acceptors, &unix_path);
+    if (rings && mode != MODE_THREADS) {
+        fprintf(stderr, "The shared memory rings need the threads mode\n");
+        return 1;
+    }
 
-    server = server_init(server_port, filename);
+    server = server_init(server_port, filename, db_options, workers, writer, rings, backlog, acceptors,
+                         unix_path);
     if (server == NULL) {
         fprintf(stderr, "Server initialization failed\n");
         return -1;
     }
 
-    printf("Successful database setup: '%s'\n", filename);
+    server_handle_signals(server);
+
+    printf("Successful database setup: '%s' (%d workers)\n", filename, server_workers(server));
     printf("Listening on TCP port %d\n", server_port);
     printf("Waiting for connections...\n");
 
-    while(true) {
-        ClientData * data = server_accept_connection(server);
+    if (mode == MODE_EPOLL) {
+        return event_loop_run(server);
+    }
+    if (mode == MODE_URING) {
+        return uring_loop_run(server);
+    }
 
-        if (data != NULL) {
-            new_thread(data);
-            syslog(LOG_DEBUG, "[SERVER] [+] socket %d", data->client_fd);
-        } else {
-            fprintf(stderr, "Connection error\n");
+    for (int i = 1; i < server_acceptors(server); i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, accept_connections, (void *) (intptr_t) i) == 0) {
+            pthread_detach(thread);
         }
     }
+    accept_connections((void *) (intptr_t) 0);
+    // the signal handler is stopping the server, it dies with the signal
+    pthread_exit(NULL);
 
 //unreachable code
 
@@ -85,6 +213,24 @@ int main(int argc, char *argv[]) {
 //    return 0;
 }
 
+void * accept_connections(void * acceptor) {
+    while(true) {
+        ClientData * data = server_accept_connection(server, (int) (intptr_t) acceptor);
+
+        if (data != NULL) {
+            // the connection thread frees data when the client leaves
+            syslog(LOG_DEBUG, "[SERVER] [+] socket %d", data->client_fd);
+            new_thread(data);
+        } else if (errno == EINVAL) {
+            break;
+        } else {
+            fprintf(stderr, "Connection error\n");
+        }
+    }
+
+    return NULL;
+}
+
 void new_thread(ClientData * data) {
     pthread_t thread;
 
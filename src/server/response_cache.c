@@ -0,0 +1,266 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "response_cache.h"
+#include "server.h"
+#include "../protocol.h"
+#include "../frame.h"
+
+#define BUCKETS     64
+/** a full cache is emptied, GET_SHOWCASES keys come from the clients */
+#define MAX_ENTRIES 1024
+
+typedef struct entry {
+    /** request without its id */
+    char * request;
+    size_t request_len;
+    /** response without an id */
+    char * response;
+    size_t response_len;
+    struct entry * next;
+} Entry;
+
+struct response_cache {
+    pthread_mutex_t mutex;
+    Entry * buckets[BUCKETS];
+    int entries;
+    unsigned long generation;
+    unsigned long hits;
+    unsigned long misses;
+};
+
+ResponseCache response_cache_new(void) {
+    struct response_cache * ret = calloc(1, sizeof(*ret));
+
+    if (ret == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_init(&ret->mutex, NULL);
+
+    return ret;
+}
+
+static bool cacheable(int type) {
+    return type == GET_MOVIES || type == GET_SHOWCASES;
+}
+
+static bool changes_listings(int type) {
+    return type == ADD_SHOWCASE || type == REMOVE_SHOWCASE;
+}
+
+static unsigned hash(const char * key, size_t len) {
+    unsigned h = 5381;
+    for (size_t i = 0; i < len; i++) {
+        h = h * 33 + (unsigned char) key[i];
+    }
+    return h % BUCKETS;
+}
+
+/**
+ * Copies the message (request or response) without its id into out, which has room for len bytes.
+ * Returns the length of the copy.
+ */
+static size_t strip_id(const char * message, size_t len, char * out) {
+    if (is_frame(message, len)) {
+        if (frame_header_size(message) == FRAME_HEADER || len < FRAME_HEADER + FRAME_ID_SIZE) {
+            memcpy(out, message, len);
+            return len;
+        }
+        out[0] = (char) FRAME_MAGIC;
+        memcpy(out + 1, message + 1, FRAME_HEADER - 1);
+        memcpy(out + FRAME_HEADER, message + FRAME_HEADER + FRAME_ID_SIZE, len - FRAME_HEADER - FRAME_ID_SIZE);
+        return len - FRAME_ID_SIZE;
+    }
+
+    // "TIPO:ID\n" pasa a "TIPO\n"
+    const char * separator = memchr(message, REQUEST_ID_SEPARATOR, len);
+    const char * newline   = memchr(message, '\n', len);
+    if (separator == NULL || newline == NULL || separator > newline) {
+        memcpy(out, message, len);
+        return len;
+    }
+    size_t type = (size_t) (separator - message);
+    memcpy(out, message, type);
+    memcpy(out + type, newline, len - (size_t) (newline - message));
+    return type + len - (size_t) (newline - message);
+}
+
+/** Appends the response without an id adding the id of the request, if it has one */
+static int append_with_id(Buffer * buffer, const char * response, size_t len, bool has_id, uint32_t id) {
+    if (!has_id) {
+        return buffer_append(buffer, response, len);
+    }
+
+    if (is_frame(response, len)) {
+        char header[FRAME_HEADER + FRAME_ID_SIZE];
+        memcpy(header, response, FRAME_HEADER);
+        header[0] = (char) FRAME_MAGIC_ID;
+        for (int i = 0; i < FRAME_ID_SIZE; i++) {
+            header[FRAME_HEADER + i] = (char) (id >> (8 * (FRAME_ID_SIZE - 1 - i)));
+        }
+        if (buffer_append(buffer, header, sizeof(header)) < 0) {
+            return -1;
+        }
+        return buffer_append(buffer, response + FRAME_HEADER, len - FRAME_HEADER);
+    }
+
+    const char * newline = memchr(response, '\n', len);
+    size_t status = (size_t) (newline - response);
+    char separator[16];
+    int separator_len = snprintf(separator, sizeof(separator), "%c%u", REQUEST_ID_SEPARATOR, id);
+    if (buffer_append(buffer, response, status) < 0 || buffer_append(buffer, separator, (size_t) separator_len) < 0) {
+        return -1;
+    }
+    return buffer_append(buffer, newline, len - status);
+}
+
+static Entry * find(ResponseCache cache, const char * key, size_t key_len) {
+    for (Entry * entry = cache->buckets[hash(key, key_len)]; entry != NULL; entry = entry->next) {
+        if (entry->request_len == key_len && memcmp(entry->request, key, key_len) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/** Called with the cache locked */
+static void clear(ResponseCache cache) {
+    for (int i = 0; i < BUCKETS; i++) {
+        Entry * entry = cache->buckets[i];
+        while (entry != NULL) {
+            Entry * aux = entry->next;
+            free(entry->request);
+            free(entry->response);
+            free(entry);
+            entry = aux;
+        }
+        cache->buckets[i] = NULL;
+    }
+    cache->entries = 0;
+}
+
+bool response_cache_lookup(ResponseCache cache, const char * request, size_t len, Buffer * response,
+                           unsigned long * generation) {
+    char key[BUFFER_SIZE];
+    uint32_t id;
+
+    if (!cacheable(parse_request_type(request, len)) || len > sizeof(key)) {
+        return false;
+    }
+    size_t key_len = strip_id(request, len, key);
+    bool has_id = parse_message_id(request, len, &id);
+
+    pthread_mutex_lock(&cache->mutex);
+    Entry * entry = find(cache, key, key_len);
+    size_t before = response->len;
+    bool hit = entry != NULL && append_with_id(response, entry->response, entry->response_len, has_id, id) == 0;
+    if (entry != NULL && !hit) {
+        // sin memoria para copiarla, se pide a la base
+        response->len = before;
+    }
+    if (hit) {
+        cache->hits++;
+    } else {
+        cache->misses++;
+        *generation = cache->generation;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+
+    return hit;
+}
+
+void response_cache_store(ResponseCache cache, const char * request, size_t len,
+                          const char * response, size_t response_len, unsigned long generation) {
+    if (!cacheable(parse_request_type(request, len)) || len > BUFFER_SIZE
+        || parse_request_type(response, response_len) != RESPONSE_OK) {
+        return;
+    }
+
+    Entry * entry = malloc(sizeof(*entry));
+    char * key = malloc(len);
+    char * value = malloc(response_len);
+    if (entry == NULL || key == NULL || value == NULL) {
+        free(entry);
+        free(key);
+        free(value);
+        return;
+    }
+    entry->request      = key;
+    entry->request_len  = strip_id(request, len, key);
+    entry->response     = value;
+    entry->response_len = strip_id(response, response_len, value);
+
+    pthread_mutex_lock(&cache->mutex);
+    bool stale = generation != cache->generation || find(cache, key, entry->request_len) != NULL;
+    if (!stale) {
+        if (cache->entries == MAX_ENTRIES) {
+            clear(cache);
+        }
+        unsigned h = hash(key, entry->request_len);
+        entry->next = cache->buckets[h];
+        cache->buckets[h] = entry;
+        cache->entries++;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+
+    if (stale) {
+        free(entry);
+        free(key);
+        free(value);
+    }
+}
+
+void response_cache_invalidate(ResponseCache cache, const char * request, size_t len) {
+    int type = parse_request_type(request, len);
+    bool changes = changes_listings(type);
+
+    for (int base = 0, writes = 0; type == BATCH && !changes && writes < MAX_BATCH_REQUESTS
+                                   && batch_next_write(request, len, &base, &type); writes++) {
+        changes = changes_listings(type);
+    }
+    if (!changes) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache->mutex);
+    clear(cache);
+    cache->generation++;
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+void response_cache_stats(ResponseCache cache, const char * request, size_t len, Buffer * response) {
+    uint32_t id;
+    bool has_id = parse_message_id(request, len, &id);
+
+    pthread_mutex_lock(&cache->mutex);
+    unsigned long hits = cache->hits, misses = cache->misses;
+    pthread_mutex_unlock(&cache->mutex);
+
+    if (is_frame(request, len)) {
+        FrameWriter writer;
+        frame_writer_init(&writer, RESPONSE_OK);
+        if (has_id) {
+            frame_writer_set_id(&writer, id);
+        }
+        frame_put_int(&writer, (int32_t) hits);
+        frame_put_int(&writer, (int32_t) misses);
+        size_t frame_len = frame_writer_finish(&writer);
+        if (frame_len > 0) {
+            buffer_append(response, writer.data, frame_len);
+        }
+        frame_writer_free(&writer);
+        return;
+    }
+
+    char text[64];
+    int text_len = snprintf(text, sizeof(text), "%d\n%lu\n%lu\n.\n", RESPONSE_OK, hits, misses);
+    append_with_id(response, text, (size_t) text_len, has_id, id);
+}
+
+void response_cache_destroy(ResponseCache cache) {
+    clear(cache);
+    pthread_mutex_destroy(&cache->mutex);
+    free(cache);
+}
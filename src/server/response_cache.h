@@ -0,0 +1,41 @@
+#ifndef TPE_FINAL_SO_RESPONSE_CACHE_H
+#define TPE_FINAL_SO_RESPONSE_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "buffer.h"
+
+/**
+ * Responses to GET_MOVIES and GET_SHOWCASES kept by the server, keyed by the bytes of the
+ * request without its id. The listings only change with ADD_SHOWCASE and REMOVE_SHOWCASE,
+ * any of them drops every cached response. A hit is answered without a database worker.
+ *
+ * Every write bumps a generation when it invalidates: a response read from the database is
+ * only stored if no invalidation happened since its lookup, a read racing with a write never
+ * leaves a stale listing behind.
+ */
+
+typedef struct response_cache * ResponseCache;
+
+ResponseCache response_cache_new(void);
+
+/**
+ * Appends the cached response to the request, repeating its id, and returns true.
+ * On a miss returns false and leaves in generation the value for response_cache_store.
+ */
+bool response_cache_lookup(ResponseCache cache, const char * request, size_t len, Buffer * response,
+                           unsigned long * generation);
+
+/** Stores the OK response to a request that missed, unless an invalidation happened since the lookup */
+void response_cache_store(ResponseCache cache, const char * request, size_t len,
+                          const char * response, size_t response_len, unsigned long generation);
+
+/** Drops every cached response if the request, which already reached the database, changes a listing */
+void response_cache_invalidate(ResponseCache cache, const char * request, size_t len);
+
+/** Appends the response to a CACHE_STATS request: hits and misses so far, in the format of the request */
+void response_cache_stats(ResponseCache cache, const char * request, size_t len, Buffer * response);
+
+void response_cache_destroy(ResponseCache cache);
+
+#endif //TPE_FINAL_SO_RESPONSE_CACHE_H
@@ -1,5 +1,8 @@
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <sys/socket.h>
+#include <sys/prctl.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <netinet/in.h>
@@ -7,27 +10,118 @@
 #include <unistd.h>
 #include <semaphore.h>
 #include <strings.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <limits.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <stdint.h>
 #include "server.h"
+#include "../protocol.h"
+#include "../message.h"
+#include "../ring.h"
+#include "lock_manager.h"
+#include "subscriptions.h"
+#include "response_cache.h"
+#include "../utils.h"
 
-#define PENDING_CONNECTIONS 10
 #define DATABASE_PROC       "database"
+/** pipe a relayed response is held in until the client takes it, the kernel may cap it */
+#define RELAY_PIPE_SIZE     (1024 * 1024)
+
+/** A forked database process */
+typedef struct {
+    pid_t pid;
+    // Write in in, read from out
+    int in, out;
+    // bytes read from out that belong to the next response
+    Buffer pending;
+    // a relayed response is tee'd here to peek at it, -1 if there is no such pipe
+    int peek_in, peek_out;
+    // shared memory rings used instead of in and out, NULL with the pipe transport
+    Ring * requests, * responses;
+    // with the rings, readable once the process exits: nobody else would wake the server, -1 with the pipes
+    int pidfd;
+    // the process exited and its rings were closed
+    bool gone;
+} DatabaseWorker;
 
 struct server {
-    int listen_socket;
-    // Write in db_in, read from db_out
-    int database_in, database_out;
+    // one socket per acceptor, all bound to the port with SO_REUSEPORT when there are several,
+    // followed by the Unix domain socket if there is one
+    int * listen_sockets;
+    int   listen_count;
+    // file of the Unix domain socket, removed on close. NULL if there is none or it is abstract
+    const char * unix_path;
+
+    DatabaseWorker * workers;
+    int              workers_count;
+    // what every database process is started with, a process that dies is replaced
+    char *           filename;
+    char **          options;
+    bool             rings;
+
+    // workers libres, protegidos por pool_mutex
+    int *            idle;
+    int              idle_count;
+    pthread_mutex_t  pool_mutex;
 
     struct sockaddr_in address;
     socklen_t          address_len;
 
-    // semaforo para sincronizar consultas a la base de datos
+    // semaforo que cuenta los workers libres
     sem_t              semaphore;
+    // locks por showcase / cliente para las escrituras
+    LockManager        locks;
+    // conexiones suscriptas a los asientos de una funcion
+    Subscriptions      subscriptions;
+    // respuestas de GET_MOVIES y GET_SHOWCASES
+    ResponseCache      cache;
+    // destino de los bytes descartados del pipe de peek, -1 si no se pueden relayar respuestas
+    int                null_fd;
+
+    // proceso que recibe todas las escrituras encadenadas para agrupar commits, -1 si no hay
+    int                writer;
+    // los pedidos se numeran al escribirlos en el pipe, writer_mutex mantiene ese orden
+    pthread_mutex_t    writer_mutex;
+    unsigned long      writer_tickets;
+    // las respuestas llegan en el mismo orden, cada thread lee la suya en su turno
+    pthread_mutex_t    turn_mutex;
+    pthread_cond_t     turn;
+    unsigned long      writer_served;
+    // los pedidos anteriores a este ticket se escribieron a un writer que murio y no tienen respuesta
+    unsigned long      writer_reset;
+
+    // con los anillos un thread vigila los procesos database y es el unico que los vuelve a levantar
+    pthread_mutex_t    monitor_mutex;
+    pthread_cond_t     respawned;
+    // avisa al thread que hay un proceso para reemplazar
+    int                monitor_wake[2];
+    // proceso pedido al thread, -1 si ninguno, y el resultado del reemplazo
+    int                respawn;
+    int                respawn_result;
 };
 
-/** Forks database handler process and creates pipes for inter-process communication */
-static int database_init(Server server, char * filename);
+/** Server stopped by the signal handler */
+static Server running;
+
+/** Forks database handler processes and creates pipes for inter-process communication */
+static int database_init(Server server, char * filename, char ** options, bool rings);
 
-int create_master_socket(int protocol, struct sockaddr *addr, socklen_t addr_len) {
+/** Closes the first count database processes and waits for them to exit */
+static void database_stop(Server server, int count);
+
+/** With the rings, starts the thread that notices a database process that died */
+static int database_monitor(Server server);
+
+/** Queues a SEATS_CHANGED for a subscribed connection */
+static bool push_client(void * subscriber, const char * message, size_t len);
+
+int create_master_socket(int protocol, struct sockaddr *addr, socklen_t addr_len, int backlog, bool reuse_port) {
     int sock_opt = true;
 
     int sock = socket(addr->sa_family, SOCK_STREAM, protocol);
@@ -36,32 +130,73 @@ int create_master_socket(int protocol, struct sockaddr *addr, socklen_t addr_len
         perror("socket() failed");
         return -1;
     }
+    // the database processes must not keep the port open once the server is gone
+    fcntl(sock, F_SETFD, FD_CLOEXEC);
 
     if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (char *)&sock_opt, sizeof(sock_opt)) < 0) {
         perror("setsockopt() failed");
+        close(sock);
+        return -1;
+    }
+
+    // each acceptor binds its own socket to the port and the kernel spreads the new connections
+    if (reuse_port && setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, (char *)&sock_opt, sizeof(sock_opt)) < 0) {
+        perror("setsockopt() failed");
+        close(sock);
         return -1;
     }
     
     if(bind(sock, addr, addr_len) < 0) {
         perror("bind() failed");
+        close(sock);
         return -1;
     }
 
-    if(listen(sock, PENDING_CONNECTIONS) != 0) {
+    if(listen(sock, backlog) != 0) {
         perror("listen() failed");
+        close(sock);
         return -1;
     }
 
     return sock;
 }
 
-Server server_init(int port, char * db_filename) {
+Server server_init(int port, char * db_filename, char ** db_options, int workers, bool writer, bool rings,
+                   int backlog, int acceptors, const char * unix_path) {
     Server server = malloc(sizeof(struct server));
 
     if (server == NULL) {
         return NULL;
     }
 
+    if (workers <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cores > 0 ? (int) cores : 1;
+    }
+
+    server->workers_count = workers;
+    server->filename = db_filename;
+    server->options = db_options;
+    server->rings = rings;
+    server->writer = writer ? workers : -1;
+    server->workers = calloc((size_t) workers + (writer ? 1 : 0), sizeof(*server->workers));
+    server->idle = calloc((size_t) workers, sizeof(*server->idle));
+    acceptors = acceptors > 0 ? acceptors : 1;
+    server->listen_count = acceptors + (unix_path != NULL ? 1 : 0);
+    server->unix_path = unix_path != NULL && unix_path[0] != '@' ? unix_path : NULL;
+    server->listen_sockets = calloc((size_t) server->listen_count, sizeof(*server->listen_sockets));
+    if (server->workers == NULL || server->idle == NULL || server->listen_sockets == NULL) {
+        free(server->workers);
+        free(server->idle);
+        free(server->listen_sockets);
+        free(server);
+        return NULL;
+    }
+    // 0 is a valid descriptor, a socket that failed must not be closed
+    for (int i = 0; i < server->listen_count; i++) {
+        server->listen_sockets[i] = -1;
+    }
+
     struct sockaddr_in addr;
     socklen_t addr_len = sizeof(struct sockaddr);
 
@@ -72,61 +207,205 @@ Server server_init(int port, char * db_filename) {
     memcpy(&server->address, &addr, addr_len);
     server->address_len = addr_len;
 
-    server->listen_socket = create_master_socket(IPPROTO_TCP, (struct sockaddr *)&server->address, server->address_len);
+    bool listening = true;
+    // local front-ends skip the TCP stack, their connections are served like any other. It listens
+    // before the port does, so whoever can reach the port can reach this socket too
+    if (unix_path != NULL) {
+        struct sockaddr_un unix_addr;
+        socklen_t unix_len = unix_address(unix_path, &unix_addr);
+        if (unix_len == 0) {
+            fprintf(stderr, "invalid unix socket path: %s\n", unix_path);
+            listening = false;
+        } else {
+            // a file left by a previous run would make bind fail
+            if (server->unix_path != NULL) {
+                unlink(server->unix_path);
+            }
+            server->listen_sockets[acceptors] = create_master_socket(0, (struct sockaddr *)&unix_addr, unix_len,
+                                                                     backlog, false);
+            listening = listening && server->listen_sockets[acceptors] >= 0;
+        }
+    }
+
+    for (int i = 0; i < acceptors; i++) {
+        server->listen_sockets[i] = create_master_socket(IPPROTO_TCP, (struct sockaddr *)&server->address,
+                                                         server->address_len, backlog, acceptors > 1);
+        listening = listening && server->listen_sockets[i] >= 0;
+    }
+
+    server->locks = lock_manager_new();
+    server->subscriptions = subscriptions_new(push_client);
+    server->cache = response_cache_new();
 
-    if (server->listen_socket < 0) {
+    // each step undoes itself when it fails, the ones before it are undone here in reverse order
+    bool semaphore = false;
+    bool forked = false;
+    if (server->locks == NULL || server->subscriptions == NULL || server->cache == NULL || !listening
+        || !(semaphore = sem_init(&server->semaphore, 0, (unsigned) server->workers_count) == 0)
+        || !(forked = database_init(server, db_filename, db_options, rings) == 0)
+        || database_monitor(server) < 0) {
+        if (forked) {
+            database_stop(server, server->workers_count + (server->writer >= 0 ? 1 : 0));
+        }
+        if (semaphore) {
+            sem_destroy(&server->semaphore);
+        }
+        if (server->cache != NULL) {
+            response_cache_destroy(server->cache);
+        }
+        if (server->subscriptions != NULL) {
+            subscriptions_destroy(server->subscriptions);
+        }
+        if (server->locks != NULL) {
+            lock_manager_destroy(server->locks);
+        }
+        for (int i = server->listen_count - 1; i >= 0; i--) {
+            if (server->listen_sockets[i] >= 0) {
+                close(server->listen_sockets[i]);
+            }
+        }
+        if (server->unix_path != NULL) {
+            unlink(server->unix_path);
+        }
+        free(server->workers);
+        free(server->idle);
+        free(server->listen_sockets);
         free(server);
         return NULL;
     }
 
-    if (database_init(server, db_filename) < 0) {
-        free(server);
-        return NULL;
+    for (int i = 0; i < server->workers_count; i++) {
+        server->idle[i] = i;
     }
+    server->idle_count = server->workers_count;
+    pthread_mutex_init(&server->pool_mutex, NULL);
 
-    if (sem_init(&server->semaphore, 0, 1) < 0) {
-        free(server);
-        return NULL;
+    server->writer_tickets = server->writer_served = server->writer_reset = 0;
+    pthread_mutex_init(&server->writer_mutex, NULL);
+    pthread_mutex_init(&server->turn_mutex, NULL);
+    pthread_cond_init(&server->turn, NULL);
+
+    // the responses that come through a ring are never relayed
+    server->null_fd = rings ? -1 : open("/dev/null", O_WRONLY);
+    for (int i = 0; i < server->workers_count && server->null_fd >= 0; i++) {
+        if (server->workers[i].peek_in < 0) {
+            close(server->null_fd);
+            server->null_fd = -1;
+        }
+    }
+    if (server->null_fd >= 0) {
+        fcntl(server->null_fd, F_SETFD, FD_CLOEXEC);
     }
 
     return server;
 }
 
-ClientData * server_accept_connection(Server server) {
-    int client_socket = accept(server->listen_socket, 0, 0);
+ClientData * server_accept_connection(Server server, int acceptor) {
+    // a database process forked again by another thread must not keep the client open
+    int client_socket = accept4(server->listen_sockets[acceptor], 0, 0, SOCK_CLOEXEC);
 
     if (client_socket < 0) {
-        perror("accept() failed");
+        // EINVAL: the server is stopping and the socket no longer listens
+        if (errno != EINVAL) {
+            perror("accept() failed");
+        }
         return NULL;
     }
 
     ClientData * ret = malloc(sizeof(*ret));
-    if (ret != NULL) {
-        ret->client_fd = client_socket;
+    int wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (ret == NULL || wake_fd < 0) {
+        free(ret);
+        close(client_socket);
+        if (wake_fd >= 0) {
+            close(wake_fd);
+        }
+        errno = ENOMEM;
+        return NULL;
     }
-    
+
+    ret->client_fd    = client_socket;
+    ret->len          = 0;
+    ret->request_len  = 0;
+    ret->in_flight    = 0;
+    ret->wake_fd      = wake_fd;
+    ret->pushing_sent = 0;
+    buffer_init(&ret->response);
+    buffer_init(&ret->pushes);
+    buffer_init(&ret->pushing);
+    pthread_mutex_init(&ret->mutex, NULL);
+    pthread_mutex_init(&ret->push_mutex, NULL);
+    pthread_cond_init(&ret->completed, NULL);
+
     return ret;
 }
 
-int database_init(Server server, char * filename) {
+/** Maps the rings of the region for the server, the database maps them from the inherited fd */
+static int worker_rings(DatabaseWorker * worker, bool rings) {
+    worker->requests = worker->responses = NULL;
+    if (!rings) {
+        return -1;
+    }
+
+    int fd = ring_region_create();
+    if (fd >= 0 && ring_region_map(fd, &worker->requests, &worker->responses) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/** Closes both ends of the pipes of a database process that did not start */
+static void close_pipes(int db_in[2], int db_out[2]) {
+    close(db_in[0]);
+    close(db_in[1]);
+    close(db_out[0]);
+    close(db_out[1]);
+}
+
+static int database_fork(DatabaseWorker * worker, char * filename, char ** options, bool rings) {
 
     //create pipes, bytes written on db_...[1] can be read from db_...[0]
     int db_in[2];
     int db_out[2];
 
-    int r1 = pipe(db_in);
-    int r2 = pipe(db_out);
+    // no other worker may inherit them, not even one forked again by another thread at the same
+    // time: the database would never see its pipe close. dup2 clears the flag of its copies
+    int r1 = pipe2(db_in, O_CLOEXEC);
+    int r2 = pipe2(db_out, O_CLOEXEC);
 
     if (r1 < 0 || r2 < 0) {
         perror("pipe() failed");
+        if (r1 == 0) {
+            close(db_in[0]);
+            close(db_in[1]);
+        }
+        if (r2 == 0) {
+            close(db_out[0]);
+            close(db_out[1]);
+        }
+        return -1;
+    }
+
+    int region = worker_rings(worker, rings);
+    if (rings && region < 0) {
+        fprintf(stderr, "Error creating the shared memory rings\n");
+        close_pipes(db_in, db_out);
         return -1;
     }
 
+    pid_t parent = getpid();
     pid_t pid = fork();
 
     if (pid < 0) {
         fprintf(stderr, "Error starting database\n");
         perror("fork() failed");
+        close_pipes(db_in, db_out);
+        if (region >= 0) {
+            close(region);
+            ring_region_unmap(worker->requests);
+            worker->requests = worker->responses = NULL;
+        }
         return -1;
     } else if (pid == 0) {
         dup2(db_in[0], STDIN_FILENO);
@@ -135,7 +414,28 @@ int database_init(Server server, char * filename) {
         close(db_in[1]);
         close(db_out[0]);
 
-        char * argv[] = {DATABASE_PROC, filename, NULL};
+        char * argv[MAX_DATABASE_OPTIONS + 5] = {DATABASE_PROC};
+        int argc = 1;
+        while (options != NULL && options[argc - 1] != NULL && argc <= MAX_DATABASE_OPTIONS) {
+            argv[argc] = options[argc - 1];
+            argc++;
+        }
+        char region_str[16];
+        if (region >= 0) {
+            // with the rings the database no longer sees the pipes close, it goes with the server.
+            // The signal follows the thread that forked, see watch_databases
+            prctl(PR_SET_PDEATHSIG, SIGTERM);
+            if (getppid() != parent) {
+                // the server died before the prctl, the signal will never come
+                exit(EXIT_FAILURE);
+            }
+            fcntl(region, F_SETFD, 0);
+            snprintf(region_str, sizeof(region_str), "%d", region);
+            argv[argc++] = "-r";
+            argv[argc++] = region_str;
+        }
+        argv[argc++] = filename;
+        argv[argc]   = NULL;
         char * envp[] = {NULL};
 
         execve(DATABASE_PROC, argv, envp);
@@ -144,66 +444,925 @@ int database_init(Server server, char * filename) {
     } else {
         close(db_in[0]);
         close(db_out[1]);
+        if (region >= 0) {
+            close(region);
+        }
 
-        server->database_in = db_in[1];
-        server->database_out = db_out[0];
+        worker->pid   = pid;
+        worker->in    = db_in[1];
+        worker->out   = db_out[0];
+        worker->gone  = false;
+        worker->pidfd = rings ? (int) syscall(SYS_pidfd_open, pid, 0) : -1;
+        buffer_init(&worker->pending);
+        if (worker->pidfd >= 0) {
+            fcntl(worker->pidfd, F_SETFD, FD_CLOEXEC);
+        }
+
+        // without it the responses of this worker are read into the server, see hold_response
+        int peek[2];
+        if (pipe2(peek, O_CLOEXEC) < 0) {
+            worker->peek_in = worker->peek_out = -1;
+        } else {
+            worker->peek_in  = peek[1];
+            worker->peek_out = peek[0];
+        }
     }
 
     return 0;
 }
 
+int database_init(Server server, char * filename, char ** options, bool rings) {
+    int processes = server->workers_count + (server->writer >= 0 ? 1 : 0);
+
+    for (int i = 0; i < processes; i++) {
+        if (database_fork(&server->workers[i], filename, options, rings) < 0) {
+            database_stop(server, i);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/** Closes the server side of the process, the process itself is not waited for */
+static void database_release(DatabaseWorker * worker) {
+    close(worker->in);
+    close(worker->out);
+    // a worker that failed to fork again must not write to a descriptor reused by someone else
+    worker->in = worker->out = -1;
+    if (worker->requests != NULL) {
+        ring_close(worker->requests);
+        ring_region_unmap(worker->requests);
+        worker->requests = worker->responses = NULL;
+    }
+    if (worker->peek_in >= 0) {
+        close(worker->peek_in);
+        close(worker->peek_out);
+        worker->peek_in = worker->peek_out = -1;
+    }
+    if (worker->pidfd >= 0) {
+        close(worker->pidfd);
+        worker->pidfd = -1;
+    }
+    buffer_free(&worker->pending);
+}
+
+void database_stop(Server server, int count) {
+    for (int i = 0; i < count; i++) {
+        database_release(&server->workers[i]);
+        waitpid(server->workers[i].pid, NULL, 0);
+    }
+}
+
+static int database_respawn(Server server, int index) {
+    DatabaseWorker * worker = &server->workers[index];
+
+    fprintf(stderr, "Database process %d failed, starting a new one\n", (int) worker->pid);
+    // it may still be alive if only its pipe broke, whatever it was answering is lost
+    kill(worker->pid, SIGKILL);
+    waitpid(worker->pid, NULL, 0);
+    database_release(worker);
+
+    return database_fork(worker, server->filename, server->options, server->rings);
+}
+
+/**
+ * With the rings a database process that dies leaves the server waiting on a futex forever,
+ * holding its worker and the locks of the request. This thread polls the pidfd of every
+ * process and closes the rings of the one that exits: the waiting reads and writes fail and
+ * the worker is replaced. It also forks the replacements, PR_SET_PDEATHSIG follows the thread
+ * that forks and this one lives as long as the server.
+ */
+static void * watch_databases(void * arg) {
+    Server server = arg;
+    int processes = server->workers_count + (server->writer >= 0 ? 1 : 0);
+    struct pollfd * fds = calloc((size_t) processes + 1, sizeof(*fds));
+    int * indexes = calloc((size_t) processes + 1, sizeof(*indexes));
+    if (fds == NULL || indexes == NULL) {
+        fprintf(stderr, "Error watching the database processes\n");
+        exit(EXIT_FAILURE);
+    }
+
+    while (true) {
+        int count = 1;
+        fds[0].fd     = server->monitor_wake[0];
+        fds[0].events = POLLIN;
+        pthread_mutex_lock(&server->monitor_mutex);
+        for (int i = 0; i < processes; i++) {
+            if (!server->workers[i].gone && server->workers[i].pidfd >= 0) {
+                fds[count].fd     = server->workers[i].pidfd;
+                fds[count].events = POLLIN;
+                indexes[count++]  = i;
+            }
+        }
+        pthread_mutex_unlock(&server->monitor_mutex);
+
+        if (poll(fds, (nfds_t) count, -1) < 0) {
+            continue;
+        }
+
+        pthread_mutex_lock(&server->monitor_mutex);
+        for (int k = 1; k < count; k++) {
+            DatabaseWorker * worker = &server->workers[indexes[k]];
+            if (fds[k].revents != 0) {
+                worker->gone = true;
+                ring_close(worker->requests);
+                ring_close(worker->responses);
+            }
+        }
+        if (fds[0].revents != 0) {
+            char byte;
+            if (read(server->monitor_wake[0], &byte, 1) == 1 && server->respawn >= 0) {
+                server->respawn_result = database_respawn(server, server->respawn);
+                server->respawn = -1;
+                pthread_cond_broadcast(&server->respawned);
+            }
+        }
+        pthread_mutex_unlock(&server->monitor_mutex);
+    }
+
+    return NULL;
+}
+
+int server_respawn_worker(Server server, int index) {
+    if (!server->rings) {
+        return database_respawn(server, index);
+    }
+
+    // watch_databases forks it, one at a time
+    pthread_mutex_lock(&server->monitor_mutex);
+    while (server->respawn >= 0) {
+        pthread_cond_wait(&server->respawned, &server->monitor_mutex);
+    }
+    server->respawn = index;
+    int ret = write(server->monitor_wake[1], "", 1) == 1 ? 0 : -1;
+    while (ret == 0 && server->respawn == index) {
+        pthread_cond_wait(&server->respawned, &server->monitor_mutex);
+    }
+    ret = ret == 0 ? server->respawn_result : -1;
+    if (server->respawn == index) {
+        server->respawn = -1;
+    }
+    pthread_mutex_unlock(&server->monitor_mutex);
+
+    return ret;
+}
+
+static int database_monitor(Server server) {
+    server->respawn = -1;
+    pthread_mutex_init(&server->monitor_mutex, NULL);
+    pthread_cond_init(&server->respawned, NULL);
+    if (!server->rings) {
+        server->monitor_wake[0] = server->monitor_wake[1] = -1;
+        return 0;
+    }
+
+    pthread_t thread;
+    if (pipe2(server->monitor_wake, O_CLOEXEC) < 0) {
+        return -1;
+    }
+    if (pthread_create(&thread, NULL, watch_databases, server) != 0) {
+        close(server->monitor_wake[0]);
+        close(server->monitor_wake[1]);
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
+
+/** Takes an idle worker, blocks until there is one */
+static int acquire_worker(Server server) {
+    sem_wait(&server->semaphore);
+
+    pthread_mutex_lock(&server->pool_mutex);
+    int worker = server->idle[--server->idle_count];
+    pthread_mutex_unlock(&server->pool_mutex);
+
+    return worker;
+}
+
+static void release_worker(Server server, int worker) {
+    pthread_mutex_lock(&server->pool_mutex);
+    server->idle[server->idle_count++] = worker;
+    pthread_mutex_unlock(&server->pool_mutex);
+
+    sem_post(&server->semaphore);
+}
+
+static int write_request(DatabaseWorker * worker, const char * request, size_t len) {
+    if (worker->requests != NULL) {
+        return ring_write(worker->requests, request, len) ? 0 : -1;
+    }
+
+    size_t written = 0;
+
+    while (written < len) {
+        ssize_t n = write(worker->in, request + written, len - written);
+        if (n <= 0) {
+            return -1;
+        }
+        written += (size_t) n;
+    }
+
+    return 0;
+}
+
+/** Reads what the worker already answered, from its ring or its pipe */
+static ssize_t read_worker(DatabaseWorker * worker, char * buffer, size_t size) {
+    if (worker->responses != NULL) {
+        return (ssize_t) ring_read(worker->responses, buffer, size);
+    }
+    return read(worker->out, buffer, size);
+}
+
+/** Reads one whole response, whatever comes after it is kept for the next one */
+static int read_response(DatabaseWorker * worker, Buffer * response) {
+    char buffer[BUFFER_SIZE];
+    Buffer * pending = &worker->pending;
+
+    MessageScanner scanner;
+    message_scanner_init(&scanner);
+    bool done = false;
+    while (true) {
+        if (pending->len > 0) {
+            size_t len = message_scan(&scanner, pending->data, pending->len, &done);
+            if (buffer_append(response, pending->data, len) < 0) {
+                return -1;
+            }
+            buffer_consume(pending, len);
+            if (done) {
+                return 0;
+            }
+        }
+
+        ssize_t n = read_worker(worker, buffer, BUFFER_SIZE);
+        if (n <= 0 || buffer_append(pending, buffer, (size_t) n) < 0) {
+            return -1;
+        }
+    }
+}
+
+/** Writes the request to the worker and reads the whole response */
+static int database_round_trip(DatabaseWorker * worker, const char * request, size_t len, Buffer * response) {
+    if (write_request(worker, request, len) < 0) {
+        return -1;
+    }
+    return read_response(worker, response);
+}
+
+/** Pipelines the request to the writer, its response is read in the turn of the ticket */
+static int writer_send(Server server, const char * request, size_t len, unsigned long * ticket) {
+    pthread_mutex_lock(&server->writer_mutex);
+    int ret = write_request(&server->workers[server->writer], request, len);
+    *ticket = server->writer_tickets++;
+    pthread_mutex_unlock(&server->writer_mutex);
+
+    return ret;
+}
+
+/** Waits for the responses of the previous tickets and reads this one, the turn lasts until writer_next */
+static int writer_receive(Server server, unsigned long ticket, int sent, Buffer * response) {
+    pthread_mutex_lock(&server->turn_mutex);
+    while (server->writer_served != ticket) {
+        pthread_cond_wait(&server->turn, &server->turn_mutex);
+    }
+    pthread_mutex_unlock(&server->turn_mutex);
+
+    // a request written before the writer died has no response, only the first one replaces it
+    bool lost = ticket < server->writer_reset;
+    int ret = sent;
+    if (ret == 0 && !lost) {
+        ret = read_response(&server->workers[server->writer], response);
+    }
+    if (ret < 0 && !lost) {
+        pthread_mutex_lock(&server->writer_mutex);
+        server_respawn_worker(server, server->writer);
+        server->writer_reset = server->writer_tickets;
+        pthread_mutex_unlock(&server->writer_mutex);
+    }
+    return lost ? -1 : ret;
+}
+
+static void writer_next(Server server) {
+    pthread_mutex_lock(&server->turn_mutex);
+    server->writer_served++;
+    pthread_cond_broadcast(&server->turn);
+    pthread_mutex_unlock(&server->turn_mutex);
+}
+
+/** Runs the request in an idle worker */
+static int database_query(Server server, const char * request, size_t len, Buffer * response) {
+    int worker = acquire_worker(server);
+    int ret = database_round_trip(&server->workers[worker], request, len, response);
+    if (ret < 0) {
+        server_respawn_worker(server, worker);
+    }
+    release_worker(server, worker);
+
+    return ret;
+}
+
+/** Sends the whole message, the caller holds the mutex of the connection */
+static ssize_t send_message(int client_fd, const char * message, size_t len) {
+    size_t sent = 0;
+
+    while (sent < len) {
+        ssize_t n = send(client_fd, message + sent, len - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return n;
+        }
+        sent += (size_t) n;
+    }
+
+    return (ssize_t) sent;
+}
+
+/**
+ * Sends the pushes taken from the queue, and with `all` the ones queued since, without blocking.
+ * Without `all` it blocks until the one the socket may be in the middle of is out. The caller
+ * holds the mutex of the connection. Returns 1 if some are left, -1 if the client went away.
+ */
+static int send_pushes(ClientData * data, bool all) {
+    while (true) {
+        if (data->pushing_sent == data->pushing.len) {
+            buffer_clear(&data->pushing);
+            data->pushing_sent = 0;
+            if (!all) {
+                return 0;
+            }
+            pthread_mutex_lock(&data->push_mutex);
+            Buffer aux    = data->pushing;
+            data->pushing = data->pushes;
+            data->pushes  = aux;
+            pthread_mutex_unlock(&data->push_mutex);
+            if (data->pushing.len == 0) {
+                return 0;
+            }
+        }
+
+        ssize_t n = send(data->client_fd, data->pushing.data + data->pushing_sent,
+                         data->pushing.len - data->pushing_sent, MSG_NOSIGNAL | (all ? MSG_DONTWAIT : 0));
+        if (n < 0 && all && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 1;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        data->pushing_sent += (size_t) n;
+    }
+}
+
+/**
+ * Waits for bytes from the client. Meanwhile the changes pushed to the connection are sent
+ * as far as the socket takes them, a client that stops reading never blocks anyone else.
+ */
+static ssize_t receive(ClientData * data, char * buffer, size_t size) {
+    bool pending = false;
+
+    while (true) {
+        struct pollfd fds[2] = {
+                {.fd = data->client_fd, .events = (short) (POLLIN | (pending ? POLLOUT : 0))},
+                {.fd = data->wake_fd,   .events = POLLIN},
+        };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            uint64_t count;
+            if (read(data->wake_fd, &count, sizeof(count)) < 0) {
+                // EAGAIN, another wake-up already emptied it
+            }
+        }
+        if ((fds[1].revents & POLLIN) || (fds[0].revents & POLLOUT)) {
+            pthread_mutex_lock(&data->mutex);
+            int ret = send_pushes(data, true);
+            pthread_mutex_unlock(&data->mutex);
+            if (ret < 0) {
+                return -1;
+            }
+            pending = ret > 0;
+        }
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            return recv(data->client_fd, buffer, size, 0);
+        }
+    }
+}
+
 ssize_t server_read_request(Server server, ClientData * data) {
-    int client_fd = data->client_fd;
     char * buffer = data->buffer;
     ssize_t n;
 
-    bzero(buffer, BUFFER_SIZE);
-    n = recv(client_fd, buffer, BUFFER_SIZE, 0);
-    if (n > 0) {
-        sem_wait(&server->semaphore);
-        n = write(server->database_in, buffer, strlen(buffer));
+    // the previous request was answered, the next one may already be buffered
+    memmove(buffer, buffer + data->request_len, data->len - data->request_len);
+    data->len -= data->request_len;
+    data->request_len = 0;
+
+    MessageScanner scanner;
+    message_scanner_init(&scanner);
+    bool done = false;
+
+    size_t scanned = message_scan(&scanner, buffer, data->len, &done);
+    while (!done) {
+        if (data->len == BUFFER_SIZE) {
+            // a request never takes a whole buffer
+            return -1;
+        }
+        n = receive(data, buffer + data->len, BUFFER_SIZE - data->len);
+        if (n <= 0) {
+            return n;
+        }
+        scanned += message_scan(&scanner, buffer + data->len, (size_t) n, &done);
+        data->len += (size_t) n;
     }
+    data->request_len = scanned;
+
+    return (ssize_t) data->request_len;
+}
 
-    //printf("request: %s", buffer);
+/** The responses of a connection and the changes pushed to it never interleave */
+static ssize_t send_response(ClientData * data, const Buffer * response) {
+    pthread_mutex_lock(&data->mutex);
+    ssize_t ret = send_pushes(data, false) < 0 ? -1 : send_message(data->client_fd, response->data, response->len);
+    pthread_mutex_unlock(&data->mutex);
 
-    return n;
+    return ret;
 }
 
-bool check_response_end(char * buffer) {
-    size_t size = strlen(buffer);
-    return size >= 3 && strcmp(&buffer[size - 3], "\n.\n") == 0;
+/** Queues the message for the connection thread, it wakes up and sends it without blocking */
+static bool push_client(void * subscriber, const char * message, size_t len) {
+    ClientData * data = subscriber;
+    uint64_t one = 1;
+
+    pthread_mutex_lock(&data->push_mutex);
+    bool queued = data->pushes.len + len <= MAX_PUSH_BACKLOG && buffer_append(&data->pushes, message, len) == 0;
+    pthread_mutex_unlock(&data->push_mutex);
+
+    if (!queued) {
+        // the client fell behind, it would miss changes: its connection thread closes it
+        shutdown(data->client_fd, SHUT_RDWR);
+        return false;
+    }
+    if (write(data->wake_fd, &one, sizeof(one)) < 0) {
+        // the counter is already far from zero, the thread is awake anyway
+    }
+    return true;
 }
 
-ssize_t server_send_response(Server server, ClientData * data) {
-    int client_fd = data->client_fd;
-    char * buffer = data->buffer;
-    ssize_t n;
+static bool goes_to_writer(Server server, int type) {
+    return server->writer >= 0 && (is_write_request(type) || type == SUBSCRIBE_SEATS);
+}
+
+/**
+ * What is done with the response before another request of the same locks gets its own: the
+ * changes are queued to the subscriptions and the cached listings updated, or the map of a
+ * SUBSCRIBE_SEATS is queued to `subscriber` and the connection subscribed. Nothing is sent.
+ * Returns 1 if the connection was subscribed, 0 if not and -1 on error.
+ */
+static int settle_response(Server server, ClientData * subscriber, const char * request, size_t len,
+                           const Buffer * response, unsigned long generation) {
+    if (subscriber == NULL) {
+        subscriptions_publish(server->subscriptions, request, len, response->data, response->len);
+        response_cache_invalidate(server->cache, request, len);
+        response_cache_store(server->cache, request, len, response->data, response->len, generation);
+        return 0;
+    }
+    if (parse_request_type(response->data, response->len) != RESPONSE_OK) {
+        return 0;
+    }
+    return push_client(subscriber, response->data, response->len)
+           && subscriptions_add(server->subscriptions, request, len, subscriber) == 0 ? 1 : -1;
+}
+
+/**
+ * Runs the request with its locks and settles its response. The writer applies the requests in
+ * the order they reach its pipe, so they hold the locks only until then and are settled in their
+ * turn: the writes of a showcase share a commit and their changes still go out in commit order.
+ */
+static int locked_query(Server server, ClientData * subscriber, const char * request, size_t len,
+                        Buffer * response, unsigned long generation) {
+    LockKeys keys;
+    lock_keys_from_request(request, len, &keys);
+
+    lock_manager_acquire(server->locks, &keys);
 
-    bool done;
-    //printf("response: ");
-    do {
-        bzero(buffer, BUFFER_SIZE);
-        n = read(server->database_out, buffer, BUFFER_SIZE);
-        //printf("%s", buffer);
-        done = check_response_end(buffer);
-        if (n > 0) { 
-            n = send(client_fd, buffer, strlen(buffer), MSG_NOSIGNAL);
+    int ret;
+    if (goes_to_writer(server, parse_request_type(request, len))) {
+        unsigned long ticket;
+        int sent = writer_send(server, request, len, &ticket);
+        lock_manager_release(server->locks, &keys);
+
+        ret = writer_receive(server, ticket, sent, response);
+        if (ret == 0) {
+            ret = settle_response(server, subscriber, request, len, response, generation);
         }
-    } while(n > 0 && !done);
+        writer_next(server);
+        return ret;
+    }
 
-    sem_post(&server->semaphore);
-    return n;
+    ret = database_query(server, request, len, response);
+    if (ret == 0) {
+        ret = settle_response(server, subscriber, request, len, response, generation);
+    }
+
+    lock_manager_release(server->locks, &keys);
+
+    return ret;
+}
+
+int server_query(Server server, const char * request, size_t len, Buffer * response) {
+    unsigned long generation;
+    if (response_cache_lookup(server->cache, request, len, response, &generation)) {
+        return 0;
+    }
+    return locked_query(server, NULL, request, len, response, generation) < 0 ? -1 : 0;
+}
+
+/**
+ * SUBSCRIBE_SEATS: the seat map is queued like a push and the connection subscribed before another
+ * change of its showcase is settled, so every later change is sent after the map and none is missed.
+ * Nothing is sent with the showcase locked.
+ */
+static ssize_t subscribe(Server server, ClientData * data, const char * request, size_t len, Buffer * response) {
+    int ret = locked_query(server, data, request, len, response, 0);
+    if (ret < 0) {
+        return -1;
+    }
+    return ret == 1 ? (ssize_t) response->len : send_response(data, response);
+}
+
+/** Drops skip bytes of the peek pipe of the worker and reads the len bytes that follow */
+static int peek_response(Server server, DatabaseWorker * worker, size_t skip, char * out, size_t len) {
+    while (skip > 0) {
+        ssize_t n = splice(worker->peek_out, NULL, server->null_fd, NULL, skip, 0);
+        if (n <= 0) {
+            return -1;
+        }
+        skip -= (size_t) n;
+    }
+    while (len > 0) {
+        ssize_t n = read(worker->peek_out, out, len);
+        if (n <= 0) {
+            return -1;
+        }
+        out += n;
+        len -= (size_t) n;
+    }
+
+    return 0;
+}
+
+/** Keeps the last bytes of a relayed text response, its terminator shows up there */
+static void push_tail(char * tail, const char * bytes, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        tail[0] = tail[1];
+        tail[1] = tail[2];
+        tail[2] = bytes[i];
+    }
+}
+
+/**
+ * Moves the response of the worker into the hold pipe with splice, so its bytes never reach the
+ * server. Each chunk is tee'd into the peek pipe first and of that copy only the frame header or
+ * the last bytes of a text response are read: a pool worker answers one request at a time, so
+ * whatever it wrote belongs to this response. The splice never blocks, once the hold pipe is full
+ * the rest is read into overflow. Returns -1 if the worker failed, the worker is then out of sync.
+ */
+static int hold_response(Server server, DatabaseWorker * worker, int hold, Buffer * overflow) {
+    char header[FRAME_HEADER];
+    char tail[3] = {0, 0, 0};
+    size_t header_len = 0, total = 0, relayed = 0;
+    bool frame = false, done = false;
+
+    while (!done) {
+        ssize_t n = tee(worker->out, worker->peek_in, INT_MAX, 0);
+        if (n <= 0) {
+            return -1;
+        }
+        size_t chunk = (size_t) n, front = 0;
+
+        // the first byte tells the format, a frame needs its whole header to know its length
+        if (header_len == 0 || (frame && header_len < FRAME_HEADER)) {
+            front = chunk < FRAME_HEADER - header_len ? chunk : FRAME_HEADER - header_len;
+            if (peek_response(server, worker, 0, header + header_len, front) < 0) {
+                return -1;
+            }
+            frame = is_frame(header, header_len + front);
+            push_tail(tail, header + header_len, front);
+            header_len += front;
+            if (frame && header_len == FRAME_HEADER) {
+                total = frame_size(header);
+            }
+        }
+
+        size_t rest = chunk - front;
+        size_t last = frame ? 0 : rest < sizeof(tail) ? rest : sizeof(tail);
+        char bytes[sizeof(tail)];
+        if (peek_response(server, worker, rest - last, bytes, last) < 0) {
+            return -1;
+        }
+        push_tail(tail, bytes, last);
+
+        if (total > 0 && chunk > total - relayed) {
+            chunk = total - relayed;
+        }
+        relayed += chunk;
+        done = frame ? relayed == total : memcmp(tail, "\n.\n", sizeof(tail)) == 0;
+
+        while (chunk > 0 && overflow->len == 0) {
+            n = splice(worker->out, NULL, hold, NULL, chunk, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n > 0) {
+                chunk -= (size_t) n;
+            } else if (n < 0 && errno == EAGAIN) {
+                break;
+            } else {
+                return -1;
+            }
+        }
+        // the hold pipe is full, what is left of the chunk goes to memory and so does the rest
+        while (chunk > 0) {
+            char buffer[BUFFER_SIZE];
+            n = read(worker->out, buffer, chunk < sizeof(buffer) ? chunk : sizeof(buffer));
+            if (n <= 0 || buffer_append(overflow, buffer, (size_t) n) < 0) {
+                return -1;
+            }
+            chunk -= (size_t) n;
+        }
+    }
+
+    return 0;
+}
+
+/** Sends what hold_response kept, the caller holds the mutex of the connection */
+static ssize_t send_held(int client_fd, int hold, size_t held, const Buffer * overflow) {
+    size_t sent = 0;
+
+    while (sent < held) {
+        ssize_t n = splice(hold, NULL, client_fd, NULL, held - sent, SPLICE_F_MOVE | (overflow->len > 0 ? SPLICE_F_MORE : 0));
+        if (n <= 0) {
+            return -1;
+        }
+        sent += (size_t) n;
+    }
+    if (send_message(client_fd, overflow->data, overflow->len) < 0) {
+        return -1;
+    }
+
+    return (ssize_t) (held + overflow->len);
+}
+
+/**
+ * GET_BOOKING and GET_CANCELLED, the listings that grow without bound, go from the worker to the
+ * socket through the kernel. The worker is released as soon as the whole response is held, in a
+ * pipe of the request and in memory what does not fit, so a slow client never holds a worker.
+ */
+static ssize_t relay_query(Server server, ClientData * data, const char * request, size_t len) {
+    int hold[2];
+    if (pipe2(hold, O_CLOEXEC) < 0) {
+        return -1;
+    }
+    // the kernel caps it at fs.pipe-max-size, the default size is kept if it refuses
+    fcntl(hold[1], F_SETPIPE_SZ, RELAY_PIPE_SIZE);
+
+    Buffer overflow;
+    buffer_init(&overflow);
+
+    int worker = acquire_worker(server);
+    DatabaseWorker * relay = &server->workers[worker];
+    int held = -1;
+    if (write_request(relay, request, len) < 0 || hold_response(server, relay, hold[1], &overflow) < 0) {
+        server_respawn_worker(server, worker);
+    } else if (ioctl(hold[0], FIONREAD, &held) < 0) {
+        held = -1;
+    }
+    release_worker(server, worker);
+
+    ssize_t ret = -1;
+    if (held >= 0) {
+        pthread_mutex_lock(&data->mutex);
+        ret = send_held(data->client_fd, hold[0], (size_t) held, &overflow);
+        pthread_mutex_unlock(&data->mutex);
+    }
+    close(hold[0]);
+    close(hold[1]);
+    buffer_free(&overflow);
+
+    return ret;
+}
+
+/** Listings go through the kernel when every worker has its peek pipe */
+static bool can_relay(Server server, int type) {
+    return server->null_fd >= 0 && (type == GET_BOOKING || type == GET_CANCELLED);
+}
+
+/** Runs the request and sends its response */
+static ssize_t answer(Server server, ClientData * data, const char * request, size_t len, Buffer * response) {
+    int type = parse_request_type(request, len);
+    if (type == SUBSCRIBE_SEATS) {
+        return subscribe(server, data, request, len, response);
+    }
+    if (type == CACHE_STATS) {
+        response_cache_stats(server->cache, request, len, response);
+        return send_response(data, response);
+    }
+    if (can_relay(server, type)) {
+        return relay_query(server, data, request, len);
+    }
+
+    // la base de datos se libera antes de enviar, un cliente lento no bloquea a los demas
+    if (server_query(server, request, len, response) < 0) {
+        return -1;
+    }
+    return send_response(data, response);
+}
+
+/** Request with an id, answered by its own thread */
+typedef struct {
+    Server server;
+    ClientData * data;
+    size_t len;
+    char request[BUFFER_SIZE];
+} Task;
+
+static void * run_task(void * arg) {
+    Task * task = arg;
+    ClientData * data = task->data;
+    Buffer response;
+
+    buffer_init(&response);
+    if (answer(task->server, data, task->request, task->len, &response) < 0) {
+        // the connection thread sees the client go away and closes it
+        shutdown(data->client_fd, SHUT_RDWR);
+    }
+
+    pthread_mutex_lock(&data->mutex);
+    data->in_flight--;
+    pthread_cond_broadcast(&data->completed);
+    pthread_mutex_unlock(&data->mutex);
+
+    buffer_free(&response);
+    free(task);
+    return NULL;
+}
+
+/** Blocks until at most `max` requests with an id are running */
+static void wait_in_flight(ClientData * data, int max) {
+    pthread_mutex_lock(&data->mutex);
+    while (data->in_flight > max) {
+        pthread_cond_wait(&data->completed, &data->mutex);
+    }
+    pthread_mutex_unlock(&data->mutex);
+}
+
+/** Starts the request in its own thread, returns -1 if it could not */
+static int start_task(Server server, ClientData * data) {
+    Task * task = malloc(sizeof(*task));
+    if (task == NULL) {
+        return -1;
+    }
+    task->server = server;
+    task->data   = data;
+    task->len    = data->request_len;
+    memcpy(task->request, data->buffer, data->request_len);
+
+    wait_in_flight(data, MAX_IN_FLIGHT - 1);
+    pthread_mutex_lock(&data->mutex);
+    data->in_flight++;
+    pthread_mutex_unlock(&data->mutex);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, run_task, task) != 0) {
+        pthread_mutex_lock(&data->mutex);
+        data->in_flight--;
+        pthread_mutex_unlock(&data->mutex);
+        free(task);
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
+
+ssize_t server_send_response(Server server, ClientData * data) {
+    Buffer * response = &data->response;
+    uint32_t id;
+
+    if (parse_message_id(data->buffer, data->request_len, &id)) {
+        return start_task(server, data) < 0 ? -1 : (ssize_t) data->request_len;
+    }
+
+    // sin id se responde en orden, despues de los pedidos que siguen corriendo
+    wait_in_flight(data, 0);
+
+    buffer_clear(response);
+    ssize_t ret = answer(server, data, data->buffer, data->request_len, response);
+    if (ret < 0) {
+        shutdown(data->client_fd, SHUT_RDWR);
+    }
+    return ret;
+}
+
+LockManager server_locks(Server server) {
+    return server->locks;
+}
+
+ResponseCache server_cache(Server server) {
+    return server->cache;
+}
+
+int server_listen_socket(Server server, int acceptor) {
+    return server->listen_sockets[acceptor];
+}
+
+int server_acceptors(Server server) {
+    return server->listen_count;
+}
+
+int server_workers(Server server) {
+    return server->workers_count;
+}
+
+int server_writer(Server server) {
+    return server->writer;
+}
+
+int server_database_in(Server server, int worker) {
+    return server->workers[worker].in;
+}
+
+int server_database_out(Server server, int worker) {
+    return server->workers[worker].out;
 }
 
 void server_close_connection(Server server, ClientData * data) {
+    wait_in_flight(data, 0);
+    subscriptions_remove(server->subscriptions, data);
     close(data->client_fd);
+    close(data->wake_fd);
+    pthread_mutex_destroy(&data->mutex);
+    pthread_mutex_destroy(&data->push_mutex);
+    pthread_cond_destroy(&data->completed);
+    buffer_free(&data->response);
+    buffer_free(&data->pushes);
+    buffer_free(&data->pushing);
     free(data);
 }
 
+/**
+ * Async-signal-safe: every database process is terminated and waited for, then the signal
+ * kills the server as it would have. The listening sockets stop listening just before, the
+ * pending accepts of io_uring would keep them open until the kernel tears the ring down.
+ */
+static void stop_server(int sig) {
+    int processes = running->workers_count + (running->writer >= 0 ? 1 : 0);
+    for (int i = 0; i < processes; i++) {
+        kill(running->workers[i].pid, SIGTERM);
+    }
+    for (int i = 0; i < processes; i++) {
+        waitpid(running->workers[i].pid, NULL, 0);
+    }
+    for (int i = 0; i < running->listen_count; i++) {
+        shutdown(running->listen_sockets[i], SHUT_RDWR);
+    }
+    // server_close is never reached, the next run would find the file of the Unix domain socket
+    if (running->unix_path != NULL) {
+        unlink(running->unix_path);
+    }
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+void server_handle_signals(Server server) {
+    running = server;
+    signal(SIGTERM, stop_server);
+    signal(SIGINT, stop_server);
+    // a database process that died shows up as a failed write, not as a dead server
+    signal(SIGPIPE, SIG_IGN);
+}
+
 void server_close(Server server) {
-    close(server->listen_socket);
-    close(server->database_in);
-    close(server->database_out);
+    for (int i = 0; i < server->listen_count; i++) {
+        close(server->listen_sockets[i]);
+    }
+    if (server->unix_path != NULL) {
+        unlink(server->unix_path);
+    }
+    database_stop(server, server->workers_count + (server->writer >= 0 ? 1 : 0));
+    if (server->null_fd >= 0) {
+        close(server->null_fd);
+    }
     sem_destroy(&server->semaphore);
+    pthread_mutex_destroy(&server->pool_mutex);
+    pthread_mutex_destroy(&server->writer_mutex);
+    pthread_mutex_destroy(&server->turn_mutex);
+    pthread_cond_destroy(&server->turn);
+    lock_manager_destroy(server->locks);
+    subscriptions_destroy(server->subscriptions);
+    response_cache_destroy(server->cache);
+    free(server->workers);
+    free(server->idle);
+    free(server->listen_sockets);
     free(server);
-}
\ No newline at end of file
+}
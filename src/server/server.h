@@ -1,33 +1,144 @@
 #ifndef TPE_FINAL_SO_SERVER_H
 #define TPE_FINAL_SO_SERVER_H
 
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/socket.h>
 #include "sys/types.h"
+#include "buffer.h"
+#include "lock_manager.h"
+#include "response_cache.h"
 
 #define BUFFER_SIZE  4096
 #define DEFAULT_PORT 12345
+/** connections each listening socket queues before they are accepted, the kernel caps it at net.core.somaxconn */
+#define DEFAULT_BACKLOG SOMAXCONN
 #define DEFAULT_DATABASE_FILENAME "cinema.db"
+/** flag and value of every option forwarded to the database processes */
+#define MAX_DATABASE_OPTIONS 10
+/** requests with an id (protocol.h) a connection may have in the database at once */
+#define MAX_IN_FLIGHT 16
+/** bytes waiting to be sent to a subscribed connection, responses included, past which a push drops it */
+#define MAX_PUSH_BACKLOG (1024 * 1024)
 
 typedef struct server * Server;
 
 /** Data associated with a client */
 typedef struct {
     int client_fd;
+    /** current request, followed by whatever the client already pipelined after it */
     char buffer[BUFFER_SIZE];
+    size_t len;
+    /** length of the current request at the beginning of buffer */
+    size_t request_len;
+    /** whole database response, sent once the database is released */
+    Buffer response;
+    /** requests with an id still running, each one answers as soon as it completes */
+    int in_flight;
+    /** guards in_flight and is held while sending, so responses and pushed changes never interleave */
+    pthread_mutex_t mutex;
+    /** signaled every time a request with an id completes */
+    pthread_cond_t completed;
+
+    /** SEATS_CHANGED queued for the connection, in commit order. Guarded by push_mutex, never held while sending */
+    Buffer pushes;
+    pthread_mutex_t push_mutex;
+    /** eventfd that wakes the connection thread to send the pushes */
+    int wake_fd;
+    /** pushes taken from the queue and not completely sent yet, guarded by mutex */
+    Buffer pushing;
+    size_t pushing_sent;
 } ClientData;
 
-/** Setup and initialization of a TCP server in the specified port */
-Server server_init(int port, char * db_filename);
+/**
+ * Setup and initialization of a TCP server in the specified port.
+ * Forks `workers` database processes, if it is not positive one per core is used.
+ * `db_options` is a NULL terminated list of arguments passed to every database process
+ * before the file name, at most MAX_DATABASE_OPTIONS.
+ * If `writer` is true one more process receives every write request, pipelined without
+ * waiting for the previous response, so it can group them in a single commit.
+ * If `rings` is true requests and responses go through shared memory rings (ring.h)
+ * instead of the pipes, only the threads mode uses them.
+ * `acceptors` sockets listen on the port, each with a queue of `backlog` connections. With
+ * more than one they use SO_REUSEPORT and the kernel spreads the new connections among them.
+ * If `unix_path` is not NULL one more socket listens on that Unix domain path, or in the abstract
+ * namespace if it starts with '@', for front-ends running on the same host.
+ */
+Server server_init(int port, char * db_filename, char ** db_options, int workers, bool writer, bool rings,
+                   int backlog, int acceptors, const char * unix_path);
 
-/** Waits for incoming connections and returns a pointer to a new client structure */
-ClientData * server_accept_connection(Server server);
+/**
+ * Waits for incoming connections on the listening socket and returns a pointer to a new client structure.
+ * Returns NULL on error, with errno EINVAL once the socket was shut down to stop the server.
+ */
+ClientData * server_accept_connection(Server server, int acceptor);
 
+/**
+ * Reads a whole request from the client. Clients may pipeline requests back to back,
+ * the bytes after the current one are kept for the next call. Meanwhile the changes pushed
+ * to the connection are sent, without blocking.
+ */
 ssize_t server_read_request(Server server, ClientData * data);
 
+/**
+ * Runs the request in the database and sends the response to the client.
+ * A request with an id runs in its own thread and this returns right away, up to
+ * MAX_IN_FLIGHT at once. A request without one waits for them and answers in order.
+ * A SUBSCRIBE_SEATS that succeeds subscribes the connection until it is closed.
+ * If the request could not be answered, for example because its database process died,
+ * the connection is shut down: the client cannot tell whether a write was applied.
+ */
 ssize_t server_send_response(Server server, ClientData * data);
 
-/** Closes connection with client */
+/**
+ * Database round-trip of a serialized request: takes the locks of the request and an idle
+ * worker, reads the whole response and releases both. The seats changed by a write are pushed
+ * to the connections subscribed to their showcase before the locks are released. A write for
+ * the writer releases them once it is in the pipe and is pushed in its turn, in commit order.
+ * Listings in the response cache are answered without the database. Returns -1 on error.
+ */
+int server_query(Server server, const char * request, size_t len, Buffer * response);
+
+/** Locks shared by every server mode */
+LockManager server_locks(Server server);
+
+/** Cache of listings shared by every server mode */
+ResponseCache server_cache(Server server);
+
+/** Listening socket of an acceptor, used by the event driven server modes */
+int server_listen_socket(Server server, int acceptor);
+
+/** Number of listening sockets, TCP and Unix domain */
+int server_acceptors(Server server);
+
+/** Number of database worker processes, not counting the writer */
+int server_workers(Server server);
+
+/** Index of the writer process for server_database_in/out, -1 if writes go to any worker */
+int server_writer(Server server);
+
+/** Pipe used to write requests to a database worker */
+int server_database_in(Server server, int worker);
+
+/** Pipe used to read responses from a database worker */
+int server_database_out(Server server, int worker);
+
+/** Closes connection with client, once the requests still running are answered */
 void server_close_connection(Server server, ClientData * data);
 
+/**
+ * Replaces a database process that died or broke its pipe, what it was answering is lost.
+ * server_database_in/out return the pipes of the new process. Returns -1 if it could not be started.
+ */
+int server_respawn_worker(Server server, int worker);
+
+/**
+ * SIGTERM and SIGINT stop the server in every mode: the listening sockets stop accepting, the
+ * file of the Unix domain socket is removed and the database processes are terminated and
+ * waited for. SIGPIPE is ignored.
+ */
+void server_handle_signals(Server server);
+
 /** Closes the server and frees resources */
 void server_close(Server server);
 
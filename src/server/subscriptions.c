@@ -0,0 +1,270 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "subscriptions.h"
+#include "../frame.h"
+
+#define BUCKETS         64
+/** status, showcase and per write of a BATCH a seat and its state, or every seat if it removes the showcase */
+#define MESSAGE_SIZE    (4 * ARG_SIZE + MAX_BATCH_REQUESTS * SEATS * 8)
+/** seat of the change of a REMOVE_SHOWCASE, its bookings were deleted and every seat is free */
+#define ALL_SEATS       (-1)
+
+typedef struct subscription {
+    void * subscriber;
+    /** the changes are pushed as binary messages */
+    bool binary;
+    char movie[ARG_SIZE];
+    int day;
+    int room;
+    struct subscription * next;
+} Subscription;
+
+struct subscriptions {
+    pthread_mutex_t mutex;
+    subscription_push push;
+    /** by day and room, a room on a day hosts at most one showcase */
+    Subscription * buckets[BUCKETS];
+    /** binary SEATS_CHANGED, the buffer is reused by every publish */
+    FrameWriter frame;
+};
+
+/** A seat changed by a write */
+typedef struct {
+    char movie[ARG_SIZE];
+    int day;
+    int room;
+    int seat;
+    int state;
+} SeatChange;
+
+Subscriptions subscriptions_new(subscription_push push) {
+    struct subscriptions * ret = calloc(1, sizeof(*ret));
+
+    if (ret == NULL) {
+        return NULL;
+    }
+
+    ret->push = push;
+    frame_writer_init(&ret->frame, SEATS_CHANGED);
+    pthread_mutex_init(&ret->mutex, NULL);
+
+    return ret;
+}
+
+static unsigned bucket(int day, int room) {
+    return ((unsigned) day * 31 + (unsigned) room) % BUCKETS;
+}
+
+/** Reads the line as an int, false if it does not exist */
+static bool int_line(const char * request, size_t len, int index, int * value) {
+    char line[ARG_SIZE];
+
+    if (!request_line(request, len, index, line, sizeof(line))) {
+        return false;
+    }
+    *value = atoi(line);
+    return true;
+}
+
+int subscriptions_add(Subscriptions subscriptions, const char * request, size_t len, void * subscriber) {
+    Subscription * subscription = malloc(sizeof(*subscription));
+
+    if (subscription == NULL) {
+        return -1;
+    }
+
+    subscription->subscriber = subscriber;
+    subscription->binary     = is_frame(request, len);
+    if (!request_line(request, len, 1, subscription->movie, sizeof(subscription->movie))
+        || !int_line(request, len, 2, &subscription->day) || !int_line(request, len, 3, &subscription->room)) {
+        // the database already validated the request
+        free(subscription);
+        return -1;
+    }
+
+    pthread_mutex_lock(&subscriptions->mutex);
+    Subscription ** head = &subscriptions->buckets[bucket(subscription->day, subscription->room)];
+    for (Subscription * aux = *head; aux != NULL; aux = aux->next) {
+        if (aux->subscriber == subscriber && aux->day == subscription->day && aux->room == subscription->room
+            && strcmp(aux->movie, subscription->movie) == 0) {
+            // subscribing twice keeps a single subscription, in the last format
+            aux->binary = subscription->binary;
+            free(subscription);
+            subscription = NULL;
+            break;
+        }
+    }
+    if (subscription != NULL) {
+        subscription->next = *head;
+        *head = subscription;
+    }
+    pthread_mutex_unlock(&subscriptions->mutex);
+
+    return 0;
+}
+
+void subscriptions_remove(Subscriptions subscriptions, void * subscriber) {
+    pthread_mutex_lock(&subscriptions->mutex);
+    for (int i = 0; i < BUCKETS; i++) {
+        Subscription ** node = &subscriptions->buckets[i];
+        while (*node != NULL) {
+            if ((*node)->subscriber == subscriber) {
+                Subscription * aux = *node;
+                *node = aux->next;
+                free(aux);
+            } else {
+                node = &(*node)->next;
+            }
+        }
+    }
+    pthread_mutex_unlock(&subscriptions->mutex);
+}
+
+/** Seat changed by the write whose type is at line `base`, returns false if the write changes none */
+static bool write_change(const char * request, size_t len, int type, int base, SeatChange * change) {
+    if (type == REMOVE_SHOWCASE) {
+        // the subscriptions stay, the map of a showcase added again starts empty too
+        change->seat  = ALL_SEATS;
+        change->state = EMPTY_SEAT;
+        return request_line(request, len, base + 1, change->movie, sizeof(change->movie))
+               && int_line(request, len, base + 2, &change->day)
+               && int_line(request, len, base + 3, &change->room);
+    }
+    if (type != ADD_BOOKING && type != REMOVE_BOOKING) {
+        return false;
+    }
+
+    change->state = type == ADD_BOOKING ? RESERVED_SEAT : EMPTY_SEAT;
+    return request_line(request, len, base + 2, change->movie, sizeof(change->movie))
+           && int_line(request, len, base + 3, &change->day)
+           && int_line(request, len, base + 4, &change->room)
+           && int_line(request, len, base + 5, &change->seat);
+}
+
+/** Seats changed by the request, in the order they were written */
+static int request_changes(const char * request, size_t len, SeatChange * changes) {
+    int type = parse_request_type(request, len);
+    if (type != BATCH) {
+        return write_change(request, len, type, 0, &changes[0]) ? 1 : 0;
+    }
+
+    int count = 0;
+    for (int base = 0, writes = 0; writes < MAX_BATCH_REQUESTS && batch_next_write(request, len, &base, &type); writes++) {
+        if (write_change(request, len, type, base, &changes[count])) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static bool same_showcase(const SeatChange * change, const char * movie, int day, int room) {
+    return change->day == day && change->room == room && strcmp(change->movie, movie) == 0;
+}
+
+/** SEATS_CHANGED in text with the changes of the showcase of changes[first], returns its length */
+static size_t text_message(const SeatChange * changes, int count, int first, char * message) {
+    const SeatChange * showcase = &changes[first];
+    int len = snprintf(message, MESSAGE_SIZE, "%d\n%s\n%d\n%d\n", SEATS_CHANGED, showcase->movie, showcase->day, showcase->room);
+
+    for (int i = first; i < count; i++) {
+        if (!same_showcase(&changes[i], showcase->movie, showcase->day, showcase->room)) {
+            continue;
+        }
+        int seat = changes[i].seat == ALL_SEATS ? 0 : changes[i].seat;
+        int last = changes[i].seat == ALL_SEATS ? SEATS - 1 : changes[i].seat;
+        for (; seat <= last; seat++) {
+            len += snprintf(message + len, MESSAGE_SIZE - (size_t) len, "%d\n%d\n", seat, changes[i].state);
+        }
+    }
+    len += snprintf(message + len, MESSAGE_SIZE - (size_t) len, ".\n");
+    return (size_t) len;
+}
+
+/** The same message in binary, 0 on memory error */
+static size_t frame_message(FrameWriter * writer, const SeatChange * changes, int count, int first) {
+    const SeatChange * showcase = &changes[first];
+
+    frame_writer_reset(writer, SEATS_CHANGED);
+    frame_put_string(writer, showcase->movie);
+    frame_put_int(writer, showcase->day);
+    frame_put_int(writer, showcase->room);
+    for (int i = first; i < count; i++) {
+        if (!same_showcase(&changes[i], showcase->movie, showcase->day, showcase->room)) {
+            continue;
+        }
+        int seat = changes[i].seat == ALL_SEATS ? 0 : changes[i].seat;
+        int last = changes[i].seat == ALL_SEATS ? SEATS - 1 : changes[i].seat;
+        for (; seat <= last; seat++) {
+            frame_put_int(writer, seat);
+            frame_put_int(writer, changes[i].state);
+        }
+    }
+    return frame_writer_finish(writer);
+}
+
+void subscriptions_publish(Subscriptions subscriptions, const char * request, size_t len,
+                           const char * response, size_t response_len) {
+    SeatChange changes[MAX_BATCH_REQUESTS];
+    char text[MESSAGE_SIZE];
+
+    if (parse_request_type(response, response_len) != RESPONSE_OK) {
+        return;
+    }
+    int count = request_changes(request, len, changes);
+
+    pthread_mutex_lock(&subscriptions->mutex);
+    for (int i = 0; i < count; i++) {
+        bool first = true;
+        for (int j = 0; j < i && first; j++) {
+            first = !same_showcase(&changes[j], changes[i].movie, changes[i].day, changes[i].room);
+        }
+        if (!first) {
+            // already pushed along with a previous change of the showcase
+            continue;
+        }
+
+        // each format is built only if some subscriber uses it
+        size_t text_len = 0, frame_len = 0;
+        Subscription ** node = &subscriptions->buckets[bucket(changes[i].day, changes[i].room)];
+        while (*node != NULL) {
+            Subscription * aux = *node;
+            bool kept = true;
+            if (!same_showcase(&changes[i], aux->movie, aux->day, aux->room)) {
+                // not this showcase
+            } else if (aux->binary) {
+                if (frame_len != 0 || (frame_len = frame_message(&subscriptions->frame, changes, count, i)) != 0) {
+                    kept = subscriptions->push(aux->subscriber, subscriptions->frame.data, frame_len);
+                }
+            } else {
+                if (text_len == 0) {
+                    text_len = text_message(changes, count, i, text);
+                }
+                kept = subscriptions->push(aux->subscriber, text, text_len);
+            }
+
+            if (kept) {
+                node = &aux->next;
+            } else {
+                *node = aux->next;
+                free(aux);
+            }
+        }
+    }
+    pthread_mutex_unlock(&subscriptions->mutex);
+}
+
+void subscriptions_destroy(Subscriptions subscriptions) {
+    for (int i = 0; i < BUCKETS; i++) {
+        Subscription * node = subscriptions->buckets[i];
+        while (node != NULL) {
+            Subscription * aux = node->next;
+            free(node);
+            node = aux;
+        }
+    }
+    frame_writer_free(&subscriptions->frame);
+    pthread_mutex_destroy(&subscriptions->mutex);
+    free(subscriptions);
+}
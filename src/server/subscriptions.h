@@ -0,0 +1,46 @@
+#ifndef TPE_FINAL_SO_SUBSCRIPTIONS_H
+#define TPE_FINAL_SO_SUBSCRIPTIONS_H
+
+#include <stddef.h>
+#include "../protocol.h"
+
+/**
+ * Connections subscribed to the seats of a showcase with SUBSCRIBE_SEATS.
+ * The seats changed by a write are turned into one SEATS_CHANGED message per showcase
+ * and format, built once and pushed to every subscriber instead of each one polling GET_SEATS.
+ * Subscriptions last until the subscriber is removed, usually when its connection closes.
+ */
+
+typedef struct subscriptions * Subscriptions;
+
+/**
+ * Queues a whole message for a subscriber, called with the subscriptions locked. The writes of
+ * a showcase are published one at a time in commit order: while their showcase is locked, or
+ * in the order the writer answers them when there is one. It must not block on the socket.
+ * Returns false if the subscriber fell too far behind: its subscription is removed and nothing
+ * else is pushed to it for that showcase.
+ */
+typedef bool (*subscription_push)(void * subscriber, const char * message, size_t len);
+
+Subscriptions subscriptions_new(subscription_push push);
+
+/**
+ * Subscribes to the showcase of a serialized SUBSCRIBE_SEATS request, the changes are
+ * pushed in the format of the request. Returns -1 on memory error.
+ */
+int subscriptions_add(Subscriptions subscriptions, const char * request, size_t len, void * subscriber);
+
+/** Removes every subscription of the subscriber, nothing is pushed to it once this returns */
+void subscriptions_remove(Subscriptions subscriptions, void * subscriber);
+
+/**
+ * Pushes the seats changed by a write once the database answered it with OK: an ADD_BOOKING,
+ * a REMOVE_BOOKING, a REMOVE_SHOWCASE, which frees every seat, or the ones inside a BATCH.
+ * Any other request or response is ignored.
+ */
+void subscriptions_publish(Subscriptions subscriptions, const char * request, size_t len,
+                           const char * response, size_t response_len);
+
+void subscriptions_destroy(Subscriptions subscriptions);
+
+#endif //TPE_FINAL_SO_SUBSCRIPTIONS_H
@@ -0,0 +1,589 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include "uring_loop.h"
+#include "dispatcher.h"
+
+/** submissions filled before they have to be handed to the kernel */
+#define URING_ENTRIES       256
+/** connections served at once, each one reads into its own registered buffer */
+#define URING_CONNECTIONS   1024
+/** completions the kernel may hold: a read and a send per connection always fit */
+#define URING_COMPLETIONS   (4 * URING_CONNECTIONS)
+
+/**
+ * Anything submitted to the ring. The completion points to the operation and the
+ * operation knows how to react to its result, a negative errno if it failed.
+ */
+typedef struct operation {
+    void (*complete)(struct operation * op, int res);
+    /** owner of the operation */
+    void * data;
+    /** submitted and not completed yet, the kernel may still use its buffer */
+    bool pending;
+} Operation;
+
+typedef struct connection {
+    int fd;
+    Operation recv;
+    Operation send;
+    /** its buffer is the registered buffer of the slot */
+    Session session;
+    int slot;
+
+    /** responses handed to the kernel, they are not touched until the send completes */
+    Buffer sending;
+    /** bytes of sending already sent to the client */
+    size_t sent;
+
+    /** next connection in the list of destroyed ones */
+    struct connection * next;
+} Connection;
+
+/** A database process, its queries are kept by the dispatcher */
+typedef struct worker {
+    int in;
+    int out;
+    Operation write;
+    Operation read;
+    WorkerQueue * queue;
+
+    /** registered buffer the responses are read into */
+    int slot;
+    char * buffer;
+    /** the responses in buffer are being scanned, no read may be submitted into it */
+    bool draining;
+    /** process of the server, for server_database_in/out */
+    int index;
+    /** the process died, it is replaced once its pending write and read complete */
+    bool failed;
+} Worker;
+
+/** A listening socket, it always has an accept pending while a buffer is free */
+typedef struct listener {
+    int fd;
+    Operation accept;
+    /** buffer of the connection being accepted, -1 if none was free */
+    int slot;
+} Listener;
+
+/** Ring and its two queues, mapped from the kernel */
+static int ring_fd;
+static unsigned * sq_head, * sq_tail, * sq_mask, * sq_array;
+static unsigned * cq_head, * cq_tail, * cq_mask;
+static unsigned sq_entries;
+static struct io_uring_sqe * sqes;
+static struct io_uring_cqe * cqes;
+/** submissions filled so far, the kernel sees them on the next io_uring_enter */
+static unsigned sq_local_tail;
+
+/** Registered buffers: one per connection followed by one per database process */
+static char * slots;
+static int * free_slots;
+static int free_count;
+
+static Server server;
+
+static Listener * listeners;
+static int listeners_count;
+
+static Worker * workers;
+/** Connections destroyed while processing the current batch of completions */
+static Connection * dead;
+
+static void handle_accept(Operation * op, int res);
+static void handle_recv(Operation * op, int res);
+static void handle_send(Operation * op, int res);
+static void handle_database_write(Operation * op, int res);
+static void handle_database_read(Operation * op, int res);
+
+static int uring_setup(void) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags      = IORING_SETUP_CQSIZE;
+    params.cq_entries = URING_COMPLETIONS;
+
+    ring_fd = (int) syscall(SYS_io_uring_setup, URING_ENTRIES, &params);
+    if (ring_fd < 0) {
+        perror("io_uring_setup() failed");
+        return -1;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP)) {
+        fprintf(stderr, "io_uring is too old\n");
+        return -1;
+    }
+
+    // both queues live in the same mapping
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    char * rings = mmap(NULL, sq_size > cq_size ? sq_size : cq_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (rings == MAP_FAILED || sqes == MAP_FAILED) {
+        perror("mmap() failed");
+        return -1;
+    }
+
+    sq_head  = (unsigned *) (rings + params.sq_off.head);
+    sq_tail  = (unsigned *) (rings + params.sq_off.tail);
+    sq_mask  = (unsigned *) (rings + params.sq_off.ring_mask);
+    sq_array = (unsigned *) (rings + params.sq_off.array);
+    cq_head  = (unsigned *) (rings + params.cq_off.head);
+    cq_tail  = (unsigned *) (rings + params.cq_off.tail);
+    cq_mask  = (unsigned *) (rings + params.cq_off.ring_mask);
+    cqes     = (struct io_uring_cqe *) (rings + params.cq_off.cqes);
+    sq_entries    = params.sq_entries;
+    sq_local_tail = *sq_tail;
+    return 0;
+}
+
+/** Hands every filled submission to the kernel and waits until `wait` completions are ready */
+static int uring_enter(unsigned wait) {
+    __atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+    unsigned submit = sq_local_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+
+    if (syscall(SYS_io_uring_enter, ring_fd, submit, wait, wait > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0) < 0
+        && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        perror("io_uring_enter() failed");
+        return -1;
+    }
+    return 0;
+}
+
+/** Fills a submission for the operation, it goes to the kernel with the rest of the batch */
+static struct io_uring_sqe * submit(Operation * op, uint8_t opcode, int fd, void * addr, size_t len) {
+    while (sq_local_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) == sq_entries) {
+        // the queue is full, the kernel takes what is filled so far
+        if (uring_enter(0) < 0) {
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    unsigned index = sq_local_tail & *sq_mask;
+    struct io_uring_sqe * sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode    = opcode;
+    sqe->fd        = fd;
+    sqe->addr      = (uint64_t) (uintptr_t) addr;
+    sqe->len       = (uint32_t) len;
+    sqe->user_data = (uint64_t) (uintptr_t) op;
+    sq_array[index] = index;
+    sq_local_tail++;
+
+    op->pending = true;
+    return sqe;
+}
+
+static char * slot_buffer(int slot) {
+    return slots + (size_t) slot * BUFFER_SIZE;
+}
+
+/** Reads from a pipe or a socket into part of a registered buffer */
+static void read_fixed(Operation * op, int fd, int slot, char * buffer, size_t len) {
+    struct io_uring_sqe * sqe = submit(op, IORING_OP_READ_FIXED, fd, buffer, len);
+    sqe->off       = (uint64_t) -1;
+    sqe->buf_index = (uint16_t) slot;
+}
+
+/** Every listener without an accept pending takes a free buffer and accepts the next connection */
+static void accept_connections(void) {
+    for (int i = 0; i < listeners_count; i++) {
+        Listener * listener = &listeners[i];
+
+        if (listener->accept.pending) {
+            continue;
+        }
+        if (listener->slot < 0) {
+            if (free_count == 0) {
+                // the connections are queued in the listening socket until one leaves
+                return;
+            }
+            listener->slot = free_slots[--free_count];
+        }
+        // a database process forked again must not keep the client open
+        struct io_uring_sqe * sqe = submit(&listener->accept, IORING_OP_ACCEPT, listener->fd, NULL, 0);
+        sqe->accept_flags = SOCK_CLOEXEC;
+    }
+}
+
+/** The connection is freed after the current batch of completions, once nothing of it is pending */
+static void destroy_connection(Connection * conn) {
+    if (conn->recv.pending || conn->send.pending || conn->session.in_flight > 0) {
+        return;
+    }
+
+    syslog(LOG_DEBUG, "[SERVER] [-] socket %d", conn->fd);
+    close(conn->fd);
+    buffer_free(&conn->sending);
+    free_slots[free_count++] = conn->slot;
+    conn->next = dead;
+    dead = conn;
+    accept_connections();
+}
+
+/**
+ * Stops serving the client. The shutdown completes the pending read and send and
+ * the requests still in the database are drained before the connection is freed.
+ */
+static void close_connection(Connection * conn) {
+    if (conn->session.closed) {
+        return;
+    }
+    conn->session.closed = true;
+    dispatcher_session_free(&conn->session);
+    shutdown(conn->fd, SHUT_RDWR);
+    destroy_connection(conn);
+}
+
+/**
+ * Sends the ready responses unless a send is pending. While responses are pending the client
+ * is not read, a client that does not read them stops being read. A complete request waiting
+ * for its turn is not read past either.
+ */
+static void arm_connection(Connection * conn) {
+    Session * session = &conn->session;
+
+    if (session->closed) {
+        return;
+    }
+
+    if (!conn->send.pending) {
+        if (conn->sending.len == 0 && session->output.len > 0) {
+            Buffer aux      = conn->sending;
+            conn->sending   = session->output;
+            session->output = aux;
+            conn->sent      = 0;
+        }
+        if (conn->sent < conn->sending.len) {
+            struct io_uring_sqe * sqe = submit(&conn->send, IORING_OP_SEND, conn->fd, conn->sending.data + conn->sent,
+                                               conn->sending.len - conn->sent);
+            sqe->msg_flags = MSG_NOSIGNAL;
+        }
+    }
+
+    if (!conn->recv.pending && !session->complete && conn->sending.len == 0 && session->output.len == 0) {
+        read_fixed(&conn->recv, conn->fd, conn->slot, session->buffer + session->buffered,
+                   BUFFER_SIZE - session->buffered);
+    }
+}
+
+/** Submits the write of the first request not completely written, one at a time per pipe */
+static void write_requests(Worker * worker) {
+    WorkerQueue * queue = worker->queue;
+
+    if (worker->write.pending || worker->failed) {
+        return;
+    }
+    while (queue->writing != NULL && queue->writing->sent == queue->writing->len) {
+        queue->writing = queue->writing->next;
+    }
+
+    Query * query = queue->writing;
+    if (query != NULL) {
+        struct io_uring_sqe * sqe = submit(&worker->write, IORING_OP_WRITE, worker->in, query->request + query->sent,
+                                           query->len - query->sent);
+        sqe->off = (uint64_t) -1;
+    }
+}
+
+/** Submits the read of the responses while the worker has queries */
+static void read_responses(Worker * worker) {
+    if (!worker->read.pending && !worker->draining && !worker->failed && worker->queue->first != NULL) {
+        read_fixed(&worker->read, worker->out, worker->slot, worker->buffer, BUFFER_SIZE);
+    }
+}
+
+/** The write of the request goes along with the read of the response when the worker was idle */
+static void start_worker(WorkerQueue * queue) {
+    write_requests(queue->data);
+    read_responses(queue->data);
+}
+
+static void session_ready(Session * session) {
+    arm_connection(session->data);
+}
+
+static void session_close(Session * session) {
+    close_connection(session->data);
+}
+
+static void session_drained(Session * session) {
+    destroy_connection(session->data);
+}
+
+static const DispatcherOps ops = {
+        .write_requests = start_worker,
+        .ready          = session_ready,
+        .close          = session_close,
+        .drained        = session_drained,
+};
+
+/**
+ * Queues a SEATS_CHANGED after the responses already waiting, it is sent with the next batch.
+ * A client that lets more than MAX_PUSH_BACKLOG bytes pile up is dropped.
+ */
+static bool push_connection(void * subscriber, const char * message, size_t len) {
+    Session * session = subscriber;
+    Connection * conn = session->data;
+
+    if (session->closed) {
+        return false;
+    }
+    // the connection is not closed while the subscriptions are being walked, its pending read or send ends and closes it
+    if (conn->sending.len - conn->sent + session->output.len + len > MAX_PUSH_BACKLOG
+        || buffer_append(&session->output, message, len) < 0) {
+        shutdown(conn->fd, SHUT_RDWR);
+        return false;
+    }
+    arm_connection(conn);
+    return true;
+}
+
+/** Never scans while a read into the connection buffer is pending */
+static void handle_recv(Operation * op, int res) {
+    Connection * conn = op->data;
+
+    if (conn->session.closed) {
+        destroy_connection(conn);
+        return;
+    }
+    if (res == -EINTR || res == -EAGAIN) {
+        arm_connection(conn);
+        return;
+    }
+    if (res <= 0) {
+        close_connection(conn);
+        return;
+    }
+
+    conn->session.buffered += (size_t) res;
+    dispatcher_scan(&conn->session);
+}
+
+/** Once every ready response is out the next requests may start */
+static void handle_send(Operation * op, int res) {
+    Connection * conn = op->data;
+
+    if (conn->session.closed) {
+        destroy_connection(conn);
+        return;
+    }
+    if (res < 0 && res != -EINTR && res != -EAGAIN) {
+        close_connection(conn);
+        return;
+    }
+
+    if (res > 0) {
+        conn->sent += (size_t) res;
+    }
+    if (conn->sent == conn->sending.len) {
+        buffer_clear(&conn->sending);
+        conn->sent = 0;
+        if (conn->session.output.len == 0 && !conn->recv.pending) {
+            dispatcher_scan(&conn->session);
+            return;
+        }
+    }
+    arm_connection(conn);
+}
+
+static void handle_accept(Operation * op, int res) {
+    Listener * listener = op->data;
+
+    if (res < 0) {
+        if (res != -EINTR && res != -EAGAIN && res != -ECONNABORTED) {
+            fprintf(stderr, "accept() failed: %s\n", strerror(-res));
+        }
+        accept_connections();
+        return;
+    }
+
+    Connection * conn = calloc(1, sizeof(*conn));
+    if (conn == NULL) {
+        fprintf(stderr, "Connection error\n");
+        close(res);
+        accept_connections();
+        return;
+    }
+
+    conn->fd            = res;
+    conn->recv.complete = handle_recv;
+    conn->recv.data     = conn;
+    conn->send.complete = handle_send;
+    conn->send.data     = conn;
+    conn->slot          = listener->slot;
+    listener->slot      = -1;
+    dispatcher_session_init(&conn->session, slot_buffer(conn->slot), conn);
+    buffer_init(&conn->sending);
+    syslog(LOG_DEBUG, "[SERVER] [+] socket %d", res);
+
+    arm_connection(conn);
+    accept_connections();
+}
+
+/**
+ * Drops the queries of a process that died and replaces it once the kernel is done with its
+ * pipes, the completions of its pending write and read come back here.
+ */
+static void worker_failed(Worker * worker) {
+    if (!worker->failed) {
+        worker->failed = true;
+        dispatcher_worker_failed(worker->queue);
+    }
+    if (worker->write.pending || worker->read.pending) {
+        return;
+    }
+
+    if (server_respawn_worker(server, worker->index) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    worker->in     = server_database_in(server, worker->index);
+    worker->out    = server_database_out(server, worker->index);
+    worker->failed = false;
+    start_worker(worker->queue);
+}
+
+static void handle_database_write(Operation * op, int res) {
+    Worker * worker = op->data;
+
+    if (worker->failed || (res < 0 && res != -EINTR && res != -EAGAIN)) {
+        if (!worker->failed) {
+            fprintf(stderr, "write() to database failed: %s\n", strerror(-res));
+        }
+        worker_failed(worker);
+        return;
+    }
+    if (res > 0) {
+        worker->queue->writing->sent += (size_t) res;
+    }
+    write_requests(worker);
+}
+
+static void handle_database_read(Operation * op, int res) {
+    Worker * worker = op->data;
+
+    if (worker->failed) {
+        worker_failed(worker);
+        return;
+    }
+    if (res == -EINTR || res == -EAGAIN) {
+        read_responses(worker);
+        return;
+    }
+    if (res <= 0) {
+        fprintf(stderr, "Database process closed the pipe\n");
+        worker_failed(worker);
+        return;
+    }
+
+    worker->draining = true;
+    dispatcher_responses(worker->queue, worker->buffer, (size_t) res);
+    worker->draining = false;
+    read_responses(worker);
+}
+
+/** Registers one buffer per connection and one per database process, the kernel pins them once */
+static int register_buffers(int processes) {
+    int count = URING_CONNECTIONS + processes;
+
+    slots = mmap(NULL, (size_t) count * BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    free_slots = malloc(URING_CONNECTIONS * sizeof(*free_slots));
+    struct iovec * iovecs = calloc((size_t) count, sizeof(*iovecs));
+    if (slots == MAP_FAILED || free_slots == NULL || iovecs == NULL) {
+        free(iovecs);
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        iovecs[i].iov_base = slot_buffer(i);
+        iovecs[i].iov_len  = BUFFER_SIZE;
+    }
+    // the first connections take the first buffers
+    for (int i = URING_CONNECTIONS - 1; i >= 0; i--) {
+        free_slots[free_count++] = i;
+    }
+
+    int ret = (int) syscall(SYS_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, iovecs, count);
+    if (ret < 0) {
+        perror("io_uring_register() failed");
+    }
+    free(iovecs);
+    return ret;
+}
+
+int uring_loop_run(Server running) {
+    server = running;
+    if (uring_setup() < 0) {
+        return -1;
+    }
+
+    int processes = server_workers(server) + (server_writer(server) >= 0 ? 1 : 0);
+    workers = calloc((size_t) processes, sizeof(*workers));
+    listeners_count = server_acceptors(server);
+    listeners = calloc((size_t) listeners_count, sizeof(*listeners));
+    if (workers == NULL || listeners == NULL || register_buffers(processes) < 0
+        || dispatcher_init(server, &ops, push_connection) < 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < processes; i++) {
+        Worker * worker = &workers[i];
+        worker->in             = server_database_in(server, i);
+        worker->out            = server_database_out(server, i);
+        worker->write.complete = handle_database_write;
+        worker->write.data     = worker;
+        worker->read.complete  = handle_database_read;
+        worker->read.data      = worker;
+        worker->slot           = URING_CONNECTIONS + i;
+        worker->buffer         = slot_buffer(worker->slot);
+        worker->index          = i;
+        worker->queue          = dispatcher_worker(i);
+        worker->queue->data    = worker;
+    }
+
+    // with several listening sockets the kernel spreads the connections, each one has its accept pending
+    for (int i = 0; i < listeners_count; i++) {
+        listeners[i].fd              = server_listen_socket(server, i);
+        listeners[i].accept.complete = handle_accept;
+        listeners[i].accept.data     = &listeners[i];
+        listeners[i].slot            = -1;
+    }
+    accept_connections();
+
+    while (true) {
+        // the submissions of the previous batch go with the wait for the next one
+        if (uring_enter(1) < 0) {
+            return -1;
+        }
+
+        unsigned head = *cq_head;
+        unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            struct io_uring_cqe * cqe = &cqes[head & *cq_mask];
+            Operation * op = (Operation *) (uintptr_t) cqe->user_data;
+            int res = cqe->res;
+
+            __atomic_store_n(cq_head, ++head, __ATOMIC_RELEASE);
+            op->pending = false;
+            op->complete(op, res);
+        }
+
+        while (dead != NULL) {
+            Connection * next = dead->next;
+            free(dead);
+            dead = next;
+        }
+    }
+}
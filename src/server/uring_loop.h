@@ -0,0 +1,16 @@
+#ifndef TPE_FINAL_SO_URING_LOOP_H
+#define TPE_FINAL_SO_URING_LOOP_H
+
+#include "server.h"
+
+/**
+ * Completion driven server mode built on io_uring: accepts, client reads and sends and the
+ * database pipe reads and writes are queued as submissions and sent to the kernel in a single
+ * io_uring_enter per batch of completions. Client requests and database responses are read
+ * into buffers registered once with the ring instead of a buffer per connection.
+ */
+
+/** Runs the loop until a fatal error occurs, returns -1 in that case */
+int uring_loop_run(Server server);
+
+#endif //TPE_FINAL_SO_URING_LOOP_H
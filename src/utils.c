@@ -3,6 +3,8 @@
 #include <limits.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stddef.h>
+#include <string.h>
 #include "utils.h"
 
 bool debug = false;
@@ -21,6 +23,24 @@ int parse_port(char *optarg) {
     return (int) sl;
 }
 
+socklen_t unix_address(const char * path, struct sockaddr_un * addr) {
+    size_t len = strlen(path);
+
+    if (len == 0 || len >= sizeof(addr->sun_path)) {
+        return 0;
+    }
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    memcpy(addr->sun_path, path, len);
+    if (path[0] == '@') {
+        // abstract names are not terminated, the length of the address says where they end
+        addr->sun_path[0] = '\0';
+        return (socklen_t) (offsetof(struct sockaddr_un, sun_path) + len);
+    }
+    return (socklen_t) (offsetof(struct sockaddr_un, sun_path) + len + 1);
+}
+
 void print_state(const char *p, const char *(*namefnc)(unsigned), const ParserEvent *e) {
     if (e->n == 0) {
         fprintf(stderr, "%-8s: %-14s\n", p, namefnc(e->type));
@@ -1,10 +1,18 @@
 #ifndef TPE_FINAL_SO_UTILS_H
 #define TPE_FINAL_SO_UTILS_H
 
+#include <sys/socket.h>
+#include <sys/un.h>
 #include "parser.h"
 
 int parse_port(char *optarg);
 
+/**
+ * Fills the address of a Unix domain socket. A path starting with '@' names a socket in the
+ * abstract namespace, without a file. Returns the length of the address or 0 if the path is too long.
+ */
+socklen_t unix_address(const char * path, struct sockaddr_un * addr);
+
 void print_state(const char *p, const char *(*namefnc)(unsigned), const ParserEvent *e);
 
 #endif //TPE_FINAL_SO_UTILS_H
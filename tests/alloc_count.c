@@ -0,0 +1,26 @@
+#include "alloc_count.h"
+
+void * __real_malloc(size_t size);
+void * __real_calloc(size_t n, size_t size);
+void * __real_realloc(void * ptr, size_t size);
+
+static size_t count = 0;
+
+void * __wrap_malloc(size_t size) {
+    count++;
+    return __real_malloc(size);
+}
+
+void * __wrap_calloc(size_t n, size_t size) {
+    count++;
+    return __real_calloc(n, size);
+}
+
+void * __wrap_realloc(void * ptr, size_t size) {
+    count++;
+    return __real_realloc(ptr, size);
+}
+
+size_t alloc_count(void) {
+    return count;
+}
@@ -0,0 +1,14 @@
+#ifndef TPE_FINAL_SO_ALLOC_COUNT_H
+#define TPE_FINAL_SO_ALLOC_COUNT_H
+
+#include <stddef.h>
+
+/**
+ * Cuenta los pedidos de memoria al heap. El test se enlaza con
+ * -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc para que pasen por aca.
+ */
+
+/** Cantidad de llamadas a malloc, calloc y realloc desde que empezo el programa */
+size_t alloc_count(void);
+
+#endif //TPE_FINAL_SO_ALLOC_COUNT_H
@@ -0,0 +1,244 @@
+#define _GNU_SOURCE
+#include <check.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <message.h>
+
+/**
+ * Benchmark de los modos del server: varios clientes hacen GET_SEATS (que siempre llega
+ * a la base) uno detras de otro contra threads, epoll y uring. Cada modo se corre dos
+ * veces: una libre para medir pedidos por segundo y otra bajo ptrace, contando las
+ * llamadas al sistema de todos los threads del server (no las de los procesos database)
+ * para sacar cuantas hace por pedido. Se corre desde el directorio donde se generan los binarios.
+ *
+ * Uso: backend_bench [pedidos]
+ */
+
+#define SERVER_PROC         "./server"
+#define BENCH_DATABASE      "backend_bench.db"
+#define BENCH_PORT          22645
+#define DEFAULT_REQUESTS    2000
+#define CLIENTS             4
+
+static int requests = DEFAULT_REQUESTS;
+
+static const char request[] = "5\nmovie\n2\n3\n.\n";
+
+static const char * modes[] = {"threads", "epoll", "uring"};
+#define MODES (sizeof(modes) / sizeof(modes[0]))
+
+/** Compartido con el proceso que traza al server */
+typedef struct {
+    pid_t server;
+    /** paradas de entrada y salida de llamadas al sistema de los threads del server */
+    unsigned long stops;
+} Trace;
+
+static double elapsed_ms(const struct timespec * start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e3 + (end.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static int connect_server(void) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t) BENCH_PORT);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    struct timespec wait = {.tv_sec = 0, .tv_nsec = 20 * 1000 * 1000};
+    for (int i = 0; i < 250; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+            return fd;
+        }
+        close(fd);
+        nanosleep(&wait, NULL);
+    }
+    return -1;
+}
+
+static void exec_server(const char * mode) {
+    char port[8];
+    snprintf(port, sizeof(port), "%d", BENCH_PORT);
+
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    char * argv[] = {"server", "-p", port, "-f", BENCH_DATABASE, "-m", (char *) mode, "-w", "2", NULL};
+    execv(SERVER_PROC, argv);
+    perror("execv() failed");
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Sigue al server y a cada thread que crea, contando sus paradas en llamadas al sistema.
+ * Los procesos database se crean con fork y no se siguen.
+ */
+static void trace_server(const char * mode, Trace * trace) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+        exec_server(mode);
+    }
+    trace->server = pid;
+
+    int status;
+    waitpid(pid, &status, 0);
+    ptrace(PTRACE_SETOPTIONS, pid, NULL, PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACECLONE | PTRACE_O_EXITKILL);
+    ptrace(PTRACE_SYSCALL, pid, NULL, NULL);
+
+    pid_t tid;
+    while ((tid = waitpid(-1, &status, __WALL)) > 0) {
+        if (!WIFSTOPPED(status)) {
+            continue;
+        }
+        int sig = WSTOPSIG(status);
+        if (sig == (SIGTRAP | 0x80)) {
+            __atomic_fetch_add(&trace->stops, 1, __ATOMIC_SEQ_CST);
+            sig = 0;
+        } else if (sig == SIGTRAP || sig == SIGSTOP) {
+            // eventos de clone y el arranque de los threads nuevos, no son señales para el server
+            sig = 0;
+        }
+        ptrace(PTRACE_SYSCALL, tid, NULL, sig);
+    }
+    exit(EXIT_SUCCESS);
+}
+
+/** Levanta el server, bajo ptrace si trace no es NULL. Retorna el pid a esperar al final */
+static pid_t start_server(const char * mode, Trace * trace) {
+    unlink(BENCH_DATABASE);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (trace != NULL) {
+            trace_server(mode, trace);
+        }
+        exec_server(mode);
+    }
+
+    int fd = connect_server();
+    ck_assert_int_ge(fd, 0);
+    close(fd);
+    return pid;
+}
+
+static void stop_server(pid_t pid, Trace * trace) {
+    kill(trace != NULL ? trace->server : pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    unlink(BENCH_DATABASE);
+}
+
+/** Un cliente: sus pedidos uno detras de otro, cada uno espera su respuesta */
+static void client(int count) {
+    int fd = connect_server();
+    char buffer[4096];
+
+    if (fd < 0) {
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < count; i++) {
+        MessageScanner scanner;
+        bool done = false;
+
+        message_scanner_init(&scanner);
+        if (send(fd, request, strlen(request), MSG_NOSIGNAL) != (ssize_t) strlen(request)) {
+            exit(EXIT_FAILURE);
+        }
+        while (!done) {
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) {
+                exit(EXIT_FAILURE);
+            }
+            message_scan(&scanner, buffer, (size_t) n, &done);
+        }
+    }
+    close(fd);
+    exit(EXIT_SUCCESS);
+}
+
+/** Reparte los pedidos entre los clientes y retorna los ms hasta que termina el ultimo */
+static double run_clients(void) {
+    struct timespec start;
+    pid_t pids[CLIENTS];
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < CLIENTS; i++) {
+        pids[i] = fork();
+        if (pids[i] == 0) {
+            client(requests / CLIENTS);
+        }
+    }
+    for (int i = 0; i < CLIENTS; i++) {
+        int status;
+        waitpid(pids[i], &status, 0);
+        ck_assert(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+    }
+    return elapsed_ms(&start);
+}
+
+START_TEST(test_backend_bench)
+    Trace * trace = mmap(NULL, sizeof(*trace), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    ck_assert_ptr_ne(trace, MAP_FAILED);
+    int total = requests / CLIENTS * CLIENTS;
+
+    fprintf(stderr, "%d GET_SEATS from %d clients, one at a time each\n", total, CLIENTS);
+    fprintf(stderr, "  %-10s %12s %16s\n", "", "requests/s", "syscalls/request");
+    for (size_t m = 0; m < MODES; m++) {
+        pid_t pid = start_server(modes[m], NULL);
+        double ms = run_clients();
+        stop_server(pid, NULL);
+
+        memset(trace, 0, sizeof(*trace));
+        pid = start_server(modes[m], trace);
+        unsigned long before = __atomic_load_n(&trace->stops, __ATOMIC_SEQ_CST);
+        run_clients();
+        unsigned long stops = __atomic_load_n(&trace->stops, __ATOMIC_SEQ_CST) - before;
+        stop_server(pid, trace);
+
+        // cada llamada para dos veces, al entrar y al salir
+        fprintf(stderr, "  %-10s %12.0f %16.2f\n", modes[m], total / (ms / 1e3), stops / 2.0 / total);
+    }
+
+    munmap(trace, sizeof(*trace));
+END_TEST
+
+Suite * suite(void) {
+    Suite *s   = suite_create("backend_bench");
+    TCase *tc  = tcase_create("backend_bench");
+
+    tcase_set_timeout(tc, 300);
+    tcase_add_test(tc, test_backend_bench);
+    suite_add_tcase(s, tc);
+
+    return s;
+}
+
+int main(int argc, char * argv[]) {
+    if (argc > 1) {
+        requests = atoi(argv[1]) >= CLIENTS ? atoi(argv[1]) : DEFAULT_REQUESTS;
+    }
+
+    int number_failed;
+    SRunner *sr = srunner_create(suite());
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,280 @@
+#include <check.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <message.h>
+#include <database/db_functions.h>
+
+/**
+ * Benchmark de escrituras: reservas por segundo con cada combinacion de journal y
+ * synchronous que acepta `database`. Cada reserva se confirma por separado, como
+ * llegan desde el server, o en lotes de GROUP_COMMIT como hace `database -g`.
+ * Ademas se levanta el server con -G y BURST_CLIENTS clientes reservan a la vez, todos
+ * en la misma funcion o cada uno en la suya: las reservas de una funcion tambien tienen
+ * que compartir el commit. Se corre desde el directorio donde se generan los binarios.
+ *
+ * Uso: durability_bench [reservas]
+ */
+
+#define BENCH_DATABASE      "durability_bench.db"
+#define BENCH_WAL           BENCH_DATABASE "-wal"
+#define BENCH_SHM           BENCH_DATABASE "-shm"
+#define BENCH_JOURNAL       BENCH_DATABASE "-journal"
+#define DEFAULT_BOOKINGS    (SEATS / 2)
+#define GROUP_COMMIT        16
+
+#define SERVER_PROC         "./server"
+#define BURST_DATABASE      "durability_burst.db"
+#define BURST_PORT          22845
+#define BURST_CLIENTS       16
+#define BURST_WINDOW        "2000"
+
+static int bookings = DEFAULT_BOOKINGS;
+
+static const DatabaseOptions configurations[] = {
+        {.journal_mode = "delete", .synchronous = "full",   .cache_size = 0,     .mmap_size = -1},
+        {.journal_mode = "wal",    .synchronous = "full",   .cache_size = 0,     .mmap_size = -1},
+        {.journal_mode = "wal",    .synchronous = "normal", .cache_size = 0,     .mmap_size = -1},
+        {.journal_mode = "wal",    .synchronous = "normal", .cache_size = -8192, .mmap_size = 1 << 26},
+        {.journal_mode = "wal",    .synchronous = "off",    .cache_size = 0,     .mmap_size = -1},
+};
+#define CONFIGURATIONS (sizeof(configurations) / sizeof(configurations[0]))
+
+static void remove_files(void) {
+    unlink(BENCH_DATABASE);
+    unlink(BENCH_WAL);
+    unlink(BENCH_SHM);
+    unlink(BENCH_JOURNAL);
+}
+
+/** Retorna las reservas por segundo con las opciones dadas, confirmando cada `group` reservas */
+static double run(const DatabaseOptions * options, int group) {
+    char movie[MOVIE_NAME_LENGTH];
+
+    remove_files();
+    ck_assert_int_eq(database_open(BENCH_DATABASE), RESPONSE_OK);
+    ck_assert_int_eq(database_configure(options), RESPONSE_OK);
+    ck_assert_int_eq(add_client("client"), RESPONSE_OK);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < bookings; i++) {
+        int showcase = i / SEATS;
+        if (group > 1 && i % group == 0) {
+            ck_assert_int_eq(database_batch_begin(), RESPONSE_OK);
+        }
+        sprintf(movie, "movie %d", showcase);
+        if (i % SEATS == 0) {
+            ck_assert_int_eq(add_showcase(movie, showcase % 7, 1 + showcase / 7), RESPONSE_OK);
+        }
+        ck_assert_int_eq(add_booking("client", movie, showcase % 7, 1 + showcase / 7, i % SEATS), RESPONSE_OK);
+        if (group > 1 && (i % group == group - 1 || i == bookings - 1)) {
+            ck_assert_int_eq(database_batch_commit(), RESPONSE_OK);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    database_close();
+    remove_files();
+
+    return bookings / ((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+}
+
+START_TEST(test_durability_bench)
+    fprintf(stderr, "ADD_BOOKING throughput over %d bookings\n", bookings);
+    for (size_t i = 0; i < CONFIGURATIONS; i++) {
+        const DatabaseOptions * options = &configurations[i];
+        double single = run(options, 1);
+        double group  = run(options, GROUP_COMMIT);
+        fprintf(stderr, "  journal %-6s synchronous %-6s cache %6d mmap %9lld: %10.0f bookings/s, "
+                        "%10.0f with group commit\n",
+                options->journal_mode, options->synchronous, options->cache_size, options->mmap_size, single, group);
+    }
+END_TEST
+
+START_TEST(test_invalid_options)
+    DatabaseOptions journal = {.journal_mode = "wal; DROP TABLE client", .mmap_size = -1};
+    DatabaseOptions synchronous = {.synchronous = "always", .mmap_size = -1};
+
+    remove_files();
+    ck_assert_int_eq(database_open(BENCH_DATABASE), RESPONSE_OK);
+    ck_assert_int_eq(database_configure(&journal), RESPONSE_ERR);
+    ck_assert_int_eq(database_configure(&synchronous), RESPONSE_ERR);
+    database_close();
+    remove_files();
+END_TEST
+
+static int connect_server(void) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t) BURST_PORT);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/** Levanta el server con group commit y espera a que acepte conexiones */
+static pid_t start_server(const char * mode) {
+    char port[8];
+    snprintf(port, sizeof(port), "%d", BURST_PORT);
+    unlink(BURST_DATABASE);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        char * argv[] = {"server", "-p", port, "-f", BURST_DATABASE, "-m", (char *) mode, "-w", "2",
+                         "-J", "wal", "-S", "full", "-G", BURST_WINDOW, NULL};
+        execv(SERVER_PROC, argv);
+        perror("execv() failed");
+        exit(EXIT_FAILURE);
+    }
+
+    struct timespec wait = {.tv_sec = 0, .tv_nsec = 20 * 1000 * 1000};
+    int fd = -1;
+    for (int i = 0; i < 250 && fd < 0; i++) {
+        fd = connect_server();
+        if (fd < 0) {
+            nanosleep(&wait, NULL);
+        }
+    }
+    ck_assert_int_ge(fd, 0);
+    close(fd);
+    return pid;
+}
+
+static void stop_server(pid_t pid) {
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    unlink(BURST_DATABASE);
+    unlink(BURST_DATABASE "-wal");
+    unlink(BURST_DATABASE "-shm");
+}
+
+/** Manda el pedido y retorna el estado de la respuesta */
+static int round_trip(int fd, const char * request) {
+    char buffer[256];
+    MessageScanner scanner;
+    bool done = false;
+    size_t len = 0;
+
+    message_scanner_init(&scanner);
+    if (send(fd, request, strlen(request), MSG_NOSIGNAL) != (ssize_t) strlen(request)) {
+        return -1;
+    }
+    while (!done) {
+        ssize_t n = recv(fd, buffer + len, sizeof(buffer) - len, 0);
+        if (n <= 0) {
+            return -1;
+        }
+        message_scan(&scanner, buffer + len, (size_t) n, &done);
+        len += (size_t) n;
+    }
+    return atoi(buffer);
+}
+
+/**
+ * Cada cliente reserva y cancela sus asientos, uno por vez, en su funcion: todos en la sala 1
+ * o cada uno en la sala 1 + su numero. Retorna las escrituras por segundo de todos juntos.
+ */
+static double burst(const char * mode, bool same_showcase) {
+    char request[128];
+    int seats = SEATS / BURST_CLIENTS;
+    int rounds = bookings / (seats * BURST_CLIENTS) > 0 ? bookings / (seats * BURST_CLIENTS) : 1;
+
+    pid_t server = start_server(mode);
+    int fd = connect_server();
+    ck_assert_int_ge(fd, 0);
+    for (int i = 0; i < BURST_CLIENTS; i++) {
+        sprintf(request, "0\nclient %d\n.\n", i);
+        ck_assert_int_eq(round_trip(fd, request), RESPONSE_OK);
+        sprintf(request, "1\nmovie\n2\n%d\n.\n", 1 + i);
+        ck_assert_int_eq(round_trip(fd, request), RESPONSE_OK);
+    }
+    close(fd);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pid_t clients[BURST_CLIENTS];
+    for (int i = 0; i < BURST_CLIENTS; i++) {
+        clients[i] = fork();
+        if (clients[i] == 0) {
+            int client = connect_server();
+            int room = same_showcase ? 1 : 1 + i;
+            for (int round = 0; client >= 0 && round < rounds; round++) {
+                for (int type = ADD_BOOKING; type <= REMOVE_BOOKING; type++) {
+                    for (int seat = i * seats; seat < (i + 1) * seats; seat++) {
+                        sprintf(request, "%d\nclient %d\nmovie\n2\n%d\n%d\n.\n", type, i, room, seat);
+                        if (round_trip(client, request) != RESPONSE_OK) {
+                            exit(EXIT_FAILURE);
+                        }
+                    }
+                }
+            }
+            exit(client >= 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+    }
+    for (int i = 0; i < BURST_CLIENTS; i++) {
+        int status;
+        waitpid(clients[i], &status, 0);
+        ck_assert(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    stop_server(server);
+
+    return 2.0 * rounds * seats * BURST_CLIENTS / ((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+}
+
+START_TEST(test_showcase_burst)
+    static const char * modes[] = {"threads", "epoll", "uring"};
+
+    fprintf(stderr, "%d clients booking and cancelling at once through the server, -G %s, wal, synchronous full\n",
+            BURST_CLIENTS, BURST_WINDOW);
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        double same  = burst(modes[i], true);
+        double spread = burst(modes[i], false);
+        fprintf(stderr, "  %-8s %10.0f writes/s on one showcase, %10.0f on one showcase each\n",
+                modes[i], same, spread);
+    }
+END_TEST
+
+Suite * suite(void) {
+    Suite *s   = suite_create("durability_bench");
+    TCase *tc  = tcase_create("durability_bench");
+
+    tcase_set_timeout(tc, 120);
+    tcase_add_test(tc, test_invalid_options);
+    tcase_add_test(tc, test_durability_bench);
+    tcase_add_test(tc, test_showcase_burst);
+    suite_add_tcase(s, tc);
+
+    return s;
+}
+
+int main(int argc, char * argv[]) {
+    if (argc > 1) {
+        bookings = atoi(argv[1]) > 0 ? atoi(argv[1]) : DEFAULT_BOOKINGS;
+    }
+
+    int number_failed;
+    SRunner *sr = srunner_create(suite());
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,251 @@
+#include <check.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <database/db_functions.h>
+
+/**
+ * Benchmark de los indices del esquema: latencia de las busquedas de cada pedido a
+ * medida que crece el historial de reservas. Con los indices tiene que quedar plana,
+ * al final se borran y se mide la misma base recorriendo las tablas completas.
+ *
+ * Uso: index_bench [reservas]
+ */
+
+#define BENCH_DATABASE      "index_bench.db"
+#define DEFAULT_BOOKINGS    20000
+#define LOOKUPS             2000
+#define SHOWCASES           (7 * ROOMS)
+#define CLIENTS_PER_BOOKING 20
+/** La latencia con el historial completo puede ser a lo sumo GROWTH veces la inicial (mas SLACK us) */
+#define GROWTH              5
+#define SLACK               5.0
+#define LEVELS              3
+
+extern sqlite3 * db_fd;
+
+static int bookings = DEFAULT_BOOKINGS;
+static int clients  = 0;
+
+typedef enum {
+    LOOKUP_CLIENT,
+    LOOKUP_SHOWCASE,
+    LOOKUP_SEAT,
+    LOOKUP_TYPES
+} lookup_type;
+
+static const char * lookup_names[] = {
+        [LOOKUP_CLIENT]   = "client by name",
+        [LOOKUP_SHOWCASE] = "showcase by movie/day/room",
+        [LOOKUP_SEAT]     = "booking of a taken seat",
+};
+
+static void client_name(int client, char * name) {
+    sprintf(name, "client %d", client);
+}
+
+static void showcase_movie(int showcase, char * movie) {
+    sprintf(movie, "movie %d", showcase);
+}
+
+/** Agrega clientes y reservas canceladas hasta llegar a `total` reservas */
+static void populate(int from, int total) {
+    char name[CLIENT_NAME_LENGTH], movie[MOVIE_NAME_LENGTH];
+
+    ck_assert_int_eq(database_batch_begin(), RESPONSE_OK);
+    for (; clients < total / CLIENTS_PER_BOOKING + 1; clients++) {
+        client_name(clients, name);
+        ck_assert_int_eq(add_client(name), RESPONSE_OK);
+    }
+    for (int i = from; i < total; i++) {
+        int showcase = i % SHOWCASES;
+        // el asiento 0 de cada funcion queda reservado, el historial usa los demas
+        int seat = 1 + (i / SHOWCASES) % (SEATS - 1);
+        client_name(i % clients, name);
+        showcase_movie(showcase, movie);
+        ck_assert_int_eq(add_booking(name, movie, showcase % 7, 1 + showcase / 7, seat), RESPONSE_OK);
+        ck_assert_int_eq(cancel_booking(name, movie, showcase % 7, 1 + showcase / 7, seat), RESPONSE_OK);
+    }
+    ck_assert_int_eq(database_batch_commit(), RESPONSE_OK);
+}
+
+static void setup_showcases(void) {
+    char movie[MOVIE_NAME_LENGTH];
+
+    unlink(BENCH_DATABASE);
+    ck_assert_int_eq(database_open(BENCH_DATABASE), RESPONSE_OK);
+    ck_assert_int_eq(add_client("owner"), RESPONSE_OK);
+    for (int showcase = 0; showcase < SHOWCASES; showcase++) {
+        showcase_movie(showcase, movie);
+        ck_assert_int_eq(add_showcase(movie, showcase % 7, 1 + showcase / 7), RESPONSE_OK);
+        ck_assert_int_eq(add_booking("owner", movie, showcase % 7, 1 + showcase / 7, 0), RESPONSE_OK);
+    }
+}
+
+/** Retorna la latencia promedio en microsegundos de la busqueda */
+static double measure(lookup_type type) {
+    char name[CLIENT_NAME_LENGTH], movie[MOVIE_NAME_LENGTH];
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < LOOKUPS; i++) {
+        int showcase = i % SHOWCASES;
+        client_name((i * 7919) % clients, name);
+        showcase_movie(showcase, movie);
+        switch (type) {
+            case LOOKUP_CLIENT:
+                ck_assert_int_ne(get_client_id(name), INVALID_ID);
+                break;
+            case LOOKUP_SHOWCASE:
+                ck_assert_int_ne(get_showcase_id(movie, showcase % 7, 1 + showcase / 7), INVALID_ID);
+                break;
+            default:
+                ck_assert_int_eq(add_booking(name, movie, showcase % 7, 1 + showcase / 7, 0), ALREADY_EXIST);
+                break;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return ((end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3) / LOOKUPS;
+}
+
+START_TEST(test_index_bench)
+    double latency[LEVELS][LOOKUP_TYPES];
+    int sizes[LEVELS];
+
+    setup_showcases();
+
+    int size = bookings;
+    for (int level = LEVELS - 1; level >= 0; level--) {
+        sizes[level] = size;
+        size /= 10;
+    }
+
+    int populated = 0;
+    for (int level = 0; level < LEVELS; level++) {
+        populate(populated, sizes[level]);
+        populated = sizes[level];
+        for (int type = 0; type < LOOKUP_TYPES; type++) {
+            latency[level][type] = measure(type);
+        }
+    }
+
+    // la misma base sin los indices de la migracion 2
+    ck_assert_int_eq(sqlite3_exec(db_fd, "DROP INDEX client_name; DROP INDEX showcase_movie_day_room;"
+                                         "DROP INDEX booking_showcase_seat_cancelled;", NULL, NULL, NULL), SQLITE_OK);
+    double scan[LOOKUP_TYPES];
+    for (int type = 0; type < LOOKUP_TYPES; type++) {
+        scan[type] = measure(type);
+    }
+
+    fprintf(stderr, "Lookup latency (us) by booking history size\n");
+    fprintf(stderr, "  %-28s", "");
+    for (int level = 0; level < LEVELS; level++) {
+        fprintf(stderr, "%10d", sizes[level]);
+    }
+    fprintf(stderr, "  %10s\n", "no index");
+    for (int type = 0; type < LOOKUP_TYPES; type++) {
+        fprintf(stderr, "  %-28s", lookup_names[type]);
+        for (int level = 0; level < LEVELS; level++) {
+            fprintf(stderr, "%10.2f", latency[level][type]);
+        }
+        fprintf(stderr, "  %10.2f\n", scan[type]);
+    }
+
+    for (int type = 0; type < LOOKUP_TYPES; type++) {
+        ck_assert(latency[LEVELS - 1][type] <= GROWTH * latency[0][type] + SLACK);
+    }
+
+    database_close();
+    unlink(BENCH_DATABASE);
+END_TEST
+
+START_TEST(test_migrations_version)
+    unlink(BENCH_DATABASE);
+    ck_assert_int_eq(database_open(BENCH_DATABASE), RESPONSE_OK);
+    database_close();
+
+    // abrir de nuevo un archivo ya migrado no vuelve a aplicar nada
+    ck_assert_int_eq(database_open(BENCH_DATABASE), RESPONSE_OK);
+    ck_assert_int_eq(add_client("client"), RESPONSE_OK);
+    ck_assert_int_eq(add_client("client"), ALREADY_EXIST);
+
+    sqlite3_stmt * stmt;
+    ck_assert_int_eq(sqlite3_prepare_v2(db_fd, "PRAGMA user_version", -1, &stmt, NULL), SQLITE_OK);
+    ck_assert_int_eq(sqlite3_step(stmt), SQLITE_ROW);
+    ck_assert_int_gt(sqlite3_column_int(stmt, 0), 0);
+    sqlite3_finalize(stmt);
+
+    database_close();
+    unlink(BENCH_DATABASE);
+END_TEST
+
+START_TEST(test_migrate_duplicates)
+    sqlite3 * old;
+    unlink(BENCH_DATABASE);
+
+    // un archivo sin version, de antes de los indices unicos, con un cliente y una funcion repetidos
+    ck_assert_int_eq(sqlite3_open(BENCH_DATABASE, &old), SQLITE_OK);
+    ck_assert_int_eq(sqlite3_exec(old,
+            "CREATE TABLE client(id INTEGER NOT NULL, name TEXT, PRIMARY KEY(id));"
+            "CREATE TABLE showcase(id INTEGER NOT NULL, movie TEXT NOT NULL, day INT NOT NULL, room INT NOT NULL,"
+            " PRIMARY KEY(id));"
+            "CREATE TABLE booking(id INTEGER NOT NULL, client_id INTEGER NOT NULL, showcase_id INTEGER NOT NULL,"
+            " cancelled INTEGER NOT NULL, seat INTEGER NOT NULL, FOREIGN KEY (client_id) REFERENCES client(id),"
+            " FOREIGN KEY (showcase_id) REFERENCES showcase(id), PRIMARY KEY (id));"
+            "INSERT INTO client(id, name) VALUES(1, 'client'), (2, 'other'), (3, 'client');"
+            "INSERT INTO showcase(id, movie, day, room) VALUES(1, 'movie', 2, 3), (2, 'movie', 2, 3), (3, 'movie', 2, 4);"
+            "INSERT INTO booking(client_id, showcase_id, cancelled, seat) VALUES(3, 2, 0, 4), (1, 1, 1, 5), (2, 3, 0, 6);",
+            NULL, NULL, NULL), SQLITE_OK);
+    sqlite3_close(old);
+
+    // las reservas de los repetidos quedan en el cliente y la funcion de menor id
+    ck_assert_int_eq(database_open(BENCH_DATABASE), RESPONSE_OK);
+    ck_assert_int_eq(get_client_id("client"), 1);
+    ck_assert_int_eq(get_showcase_id("movie", 2, 3), 1);
+    ck_assert_int_eq(add_client("client"), ALREADY_EXIST);
+    ck_assert_int_eq(add_showcase("movie", 2, 3), ALREADY_EXIST);
+    ck_assert_int_eq(add_booking("other", "movie", 2, 3, 4), ALREADY_EXIST);
+    ck_assert_int_eq(cancel_booking("client", "movie", 2, 3, 4), RESPONSE_OK);
+    ck_assert_int_eq(cancel_booking("other", "movie", 2, 4, 6), RESPONSE_OK);
+
+    sqlite3_stmt * stmt;
+    ck_assert_int_eq(sqlite3_prepare_v2(db_fd, "SELECT (SELECT COUNT(*) FROM client) + (SELECT COUNT(*) FROM showcase)"
+                                               " + (SELECT COUNT(*) FROM booking)", -1, &stmt, NULL), SQLITE_OK);
+    ck_assert_int_eq(sqlite3_step(stmt), SQLITE_ROW);
+    ck_assert_int_eq(sqlite3_column_int(stmt, 0), 2 + 2 + 3);
+    sqlite3_finalize(stmt);
+
+    database_close();
+    unlink(BENCH_DATABASE);
+END_TEST
+
+
+Suite * suite(void) {
+    Suite *s   = suite_create("index_bench");
+    TCase *tc  = tcase_create("index_bench");
+
+    tcase_set_timeout(tc, 600);
+    tcase_add_test(tc, test_migrations_version);
+    tcase_add_test(tc, test_migrate_duplicates);
+    tcase_add_test(tc, test_index_bench);
+    suite_add_tcase(s, tc);
+
+    return s;
+}
+
+int main(int argc, char * argv[]) {
+    if (argc > 1) {
+        bookings = atoi(argv[1]) > 0 ? atoi(argv[1]) : DEFAULT_BOOKINGS;
+    }
+
+    int number_failed;
+    SRunner *sr = srunner_create(suite());
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,144 @@
+#include <check.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <server/lock_manager.h>
+#include <frame.h>
+
+static void keys(const char * request, LockKeys * keys) {
+    lock_keys_from_request(request, strlen(request), keys);
+}
+
+START_TEST(test_lock_keys_reads)
+    LockKeys k;
+
+    keys("3\n.\n", &k);
+    ck_assert_int_eq(k.count, 0);
+    keys("5\nmovie\n2\n3\n.\n", &k);
+    ck_assert_int_eq(k.count, 0);
+    keys("8\nclient\n.\n", &k);
+    ck_assert_int_eq(k.count, 0);
+END_TEST
+
+START_TEST(test_lock_keys_writes)
+    LockKeys booking, cancel, showcase, client;
+
+    keys("6\nclient\nmovie\n2\n3\n4\n.\n", &booking);
+    keys("7\nother\nmovie\n2\n3\n5\n.\n", &cancel);
+    keys("2\nmovie\n2\n3\n.\n", &showcase);
+    keys("0\nclient\n.\n", &client);
+
+    ck_assert_int_eq(booking.count, 1);
+    ck_assert_str_eq(booking.keys[0], cancel.keys[0]);
+    ck_assert_str_eq(booking.keys[0], showcase.keys[0]);
+    ck_assert_int_eq(client.count, 1);
+    ck_assert_int_ne(strcmp(client.keys[0], booking.keys[0]), 0);
+
+    // la suscripcion toma la funcion aunque solo lee
+    LockKeys subscribe;
+    keys("11\nmovie\n2\n3\n.\n", &subscribe);
+    ck_assert_int_eq(subscribe.count, 1);
+    ck_assert_str_eq(subscribe.keys[0], booking.keys[0]);
+END_TEST
+
+START_TEST(test_lock_keys_frames)
+    LockKeys text, binary, client;
+    FrameWriter writer;
+
+    keys("6\nclient\nmovie\n2\n3\n4\n.\n", &text);
+
+    frame_writer_init(&writer, REMOVE_BOOKING);
+    frame_put_string(&writer, "client");
+    frame_put_string(&writer, "movie");
+    frame_put_int(&writer, 2);
+    frame_put_int(&writer, 3);
+    frame_put_int(&writer, 4);
+    lock_keys_from_request(writer.data, frame_writer_finish(&writer), &binary);
+
+    // un pedido binario y uno de texto sobre la misma funcion comparten la key
+    ck_assert_int_eq(binary.count, 1);
+    ck_assert_str_eq(binary.keys[0], text.keys[0]);
+
+    frame_writer_reset(&writer, ADD_CLIENT);
+    frame_put_string(&writer, "client");
+    lock_keys_from_request(writer.data, frame_writer_finish(&writer), &client);
+    ck_assert_int_eq(client.count, 1);
+    ck_assert_str_eq(client.keys[0], "cclient");
+
+    frame_writer_free(&writer);
+END_TEST
+
+START_TEST(test_lock_conflicts)
+    LockManager manager = lock_manager_new();
+    LockKeys room1, room1_again, room2, read;
+
+    keys("6\nclient\nmovie\n2\n1\n4\n.\n", &room1);
+    keys("6\nclient\nmovie\n2\n1\n5\n.\n", &room1_again);
+    keys("6\nclient\nmovie\n2\n2\n4\n.\n", &room2);
+    keys("3\n.\n", &read);
+
+    ck_assert(lock_manager_try_acquire(manager, &room1));
+    ck_assert(!lock_manager_try_acquire(manager, &room1_again));
+    ck_assert(lock_manager_try_acquire(manager, &room2));
+    ck_assert(lock_manager_try_acquire(manager, &read));
+
+    lock_manager_release(manager, &room1);
+    ck_assert(lock_manager_try_acquire(manager, &room1_again));
+
+    lock_manager_release(manager, &room1_again);
+    lock_manager_release(manager, &room2);
+    lock_manager_destroy(manager);
+END_TEST
+
+START_TEST(test_lock_keys_batch)
+    LockKeys batch, booking, other;
+
+    // seis asientos de la misma funcion y un cliente nuevo: una key por funcion o cliente
+    char request[1024] = "10\n0\nfriend\n";
+    for (int seat = 0; seat < 6; seat++) {
+        sprintf(request + strlen(request), "6\nclient\nmovie\n2\n3\n%d\n", seat);
+    }
+    strcat(request, "6\nclient\nother\n4\n1\n0\n.\n");
+    keys(request, &batch);
+    keys("6\nclient\nmovie\n2\n3\n40\n.\n", &booking);
+    keys("6\nclient\nother\n4\n1\n9\n.\n", &other);
+
+    ck_assert_int_eq(batch.count, 3);
+    ck_assert_str_eq(batch.keys[0], "cfriend");
+    ck_assert_str_eq(batch.keys[1], booking.keys[0]);
+    ck_assert_str_eq(batch.keys[2], other.keys[0]);
+
+    // un BATCH conflictua con cualquier escritura sobre sus funciones
+    LockManager manager = lock_manager_new();
+    ck_assert(lock_manager_try_acquire(manager, &batch));
+    ck_assert(!lock_manager_try_acquire(manager, &other));
+    lock_manager_release(manager, &batch);
+    ck_assert(lock_manager_try_acquire(manager, &other));
+    lock_manager_release(manager, &other);
+    lock_manager_destroy(manager);
+END_TEST
+
+
+Suite * suite(void) {
+    Suite *s   = suite_create("lock_manager");
+    TCase *tc  = tcase_create("lock_manager");
+
+    tcase_add_test(tc, test_lock_keys_reads);
+    tcase_add_test(tc, test_lock_keys_writes);
+    tcase_add_test(tc, test_lock_keys_frames);
+    tcase_add_test(tc, test_lock_conflicts);
+    tcase_add_test(tc, test_lock_keys_batch);
+    suite_add_tcase(s, tc);
+
+    return s;
+}
+
+int main(int argc, char * argv[]) {
+    int number_failed;
+    SRunner *sr = srunner_create(suite());
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,224 @@
+#include <check.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <parser.h>
+#include <multiline_parser.h>
+#include <protocol.h>
+#include <database/request_parser.h>
+
+/**
+ * Benchmark del motor de parsers: MB/s del parser multilinea recorriendo las
+ * transiciones de cada estado por byte (como lo hacia parser_feed antes de compilar
+ * la definicion), con la tabla compilada de a un byte y con parser_feed_buffer.
+ * Tambien compara el parser de pedidos creado para cada pedido y reutilizado con reset.
+ *
+ * Uso: parser_bench [iteraciones]
+ */
+
+#define DEFAULT_ITERATIONS  2000
+#define EVENT_BATCH         64
+
+static int iterations = DEFAULT_ITERATIONS;
+
+/** Version anterior de parser_feed: busca en orden la transicion que acepta el byte */
+typedef struct {
+    const ParserDefinition * def;
+    const unsigned * classes;
+    unsigned state;
+    ParserEvent e1, e2;
+} LegacyParser;
+
+static const ParserEvent * legacy_feed(LegacyParser * p, const uint8_t c) {
+    const unsigned type = p->classes[c];
+    const ParserStateTransition * state = p->def->states[p->state];
+    const size_t n = p->def->states_n[p->state];
+
+    p->e1.next = p->e2.next = 0;
+    for (unsigned i = 0; i < n; i++) {
+        const int when = state[i].when;
+        bool matched = when <= 0xFF ? c == when : when == ANY ? true : (type & when) != 0;
+        if (matched) {
+            state[i].act1(&p->e1, c);
+            if (state[i].act2 != NULL) {
+                p->e1.next = &p->e2;
+                state[i].act2(&p->e2, c);
+            }
+            p->state = state[i].dest;
+            break;
+        }
+    }
+    return &p->e1;
+}
+
+/** Respuesta de texto de SEATS lineas, como la de GET_SEATS antes del mapa de asientos */
+static size_t seats_response(char * buffer) {
+    char * aux = buffer;
+    aux += sprintf(aux, "%d\n", RESPONSE_OK);
+    for (int i = 0; i < SEATS; i++) {
+        aux += sprintf(aux, "%d\n", i % 3 == 0 ? RESERVED_SEAT : EMPTY_SEAT);
+    }
+    aux += sprintf(aux, ".\n");
+    return (size_t) (aux - buffer);
+}
+
+static double elapsed(struct timespec * start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+START_TEST(test_parser_equivalence)
+    // bytes al azar con muchos \n y . para recorrer todos los estados
+    uint8_t input[4096];
+    srand(1);
+    for (size_t i = 0; i < sizeof(input); i++) {
+        int r = rand() % 4;
+        input[i] = r == 0 ? '\n' : r == 1 ? '.' : (uint8_t) rand();
+    }
+
+    LegacyParser legacy = {.def = multiline_parser_definition(), .classes = parser_no_classes()};
+    legacy.state = legacy.def->start_state;
+    Parser * table = parser_init(parser_no_classes(), multiline_parser_definition());
+    Parser * buffered = parser_init(parser_no_classes(), multiline_parser_definition());
+    ParserEvent events[EVENT_BATCH];
+    size_t count = 0, next = 0, fed = 0;
+
+    for (size_t i = 0; i < sizeof(input); i++) {
+        const ParserEvent * expected = legacy_feed(&legacy, input[i]);
+        const ParserEvent * actual = parser_feed(table, input[i]);
+
+        for (const ParserEvent * e = expected; e != NULL; e = e->next, actual = actual->next) {
+            ck_assert_ptr_ne(actual, NULL);
+            ck_assert_uint_eq(actual->type, e->type);
+            ck_assert_uint_eq(actual->n, e->n);
+            ck_assert_int_eq(memcmp(actual->data, e->data, e->n), 0);
+
+            // los eventos por buffer salen en el mismo orden
+            if (next == count) {
+                fed += parser_feed_buffer(buffered, input + fed, sizeof(input) - fed, events, EVENT_BATCH, &count);
+                next = 0;
+            }
+            ck_assert_uint_eq(events[next].type, e->type);
+            ck_assert_int_eq(memcmp(events[next].data, e->data, e->n), 0);
+            next++;
+        }
+        ck_assert_ptr_eq(actual, NULL);
+    }
+
+    parser_destroy(table);
+    parser_destroy(buffered);
+END_TEST
+
+START_TEST(test_parser_bench)
+    char message[BUFFER_SIZE];
+    size_t len = seats_response(message);
+    const uint8_t * bytes = (const uint8_t *) message;
+    size_t events = 0;
+    struct timespec start;
+
+    LegacyParser legacy = {.def = multiline_parser_definition(), .classes = parser_no_classes()};
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations; i++) {
+        legacy.state = legacy.def->start_state;
+        for (size_t j = 0; j < len; j++) {
+            events += legacy_feed(&legacy, bytes[j])->type == MULTI_BYTE;
+        }
+    }
+    double legacy_time = elapsed(&start);
+
+    Parser * parser = parser_init(parser_no_classes(), multiline_parser_definition());
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations; i++) {
+        parser_reset(parser);
+        for (size_t j = 0; j < len; j++) {
+            events += parser_feed(parser, bytes[j])->type == MULTI_BYTE;
+        }
+    }
+    double table_time = elapsed(&start);
+
+    ParserEvent batch[EVENT_BATCH];
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations; i++) {
+        parser_reset(parser);
+        for (size_t j = 0, count; j < len;) {
+            j += parser_feed_buffer(parser, bytes + j, len - j, batch, EVENT_BATCH, &count);
+            for (size_t k = 0; k < count; k++) {
+                events += batch[k].type == MULTI_BYTE;
+            }
+        }
+    }
+    double buffer_time = elapsed(&start);
+    parser_destroy(parser);
+
+    // las tres formas ven los mismos bytes
+    ck_assert_uint_eq(events % 3, 0);
+
+    double megabytes = (double) len * iterations / (1 << 20);
+    fprintf(stderr, "Multiline parser over %d responses of %d lines (%zu bytes)\n", iterations, SEATS, len);
+    fprintf(stderr, "  transition scan %8.1f MB/s\n", megabytes / legacy_time);
+    fprintf(stderr, "  compiled table  %8.1f MB/s\n", megabytes / table_time);
+    fprintf(stderr, "  feed_buffer     %8.1f MB/s\n", megabytes / buffer_time);
+END_TEST
+
+START_TEST(test_request_parser_bench)
+    const char * request = "6\nclient_name\nmovie_name\n4\n4\n2\n.\n";
+    size_t len = strlen(request);
+    char message[BUFFER_SIZE];
+    RequestParser parser;
+    struct timespec start;
+
+    // el parser termina los argumentos sobre el mensaje, se vuelve a copiar en cada vuelta
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations * 10; i++) {
+        memcpy(message, request, len);
+        request_parser_init(&parser);
+        ck_assert_uint_eq(request_parser_feed_buffer(&parser, message, len), request_done);
+        request_parser_destroy(&parser);
+    }
+    double init_time = elapsed(&start);
+
+    request_parser_init(&parser);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations * 10; i++) {
+        memcpy(message, request, len);
+        request_parser_reset(&parser);
+        ck_assert_uint_eq(request_parser_feed_buffer(&parser, message, len), request_done);
+    }
+    double reset_time = elapsed(&start);
+    ck_assert_str_eq(parser.request->args[1], "movie_name");
+    request_parser_destroy(&parser);
+
+    fprintf(stderr, "ADD_BOOKING request parser over %d requests\n", iterations * 10);
+    fprintf(stderr, "  init/destroy %8.0f ns/request\n", init_time * 1e9 / (iterations * 10));
+    fprintf(stderr, "  reset        %8.0f ns/request\n", reset_time * 1e9 / (iterations * 10));
+END_TEST
+
+
+Suite * suite(void) {
+    Suite *s   = suite_create("parser_bench");
+    TCase *tc  = tcase_create("parser_bench");
+
+    tcase_set_timeout(tc, 120);
+    tcase_add_test(tc, test_parser_equivalence);
+    tcase_add_test(tc, test_parser_bench);
+    tcase_add_test(tc, test_request_parser_bench);
+    suite_add_tcase(s, tc);
+
+    return s;
+}
+
+int main(int argc, char * argv[]) {
+    if (argc > 1) {
+        iterations = atoi(argv[1]) > 0 ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+    }
+
+    int number_failed;
+    SRunner *sr = srunner_create(suite());
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
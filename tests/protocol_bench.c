@@ -0,0 +1,244 @@
+#include <check.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <message.h>
+#include <protocol.h>
+#include <frame.h>
+#include <client/response_parser.h>
+
+/**
+ * Benchmark del protocolo: pedidos por segundo contra el server (modo epoll) con el
+ * protocolo de texto y con el binario, y el costo de decodificar cada respuesta en
+ * el cliente. Se corre desde el directorio donde se generan los binarios.
+ *
+ * Uso: protocol_bench [pedidos]
+ */
+
+#define SERVER_PROC         "./server"
+#define BENCH_DATABASE      "protocol_bench.db"
+#define BENCH_PORT          22445
+#define RESPONSE_SIZE       4096
+#define DEFAULT_REQUESTS    2000
+#define DECODES             20000
+
+static int requests = DEFAULT_REQUESTS;
+
+/** Pedido medido, en los dos formatos */
+typedef struct {
+    const char * name;
+    const char * text;
+    void (*frame)(FrameWriter * writer);
+    int argc;
+} BenchRequest;
+
+static void seats_frame(FrameWriter * writer) {
+    frame_writer_reset(writer, GET_SEATS);
+    frame_put_string(writer, "movie");
+    frame_put_int(writer, 2);
+    frame_put_int(writer, 3);
+}
+
+static void movies_frame(FrameWriter * writer) {
+    frame_writer_reset(writer, GET_MOVIES);
+}
+
+static void booking_frame(FrameWriter * writer) {
+    frame_writer_reset(writer, GET_BOOKING);
+    frame_put_string(writer, "client");
+}
+
+static const BenchRequest bench_requests[] = {
+        {"GET_SEATS",   "5\nmovie\n2\n3\n.\n", seats_frame,   1},
+        {"GET_MOVIES",  "3\n.\n",              movies_frame,  1},
+        {"GET_BOOKING", "8\nclient\n.\n",      booking_frame, 4 * 8},
+};
+#define BENCH_REQUESTS (sizeof(bench_requests) / sizeof(bench_requests[0]))
+
+static pid_t server_pid;
+static int fd;
+
+static int connect_server(int port) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t) port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    struct timespec wait = {.tv_sec = 0, .tv_nsec = 20 * 1000 * 1000};
+    for (int i = 0; i < 250; i++) {
+        int ret = socket(AF_INET, SOCK_STREAM, 0);
+        if (ret < 0) {
+            return -1;
+        }
+        if (connect(ret, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+            return ret;
+        }
+        close(ret);
+        nanosleep(&wait, NULL);
+    }
+
+    return -1;
+}
+
+/** Lee una respuesta completa, retorna su largo */
+static size_t receive(char * response) {
+    MessageScanner scanner;
+    message_scanner_init(&scanner);
+    size_t len = 0;
+    bool done = false;
+
+    while (!done && len < RESPONSE_SIZE) {
+        ssize_t n = recv(fd, response + len, RESPONSE_SIZE - len, 0);
+        ck_assert_int_gt(n, 0);
+        message_scan(&scanner, response + len, (size_t) n, &done);
+        len += (size_t) n;
+    }
+    return len;
+}
+
+static size_t round_trip(const char * request, size_t len, char * response) {
+    ck_assert_int_eq(send(fd, request, len, 0), len);
+    return receive(response);
+}
+
+/** Decodifica una respuesta en cualquiera de los dos formatos, como lo hace el cliente */
+static Response * decode(const char * message, size_t len) {
+    if (is_frame(message, len)) {
+        return response_from_frame(message, len);
+    }
+
+    Response * response = new_response();
+    ResponseParser parser;
+    response_parser_init(&parser, response);
+    response_parser_feed_buffer(&parser, message, len);
+    response_parser_destroy(&parser);
+    return response;
+}
+
+static double elapsed(struct timespec * start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/** Retorna los pedidos por segundo, cada respuesta se decodifica y se verifica */
+static double run(const BenchRequest * bench, const char * request, size_t len) {
+    char response[RESPONSE_SIZE];
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < requests; i++) {
+        Response * decoded = decode(response, round_trip(request, len, response));
+        ck_assert_ptr_ne(decoded, NULL);
+        ck_assert_int_eq(decoded->status, RESPONSE_OK);
+        ck_assert_int_eq(decoded->argc, bench->argc);
+        destroy_response(decoded);
+    }
+    return requests / elapsed(&start);
+}
+
+/** Retorna los nanosegundos que lleva decodificar la respuesta */
+static double decode_time(const char * request, size_t len) {
+    char response[RESPONSE_SIZE];
+    size_t response_len = round_trip(request, len, response);
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < DECODES; i++) {
+        destroy_response(decode(response, response_len));
+    }
+    return elapsed(&start) * 1e9 / DECODES;
+}
+
+static void setup(void) {
+    char port[8];
+    snprintf(port, sizeof(port), "%d", BENCH_PORT);
+    unlink(BENCH_DATABASE);
+
+    server_pid = fork();
+    if (server_pid == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        char * argv[] = {"server", "-p", port, "-f", BENCH_DATABASE, "-m", "epoll", NULL};
+        execv(SERVER_PROC, argv);
+        perror("execv() failed");
+        exit(EXIT_FAILURE);
+    }
+
+    fd = connect_server(BENCH_PORT);
+    ck_assert_int_ge(fd, 0);
+
+    char response[RESPONSE_SIZE], request[RESPONSE_SIZE];
+    const char * writes[] = {"0\nclient\n.\n", "1\nmovie\n2\n3\n.\n"};
+    for (size_t i = 0; i < sizeof(writes) / sizeof(writes[0]); i++) {
+        round_trip(writes[i], strlen(writes[i]), response);
+    }
+    for (int seat = 0; seat < 8; seat++) {
+        sprintf(request, "6\nclient\nmovie\n2\n3\n%d\n.\n", seat * 10);
+        round_trip(request, strlen(request), response);
+    }
+}
+
+static void teardown(void) {
+    close(fd);
+    kill(server_pid, SIGTERM);
+    waitpid(server_pid, NULL, 0);
+    unlink(BENCH_DATABASE);
+}
+
+START_TEST(test_protocol_bench)
+    FrameWriter writer;
+    frame_writer_init(&writer, 0);
+
+    fprintf(stderr, "Round trips over %d requests, text vs binary\n", requests);
+    for (size_t i = 0; i < BENCH_REQUESTS; i++) {
+        const BenchRequest * bench = &bench_requests[i];
+        bench->frame(&writer);
+        size_t frame_len = frame_writer_finish(&writer);
+
+        double text   = run(bench, bench->text, strlen(bench->text));
+        double binary = run(bench, writer.data, frame_len);
+        double text_decode   = decode_time(bench->text, strlen(bench->text));
+        double binary_decode = decode_time(writer.data, frame_len);
+        fprintf(stderr, "  %-12s text %8.0f req/s, decode %7.0f ns | binary %8.0f req/s, decode %7.0f ns\n",
+                bench->name, text, text_decode, binary, binary_decode);
+    }
+
+    frame_writer_free(&writer);
+END_TEST
+
+
+Suite * suite(void) {
+    Suite *s   = suite_create("protocol_bench");
+    TCase *tc  = tcase_create("protocol_bench");
+
+    tcase_set_timeout(tc, 120);
+    tcase_add_checked_fixture(tc, setup, teardown);
+    tcase_add_test(tc, test_protocol_bench);
+    suite_add_tcase(s, tc);
+
+    return s;
+}
+
+int main(int argc, char * argv[]) {
+    if (argc > 1) {
+        requests = atoi(argv[1]) > 0 ? atoi(argv[1]) : DEFAULT_REQUESTS;
+    }
+
+    int number_failed;
+    SRunner *sr = srunner_create(suite());
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,14 +1,20 @@
 #include <check.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 #include <database/request_parser.h>
+#include <frame.h>
+#include "alloc_count.h"
 
 extern bool debug;
 
 START_TEST(test_request_add_client)
     RequestParser parser;
 
+    char message[] = "0\nclient_name\n.\n";
+
     request_parser_init(&parser);
-    request_state state = request_parser_consume(&parser, "0\nclient_name\n.\n");
+    request_state state = request_parser_consume(&parser, message);
 
     ck_assert_uint_eq(state, request_done);
     ck_assert_uint_eq(parser.request->type, ADD_CLIENT);
@@ -21,8 +27,10 @@ END_TEST
 START_TEST(test_request_add_booking)
     RequestParser parser;
 
+    char message[] = "6\nclient_name\nmovie_name\n4\n4\n2\n.\n";
+
     request_parser_init(&parser);
-    request_state state = request_parser_consume(&parser, "6\nclient_name\nmovie_name\n4\n4\n2\n.\n");
+    request_state state = request_parser_consume(&parser, message);
 
     ck_assert_uint_eq(state, request_done);
     ck_assert_uint_eq(parser.request->type, ADD_BOOKING);
@@ -39,8 +47,10 @@ END_TEST
 START_TEST(test_request_invalid_cmd)
     RequestParser parser;
 
+    char message[] = "-1\n.\n";
+
     request_parser_init(&parser);
-    request_state state = request_parser_consume(&parser, "-1\n.\n");
+    request_state state = request_parser_consume(&parser, message);
 
     ck_assert_uint_eq(state, request_error_invalid_cmd);
 
@@ -49,16 +59,13 @@ END_TEST
 
 START_TEST(test_request_arg_too_long)
     RequestParser parser;
+    char message[ARG_SIZE * 2 + 8] = "0\n";
 
-    request_parser_init(&parser);
-    request_state state = request_parser_consume(&parser, "0\n");
+    memset(message + 2, '-', ARG_SIZE * 2);
+    strcat(message, "\n.\n");
 
-    for (int i = 0; i < ARG_SIZE * 2; i++) {
-        state = request_parser_consume(&parser, "-");
-        if (state > request_done) {
-            break;
-        }
-    }
+    request_parser_init(&parser);
+    request_state state = request_parser_consume(&parser, message);
 
     ck_assert_uint_eq(state, request_error_argument_too_long);
 
@@ -67,20 +74,266 @@ END_TEST
 
 START_TEST(test_request_too_many_args)
     RequestParser parser;
+    char message[MAX_ARGS * 4 + 8] = "0\n";
+
+    for (int i = 0; i < MAX_ARGS * 2; i++) {
+        strcat(message, "-\n");
+    }
+    strcat(message, ".\n");
 
     request_parser_init(&parser);
-    request_state state = request_parser_consume(&parser, "0\n");
+    request_state state = request_parser_consume(&parser, message);
 
-    for (int i = 0; i < MAX_ARGS * 2; i++) {
-        state = request_parser_consume(&parser, "-\n");
-        if (state > request_done) {
-            break;
+    ck_assert_uint_eq(state, request_error_too_many_arguments);
+
+    request_parser_destroy(&parser);
+END_TEST
+
+START_TEST(test_request_dot_arg)
+    RequestParser parser;
+    char message[] = "0\n.name\n\n..\n.\n";
+
+    request_parser_init(&parser);
+    request_state state = request_parser_consume(&parser, message);
+
+    ck_assert_uint_eq(state, request_done);
+    ck_assert_uint_eq(parser.request->argc, 2);
+    ck_assert_str_eq(parser.request->args[0], ".name");
+    ck_assert_str_eq(parser.request->args[1], "..");
+    ck_assert_uint_eq(parser.request->lengths[1], 2);
+
+    request_parser_destroy(&parser);
+END_TEST
+
+START_TEST(test_request_short)
+    RequestParser parser;
+    char booking[] = "6\nclient_name\nmovie_name\n2\n3\n7\n.\n";
+    char add_booking[] = "6\nbob\n.\n";
+    char seats[] = "5\n.\n";
+    char batch[] = "10\n0\nbob\n6\nbob\nmovie_name\n.\n";
+
+    request_parser_init(&parser);
+    ck_assert_uint_eq(request_parser_consume(&parser, booking), request_done);
+    ck_assert(request_has_args(parser.request));
+
+    // el pedido siguiente no hereda los argumentos del anterior
+    request_parser_reset(&parser);
+    ck_assert_uint_eq(request_parser_consume(&parser, add_booking), request_done);
+    ck_assert_uint_eq(parser.request->argc, 1);
+    ck_assert_ptr_eq(parser.request->args[1], NULL);
+    ck_assert(!request_has_args(parser.request));
+
+    request_parser_reset(&parser);
+    ck_assert_uint_eq(request_parser_consume(&parser, seats), request_done);
+    ck_assert(!request_has_args(parser.request));
+
+    // a la segunda escritura del BATCH le faltan argumentos
+    request_parser_reset(&parser);
+    ck_assert_uint_eq(request_parser_consume(&parser, batch), request_done);
+    ck_assert(!request_has_args(parser.request));
+
+    request_parser_destroy(&parser);
+END_TEST
+
+START_TEST(test_request_reuse)
+    RequestParser parser;
+    FrameWriter writer;
+    char message[BUFFER_SIZE];
+
+    request_parser_init(&parser);
+    frame_writer_init(&writer, REMOVE_BOOKING);
+    ck_assert_uint_gt(alloc_count(), 0);
+
+    // los argumentos apuntan al mensaje, reutilizar el parser no pide memoria; la primera
+    // vuelta queda afuera porque agranda el buffer del writer y el de stdout (debug)
+    size_t allocations = 0;
+    for (int i = 0; i < 100; i++) {
+        if (i == 1) {
+            allocations = alloc_count();
         }
+        request_parser_reset(&parser);
+        sprintf(message, "6\nclient_%d\nmovie\n%d\n4\n%d\n.\n", i, i % 7, i % SEATS);
+        ck_assert_uint_eq(request_parser_consume(&parser, message), request_done);
+        ck_assert_uint_eq(parser.request->type, ADD_BOOKING);
+        ck_assert_uint_eq(parser.request->argc, 5);
+        ck_assert_int_eq(atoi(parser.request->args[0] + strlen("client_")), i);
+        ck_assert_int_eq(atoi(parser.request->args[4]), i % SEATS);
+
+        frame_writer_reset(&writer, REMOVE_BOOKING);
+        frame_put_string(&writer, "client");
+        frame_put_int(&writer, i);
+        size_t len = frame_writer_finish(&writer);
+        request_parser_reset(&parser);
+        ck_assert(request_from_frame(parser.request, writer.data, len));
+        ck_assert_uint_eq(parser.request->argc, 2);
+        ck_assert_str_eq(parser.request->args[0], "client");
+        ck_assert_int_eq(atoi(parser.request->args[1]), i);
     }
+    ck_assert_uint_eq(alloc_count(), allocations);
 
-    ck_assert_uint_eq(state, request_error_too_many_arguments);
+    frame_writer_free(&writer);
+    request_parser_destroy(&parser);
+END_TEST
+
+START_TEST(test_request_frame_add_booking)
+    FrameWriter writer;
+    frame_writer_init(&writer, ADD_BOOKING);
+    frame_put_string(&writer, "client_name");
+    frame_put_string(&writer, "movie_name");
+    frame_put_int(&writer, 4);
+    frame_put_int(&writer, 4);
+    frame_put_int(&writer, 2);
+    size_t len = frame_writer_finish(&writer);
+
+    Request * request = new_request();
+    ck_assert(request_from_frame(request, writer.data, len));
+    ck_assert_uint_eq(request->type, ADD_BOOKING);
+    ck_assert_uint_eq(request->argc, 5);
+    ck_assert_str_eq(request->args[0], "client_name");
+    ck_assert_str_eq(request->args[1], "movie_name");
+    ck_assert_str_eq(request->args[2], "4");
+    ck_assert_str_eq(request->args[3], "4");
+    ck_assert_str_eq(request->args[4], "2");
+
+    // mensaje incompleto
+    request_reset(request);
+    ck_assert(!request_from_frame(request, writer.data, len - 1));
+
+    destroy_request(request);
+    frame_writer_free(&writer);
+END_TEST
+
+START_TEST(test_request_frame_invalid)
+    char name[ARG_SIZE * 2] = {0};
+    memset(name, 'a', sizeof(name) - 1);
+
+    FrameWriter writer;
+    frame_writer_init(&writer, ADD_CLIENT);
+    frame_put_string(&writer, name);
+    size_t len = frame_writer_finish(&writer);
+    Request * request = new_request();
+    ck_assert(!request_from_frame(request, writer.data, len));
+
+    frame_writer_reset(&writer, GET_MOVIES);
+    for (int i = 0; i <= MAX_ARGS; i++) {
+        frame_put_int(&writer, i);
+    }
+    len = frame_writer_finish(&writer);
+    request_reset(request);
+    ck_assert(!request_from_frame(request, writer.data, len));
+
+    destroy_request(request);
+    frame_writer_free(&writer);
+END_TEST
+
+START_TEST(test_request_id)
+    RequestParser parser;
+
+    char message[] = "6:42\nclient_name\nmovie_name\n4\n4\n2\n.\n";
+
+    request_parser_init(&parser);
+    ck_assert_uint_eq(request_parser_consume(&parser, message), request_done);
+    ck_assert_uint_eq(parser.request->type, ADD_BOOKING);
+    ck_assert(parser.request->has_id);
+    ck_assert_uint_eq(parser.request->id, 42);
+    ck_assert_uint_eq(parser.request->argc, 5);
+    ck_assert_str_eq(parser.request->args[0], "client_name");
+
+    // el id no pasa al pedido siguiente
+    char plain[] = "3\n.\n";
+    request_parser_reset(&parser);
+    ck_assert_uint_eq(request_parser_consume(&parser, plain), request_done);
+    ck_assert(!parser.request->has_id);
+
+    char invalid[] = "3:4a\n.\n";
+    request_parser_reset(&parser);
+    ck_assert_uint_eq(request_parser_consume(&parser, invalid), request_error_invalid_cmd);
+
+    // el id mas grande que entra en 32 bits, uno mas y uno de 11 digitos no entran
+    char largest[] = "3:4294967295\n.\n";
+    request_parser_reset(&parser);
+    ck_assert_uint_eq(request_parser_consume(&parser, largest), request_done);
+    ck_assert_uint_eq(parser.request->id, UINT32_MAX);
+    uint32_t text_id;
+    ck_assert(parse_message_id(largest, sizeof(largest) - 1, &text_id));
+    ck_assert_uint_eq(text_id, UINT32_MAX);
+
+    char overflow[] = "3:4294967296\n.\n";
+    ck_assert(!parse_message_id(overflow, sizeof(overflow) - 1, &text_id));
+    request_parser_reset(&parser);
+    ck_assert_uint_eq(request_parser_consume(&parser, overflow), request_error_invalid_cmd);
+
+    char digits[] = "3:00000000001\n.\n";
+    ck_assert(!parse_message_id(digits, sizeof(digits) - 1, &text_id));
+    request_parser_reset(&parser);
+    ck_assert_uint_eq(request_parser_consume(&parser, digits), request_error_invalid_cmd);
 
     request_parser_destroy(&parser);
+
+    FrameWriter writer;
+    frame_writer_init(&writer, GET_SHOWCASES);
+    frame_writer_set_id(&writer, 70000);
+    frame_put_string(&writer, "movie_name");
+    size_t len = frame_writer_finish(&writer);
+
+    uint32_t id;
+    ck_assert(parse_message_id(writer.data, len, &id));
+    ck_assert_uint_eq(id, 70000);
+    ck_assert_int_eq(parse_request_type(writer.data, len), GET_SHOWCASES);
+
+    Request * request = new_request();
+    ck_assert(request_from_frame(request, writer.data, len));
+    ck_assert(request->has_id);
+    ck_assert_uint_eq(request->id, 70000);
+    ck_assert_str_eq(request->args[0], "movie_name");
+    destroy_request(request);
+
+    // despues del primer argumento ya no entra
+    frame_writer_reset(&writer, GET_SHOWCASES);
+    frame_put_string(&writer, "movie_name");
+    frame_writer_set_id(&writer, 1);
+    ck_assert_uint_eq(frame_writer_finish(&writer), 0);
+    frame_writer_free(&writer);
+END_TEST
+
+START_TEST(test_request_batch)
+    RequestParser parser;
+    char message[BUFFER_SIZE] = "10\n";
+
+    // mas argumentos que cualquier otro pedido
+    for (int seat = 0; seat < 6; seat++) {
+        sprintf(message + strlen(message), "6\nclient_name\nmovie_name\n4\n4\n%d\n", seat);
+    }
+    strcat(message, ".\n");
+
+    request_parser_init(&parser);
+    ck_assert_uint_eq(request_parser_consume(&parser, message), request_done);
+    ck_assert_uint_eq(parser.request->type, BATCH);
+    ck_assert_uint_eq(parser.request->argc, 6 * 6);
+    ck_assert_str_eq(parser.request->args[6], "6");
+    ck_assert_str_eq(parser.request->args[6 * 6 - 1], "5");
+    request_parser_destroy(&parser);
+
+    FrameWriter writer;
+    frame_writer_init(&writer, BATCH);
+    for (int i = 0; i < MAX_BATCH_ARGS; i++) {
+        frame_put_int(&writer, i);
+    }
+    size_t len = frame_writer_finish(&writer);
+    Request * request = new_request();
+    ck_assert(request_from_frame(request, writer.data, len));
+    ck_assert_int_eq(request->argc, MAX_BATCH_ARGS);
+
+    frame_writer_reset(&writer, BATCH);
+    for (int i = 0; i <= MAX_BATCH_ARGS; i++) {
+        frame_put_int(&writer, i);
+    }
+    len = frame_writer_finish(&writer);
+    request_reset(request);
+    ck_assert(!request_from_frame(request, writer.data, len));
+
+    destroy_request(request);
+    frame_writer_free(&writer);
 END_TEST
 
 
@@ -93,6 +346,13 @@ Suite * suite() {
     tcase_add_test(tc, test_request_invalid_cmd);
     tcase_add_test(tc, test_request_arg_too_long);
     tcase_add_test(tc, test_request_too_many_args);
+    tcase_add_test(tc, test_request_dot_arg);
+    tcase_add_test(tc, test_request_short);
+    tcase_add_test(tc, test_request_reuse);
+    tcase_add_test(tc, test_request_frame_add_booking);
+    tcase_add_test(tc, test_request_frame_invalid);
+    tcase_add_test(tc, test_request_id);
+    tcase_add_test(tc, test_request_batch);
 
     suite_add_tcase(s, tc);
 
@@ -0,0 +1,156 @@
+#include <check.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <protocol.h>
+#include <frame.h>
+#include <client/response_parser.h>
+#include "alloc_count.h"
+
+/**
+ * Pedidos de memoria y tiempo por respuesta decodificada en el cliente, para
+ * respuestas con cada vez mas argumentos: GET_SEATS y historiales de GET_BOOKING
+ * de distinto largo, en texto y en binario. Con la arena de la respuesta los
+ * pedidos de memoria no dependen de la cantidad de argumentos.
+ *
+ * Uso: response_bench [iteraciones]
+ */
+
+#define DEFAULT_ITERATIONS  2000
+
+static int iterations = DEFAULT_ITERATIONS;
+
+/** Respuesta de GET_SEATS en texto, con el mapa de asientos en hexadecimal */
+static size_t seats_response(char * buffer) {
+    uint8_t map[SEATMAP_BYTES] = {0};
+    for (int i = 0; i < SEATS; i += 3) {
+        seatmap_set(map, i);
+    }
+
+    char * aux = buffer;
+    aux += sprintf(aux, "%d\n", RESPONSE_OK);
+    for (int i = 0; i < SEATMAP_BYTES; i++) {
+        aux += sprintf(aux, "%02x", map[i]);
+    }
+    aux += sprintf(aux, "\n.\n");
+    return (size_t) (aux - buffer);
+}
+
+/** Respuesta de GET_BOOKING con tickets reservas, en texto */
+static size_t booking_response(char * buffer, int tickets) {
+    char * aux = buffer;
+    aux += sprintf(aux, "%d\n", RESPONSE_OK);
+    for (int i = 0; i < tickets; i++) {
+        aux += sprintf(aux, "movie %d\n%d\n%d\n%d\n", i, i % 7, 1 + i % 5, i % SEATS);
+    }
+    aux += sprintf(aux, ".\n");
+    return (size_t) (aux - buffer);
+}
+
+/** La misma respuesta de GET_BOOKING en binario */
+static size_t booking_frame(FrameWriter * writer, int tickets) {
+    char movie[32];
+    frame_writer_reset(writer, RESPONSE_OK);
+    for (int i = 0; i < tickets; i++) {
+        snprintf(movie, sizeof(movie), "movie %d", i);
+        frame_put_string(writer, movie);
+        frame_put_int(writer, i % 7);
+        frame_put_int(writer, 1 + i % 5);
+        frame_put_int(writer, i % SEATS);
+    }
+    return frame_writer_finish(writer);
+}
+
+/** Decodifica la respuesta como client_wait_response */
+static Response * decode(const char * message, size_t len) {
+    if (is_frame(message, len)) {
+        return response_from_frame(message, len);
+    }
+
+    Response * response = new_response();
+    ResponseParser parser;
+    response_parser_init(&parser, response);
+    response_parser_feed_buffer(&parser, message, len);
+    response_parser_destroy(&parser);
+    return response;
+}
+
+static double elapsed(struct timespec * start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/** Mide las decodificaciones de un mensaje, retorna los pedidos de memoria por respuesta */
+static size_t measure(const char * name, const char * message, size_t len, int argc) {
+    struct timespec start;
+    size_t allocations = alloc_count();
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations; i++) {
+        Response * response = decode(message, len);
+        ck_assert_ptr_ne(response, NULL);
+        ck_assert_int_eq(response->argc, argc);
+        destroy_response(response);
+    }
+    double time = elapsed(&start);
+    size_t per_response = (alloc_count() - allocations) / (size_t) iterations;
+
+    fprintf(stderr, "  %-22s %5d args %8zu bytes %4zu allocs/response %9.0f ns/response\n",
+            name, argc, len, per_response, time * 1e9 / iterations);
+    return per_response;
+}
+
+START_TEST(test_response_bench)
+    static const int tickets[] = {1, 10, 100, 1000};
+    char name[32];
+    char * message = malloc(64 * 1024);
+    ck_assert_ptr_ne(message, NULL);
+    FrameWriter writer;
+    frame_writer_init(&writer, RESPONSE_OK);
+
+    fprintf(stderr, "Client side decoding over %d responses\n", iterations);
+    size_t text = measure("GET_SEATS text", message, seats_response(message), 1);
+
+    for (size_t i = 0; i < sizeof(tickets) / sizeof(tickets[0]); i++) {
+        snprintf(name, sizeof(name), "GET_BOOKING %d text", tickets[i]);
+        ck_assert_uint_eq(measure(name, message, booking_response(message, tickets[i]), tickets[i] * 4), text);
+    }
+
+    size_t binary = measure("GET_BOOKING 1 binary", writer.data, booking_frame(&writer, 1), 4);
+    for (size_t i = 1; i < sizeof(tickets) / sizeof(tickets[0]); i++) {
+        size_t len = booking_frame(&writer, tickets[i]);
+        snprintf(name, sizeof(name), "GET_BOOKING %d binary", tickets[i]);
+        ck_assert_uint_eq(measure(name, writer.data, len, tickets[i] * 4), binary);
+    }
+
+    frame_writer_free(&writer);
+    free(message);
+END_TEST
+
+
+Suite * suite(void) {
+    Suite *s   = suite_create("response_bench");
+    TCase *tc  = tcase_create("response_bench");
+
+    tcase_set_timeout(tc, 120);
+    tcase_add_test(tc, test_response_bench);
+    suite_add_tcase(s, tc);
+
+    return s;
+}
+
+int main(int argc, char * argv[]) {
+    if (argc > 1) {
+        iterations = atoi(argv[1]) > 0 ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+    }
+
+    int number_failed;
+    SRunner *sr = srunner_create(suite());
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
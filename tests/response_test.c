@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <protocol.h>
 #include <client/response_parser.h>
+#include <frame.h>
 
 extern bool debug;
 
@@ -75,28 +76,50 @@ START_TEST(test_response_extract_seats)
     ResponseParser parser;
     Response * response = new_response();
     response_parser_init(&parser, response);
-    response_parser_consume(&parser, "0\n");
-    for (int i = 0; i < SEATS; i++) {
-        response_parser_consume(&parser, "1\n");
-        ck_assert_uint_eq(parser.state, response_args);
-    }
-    response_parser_consume(&parser, ".\n");
+    // asientos 0, 9 y 79 reservados
+    response_parser_consume(&parser, "0\n80400000000000000001\n.\n");
 
     ck_assert_uint_eq(parser.state, response_done);
     ck_assert_uint_eq(response->status, RESPONSE_OK);
-    ck_assert_uint_eq(response->argc, SEATS);
+    ck_assert_uint_eq(response->argc, 1);
+    ck_assert_uint_eq(response_arg_len(response, 0), SEATMAP_HEX);
 
     int seats[SEATS];
     response_extract_seats(response, seats);
     for (int i = 0; i < SEATS; i++) {
-        ck_assert_str_eq(response->args[i], "1");
-        ck_assert_uint_eq(seats[i], EMPTY_SEAT);
+        ck_assert_uint_eq(seats[i], i == 0 || i == 9 || i == 79 ? RESERVED_SEAT : EMPTY_SEAT);
     }
 
     destroy_response(response);
     response_parser_destroy(&parser);
 END_TEST
 
+START_TEST(test_response_frame_seats)
+    uint8_t map[SEATMAP_BYTES] = {0};
+    seatmap_set(map, 9);
+    seatmap_set(map, 79);
+
+    // los bytes en 0 del mapa no cortan el argumento
+    FrameWriter writer;
+    frame_writer_init(&writer, RESPONSE_OK);
+    frame_put_bytes(&writer, map, SEATMAP_BYTES);
+    size_t len = frame_writer_finish(&writer);
+
+    Response * response = response_from_frame(writer.data, len);
+    ck_assert_ptr_ne(response, NULL);
+    ck_assert_uint_eq(response->argc, 1);
+    ck_assert_uint_eq(response_arg_len(response, 0), SEATMAP_BYTES);
+
+    int seats[SEATS];
+    response_extract_seats(response, seats);
+    for (int i = 0; i < SEATS; i++) {
+        ck_assert_uint_eq(seats[i], i == 9 || i == 79 ? RESERVED_SEAT : EMPTY_SEAT);
+    }
+
+    destroy_response(response);
+    frame_writer_free(&writer);
+END_TEST
+
 START_TEST(test_response_extract_movies)
     ResponseParser parser;
     Response * response = new_response();
@@ -198,6 +221,75 @@ START_TEST(test_response_extract_tickets)
     response_parser_destroy(&parser);
 END_TEST
 
+START_TEST(test_response_frame_tickets)
+    FrameWriter writer;
+    frame_writer_init(&writer, RESPONSE_OK);
+    frame_put_string(&writer, "movie");
+    frame_put_int(&writer, 2);
+    frame_put_int(&writer, 3);
+    frame_put_int(&writer, 40);
+    size_t len = frame_writer_finish(&writer);
+
+    Response * response = response_from_frame(writer.data, len);
+    ck_assert_ptr_ne(response, NULL);
+    ck_assert_int_eq(response->status, RESPONSE_OK);
+
+    List tickets = response_extract_tickets(response);
+
+    Ticket * ticket = list_get_next(tickets);
+    ck_assert_str_eq(ticket->showcase.movie_name, "movie");
+    ck_assert_uint_eq(ticket->showcase.day, TUE);
+    ck_assert_uint_eq(ticket->showcase.room, 3);
+    ck_assert_uint_eq(ticket->seat, 40);
+    destroy_ticket(ticket);
+
+    ck_assert_ptr_eq(list_get_next(tickets), NULL);
+    list_destroy(tickets);
+    destroy_response(response);
+
+    // un argumento cortado
+    ck_assert_ptr_eq(response_from_frame(writer.data, len - 2), NULL);
+    frame_writer_free(&writer);
+END_TEST
+
+START_TEST(test_response_id)
+    ResponseParser parser;
+    Response * response = new_response();
+    response_parser_init(&parser, response);
+    response_parser_consume(&parser, "0:7\nmovie\n.\n");
+
+    ck_assert_uint_eq(parser.state, response_done);
+    ck_assert_uint_eq(response->status, RESPONSE_OK);
+    ck_assert(response->has_id);
+    ck_assert_uint_eq(response->id, 7);
+    ck_assert_uint_eq(response->argc, 1);
+    ck_assert_str_eq(response->args[0], "movie");
+
+    destroy_response(response);
+    response_parser_destroy(&parser);
+
+    // un id que no entra en 32 bits
+    response = new_response();
+    response_parser_init(&parser, response);
+    response_parser_consume(&parser, "0:4294967296\n.\n");
+    ck_assert_uint_eq(parser.state, response_error);
+    destroy_response(response);
+    response_parser_destroy(&parser);
+
+    FrameWriter writer;
+    frame_writer_init(&writer, BAD_CLIENT);
+    frame_writer_set_id(&writer, 9);
+    size_t len = frame_writer_finish(&writer);
+
+    response = response_from_frame(writer.data, len);
+    ck_assert_ptr_ne(response, NULL);
+    ck_assert_int_eq(response->status, BAD_CLIENT);
+    ck_assert(response->has_id);
+    ck_assert_uint_eq(response->id, 9);
+    destroy_response(response);
+    frame_writer_free(&writer);
+END_TEST
+
 
 Suite * suite() {
     Suite *s = suite_create("response");
@@ -211,6 +303,9 @@ Suite * suite() {
     tcase_add_test(tc, test_response_extract_movies);
     tcase_add_test(tc, test_response_extract_showcases);
     tcase_add_test(tc, test_response_extract_tickets);
+    tcase_add_test(tc, test_response_frame_tickets);
+    tcase_add_test(tc, test_response_frame_seats);
+    tcase_add_test(tc, test_response_id);
 
     suite_add_tcase(s, tc);
 
@@ -0,0 +1,161 @@
+#include <check.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <ring.h>
+
+/**
+ * Transporte entre el server y la base: un proceso que devuelve cada mensaje hace de
+ * database, por pipes y por los anillos de ring.h. Se miden idas y vueltas de un pedido
+ * chico de a uno (el server espera cada respuesta) y en rafagas encadenadas (como el
+ * proceso de group commit).
+ *
+ * Uso: ring_bench [idas y vueltas]
+ */
+
+#define DEFAULT_ROUND_TRIPS 20000
+#define BURST               16
+
+static int round_trips = DEFAULT_ROUND_TRIPS;
+
+static const char message[] = "6\nclient\nmovie\n2\n3\n4\n.\n";
+#define MESSAGE_LEN (sizeof(message) - 1)
+
+/** Un lado del transporte: por pipes o por anillos */
+typedef struct {
+    int in, out;
+    Ring * requests, * responses;
+} Transport;
+
+static void transport_write(Transport * t, const char * data, size_t len) {
+    if (t->requests != NULL) {
+        ck_assert(ring_write(t->requests, data, len));
+    } else {
+        ck_assert_int_eq(write(t->in, data, len), len);
+    }
+}
+
+/** Lee exactamente len bytes */
+static void transport_read(Transport * t, char * buffer, size_t len) {
+    size_t read_bytes = 0;
+    while (read_bytes < len) {
+        ssize_t n = t->responses != NULL ? (ssize_t) ring_read(t->responses, buffer + read_bytes, len - read_bytes)
+                                         : read(t->out, buffer + read_bytes, len - read_bytes);
+        ck_assert_int_gt(n, 0);
+        read_bytes += (size_t) n;
+    }
+}
+
+/** Levanta el proceso que hace eco de todo lo que recibe hasta que se cierra su entrada */
+static pid_t start_echo(Transport * t, bool rings) {
+    int requests[2], responses[2];
+    t->requests = t->responses = NULL;
+
+    if (rings) {
+        int fd = ring_region_create();
+        ck_assert_int_ge(fd, 0);
+        ck_assert_int_eq(ring_region_map(fd, &t->requests, &t->responses), 0);
+        close(fd);
+    } else {
+        ck_assert_int_eq(pipe(requests), 0);
+        ck_assert_int_eq(pipe(responses), 0);
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        char buffer[4096];
+        if (!rings) {
+            close(requests[1]);
+            close(responses[0]);
+        }
+        while (true) {
+            ssize_t n = rings ? (ssize_t) ring_read(t->requests, buffer, sizeof(buffer))
+                              : read(requests[0], buffer, sizeof(buffer));
+            if (n <= 0) {
+                _exit(0);
+            }
+            if (rings) {
+                ring_write(t->responses, buffer, (size_t) n);
+            } else if (write(responses[1], buffer, (size_t) n) != n) {
+                _exit(1);
+            }
+        }
+    }
+
+    if (!rings) {
+        close(requests[0]);
+        close(responses[1]);
+        t->in  = requests[1];
+        t->out = responses[0];
+    }
+    return pid;
+}
+
+static void stop_echo(Transport * t, pid_t pid) {
+    if (t->requests != NULL) {
+        ring_close(t->requests);
+    } else {
+        close(t->in);
+        close(t->out);
+    }
+    waitpid(pid, NULL, 0);
+    if (t->requests != NULL) {
+        ring_region_unmap(t->requests);
+    }
+}
+
+/** Idas y vueltas por segundo, de a burst mensajes por vez */
+static double measure(bool rings, int burst) {
+    Transport t;
+    pid_t pid = start_echo(&t, rings);
+    char buffer[BURST * MESSAGE_LEN];
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < round_trips; i += burst) {
+        for (int j = 0; j < burst; j++) {
+            transport_write(&t, message, MESSAGE_LEN);
+        }
+        transport_read(&t, buffer, burst * MESSAGE_LEN);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    ck_assert_int_eq(memcmp(buffer, message, MESSAGE_LEN), 0);
+
+    stop_echo(&t, pid);
+    return round_trips / ((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+}
+
+START_TEST(test_ring_bench)
+    fprintf(stderr, "Round trips of a %zu byte request to an echo process (%d)\n", MESSAGE_LEN, round_trips);
+    fprintf(stderr, "  %-8s %14s %14s\n", "", "one by one/s", "burst of 16/s");
+    fprintf(stderr, "  %-8s %14.0f %14.0f\n", "pipes", measure(false, 1), measure(false, BURST));
+    fprintf(stderr, "  %-8s %14.0f %14.0f\n", "rings", measure(true, 1), measure(true, BURST));
+END_TEST
+
+Suite * suite(void) {
+    Suite *s   = suite_create("ring_bench");
+    TCase *tc  = tcase_create("ring_bench");
+
+    tcase_set_timeout(tc, 120);
+    tcase_add_test(tc, test_ring_bench);
+    suite_add_tcase(s, tc);
+
+    return s;
+}
+
+int main(int argc, char * argv[]) {
+    if (argc > 1) {
+        round_trips = atoi(argv[1]) > 0 ? atoi(argv[1]) : DEFAULT_ROUND_TRIPS;
+    }
+
+    int number_failed;
+    SRunner *sr = srunner_create(suite());
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,149 @@
+#include <check.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <ring.h>
+
+#define ECHO_BYTES  (4 * RING_SIZE + 123)
+#define CHUNK       5000
+
+static void open_region(Ring ** requests, Ring ** responses) {
+    int fd = ring_region_create();
+    ck_assert_int_ge(fd, 0);
+    ck_assert_int_eq(ring_region_map(fd, requests, responses), 0);
+    close(fd);
+}
+
+START_TEST(test_ring_wrap)
+    Ring * requests, * responses;
+    open_region(&requests, &responses);
+    char data[RING_SIZE], out[RING_SIZE];
+
+    // cada vuelta deja los contadores en otra posicion, la ultima escritura cruza el final
+    for (int round = 0; round < 5; round++) {
+        memset(data, 'a' + round, sizeof(data));
+        size_t len = RING_SIZE - 1000 + (size_t) round;
+        ck_assert(ring_write(requests, data, len));
+
+        size_t read = 0;
+        while (read < len) {
+            read += ring_read(requests, out + read, len - read);
+        }
+        ck_assert_int_eq(memcmp(out, data, len), 0);
+    }
+
+    // el otro anillo de la region es independiente
+    ck_assert(!ring_wait(responses, 0));
+    ring_region_unmap(requests);
+END_TEST
+
+START_TEST(test_ring_wait_close)
+    Ring * requests, * responses;
+    open_region(&requests, &responses);
+    char out[8];
+
+    ck_assert(!ring_wait(requests, 10000));
+    ck_assert(ring_write(requests, "abc", 3));
+    ck_assert(ring_wait(requests, 10000));
+
+    // lo que se escribio antes de cerrar se sigue leyendo
+    ring_close(requests);
+    ck_assert(ring_wait(requests, -1));
+    ck_assert(!ring_write(requests, "d", 1));
+    ck_assert_uint_eq(ring_read(requests, out, sizeof(out)), 3);
+    ck_assert_uint_eq(ring_read(requests, out, sizeof(out)), 0);
+
+    ring_region_unmap(requests);
+END_TEST
+
+START_TEST(test_ring_stream)
+    Ring * requests, * responses;
+    open_region(&requests, &responses);
+    char out[32] = {0};
+
+    FILE * stream = ring_open_stream(responses);
+    ck_assert_ptr_ne(stream, NULL);
+    fprintf(stream, "%d\n%s\n.\n", 0, "movie");
+    ck_assert(!ring_wait(responses, 0));
+    fflush(stream);
+    ck_assert_uint_eq(ring_read(responses, out, sizeof(out)), strlen("0\nmovie\n.\n"));
+    ck_assert_str_eq(out, "0\nmovie\n.\n");
+
+    fclose(stream);
+    ring_region_unmap(requests);
+END_TEST
+
+/** Otro proceso devuelve por el segundo anillo lo que lee del primero: los dos lados se duermen y despiertan */
+START_TEST(test_ring_processes)
+    Ring * requests, * responses;
+    open_region(&requests, &responses);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        char buffer[CHUNK];
+        size_t n;
+        while ((n = ring_read(requests, buffer, sizeof(buffer))) > 0) {
+            ring_write(responses, buffer, n);
+        }
+        ring_close(responses);
+        _exit(0);
+    }
+
+    char * data = malloc(ECHO_BYTES), * out = malloc(ECHO_BYTES);
+    ck_assert_ptr_ne(data, NULL);
+    ck_assert_ptr_ne(out, NULL);
+    for (size_t i = 0; i < ECHO_BYTES; i++) {
+        data[i] = (char) (i * 7 + i / 251);
+    }
+
+    // se escribe todo antes de leer: el anillo de vuelta se llena y el eco espera lugar
+    size_t written = 0, read = 0;
+    while (written < RING_SIZE) {
+        size_t len = ECHO_BYTES - written < CHUNK ? ECHO_BYTES - written : CHUNK;
+        ck_assert(ring_write(requests, data + written, len));
+        written += len;
+    }
+    while (read < ECHO_BYTES) {
+        if (written < ECHO_BYTES) {
+            size_t len = ECHO_BYTES - written < CHUNK ? ECHO_BYTES - written : CHUNK;
+            ck_assert(ring_write(requests, data + written, len));
+            written += len;
+        }
+        read += ring_read(responses, out + read, ECHO_BYTES - read);
+    }
+    ck_assert_int_eq(memcmp(out, data, ECHO_BYTES), 0);
+
+    ring_close(requests);
+    char rest[1];
+    ck_assert_uint_eq(ring_read(responses, rest, sizeof(rest)), 0);
+    waitpid(pid, NULL, 0);
+
+    free(data);
+    free(out);
+    ring_region_unmap(requests);
+END_TEST
+
+Suite * suite(void) {
+    Suite *s   = suite_create("ring");
+    TCase *tc  = tcase_create("ring");
+
+    tcase_add_test(tc, test_ring_wrap);
+    tcase_add_test(tc, test_ring_wait_close);
+    tcase_add_test(tc, test_ring_stream);
+    tcase_add_test(tc, test_ring_processes);
+    suite_add_tcase(s, tc);
+
+    return s;
+}
+
+int main(int argc, char * argv[]) {
+    int number_failed;
+    SRunner *sr = srunner_create(suite());
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
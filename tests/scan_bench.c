@@ -0,0 +1,163 @@
+#include <check.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <scan.h>
+#include <message.h>
+
+/**
+ * Busqueda del terminador: cada implementacion de scan.h (escalar, SSE2, AVX2) contra
+ * la maquina de estados byte a byte, y MB/s de cada una enmarcando una respuesta larga
+ * como un historial de GET_BOOKING.
+ *
+ * Uso: scan_bench [iteraciones]
+ */
+
+#define DEFAULT_ITERATIONS  200
+#define MESSAGE_SIZE        (1 << 16)
+#define RANDOM_SIZE         1024
+
+static int iterations = DEFAULT_ITERATIONS;
+
+static const scan_level levels[] = {SCAN_SCALAR, SCAN_SSE2, SCAN_AVX2};
+#define LEVELS (sizeof(levels) / sizeof(levels[0]))
+
+/** Fin del mensaje recorriendo byte a byte, como lo hacia message_scan */
+static size_t reference_end(const char * buffer, size_t len) {
+    int matched = 0;
+    for (size_t i = 0; i < len; i++) {
+        const char c = buffer[i];
+        if (matched == 0) {
+            matched = c == '\n';
+        } else if (matched == 1) {
+            matched = c == '.' ? 2 : c == '\n';
+        } else if (c == '\n') {
+            return i + 1;
+        } else {
+            matched = 0;
+        }
+    }
+    return len;
+}
+
+/** Texto al azar con muchos \n y puntos, asi aparecen terminadores parciales */
+static void random_text(char * buffer, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        int r = rand() % 8;
+        buffer[i] = r < 2 ? '\n' : r < 4 ? '.' : (char) ('a' + r);
+    }
+}
+
+/** Respuesta de GET_BOOKING con reservas hasta llenar size bytes */
+static size_t booking_response(char * buffer, size_t size) {
+    size_t len = (size_t) sprintf(buffer, "0\n");
+    for (int i = 0; len + 64 < size; i++) {
+        len += (size_t) sprintf(buffer + len, "movie %d\n%d\n%d\n%d\n", i, i % 7, 1 + i % 5, i % 80);
+    }
+    len += (size_t) sprintf(buffer + len, ".\n");
+    return len;
+}
+
+START_TEST(test_scan_levels)
+    char buffer[RANDOM_SIZE];
+    srand(7);
+
+    for (size_t l = 0; l < LEVELS; l++) {
+        if (!scan_set_level(levels[l])) {
+            continue;
+        }
+        for (int round = 0; round < 200; round++) {
+            size_t len = (size_t) (rand() % RANDOM_SIZE);
+            random_text(buffer, len);
+
+            const char * newline = memchr(buffer, '\n', len);
+            ck_assert_uint_eq(scan_newline(buffer, len), newline == NULL ? len : (size_t) (newline - buffer));
+
+            size_t expected = reference_end(buffer, len);
+            size_t terminator = scan_terminator(buffer, len);
+            ck_assert_uint_eq(terminator == len ? len : terminator + 3, expected);
+
+            // el mensaje llega partido en cualquier lugar
+            size_t cut = len == 0 ? 0 : (size_t) rand() % len;
+            MessageScanner scanner;
+            message_scanner_init(&scanner);
+            bool done;
+            size_t scanned = message_scan(&scanner, buffer, cut, &done);
+            if (!done) {
+                scanned += message_scan(&scanner, buffer + cut, len - cut, &done);
+            }
+            ck_assert_uint_eq(scanned, expected);
+        }
+    }
+END_TEST
+
+START_TEST(test_scan_bench)
+    char * message = malloc(MESSAGE_SIZE);
+    ck_assert_ptr_ne(message, NULL);
+    size_t len = booking_response(message, MESSAGE_SIZE);
+    double megabytes = (double) len * iterations / (1 << 20);
+
+    fprintf(stderr, "Framing a %zu byte GET_BOOKING response %d times\n", len, iterations);
+
+    struct timespec start, end;
+    size_t total = 0;
+    // sin volatile el compilador calcula una sola vez el fin del mismo mensaje
+    volatile size_t message_len = len;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations; i++) {
+        total += reference_end(message, message_len);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    ck_assert_uint_eq(total, len * iterations);
+    fprintf(stderr, "  %-10s %8.0f MB/s\n", "byte loop",
+            megabytes / ((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9));
+
+    for (size_t l = 0; l < LEVELS; l++) {
+        if (!scan_set_level(levels[l])) {
+            fprintf(stderr, "  %-10s not supported\n", scan_level_name(levels[l]));
+            continue;
+        }
+        MessageScanner scanner;
+        bool done;
+        total = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < iterations; i++) {
+            message_scanner_init(&scanner);
+            total += message_scan(&scanner, message, len, &done);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        ck_assert_uint_eq(total, len * iterations);
+        fprintf(stderr, "  %-10s %8.0f MB/s\n", scan_level_name(levels[l]),
+                megabytes / ((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9));
+    }
+
+    free(message);
+END_TEST
+
+
+Suite * suite(void) {
+    Suite *s   = suite_create("scan_bench");
+    TCase *tc  = tcase_create("scan_bench");
+
+    tcase_set_timeout(tc, 120);
+    tcase_add_test(tc, test_scan_levels);
+    tcase_add_test(tc, test_scan_bench);
+    suite_add_tcase(s, tc);
+
+    return s;
+}
+
+int main(int argc, char * argv[]) {
+    if (argc > 1) {
+        iterations = atoi(argv[1]) > 0 ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+    }
+
+    int number_failed;
+    SRunner *sr = srunner_create(suite());
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,114 @@
+#include <check.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <database/db_functions.h>
+#include <database/seat_cache.h>
+
+/**
+ * El cache de asientos se mantiene con las escrituras propias y se recarga cuando
+ * otro proceso modifica la base. El otro proceso se simula con una segunda conexion.
+ */
+
+#define TEST_DATABASE "seat_cache_test.db"
+
+static sqlite3 * other;
+
+static void setup(void) {
+    unlink(TEST_DATABASE);
+    ck_assert_int_eq(database_open(TEST_DATABASE), RESPONSE_OK);
+    ck_assert_int_eq(add_client("client"), RESPONSE_OK);
+    ck_assert_int_eq(add_showcase("movie", 2, 3), RESPONSE_OK);
+    ck_assert_int_eq(sqlite3_open(TEST_DATABASE, &other), SQLITE_OK);
+    sqlite3_busy_timeout(other, BUSY_TIMEOUT);
+}
+
+static void teardown(void) {
+    sqlite3_close(other);
+    database_close();
+    unlink(TEST_DATABASE);
+}
+
+static void other_exec(const char * sql) {
+    ck_assert_int_eq(sqlite3_exec(other, sql, NULL, NULL, NULL), SQLITE_OK);
+}
+
+START_TEST(test_write_through)
+    ShowcaseSeats * showcase = seat_cache_find("movie", 2, 3);
+    ck_assert_ptr_ne(showcase, NULL);
+    ck_assert(!seat_taken(showcase, 7));
+
+    ck_assert_int_eq(add_booking("client", "movie", 2, 3, 7), RESPONSE_OK);
+    ck_assert(seat_taken(showcase, 7));
+    ck_assert_int_eq(add_booking("client", "movie", 2, 3, 7), ALREADY_EXIST);
+
+    ck_assert_int_eq(cancel_booking("client", "movie", 2, 3, 7), RESPONSE_OK);
+    ck_assert(!seat_taken(showcase, 7));
+
+    ck_assert_int_eq(add_showcase("other", 2, 3), ALREADY_EXIST);
+    ck_assert_int_eq(remove_showcase("movie", 2, 3), RESPONSE_OK);
+    ck_assert_ptr_eq(seat_cache_find("movie", 2, 3), NULL);
+    ck_assert_int_eq(get_showcase_id("movie", 2, 3), INVALID_ID);
+END_TEST
+
+START_TEST(test_cancel_other_client)
+    ck_assert_int_eq(add_client("other"), RESPONSE_OK);
+    ck_assert_int_eq(add_booking("client", "movie", 2, 3, 7), RESPONSE_OK);
+
+    // cancelar una reserva ajena no libera el asiento
+    ck_assert_int_eq(cancel_booking("other", "movie", 2, 3, 7), BAD_BOOKING);
+    ck_assert_int_eq(add_booking("other", "movie", 2, 3, 7), ALREADY_EXIST);
+END_TEST
+
+START_TEST(test_other_process_writes)
+    int showcase_id = get_showcase_id("movie", 2, 3);
+    char sql[256];
+
+    sprintf(sql, "INSERT INTO booking(client_id, showcase_id, cancelled, seat) VALUES(%d, %d, 0, 5)",
+            get_client_id("client"), showcase_id);
+    other_exec(sql);
+    ck_assert_int_eq(add_booking("client", "movie", 2, 3, 5), ALREADY_EXIST);
+
+    other_exec("UPDATE booking SET cancelled = 1 WHERE seat = 5");
+    ck_assert_int_eq(add_booking("client", "movie", 2, 3, 5), RESPONSE_OK);
+
+    other_exec("INSERT INTO showcase(movie, day, room) VALUES('new', 4, 1)");
+    ck_assert_int_ne(get_showcase_id("new", 4, 1), INVALID_ID);
+
+    other_exec("DELETE FROM booking; DELETE FROM showcase WHERE movie = 'movie'");
+    ck_assert_int_eq(get_showcase_id("movie", 2, 3), INVALID_ID);
+END_TEST
+
+START_TEST(test_batch)
+    ck_assert_int_eq(database_batch_begin(), RESPONSE_OK);
+    ck_assert_int_eq(add_booking("client", "movie", 2, 3, 9), RESPONSE_OK);
+    ck_assert_int_eq(add_booking("client", "movie", 2, 3, 9), ALREADY_EXIST);
+    ck_assert_int_eq(database_batch_commit(), RESPONSE_OK);
+
+    ShowcaseSeats * showcase = seat_cache_find("movie", 2, 3);
+    ck_assert(seat_taken(showcase, 9));
+END_TEST
+
+
+Suite * suite(void) {
+    Suite *s   = suite_create("seat_cache");
+    TCase *tc  = tcase_create("seat_cache");
+
+    tcase_add_checked_fixture(tc, setup, teardown);
+    tcase_add_test(tc, test_write_through);
+    tcase_add_test(tc, test_cancel_other_client);
+    tcase_add_test(tc, test_other_process_writes);
+    tcase_add_test(tc, test_batch);
+    suite_add_tcase(s, tc);
+
+    return s;
+}
+
+int main(int argc, char * argv[]) {
+    int number_failed;
+    SRunner *sr = srunner_create(suite());
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
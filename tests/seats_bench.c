@@ -0,0 +1,261 @@
+#include <check.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <database/db_functions.h>
+
+/**
+ * Benchmark de GET_SEATS: compara la version anterior de show_seats (una consulta por asiento)
+ * con la actual (mapa de bits en memoria por funcion) sobre una base poblada. Despues se
+ * agrega un historial de reservas canceladas y otro proceso, simulado con una segunda
+ * conexion, escribe antes de cada GET_SEATS: el cache no vuelve a leer todas las reservas.
+ *
+ * Uso: seats_bench [iteraciones] [historial]
+ */
+
+#define BENCH_DATABASE      "seats_bench.db"
+#define BENCH_OUTPUT        "seats_bench.out"
+#define BENCH_CLIENTS       50
+#define DEFAULT_ITERATIONS  200
+#define DEFAULT_HISTORY     1000000
+#define OUTPUT_SIZE         (4 * SEATS + 16)
+#define MAX_QUERY_SIZE      (2 + MAX_ARGS  * (ARG_SIZE + 2))
+
+extern sqlite3 * db_fd;
+
+static int callback_retr_id(void *data, int argc, char **argv, char **azColName) {
+    *(int *) data = atoi(argv[0]);
+    return 0;
+}
+
+static int iterations = DEFAULT_ITERATIONS;
+static int history = DEFAULT_HISTORY;
+
+/** show_seats tal como estaba antes: SEATS consultas armadas con sprintf, con el mapa de asientos actual */
+static int legacy_show_seats(char *movie, int day, int room) {
+    int rc, show_id = get_showcase_id(movie, day, room);
+    if (show_id == INVALID_ID) {
+        printf("%d\n", BAD_SHOWCASE);
+        return BAD_SHOWCASE;
+    }
+    uint8_t map[SEATMAP_BYTES] = {0};
+    for (int i = 0; i < SEATS; i++) {
+        int client_id = INVALID_ID;
+        char *showb_query = malloc(MAX_QUERY_SIZE);
+        sprintf(showb_query, "SELECT client_id FROM booking "
+                "WHERE showcase_id = %d AND seat = %d AND cancelled = 0",
+                show_id, i);
+        rc = sqlite3_exec(db_fd, showb_query, callback_retr_id, &client_id, NULL);
+        free(showb_query);
+        if (rc != SQLITE_OK) {
+            printf("%d\n", FAIL_QUERY);
+            return FAIL_QUERY;
+        }
+        if (client_id != INVALID_ID)
+            seatmap_set(map, i);
+    }
+
+    printf("%d\n", RESPONSE_OK);
+    for (int i = 0; i < SEATMAP_BYTES; i++)
+        printf("%02x", map[i]);
+    printf("\n");
+    return RESPONSE_OK;
+}
+
+/** Carga clientes, una funcion por dia y sala, y reservas (algunas canceladas) */
+static void populate(void) {
+    char name[CLIENT_NAME_LENGTH], movie[MOVIE_NAME_LENGTH];
+
+    unlink(BENCH_DATABASE);
+    ck_assert_int_eq(database_open(BENCH_DATABASE), RESPONSE_OK);
+    ck_assert_int_eq(database_batch_begin(), RESPONSE_OK);
+
+    for (int i = 0; i < BENCH_CLIENTS; i++) {
+        sprintf(name, "client %d", i);
+        ck_assert_int_eq(add_client(name), RESPONSE_OK);
+    }
+
+    for (int day = SUN; day <= SAT; day++) {
+        for (int room = 1; room <= ROOMS; room++) {
+            sprintf(movie, "movie %d", room);
+            ck_assert_int_eq(add_showcase(movie, day, room), RESPONSE_OK);
+            for (int seat = 0; seat < SEATS; seat += 2) {
+                sprintf(name, "client %d", seat % BENCH_CLIENTS);
+                ck_assert_int_eq(add_booking(name, movie, day, room, seat), RESPONSE_OK);
+                if (seat % 3 == 0) {
+                    ck_assert_int_eq(cancel_booking(name, movie, day, room, seat), RESPONSE_OK);
+                }
+            }
+        }
+    }
+
+    ck_assert_int_eq(database_batch_commit(), RESPONSE_OK);
+}
+
+/** Ejecuta fn con la salida estandar redirigida al archivo fd */
+static void redirect(int fd, void (*fn)(int (*)(char *, int, int)), int (*show)(char *, int, int)) {
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    dup2(fd, STDOUT_FILENO);
+    fn(show);
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+}
+
+static void show_once(int (*show)(char *, int, int)) {
+    show("movie 1", MON, 1);
+}
+
+static void show_many(int (*show)(char *, int, int)) {
+    char movie[MOVIE_NAME_LENGTH];
+    for (int i = 0; i < iterations; i++) {
+        int room = 1 + i % ROOMS;
+        sprintf(movie, "movie %d", room);
+        show(movie, i % 7, room);
+    }
+}
+
+/** Deja en output la respuesta para una funcion */
+static void capture(int (*show)(char *, int, int), char * output) {
+    int fd = open(BENCH_OUTPUT, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    ck_assert_int_ge(fd, 0);
+
+    redirect(fd, show_once, show);
+
+    lseek(fd, 0, SEEK_SET);
+    ssize_t n = read(fd, output, OUTPUT_SIZE - 1);
+    ck_assert_int_gt(n, 0);
+    output[n] = 0;
+    close(fd);
+    unlink(BENCH_OUTPUT);
+}
+
+/** Retorna la latencia promedio en microsegundos */
+static double run(int (*show)(char *, int, int)) {
+    int fd = open("/dev/null", O_WRONLY);
+    ck_assert_int_ge(fd, 0);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    redirect(fd, show_many, show);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    close(fd);
+
+    return ((end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3) / iterations;
+}
+
+START_TEST(test_seats_bench)
+    char legacy_output[OUTPUT_SIZE], output[OUTPUT_SIZE];
+
+    populate();
+
+    double legacy = run(legacy_show_seats);
+    double single = run(show_seats);
+    capture(legacy_show_seats, legacy_output);
+    capture(show_seats, output);
+
+    fprintf(stderr, "GET_SEATS latency over %d requests\n", iterations);
+    fprintf(stderr, "  one query per seat: %10.2f us/request\n", legacy);
+    fprintf(stderr, "  seat cache:         %10.2f us/request\n", single);
+    fprintf(stderr, "  speedup:            %10.2fx\n", legacy / single);
+
+    ck_assert_str_eq(output, legacy_output);
+    ck_assert(single < legacy);
+
+    database_close();
+    unlink(BENCH_DATABASE);
+END_TEST
+
+/** Latencia promedio de GET_SEATS en microsegundos, si hay other escribe una reserva antes de cada uno */
+static double run_other_writes(sqlite3 * other) {
+    char movie[MOVIE_NAME_LENGTH], sql[128];
+    double total = 0;
+
+    int fd = open("/dev/null", O_WRONLY);
+    ck_assert_int_ge(fd, 0);
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    dup2(fd, STDOUT_FILENO);
+
+    for (int i = 0; i < iterations; i++) {
+        int room = 1 + i % ROOMS;
+        if (other != NULL) {
+            // una funcion cualquiera, no siempre la que se lee
+            sprintf(sql, "INSERT INTO booking(client_id, showcase_id, cancelled, seat) VALUES(1, %d, 1, 0)",
+                    1 + i * 3 % (7 * ROOMS));
+            ck_assert_int_eq(sqlite3_exec(other, sql, NULL, NULL, NULL), SQLITE_OK);
+        }
+        sprintf(movie, "movie %d", room);
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        show_seats(movie, i % 7, room);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        total += (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3;
+    }
+
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    close(fd);
+    return total / iterations;
+}
+
+START_TEST(test_other_process_bench)
+    char sql[256];
+    sqlite3 * other;
+
+    populate();
+    // historial de reservas canceladas repartido entre todas las funciones
+    sprintf(sql, "WITH RECURSIVE n(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM n WHERE i + 1 < %d) "
+                 "INSERT INTO booking(client_id, showcase_id, cancelled, seat) "
+                 "SELECT 1 + i %% %d, 1 + i %% %d, 1, i %% %d FROM n", history, BENCH_CLIENTS, 7 * ROOMS, SEATS);
+    ck_assert_int_eq(sqlite3_exec(db_fd, sql, NULL, NULL, NULL), SQLITE_OK);
+    ck_assert_int_eq(sqlite3_open(BENCH_DATABASE, &other), SQLITE_OK);
+    sqlite3_busy_timeout(other, BUSY_TIMEOUT);
+
+    double alone = run_other_writes(NULL);
+    double writes = run_other_writes(other);
+
+    fprintf(stderr, "GET_SEATS latency over %d requests with %d cancelled bookings\n", iterations, history);
+    fprintf(stderr, "  no other writer:                %10.2f us/request\n", alone);
+    fprintf(stderr, "  other process writes each time: %10.2f us/request\n", writes);
+
+    sqlite3_close(other);
+    database_close();
+    unlink(BENCH_DATABASE);
+END_TEST
+
+
+Suite * suite(void) {
+    Suite *s   = suite_create("seats_bench");
+    TCase *tc  = tcase_create("seats_bench");
+
+    tcase_set_timeout(tc, 120);
+    tcase_add_test(tc, test_seats_bench);
+    tcase_add_test(tc, test_other_process_bench);
+    suite_add_tcase(s, tc);
+
+    return s;
+}
+
+int main(int argc, char * argv[]) {
+    if (argc > 1) {
+        iterations = atoi(argv[1]) > 0 ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+    }
+    if (argc > 2) {
+        history = atoi(argv[2]) > 0 ? atoi(argv[2]) : DEFAULT_HISTORY;
+    }
+
+    int number_failed;
+    SRunner *sr = srunner_create(suite());
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
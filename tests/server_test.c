@@ -0,0 +1,1005 @@
+#include <check.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <utils.h>
+#include <message.h>
+#include <protocol.h>
+#include <frame.h>
+
+/**
+ * Tests funcionales: se levanta el binario del server (que a su vez levanta el
+ * proceso database) en cada uno de los modos, con y sin group commit, y se le
+ * hacen pedidos reales.
+ * Se corre desde el directorio donde se generan los binarios.
+ */
+
+#define SERVER_PROC     "./server"
+#define TEST_DATABASE   "server_test.db"
+#define TEST_PORT       22345
+#define RESPONSE_SIZE   4096
+#define CLIENTS         8
+#define WORKERS         "4"
+
+/**
+ * Modo del server, ventana de group commit (NULL si cada escritura confirma por separado),
+ * si habla con la base por los anillos en memoria compartida en lugar de los pipes y
+ * cuantos sockets escuchan en el puerto (NULL es uno)
+ */
+typedef struct {
+    const char * mode;
+    const char * group_commit;
+    bool rings;
+    const char * acceptors;
+} Configuration;
+
+static const Configuration configurations[] = {
+        {"threads", NULL,   false, NULL},
+        {"epoll",   NULL,   false, NULL},
+        {"threads", "2000", false, "4"},
+        {"epoll",   "2000", false, "4"},
+        {"threads", NULL,   true,  NULL},
+        {"threads", "2000", true,  NULL},
+        {"uring",   NULL,   false, NULL},
+        {"uring",   "2000", false, "4"},
+};
+#define CONFIGURATIONS (sizeof(configurations) / sizeof(configurations[0]))
+
+static int connect_server(int port) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t) port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    struct timespec wait = {.tv_sec = 0, .tv_nsec = 20 * 1000 * 1000};
+    for (int i = 0; i < 250; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+            return fd;
+        }
+        close(fd);
+        nanosleep(&wait, NULL);
+    }
+
+    return -1;
+}
+
+/** Socket Unix que escucha junto al puerto: un archivo en los puertos pares y en el namespace abstracto en los impares */
+static void unix_path(int port, char * path, size_t size) {
+    snprintf(path, size, "%sserver_test_%d.sock", port % 2 == 0 ? "" : "@", port);
+}
+
+static int connect_unix(int port) {
+    char path[64];
+    struct sockaddr_un addr;
+    unix_path(port, path, sizeof(path));
+    socklen_t len = unix_address(path, &addr);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr *) &addr, len) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static pid_t start_server(const Configuration * configuration, int port) {
+    char port_str[8], unix_str[64];
+    snprintf(port_str, sizeof(port_str), "%d", port);
+    unix_path(port, unix_str, sizeof(unix_str));
+    unlink(TEST_DATABASE);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // el server y sus procesos database quedan en un grupo propio
+        setpgid(0, 0);
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        char * argv[18] = {"server", "-p", port_str, "-f", TEST_DATABASE, "-m", (char *) configuration->mode,
+                           "-w", WORKERS, "-u", unix_str};
+        int argc = 11;
+        if (configuration->group_commit != NULL) {
+            argv[argc++] = "-G";
+            argv[argc++] = (char *) configuration->group_commit;
+        }
+        if (configuration->rings) {
+            argv[argc++] = "-R";
+        }
+        if (configuration->acceptors != NULL) {
+            argv[argc++] = "-a";
+            argv[argc++] = (char *) configuration->acceptors;
+        }
+        argv[argc] = NULL;
+        execv(SERVER_PROC, argv);
+        perror("execv() failed");
+        exit(EXIT_FAILURE);
+    }
+
+    return pid;
+}
+
+/**
+ * El server espera a sus procesos database antes de morir, no queda nadie del grupo usando la
+ * base, y borra el archivo de su socket Unix
+ */
+static void stop_server(pid_t pid) {
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+
+    struct timespec wait = {.tv_sec = 0, .tv_nsec = 20 * 1000 * 1000};
+    for (int i = 0; i < 250 && kill(-pid, 0) == 0; i++) {
+        nanosleep(&wait, NULL);
+    }
+    ck_assert_int_eq(kill(-pid, 0), -1);
+    unlink(TEST_DATABASE);
+}
+
+/** Mata con SIGKILL a los procesos database del server, retorna cuantos eran */
+static int kill_databases(pid_t server) {
+    DIR * proc = opendir("/proc");
+    ck_assert_ptr_ne(proc, NULL);
+    int killed = 0;
+
+    struct dirent * entry;
+    while ((entry = readdir(proc)) != NULL) {
+        int pid = atoi(entry->d_name);
+        char path[64], stat[256];
+        snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+        FILE * file = pid > 0 ? fopen(path, "r") : NULL;
+        if (file == NULL) {
+            continue;
+        }
+        // pid (comm) estado ppid ...
+        int ppid;
+        char * comm_end = fgets(stat, sizeof(stat), file) != NULL ? strrchr(stat, ')') : NULL;
+        if (comm_end != NULL && sscanf(comm_end + 2, "%*c %d", &ppid) == 1 && ppid == server) {
+            kill(pid, SIGKILL);
+            killed++;
+        }
+        fclose(file);
+    }
+    closedir(proc);
+    return killed;
+}
+
+/** Manda el pedido y espera una respuesta OK, false si el server cerro la conexion o respondio otra cosa */
+static bool try_request(int fd, const char * req) {
+    char response[RESPONSE_SIZE];
+    MessageScanner scanner;
+    message_scanner_init(&scanner);
+    size_t len = 0;
+    bool done = false;
+
+    if (send(fd, req, strlen(req), MSG_NOSIGNAL) != (ssize_t) strlen(req)) {
+        return false;
+    }
+    while (!done && len < sizeof(response)) {
+        ssize_t n = recv(fd, response + len, sizeof(response) - len, 0);
+        if (n <= 0) {
+            return false;
+        }
+        message_scan(&scanner, response + len, (size_t) n, &done);
+        len += (size_t) n;
+    }
+    return done && parse_request_type(response, len) == RESPONSE_OK;
+}
+
+/** Lee una respuesta completa en un buffer de size bytes, retorna su largo */
+static size_t receive_into(int fd, char * response, size_t size) {
+    MessageScanner scanner;
+    message_scanner_init(&scanner);
+    size_t len = 0;
+    bool done = false;
+
+    while (!done && len < size - 1) {
+        ssize_t n = recv(fd, response + len, size - 1 - len, 0);
+        ck_assert_int_gt(n, 0);
+        message_scan(&scanner, response + len, (size_t) n, &done);
+        len += (size_t) n;
+    }
+    response[len] = 0;
+    return len;
+}
+
+static size_t receive(int fd, char * response) {
+    return receive_into(fd, response, RESPONSE_SIZE);
+}
+
+static void request(int fd, const char * req, char * response) {
+    ck_assert_int_eq(send(fd, req, strlen(req), 0), strlen(req));
+    receive(fd, response);
+}
+
+static void assert_request(int fd, const char * req, const char * expected) {
+    char response[RESPONSE_SIZE];
+    request(fd, req, response);
+    ck_assert_str_eq(response, expected);
+}
+
+static void send_frame(int fd, FrameWriter * writer) {
+    size_t len = frame_writer_finish(writer);
+    ck_assert_int_eq(send(fd, writer->data, len, 0), len);
+}
+
+/** Lee una respuesta binaria, compara el estado y los argumentos en texto seguidos de \n */
+static void assert_frame_response(int fd, int status, const char * expected) {
+    char response[RESPONSE_SIZE], args[RESPONSE_SIZE], arg[ARG_SIZE];
+    size_t len = receive(fd, response);
+    FrameReader reader;
+    FrameHeader header;
+
+    ck_assert(frame_reader_init(&reader, response, len, &header));
+    ck_assert_int_eq(header.code, status);
+
+    char * aux = args;
+    *aux = 0;
+    for (int i = 0; i < header.argc; i++) {
+        ck_assert(frame_next_arg(&reader, arg, sizeof(arg)));
+        aux += sprintf(aux, "%s\n", arg);
+    }
+    ck_assert_str_eq(args, expected);
+}
+
+/** Respuesta de texto de GET_SEATS con los asientos de first a last (sin incluir) reservados */
+static void seats_response(char * out, int first, int last) {
+    uint8_t map[SEATMAP_BYTES] = {0};
+    for (int seat = first; seat < last; seat++) {
+        seatmap_set(map, seat);
+    }
+    out += sprintf(out, "0\n");
+    for (int i = 0; i < SEATMAP_BYTES; i++) {
+        out += sprintf(out, "%02x", map[i]);
+    }
+    sprintf(out, "\n.\n");
+}
+
+START_TEST(test_server_booking)
+    pid_t pid = start_server(&configurations[_i], TEST_PORT + _i);
+    int fd = connect_server(TEST_PORT + _i);
+    ck_assert_int_ge(fd, 0);
+
+    assert_request(fd, "0\nclient\n.\n", "0\n.\n");
+    assert_request(fd, "1\nmovie\n2\n3\n.\n", "0\n.\n");
+    assert_request(fd, "3\n.\n", "0\nmovie\n.\n");
+    assert_request(fd, "4\nmovie\n.\n", "0\nmovie\n2\n3\n.\n");
+    assert_request(fd, "6\nclient\nmovie\n2\n3\n4\n.\n", "0\n.\n");
+    assert_request(fd, "6\nclient\nmovie\n2\n3\n4\n.\n", "2\n.\n");
+    assert_request(fd, "8\nclient\n.\n", "0\nmovie\n2\n3\n4\n.\n");
+
+    char expected[RESPONSE_SIZE];
+    seats_response(expected, 4, 5);
+    ck_assert_str_eq(expected, "0\n08000000000000000000\n.\n");
+    assert_request(fd, "5\nmovie\n2\n3\n.\n", expected);
+
+    assert_request(fd, "7\nclient\nmovie\n2\n3\n4\n.\n", "0\n.\n");
+    assert_request(fd, "9\nclient\n.\n", "0\nmovie\n2\n3\n4\n.\n");
+    assert_request(fd, "8\nnobody\n.\n", "6\n.\n");
+
+    close(fd);
+    stop_server(pid);
+END_TEST
+
+START_TEST(test_server_unix_socket)
+    pid_t pid = start_server(&configurations[_i], TEST_PORT + _i);
+    int tcp = connect_server(TEST_PORT + _i);
+    ck_assert_int_ge(tcp, 0);
+    // el socket Unix ya escucha cuando el puerto acepta conexiones
+    int local = connect_unix(TEST_PORT + _i);
+    ck_assert_int_ge(local, 0);
+
+    assert_request(tcp, "0\nclient\n.\n", "0\n.\n");
+    assert_request(local, "1\nmovie\n2\n3\n.\n", "0\n.\n");
+    assert_request(tcp, "4\nmovie\n.\n", "0\nmovie\n2\n3\n.\n");
+    assert_request(tcp, "6\nclient\nmovie\n2\n3\n4\n.\n", "0\n.\n");
+    assert_request(local, "6\nclient\nmovie\n2\n3\n4\n.\n", "2\n.\n");
+    assert_request(local, "8\nclient\n.\n", "0\nmovie\n2\n3\n4\n.\n");
+
+    // los pedidos encadenados tambien se responden en orden
+    const char pipelined[] = "3\n.\n8\nclient\n.\n";
+    ck_assert_int_eq(send(local, pipelined, strlen(pipelined), 0), strlen(pipelined));
+    char response[RESPONSE_SIZE];
+    receive(local, response);
+    ck_assert_str_eq(response, "0\nmovie\n.\n");
+    receive(local, response);
+    ck_assert_str_eq(response, "0\nmovie\n2\n3\n4\n.\n");
+
+    close(local);
+    close(tcp);
+    stop_server(pid);
+
+    // el archivo del socket no queda despues de SIGTERM, en ningun modo
+    char path[64];
+    unix_path(TEST_PORT + _i, path, sizeof(path));
+    ck_assert(path[0] == '@' || access(path, F_OK) < 0);
+END_TEST
+
+START_TEST(test_server_concurrent_clients)
+    pid_t pid = start_server(&configurations[_i], TEST_PORT + _i);
+    int fds[CLIENTS];
+
+    for (int i = 0; i < CLIENTS; i++) {
+        fds[i] = connect_server(TEST_PORT + _i);
+        ck_assert_int_ge(fds[i], 0);
+    }
+
+    assert_request(fds[0], "1\nmovie\n2\n3\n.\n", "0\n.\n");
+
+    // todos los pedidos quedan en vuelo a la vez
+    for (int i = 0; i < CLIENTS; i++) {
+        ck_assert_int_eq(send(fds[i], "3\n.\n", 4, 0), 4);
+    }
+
+    char response[RESPONSE_SIZE];
+    for (int i = CLIENTS - 1; i >= 0; i--) {
+        receive(fds[i], response);
+        ck_assert_str_eq(response, "0\nmovie\n.\n");
+        close(fds[i]);
+    }
+
+    stop_server(pid);
+END_TEST
+
+START_TEST(test_server_concurrent_booking)
+    pid_t pid = start_server(&configurations[_i], TEST_PORT + _i);
+    int fds[CLIENTS];
+
+    for (int i = 0; i < CLIENTS; i++) {
+        fds[i] = connect_server(TEST_PORT + _i);
+        ck_assert_int_ge(fds[i], 0);
+    }
+
+    assert_request(fds[0], "0\nclient\n.\n", "0\n.\n");
+    assert_request(fds[0], "1\nmovie\n2\n3\n.\n", "0\n.\n");
+
+    // todos intentan reservar el mismo asiento a la vez, solo uno lo consigue
+    const char * booking = "6\nclient\nmovie\n2\n3\n7\n.\n";
+    for (int i = 0; i < CLIENTS; i++) {
+        ck_assert_int_eq(send(fds[i], booking, strlen(booking), 0), strlen(booking));
+    }
+
+    int booked = 0;
+    char response[RESPONSE_SIZE];
+    for (int i = 0; i < CLIENTS; i++) {
+        receive(fds[i], response);
+        if (strcmp(response, "0\n.\n") == 0) {
+            booked++;
+        } else {
+            ck_assert_str_eq(response, "2\n.\n");
+        }
+        close(fds[i]);
+    }
+    ck_assert_int_eq(booked, 1);
+
+    stop_server(pid);
+END_TEST
+
+START_TEST(test_server_booking_burst)
+    pid_t pid = start_server(&configurations[_i], TEST_PORT + _i);
+    int fds[CLIENTS];
+    char req[RESPONSE_SIZE];
+
+    for (int i = 0; i < CLIENTS; i++) {
+        fds[i] = connect_server(TEST_PORT + _i);
+        ck_assert_int_ge(fds[i], 0);
+    }
+
+    assert_request(fds[0], "0\nclient\n.\n", "0\n.\n");
+    for (int i = 0; i < CLIENTS; i++) {
+        sprintf(req, "1\nmovie %d\n%d\n%d\n.\n", i, i % 7, 1 + i / 7);
+        assert_request(fds[0], req, "0\n.\n");
+    }
+
+    // reservas sobre funciones distintas, no comparten locks y pueden ir en un mismo commit
+    for (int i = 0; i < CLIENTS; i++) {
+        sprintf(req, "6\nclient\nmovie %d\n%d\n%d\n%d\n.\n", i, i % 7, 1 + i / 7, i);
+        ck_assert_int_eq(send(fds[i], req, strlen(req), 0), strlen(req));
+    }
+
+    char response[RESPONSE_SIZE];
+    for (int i = 0; i < CLIENTS; i++) {
+        receive(fds[i], response);
+        ck_assert_str_eq(response, "0\n.\n");
+    }
+
+    // todas quedaron confirmadas
+    request(fds[0], "8\nclient\n.\n", response);
+    for (int i = 0; i < CLIENTS; i++) {
+        sprintf(req, "movie %d\n%d\n%d\n%d\n", i, i % 7, 1 + i / 7, i);
+        ck_assert_ptr_ne(strstr(response, req), NULL);
+    }
+
+    for (int i = 0; i < CLIENTS; i++) {
+        close(fds[i]);
+    }
+    stop_server(pid);
+END_TEST
+
+START_TEST(test_server_binary)
+    pid_t pid = start_server(&configurations[_i], TEST_PORT + _i);
+    int fd = connect_server(TEST_PORT + _i);
+    ck_assert_int_ge(fd, 0);
+    FrameWriter writer;
+
+    frame_writer_init(&writer, ADD_CLIENT);
+    frame_put_string(&writer, "client");
+    send_frame(fd, &writer);
+    assert_frame_response(fd, RESPONSE_OK, "");
+
+    frame_writer_reset(&writer, ADD_SHOWCASE);
+    frame_put_string(&writer, "movie");
+    frame_put_int(&writer, 2);
+    frame_put_int(&writer, 3);
+    send_frame(fd, &writer);
+    assert_frame_response(fd, RESPONSE_OK, "");
+
+    frame_writer_reset(&writer, ADD_BOOKING);
+    frame_put_string(&writer, "client");
+    frame_put_string(&writer, "movie");
+    frame_put_int(&writer, 2);
+    frame_put_int(&writer, 3);
+    frame_put_int(&writer, 4);
+    send_frame(fd, &writer);
+    assert_frame_response(fd, RESPONSE_OK, "");
+    send_frame(fd, &writer);
+    assert_frame_response(fd, ALREADY_EXIST, "");
+
+    // el formato se elige en cada mensaje, los dos conviven en la misma conexion
+    assert_request(fd, "8\nclient\n.\n", "0\nmovie\n2\n3\n4\n.\n");
+
+    frame_writer_reset(&writer, GET_BOOKING);
+    frame_put_string(&writer, "client");
+    send_frame(fd, &writer);
+    assert_frame_response(fd, RESPONSE_OK, "movie\n2\n3\n4\n");
+
+    // el mapa de asientos viaja como bytes crudos
+    char response[RESPONSE_SIZE];
+    frame_writer_reset(&writer, GET_SEATS);
+    frame_put_string(&writer, "movie");
+    frame_put_int(&writer, 2);
+    frame_put_int(&writer, 3);
+    send_frame(fd, &writer);
+    size_t received = receive(fd, response);
+    FrameReader reader;
+    FrameHeader header;
+    FrameArg arg;
+    ck_assert(frame_reader_init(&reader, response, received, &header));
+    ck_assert_int_eq(header.code, RESPONSE_OK);
+    ck_assert_int_eq(header.argc, 1);
+    ck_assert(frame_next(&reader, &arg));
+    ck_assert_int_eq(arg.type, FRAME_STRING);
+    ck_assert_uint_eq(arg.len, SEATMAP_BYTES);
+    for (int i = 0; i < SEATS; i++) {
+        ck_assert_int_eq(seatmap_taken((const uint8_t *) arg.string, i), i == 4);
+    }
+
+    // el encabezado llega partido en dos envios
+    frame_writer_reset(&writer, GET_MOVIES);
+    size_t len = frame_writer_finish(&writer);
+    struct timespec wait = {.tv_sec = 0, .tv_nsec = 10 * 1000 * 1000};
+    ck_assert_int_eq(send(fd, writer.data, 3, 0), 3);
+    nanosleep(&wait, NULL);
+    ck_assert_int_eq(send(fd, writer.data + 3, len - 3, 0), len - 3);
+    assert_frame_response(fd, RESPONSE_OK, "movie\n");
+
+    frame_writer_reset(&writer, GET_BOOKING);
+    frame_put_string(&writer, "nobody");
+    send_frame(fd, &writer);
+    assert_frame_response(fd, BAD_CLIENT, "");
+
+    frame_writer_free(&writer);
+    close(fd);
+    stop_server(pid);
+END_TEST
+START_TEST(test_server_pipelining)
+    pid_t pid = start_server(&configurations[_i], TEST_PORT + _i);
+    int fd = connect_server(TEST_PORT + _i);
+    ck_assert_int_ge(fd, 0);
+    char requests[4 * RESPONSE_SIZE], expected[4 * RESPONSE_SIZE], response[4 * RESPONSE_SIZE];
+    char * req = requests, * exp = expected;
+
+    // escrituras y lecturas encadenadas en un solo envio, las respuestas llegan en orden
+    req += sprintf(req, "0\nclient\n.\n");
+    exp += sprintf(exp, "0\n.\n");
+    for (int i = 0; i < CLIENTS; i++) {
+        req += sprintf(req, "1\nmovie %d\n%d\n%d\n.\n", i, i % 7, 1 + i);
+        exp += sprintf(exp, "0\n.\n");
+        req += sprintf(req, "4\nmovie %d\n.\n", i);
+        exp += sprintf(exp, "0\nmovie %d\n%d\n%d\n.\n", i, i % 7, 1 + i);
+        req += sprintf(req, "6\nclient\nmovie %d\n%d\n%d\n%d\n.\n", i, i % 7, 1 + i, i);
+        exp += sprintf(exp, "0\n.\n");
+    }
+    req += sprintf(req, "8\nclient\n.\n");
+    exp += sprintf(exp, "0\n");
+    for (int i = 0; i < CLIENTS; i++) {
+        exp += sprintf(exp, "movie %d\n%d\n%d\n%d\n", i, i % 7, 1 + i, i);
+    }
+    exp += sprintf(exp, ".\n");
+
+    // el ultimo pedido queda partido entre dos envios
+    size_t len = (size_t) (req - requests);
+    ck_assert_int_eq(send(fd, requests, len - 3, 0), len - 3);
+    struct timespec wait = {.tv_sec = 0, .tv_nsec = 10 * 1000 * 1000};
+    nanosleep(&wait, NULL);
+    ck_assert_int_eq(send(fd, requests + len - 3, 3, 0), 3);
+
+    size_t received = 0, total = (size_t) (exp - expected);
+    while (received < total) {
+        ssize_t n = recv(fd, response + received, total - received, 0);
+        ck_assert_int_gt(n, 0);
+        received += (size_t) n;
+    }
+    response[received] = 0;
+    ck_assert_str_eq(response, expected);
+
+    // mas pedidos encadenados de los que entran en el buffer del server
+    const char * movies = "3\n.\n";
+    char single[RESPONSE_SIZE];
+    request(fd, movies, single);
+    size_t count = 2 * RESPONSE_SIZE / strlen(movies);
+    req = requests;
+    for (size_t i = 0; i < count; i++) {
+        req += sprintf(req, "%s", movies);
+    }
+    len = (size_t) (req - requests);
+    ck_assert_int_eq(send(fd, requests, len, 0), len);
+
+    size_t single_len = strlen(single), offset = 0;
+    for (size_t remaining = count * single_len; remaining > 0;) {
+        ssize_t n = recv(fd, response, remaining < sizeof(response) ? remaining : sizeof(response), 0);
+        ck_assert_int_gt(n, 0);
+        for (ssize_t j = 0; j < n; j++, offset++) {
+            ck_assert_msg(response[j] == single[offset % single_len], "unexpected byte %zu of the pipelined responses", offset);
+        }
+        remaining -= (size_t) n;
+    }
+
+    close(fd);
+    stop_server(pid);
+END_TEST
+
+START_TEST(test_server_request_id)
+    pid_t pid = start_server(&configurations[_i], TEST_PORT + _i);
+    int fd = connect_server(TEST_PORT + _i);
+    ck_assert_int_ge(fd, 0);
+
+    assert_request(fd, "0\nclient\n.\n", "0\n.\n");
+    assert_request(fd, "1\nmovie\n2\n3\n.\n", "0\n.\n");
+
+    // los pedidos con id pueden volver en cualquier orden, el ultimo sin id espera a todos
+    const char * requests = "6:1\nclient\nmovie\n2\n3\n10\n.\n" "3:2\n.\n" "4:3\nmovie\n.\n" "8\nclient\n.\n";
+    const char * expected[] = {"0:1\n.\n", "0:2\nmovie\n.\n", "0:3\nmovie\n2\n3\n.\n", "0\nmovie\n2\n3\n10\n.\n"};
+    size_t total = 0;
+    for (int i = 0; i < 4; i++) {
+        total += strlen(expected[i]);
+    }
+    ck_assert_int_eq(send(fd, requests, strlen(requests), 0), strlen(requests));
+
+    char response[RESPONSE_SIZE];
+    size_t received = 0;
+    while (received < total) {
+        ssize_t n = recv(fd, response + received, total - received, 0);
+        ck_assert_int_gt(n, 0);
+        received += (size_t) n;
+    }
+
+    bool answered[3] = {false};
+    size_t offset = 0;
+    for (int i = 0; i < 4; i++) {
+        MessageScanner scanner;
+        message_scanner_init(&scanner);
+        bool done;
+        size_t len = message_scan(&scanner, response + offset, received - offset, &done);
+        ck_assert(done);
+
+        uint32_t id;
+        if (i < 3) {
+            ck_assert(parse_message_id(response + offset, len, &id));
+            ck_assert(id >= 1 && id <= 3 && !answered[id - 1]);
+            answered[id - 1] = true;
+        } else {
+            ck_assert(!parse_message_id(response + offset, len, &id));
+            id = 4;
+        }
+        ck_assert_uint_eq(len, strlen(expected[id - 1]));
+        ck_assert_int_eq(memcmp(response + offset, expected[id - 1], len), 0);
+        offset += len;
+    }
+
+    // el id de un pedido binario vuelve en el encabezado de la respuesta
+    FrameWriter writer;
+    frame_writer_init(&writer, GET_MOVIES);
+    frame_writer_set_id(&writer, 70000);
+    send_frame(fd, &writer);
+    size_t len = receive(fd, response);
+    FrameReader reader;
+    FrameHeader header;
+    ck_assert(frame_reader_init(&reader, response, len, &header));
+    ck_assert_int_eq(header.code, RESPONSE_OK);
+    ck_assert(header.has_id);
+    ck_assert_uint_eq(header.id, 70000);
+    frame_writer_free(&writer);
+
+    close(fd);
+    stop_server(pid);
+END_TEST
+
+START_TEST(test_server_batch)
+    pid_t pid = start_server(&configurations[_i], TEST_PORT + _i);
+    int fd = connect_server(TEST_PORT + _i);
+    ck_assert_int_ge(fd, 0);
+    char request[RESPONSE_SIZE], expected[RESPONSE_SIZE];
+
+    assert_request(fd, "0\nclient\n.\n", "0\n.\n");
+    assert_request(fd, "1\nmovie\n2\n3\n.\n", "0\n.\n");
+
+    // seis asientos juntos en un solo pedido
+    char * aux = request + sprintf(request, "10\n");
+    for (int seat = 10; seat < 16; seat++) {
+        aux += sprintf(aux, "6\nclient\nmovie\n2\n3\n%d\n", seat);
+    }
+    sprintf(aux, ".\n");
+    assert_request(fd, request, "0\n.\n");
+
+    // el cuarto ya esta tomado: ALREADY_EXIST con su indice y no se reserva ninguno
+    aux = request + sprintf(request, "10\n");
+    for (int seat = 20; seat < 24; seat++) {
+        aux += sprintf(aux, "6\nclient\nmovie\n2\n3\n%d\n", seat == 23 ? 12 : seat);
+    }
+    sprintf(aux, ".\n");
+    sprintf(expected, "%d\n3\n.\n", ALREADY_EXIST);
+    assert_request(fd, request, expected);
+
+    seats_response(expected, 10, 16);
+    assert_request(fd, "5\nmovie\n2\n3\n.\n", expected);
+
+    aux = expected + sprintf(expected, "0\n");
+    for (int seat = 10; seat < 16; seat++) {
+        aux += sprintf(aux, "movie\n2\n3\n%d\n", seat);
+    }
+    sprintf(aux, ".\n");
+    assert_request(fd, "8\nclient\n.\n", expected);
+
+    // los mismos pedidos en binario, un argumento mal armado rechaza todo el lote
+    FrameWriter writer;
+    frame_writer_init(&writer, BATCH);
+    frame_put_int(&writer, REMOVE_BOOKING);
+    frame_put_string(&writer, "client");
+    frame_put_string(&writer, "movie");
+    frame_put_int(&writer, 2);
+    frame_put_int(&writer, 3);
+    frame_put_int(&writer, 10);
+    frame_put_int(&writer, GET_MOVIES);
+    send_frame(fd, &writer);
+    assert_frame_response(fd, RESPONSE_ERR, "");
+
+    frame_writer_reset(&writer, BATCH);
+    for (int seat = 10; seat < 12; seat++) {
+        frame_put_int(&writer, REMOVE_BOOKING);
+        frame_put_string(&writer, "client");
+        frame_put_string(&writer, "movie");
+        frame_put_int(&writer, 2);
+        frame_put_int(&writer, 3);
+        frame_put_int(&writer, seat);
+    }
+    send_frame(fd, &writer);
+    assert_frame_response(fd, RESPONSE_OK, "");
+    frame_writer_free(&writer);
+
+    aux = expected + sprintf(expected, "0\n");
+    for (int seat = 12; seat < 16; seat++) {
+        aux += sprintf(aux, "movie\n2\n3\n%d\n", seat);
+    }
+    sprintf(aux, ".\n");
+    assert_request(fd, "8\nclient\n.\n", expected);
+
+    close(fd);
+    stop_server(pid);
+END_TEST
+
+START_TEST(test_server_subscribe)
+    pid_t pid = start_server(&configurations[_i], TEST_PORT + _i);
+    int text = connect_server(TEST_PORT + _i);
+    int binary = connect_server(TEST_PORT + _i);
+    int fd = connect_server(TEST_PORT + _i);
+    ck_assert_int_ge(text, 0);
+    ck_assert_int_ge(binary, 0);
+    ck_assert_int_ge(fd, 0);
+    char expected[RESPONSE_SIZE];
+
+    assert_request(fd, "0\nclient\n.\n", "0\n.\n");
+    assert_request(fd, "1\nmovie\n2\n3\n.\n", "0\n.\n");
+    assert_request(fd, "1\nother\n2\n4\n.\n", "0\n.\n");
+    assert_request(fd, "6\nclient\nmovie\n2\n3\n4\n.\n", "0\n.\n");
+
+    // la suscripcion responde el mapa de asientos como GET_SEATS
+    seats_response(expected, 4, 5);
+    assert_request(text, "11\nmovie\n2\n3\n.\n", expected);
+    assert_request(text, "11\nmovie\n2\n5\n.\n", "7\n.\n");
+
+    FrameWriter writer;
+    frame_writer_init(&writer, SUBSCRIBE_SEATS);
+    frame_put_string(&writer, "movie");
+    frame_put_int(&writer, 2);
+    frame_put_int(&writer, 3);
+    send_frame(binary, &writer);
+    char response[RESPONSE_SIZE];
+    receive(binary, response);
+    ck_assert_int_eq(parse_request_type(response, frame_size(response)), RESPONSE_OK);
+
+    // cada cambio llega a todas las suscripciones, en el formato de cada una
+    assert_request(fd, "6\nclient\nmovie\n2\n3\n7\n.\n", "0\n.\n");
+    receive(text, response);
+    ck_assert_str_eq(response, "8\nmovie\n2\n3\n7\n0\n.\n");
+    assert_frame_response(binary, SEATS_CHANGED, "movie\n2\n3\n7\n0\n");
+
+    assert_request(fd, "7\nclient\nmovie\n2\n3\n4\n.\n", "0\n.\n");
+    receive(text, response);
+    ck_assert_str_eq(response, "8\nmovie\n2\n3\n4\n1\n.\n");
+    assert_frame_response(binary, SEATS_CHANGED, "movie\n2\n3\n4\n1\n");
+
+    // un BATCH avisa todos sus asientos de la funcion en un solo mensaje
+    assert_request(fd, "10\n6\nclient\nmovie\n2\n3\n8\n6\nclient\nother\n2\n4\n1\n"
+                       "6\nclient\nmovie\n2\n3\n9\n.\n", "0\n.\n");
+    receive(text, response);
+    ck_assert_str_eq(response, "8\nmovie\n2\n3\n8\n0\n9\n0\n.\n");
+    assert_frame_response(binary, SEATS_CHANGED, "movie\n2\n3\n8\n0\n9\n0\n");
+
+    // las escrituras que fallan o de otras funciones no avisan nada, tampoco cancelar una reserva ajena
+    assert_request(fd, "6\nclient\nmovie\n2\n3\n8\n.\n", "2\n.\n");
+    assert_request(fd, "0\nother\n.\n", "0\n.\n");
+    assert_request(fd, "7\nother\nmovie\n2\n3\n8\n.\n", "5\n.\n");
+    assert_request(fd, "10\n7\nclient\nmovie\n2\n3\n9\n7\nother\nmovie\n2\n3\n7\n.\n", "5\n1\n.\n");
+    assert_request(fd, "6\nclient\nother\n2\n4\n2\n.\n", "0\n.\n");
+    assert_request(text, "3\n.\n", "0\nmovie\nother\n.\n");
+
+    frame_writer_free(&writer);
+    close(binary);
+
+    // una conexion cerrada deja de estar suscripta
+    assert_request(fd, "7\nclient\nmovie\n2\n3\n8\n.\n", "0\n.\n");
+    receive(text, response);
+    ck_assert_str_eq(response, "8\nmovie\n2\n3\n8\n1\n.\n");
+
+    // borrar la funcion libera todos sus asientos, la suscripcion sigue si se vuelve a agregar
+    assert_request(fd, "2\nmovie\n2\n3\n.\n", "0\n.\n");
+    char * aux = expected + sprintf(expected, "8\nmovie\n2\n3\n");
+    for (int seat = 0; seat < SEATS; seat++) {
+        aux += sprintf(aux, "%d\n%d\n", seat, EMPTY_SEAT);
+    }
+    sprintf(aux, ".\n");
+    receive(text, response);
+    ck_assert_str_eq(response, expected);
+
+    assert_request(fd, "1\nmovie\n2\n3\n.\n", "0\n.\n");
+    assert_request(fd, "6\nclient\nmovie\n2\n3\n5\n.\n", "0\n.\n");
+    receive(text, response);
+    ck_assert_str_eq(response, "8\nmovie\n2\n3\n5\n0\n.\n");
+
+    close(text);
+    close(fd);
+    stop_server(pid);
+END_TEST
+
+
+START_TEST(test_server_cache)
+    pid_t pid = start_server(&configurations[_i], TEST_PORT + _i);
+    int fd = connect_server(TEST_PORT + _i);
+    ck_assert_int_ge(fd, 0);
+
+    assert_request(fd, "12\n.\n", "0\n0\n0\n.\n");
+    assert_request(fd, "1\nmovie\n2\n3\n.\n", "0\n.\n");
+
+    // el segundo pedido igual sale del cache, con el id de cada pedido
+    assert_request(fd, "3\n.\n", "0\nmovie\n.\n");
+    assert_request(fd, "3\n.\n", "0\nmovie\n.\n");
+    assert_request(fd, "4:7\nmovie\n.\n", "0:7\nmovie\n2\n3\n.\n");
+    assert_request(fd, "4:8\nmovie\n.\n", "0:8\nmovie\n2\n3\n.\n");
+    assert_request(fd, "4\nmovie\n.\n", "0\nmovie\n2\n3\n.\n");
+    assert_request(fd, "12:1\n.\n", "0:1\n3\n2\n.\n");
+
+    // un ADD_SHOWCASE, solo o dentro de un BATCH, invalida los listados
+    assert_request(fd, "1\nother\n4\n1\n.\n", "0\n.\n");
+    assert_request(fd, "3\n.\n", "0\nmovie\nother\n.\n");
+    assert_request(fd, "10\n1\nmovie\n5\n2\n.\n", "0\n.\n");
+    assert_request(fd, "4\nmovie\n.\n", "0\nmovie\n2\n3\nmovie\n5\n2\n.\n");
+
+    // las reservas no tocan los listados
+    assert_request(fd, "0\nclient\n.\n", "0\n.\n");
+    assert_request(fd, "6\nclient\nmovie\n2\n3\n4\n.\n", "0\n.\n");
+    assert_request(fd, "4\nmovie\n.\n", "0\nmovie\n2\n3\nmovie\n5\n2\n.\n");
+
+    // en binario el id va en el encabezado de la respuesta guardada
+    FrameWriter writer;
+    frame_writer_init(&writer, GET_MOVIES);
+    send_frame(fd, &writer);
+    assert_frame_response(fd, RESPONSE_OK, "movie\nother\n");
+    frame_writer_reset(&writer, GET_MOVIES);
+    frame_writer_set_id(&writer, 9);
+    send_frame(fd, &writer);
+    char response[RESPONSE_SIZE];
+    size_t len = receive(fd, response);
+    uint32_t id;
+    ck_assert(parse_message_id(response, len, &id));
+    ck_assert_uint_eq(id, 9);
+
+    frame_writer_reset(&writer, CACHE_STATS);
+    send_frame(fd, &writer);
+    assert_frame_response(fd, RESPONSE_OK, "5\n5\n");
+    frame_writer_free(&writer);
+
+    close(fd);
+    stop_server(pid);
+END_TEST
+
+/** Funciones con todos sus asientos reservados, el listado no entra en el pipe de la base de datos */
+#define LISTING_DAYS    16
+#define LISTING_SIZE    (LISTING_DAYS * ROOMS * SEATS * 32)
+
+START_TEST(test_server_large_listing)
+    pid_t pid = start_server(&configurations[_i], TEST_PORT + _i);
+    int fd = connect_server(TEST_PORT + _i);
+    ck_assert_int_ge(fd, 0);
+    char request[RESPONSE_SIZE];
+    char * expected = malloc(LISTING_SIZE);
+    char * response = malloc(LISTING_SIZE);
+    ck_assert_ptr_ne(expected, NULL);
+    ck_assert_ptr_ne(response, NULL);
+
+    assert_request(fd, "0\nclient\n.\n", "0\n.\n");
+    char * listing = expected + sprintf(expected, "0\n");
+    for (int day = 0; day < LISTING_DAYS; day++) {
+        for (int room = 0; room < ROOMS; room++) {
+            sprintf(request, "1\nmovie\n%d\n%d\n.\n", day, room);
+            assert_request(fd, request, "0\n.\n");
+            for (int first = 0; first < SEATS; first += MAX_BATCH_REQUESTS) {
+                char * aux = request + sprintf(request, "10\n");
+                for (int seat = first; seat < first + MAX_BATCH_REQUESTS; seat++) {
+                    aux += sprintf(aux, "6\nclient\nmovie\n%d\n%d\n%d\n", day, room, seat);
+                    listing += sprintf(listing, "movie\n%d\n%d\n%d\n", day, room, seat);
+                }
+                sprintf(aux, ".\n");
+                assert_request(fd, request, "0\n.\n");
+            }
+        }
+    }
+    sprintf(listing, ".\n");
+
+    const char * get_booking = "8\nclient\n.\n";
+    ck_assert_int_eq(send(fd, get_booking, strlen(get_booking), 0), strlen(get_booking));
+    ck_assert_uint_eq(receive_into(fd, response, LISTING_SIZE), strlen(expected));
+    ck_assert_str_eq(response, expected);
+
+    // en binario el fin sale del largo del encabezado, y la conexion sigue respondiendo despues
+    FrameWriter writer;
+    frame_writer_init(&writer, GET_BOOKING);
+    frame_put_string(&writer, "client");
+    send_frame(fd, &writer);
+    frame_writer_free(&writer);
+    size_t len = receive_into(fd, response, LISTING_SIZE);
+    ck_assert_uint_eq(len, frame_size(response));
+
+    FrameReader reader;
+    FrameHeader header;
+    char arg[ARG_SIZE];
+    ck_assert(frame_reader_init(&reader, response, len, &header));
+    ck_assert_int_eq(header.code, RESPONSE_OK);
+    ck_assert_int_eq(header.argc, 4 * LISTING_DAYS * ROOMS * SEATS);
+    for (int i = 0; i < header.argc; i++) {
+        ck_assert(frame_next_arg(&reader, arg, sizeof(arg)));
+    }
+    ck_assert_str_eq(arg, "79");
+
+    assert_request(fd, "9\nclient\n.\n", "0\n.\n");
+
+    free(expected);
+    free(response);
+    close(fd);
+    stop_server(pid);
+END_TEST
+
+START_TEST(test_server_database_respawn)
+    pid_t pid = start_server(&configurations[_i], TEST_PORT + _i);
+    int fd = connect_server(TEST_PORT + _i);
+    ck_assert_int_ge(fd, 0);
+    assert_request(fd, "0\nclient\n.\n", "0\n.\n");
+    assert_request(fd, "1\nmovie\n2\n3\n.\n", "0\n.\n");
+    close(fd);
+
+    ck_assert_int_ge(kill_databases(pid), atoi(WORKERS));
+
+    // cada pedido que cae en un proceso muerto cierra su conexion y el proceso se reemplaza,
+    // hasta que una ronda de lecturas y escrituras concurrentes sale entera
+    bool recovered = false;
+    for (int round = 0; round < 10 && !recovered; round++) {
+        int fds[CLIENTS];
+        for (int i = 0; i < CLIENTS; i++) {
+            fds[i] = connect_server(TEST_PORT + _i);
+            ck_assert_int_ge(fds[i], 0);
+        }
+        recovered = true;
+        for (int i = 0; i < CLIENTS; i++) {
+            char req[RESPONSE_SIZE];
+            if (i % 2 == 0) {
+                sprintf(req, "8\nclient\n.\n");
+            } else {
+                sprintf(req, "6\nclient\nmovie\n2\n3\n%d\n.\n", round * CLIENTS + i);
+            }
+            recovered = try_request(fds[i], req) && recovered;
+        }
+        for (int i = 0; i < CLIENTS; i++) {
+            close(fds[i]);
+        }
+    }
+    ck_assert(recovered);
+
+    stop_server(pid);
+END_TEST
+
+START_TEST(test_server_init_failed)
+    // el puerto ya esta ocupado: el server no arranca y no deja el archivo de su socket Unix
+    int port = TEST_PORT + 101;
+    int busy = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons((uint16_t) port),
+                               .sin_addr.s_addr = htonl(INADDR_ANY)};
+    ck_assert_int_ge(busy, 0);
+    ck_assert_int_eq(bind(busy, (struct sockaddr *) &addr, sizeof(addr)), 0);
+    ck_assert_int_eq(listen(busy, 1), 0);
+
+    int status;
+    pid_t pid = start_server(&configurations[0], port);
+    ck_assert_int_eq(waitpid(pid, &status, 0), pid);
+    ck_assert(WIFEXITED(status) && WEXITSTATUS(status) != 0);
+
+    char path[64];
+    unix_path(port, path, sizeof(path));
+    ck_assert(access(path, F_OK) < 0);
+    close(busy);
+END_TEST
+
+Suite * suite(void) {
+    Suite *s   = suite_create("server");
+    TCase *tc  = tcase_create("server");
+
+    tcase_set_timeout(tc, 30);
+    tcase_add_loop_test(tc, test_server_booking, 0, CONFIGURATIONS);
+    tcase_add_loop_test(tc, test_server_unix_socket, 0, CONFIGURATIONS);
+    tcase_add_loop_test(tc, test_server_concurrent_clients, 0, CONFIGURATIONS);
+    tcase_add_loop_test(tc, test_server_concurrent_booking, 0, CONFIGURATIONS);
+    tcase_add_loop_test(tc, test_server_booking_burst, 0, CONFIGURATIONS);
+    tcase_add_loop_test(tc, test_server_binary, 0, CONFIGURATIONS);
+    tcase_add_loop_test(tc, test_server_pipelining, 0, CONFIGURATIONS);
+    tcase_add_loop_test(tc, test_server_request_id, 0, CONFIGURATIONS);
+    tcase_add_loop_test(tc, test_server_batch, 0, CONFIGURATIONS);
+    tcase_add_loop_test(tc, test_server_subscribe, 0, CONFIGURATIONS);
+    tcase_add_loop_test(tc, test_server_cache, 0, CONFIGURATIONS);
+    tcase_add_loop_test(tc, test_server_large_listing, 0, CONFIGURATIONS);
+    tcase_add_loop_test(tc, test_server_database_respawn, 0, CONFIGURATIONS);
+    tcase_add_test(tc, test_server_init_failed);
+    suite_add_tcase(s, tc);
+
+    return s;
+}
+
+int main(int argc, char * argv[]) {
+    int number_failed;
+    SRunner *sr = srunner_create(suite());
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,244 @@
+#include <check.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <message.h>
+
+/**
+ * Tormenta de reconexiones: todos los kioscos se conectan a la vez (como despues de un
+ * corte de red) y cada uno hace un GET_MOVIES. Se compara la cola de 10 conexiones de
+ * antes contra la configurable, con uno y con varios sockets en SO_REUSEPORT. Se mide
+ * cuanto tarda cada kiosco desde el connect hasta la respuesta; los que no se atienden
+ * en STORM_TIMEOUT_MS no cuentan. Se corre desde el directorio donde se generan los binarios.
+ *
+ * Uso: storm_bench [kioscos]
+ */
+
+#define SERVER_PROC         "./server"
+#define BENCH_DATABASE      "storm_bench.db"
+#define BENCH_PORT          22545
+#define DEFAULT_KIOSKS      256
+#define STORM_TIMEOUT_MS    5000
+
+static int kiosks = DEFAULT_KIOSKS;
+
+static const char request[] = "3\n.\n";
+
+/** Opciones del server en cada corrida */
+typedef struct {
+    const char * name;
+    const char * mode;
+    const char * backlog;
+    const char * acceptors;
+} StormConfiguration;
+
+static const StormConfiguration configurations[] = {
+        {"threads, backlog 10",    "threads", "10",   "1"},
+        {"threads, backlog 4096",  "threads", "4096", "1"},
+        {"threads, 4 acceptors",   "threads", "4096", "4"},
+        {"epoll, 4 acceptors",     "epoll",   "4096", "4"},
+};
+#define CONFIGURATIONS (sizeof(configurations) / sizeof(configurations[0]))
+
+/** Un kiosco: se conecta, pide y espera la respuesta */
+typedef struct {
+    int fd;
+    bool connected;
+    MessageScanner scanner;
+} Kiosk;
+
+static double elapsed_ms(const struct timespec * start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e3 + (end.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static struct sockaddr_in server_address(void) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t) BENCH_PORT);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    return addr;
+}
+
+/** Espera a que el server acepte conexiones */
+static void wait_server(void) {
+    struct sockaddr_in addr = server_address();
+    struct timespec wait = {.tv_sec = 0, .tv_nsec = 20 * 1000 * 1000};
+
+    for (int i = 0; i < 250; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        ck_assert_int_ge(fd, 0);
+        int ret = connect(fd, (struct sockaddr *) &addr, sizeof(addr));
+        close(fd);
+        if (ret == 0) {
+            return;
+        }
+        nanosleep(&wait, NULL);
+    }
+    ck_assert_msg(false, "server did not start");
+}
+
+static pid_t start_server(const StormConfiguration * configuration) {
+    char port[8];
+    snprintf(port, sizeof(port), "%d", BENCH_PORT);
+    unlink(BENCH_DATABASE);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        char * argv[] = {"server", "-p", port, "-f", BENCH_DATABASE, "-m", (char *) configuration->mode, "-w", "2",
+                         "-b", (char *) configuration->backlog, "-a", (char *) configuration->acceptors, NULL};
+        execv(SERVER_PROC, argv);
+        perror("execv() failed");
+        exit(EXIT_FAILURE);
+    }
+
+    wait_server();
+    return pid;
+}
+
+static void stop_server(pid_t pid) {
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    unlink(BENCH_DATABASE);
+}
+
+static int compare_latency(const void * a, const void * b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/** Lanza la tormenta, deja en latencies los ms de cada kiosco atendido y retorna cuantos fueron */
+static int storm(double * latencies) {
+    Kiosk * all = calloc((size_t) kiosks, sizeof(*all));
+    struct pollfd * fds = calloc((size_t) kiosks, sizeof(*fds));
+    ck_assert_ptr_ne(all, NULL);
+    ck_assert_ptr_ne(fds, NULL);
+    struct sockaddr_in addr = server_address();
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < kiosks; i++) {
+        all[i].fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        ck_assert_int_ge(all[i].fd, 0);
+        message_scanner_init(&all[i].scanner);
+        if (connect(all[i].fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+            close(all[i].fd);
+            all[i].fd = -1;
+        }
+        fds[i].fd     = all[i].fd;
+        fds[i].events = POLLOUT;
+    }
+
+    int served = 0, pending = kiosks;
+    for (int i = 0; i < kiosks; i++) {
+        pending -= all[i].fd < 0;
+    }
+    while (pending > 0 && elapsed_ms(&start) < STORM_TIMEOUT_MS) {
+        if (poll(fds, (nfds_t) kiosks, 100) <= 0) {
+            continue;
+        }
+        for (int i = 0; i < kiosks; i++) {
+            Kiosk * kiosk = &all[i];
+            bool failed = false;
+            if (fds[i].fd < 0 || fds[i].revents == 0) {
+                continue;
+            }
+
+            if (!kiosk->connected) {
+                int error = 0;
+                socklen_t len = sizeof(error);
+                getsockopt(kiosk->fd, SOL_SOCKET, SO_ERROR, &error, &len);
+                kiosk->connected = error == 0;
+                failed = error != 0 || send(kiosk->fd, request, strlen(request), MSG_NOSIGNAL) != (ssize_t) strlen(request);
+                fds[i].events = POLLIN;
+            } else {
+                char buffer[256];
+                bool done = false;
+                ssize_t n = recv(kiosk->fd, buffer, sizeof(buffer), 0);
+                failed = n <= 0;
+                if (n > 0) {
+                    message_scan(&kiosk->scanner, buffer, (size_t) n, &done);
+                }
+                if (done) {
+                    latencies[served++] = elapsed_ms(&start);
+                    close(kiosk->fd);
+                    fds[i].fd = -1;
+                    pending--;
+                }
+            }
+            if (failed) {
+                close(kiosk->fd);
+                fds[i].fd = -1;
+                pending--;
+            }
+        }
+    }
+
+    for (int i = 0; i < kiosks; i++) {
+        if (fds[i].fd >= 0) {
+            close(fds[i].fd);
+        }
+    }
+    free(all);
+    free(fds);
+    return served;
+}
+
+START_TEST(test_storm_bench)
+    double * latencies = calloc((size_t) kiosks, sizeof(*latencies));
+    ck_assert_ptr_ne(latencies, NULL);
+
+    fprintf(stderr, "%d kiosks connecting at once, each one sends a GET_MOVIES\n", kiosks);
+    fprintf(stderr, "  %-24s %8s %10s %10s %10s\n", "", "served", "p50 ms", "p99 ms", "max ms");
+    for (size_t c = 0; c < CONFIGURATIONS; c++) {
+        pid_t pid = start_server(&configurations[c]);
+        int served = storm(latencies);
+        stop_server(pid);
+
+        ck_assert_int_gt(served, 0);
+        qsort(latencies, (size_t) served, sizeof(*latencies), compare_latency);
+        fprintf(stderr, "  %-24s %8d %10.1f %10.1f %10.1f\n", configurations[c].name, served,
+                latencies[served / 2], latencies[served * 99 / 100], latencies[served - 1]);
+    }
+
+    free(latencies);
+END_TEST
+
+Suite * suite(void) {
+    Suite *s   = suite_create("storm_bench");
+    TCase *tc  = tcase_create("storm_bench");
+
+    tcase_set_timeout(tc, 120);
+    tcase_add_test(tc, test_storm_bench);
+    suite_add_tcase(s, tc);
+
+    return s;
+}
+
+int main(int argc, char * argv[]) {
+    if (argc > 1) {
+        kiosks = atoi(argv[1]) > 0 ? atoi(argv[1]) : DEFAULT_KIOSKS;
+    }
+
+    int number_failed;
+    SRunner *sr = srunner_create(suite());
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
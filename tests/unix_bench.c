@@ -0,0 +1,233 @@
+#include <check.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <utils.h>
+#include <message.h>
+
+/**
+ * Latencia de un front-end local segun por donde llega al server: TCP por loopback, un
+ * socket Unix con archivo o uno en el namespace abstracto. Un cliente hace pedidos uno
+ * detras de otro: GET_MOVIES, que responde el cache del server, y GET_SEATS, que llega a
+ * la base. Tambien se mide cuanto tarda el connect, para los front-ends que abren una
+ * conexion por pedido. Se corre desde el directorio donde se generan los binarios.
+ *
+ * Uso: unix_bench [pedidos]
+ */
+
+#define SERVER_PROC         "./server"
+#define BENCH_DATABASE      "unix_bench.db"
+#define BENCH_PORT          22745
+#define BENCH_SOCKET        "unix_bench.sock"
+#define BENCH_ABSTRACT      "@unix_bench"
+#define DEFAULT_REQUESTS    5000
+
+static int requests = DEFAULT_REQUESTS;
+
+static const char movies_request[] = "3\n.\n";
+static const char seats_request[] = "5\nmovie\n2\n3\n.\n";
+
+static const char * modes[] = {"threads", "epoll", "uring"};
+#define MODES (sizeof(modes) / sizeof(modes[0]))
+
+/** Por donde se conecta el cliente. NULL es TCP, sino el socket Unix con el que se levanta el server */
+static const char * transports[] = {NULL, BENCH_SOCKET, BENCH_ABSTRACT};
+#define TRANSPORTS (sizeof(transports) / sizeof(transports[0]))
+
+typedef struct {
+    struct sockaddr_storage addr;
+    socklen_t len;
+} Address;
+
+static double elapsed_us(const struct timespec * start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e6 + (end.tv_nsec - start->tv_nsec) / 1e3;
+}
+
+static int compare_latency(const void * a, const void * b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static Address server_address(const char * unix_path) {
+    Address address;
+    memset(&address, 0, sizeof(address));
+
+    if (unix_path != NULL) {
+        address.len = unix_address(unix_path, (struct sockaddr_un *) &address.addr);
+    } else {
+        struct sockaddr_in * addr = (struct sockaddr_in *) &address.addr;
+        addr->sin_family = AF_INET;
+        addr->sin_port = htons((uint16_t) BENCH_PORT);
+        addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+        address.len = sizeof(*addr);
+    }
+    return address;
+}
+
+static int connect_address(const Address * address) {
+    int fd = socket(address->addr.ss_family, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (const struct sockaddr *) &address->addr, address->len) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/** Levanta el server escuchando tambien en unix_path y espera a que acepte conexiones */
+static pid_t start_server(const char * mode, const char * unix_path) {
+    char port[8];
+    snprintf(port, sizeof(port), "%d", BENCH_PORT);
+    unlink(BENCH_DATABASE);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        char * argv[] = {"server", "-p", port, "-f", BENCH_DATABASE, "-m", (char *) mode, "-w", "2",
+                         "-u", (char *) unix_path, NULL};
+        execv(SERVER_PROC, argv);
+        perror("execv() failed");
+        exit(EXIT_FAILURE);
+    }
+
+    // el socket Unix escucha antes que el puerto
+    Address address = server_address(NULL);
+    struct timespec wait = {.tv_sec = 0, .tv_nsec = 20 * 1000 * 1000};
+    int fd = -1;
+    for (int i = 0; i < 250 && fd < 0; i++) {
+        fd = connect_address(&address);
+        if (fd < 0) {
+            nanosleep(&wait, NULL);
+        }
+    }
+    ck_assert_int_ge(fd, 0);
+    close(fd);
+    return pid;
+}
+
+static void stop_server(pid_t pid) {
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    unlink(BENCH_DATABASE);
+    unlink(BENCH_SOCKET);
+}
+
+/** Manda el pedido y espera la respuesta completa */
+static void round_trip(int fd, const char * request) {
+    char buffer[4096];
+    MessageScanner scanner;
+    bool done = false;
+
+    message_scanner_init(&scanner);
+    ck_assert_int_eq(send(fd, request, strlen(request), MSG_NOSIGNAL), strlen(request));
+    while (!done) {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        ck_assert_int_gt(n, 0);
+        message_scan(&scanner, buffer, (size_t) n, &done);
+    }
+}
+
+/** Latencia de cada pedido, uno detras de otro por la misma conexion, ordenadas */
+static void measure_requests(const Address * address, const char * request, double * latencies) {
+    int fd = connect_address(address);
+    ck_assert_int_ge(fd, 0);
+
+    for (int i = 0; i < requests; i++) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        round_trip(fd, request);
+        latencies[i] = elapsed_us(&start);
+    }
+    close(fd);
+    qsort(latencies, (size_t) requests, sizeof(*latencies), compare_latency);
+}
+
+/** Latencia de conectarse y hacer un GET_MOVIES, con una conexion nueva cada vez, ordenadas */
+static void measure_connections(const Address * address, double * latencies) {
+    int count = requests / 10 > 0 ? requests / 10 : 1;
+
+    for (int i = 0; i < count; i++) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int fd = connect_address(address);
+        ck_assert_int_ge(fd, 0);
+        round_trip(fd, movies_request);
+        latencies[i] = elapsed_us(&start);
+        close(fd);
+    }
+    qsort(latencies, (size_t) count, sizeof(*latencies), compare_latency);
+}
+
+START_TEST(test_unix_bench)
+    double * latencies = calloc((size_t) requests, sizeof(*latencies));
+    ck_assert_ptr_ne(latencies, NULL);
+    int connections = requests / 10 > 0 ? requests / 10 : 1;
+
+    fprintf(stderr, "%d requests one at a time on one connection, %d connections with one GET_MOVIES each\n",
+            requests, connections);
+    fprintf(stderr, "  %-20s %14s %14s %14s\n", "", "GET_MOVIES us", "GET_SEATS us", "connect us");
+    fprintf(stderr, "  %-20s %14s %14s %14s\n", "", "p50 / p99", "p50 / p99", "p50 / p99");
+    for (size_t m = 0; m < MODES; m++) {
+        for (size_t t = 0; t < TRANSPORTS; t++) {
+            // con TCP el server igual escucha en el archivo, como cuando hay front-ends locales
+            pid_t pid = start_server(modes[m], transports[t] != NULL ? transports[t] : BENCH_SOCKET);
+            Address address = server_address(transports[t]);
+            ck_assert_int_gt(address.len, 0);
+
+            double movies[2], seats[2], connection[2];
+            measure_requests(&address, movies_request, latencies);
+            movies[0] = latencies[requests / 2];
+            movies[1] = latencies[requests * 99 / 100];
+            measure_requests(&address, seats_request, latencies);
+            seats[0] = latencies[requests / 2];
+            seats[1] = latencies[requests * 99 / 100];
+            measure_connections(&address, latencies);
+            connection[0] = latencies[connections / 2];
+            connection[1] = latencies[connections * 99 / 100];
+            stop_server(pid);
+
+            char name[32];
+            snprintf(name, sizeof(name), "%s, %s", modes[m],
+                     transports[t] == NULL ? "tcp" : transports[t][0] == '@' ? "abstract" : "unix");
+            fprintf(stderr, "  %-20s %6.1f / %6.1f %6.1f / %6.1f %6.1f / %6.1f\n", name,
+                    movies[0], movies[1], seats[0], seats[1], connection[0], connection[1]);
+        }
+    }
+
+    free(latencies);
+END_TEST
+
+Suite * suite(void) {
+    Suite *s   = suite_create("unix_bench");
+    TCase *tc  = tcase_create("unix_bench");
+
+    tcase_set_timeout(tc, 300);
+    tcase_add_test(tc, test_unix_bench);
+    suite_add_tcase(s, tc);
+
+    return s;
+}
+
+int main(int argc, char * argv[]) {
+    if (argc > 1) {
+        requests = atoi(argv[1]) > 0 ? atoi(argv[1]) : DEFAULT_REQUESTS;
+    }
+
+    int number_failed;
+    SRunner *sr = srunner_create(suite());
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}